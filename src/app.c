@@ -17,6 +17,7 @@ int main(int argc, char *argv[])
         return 1;
     }
     check_sys_config();
+    init_distances();
     init_db_log();
     if (parse_config(argv[1]) != 0) {
         return 2;
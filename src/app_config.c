@@ -11,9 +11,18 @@ int parse_config(const char * const file)
     char *cfg_log_file_name = NULL;
     char *cfg_timeout_s = NULL;    
     char *cfg_nb_workers_s = NULL;
+    char *cfg_nb_event_loops_s = NULL;
+    char *cfg_workers_cpus_s = NULL;
+    char *cfg_event_loops_cpus_s = NULL;
     char *cfg_max_queued_replies_s = NULL;
+    char *cfg_max_queued_reads_s = NULL;
+    char *cfg_max_queued_writes_s = NULL;
+    char *cfg_reads_weight_s = NULL;
+    char *cfg_writes_weight_s = NULL;
+    char *cfg_write_batch_size_s = NULL;
     char *cfg_default_layer_type_s = NULL;
     char *cfg_default_accuracy_s = NULL;
+    char *cfg_default_index_type_s = NULL;
     char *cfg_bucket_size_s = NULL;
     char *cfg_dimension_accuracy_s = NULL;
     char *cfg_db_log_file_name = NULL;
@@ -31,9 +40,18 @@ int parse_config(const char * const file)
         { "LogFileName",            &cfg_log_file_name },
         { "Timeout",                &cfg_timeout_s },
         { "Workers",                &cfg_nb_workers_s },
+        { "EventLoops",             &cfg_nb_event_loops_s },
+        { "WorkersCPUs",            &cfg_workers_cpus_s },
+        { "EventLoopsCPUs",         &cfg_event_loops_cpus_s },
         { "MaxQueuedReplies",       &cfg_max_queued_replies_s },
+        { "MaxQueuedReads",         &cfg_max_queued_reads_s },
+        { "MaxQueuedWrites",        &cfg_max_queued_writes_s },
+        { "ReadsWeight",            &cfg_reads_weight_s },
+        { "WritesWeight",           &cfg_writes_weight_s },
+        { "WriteBatchSize",         &cfg_write_batch_size_s },
         { "DefaultLayerType",       &cfg_default_layer_type_s },
         { "Accuracy",               &cfg_default_accuracy_s },
+        { "DefaultIndex",           &cfg_default_index_type_s },
         { "BucketSize",             &cfg_bucket_size_s },
         { "DimensionAccuracy",      &cfg_dimension_accuracy_s },
         { "DBFileName",             &cfg_db_log_file_name },
@@ -52,9 +70,18 @@ int parse_config(const char * const file)
     app_context.log_file_name = NULL;    
     app_context.timeout = DEFAULT_CLIENT_TIMEOUT;
     app_context.nb_workers = NB_WORKERS;
+    app_context.nb_event_loops = NB_EVENT_LOOPS;
+    app_context.workers_cpus = (CPUSet) { .cpus = NULL, .nb_cpus = 0U };
+    app_context.event_loops_cpus = (CPUSet) { .cpus = NULL, .nb_cpus = 0U };
     app_context.max_queued_replies = MAX_QUEUED_REPLIES;
+    app_context.max_queued_reads = MAX_QUEUED_READS;
+    app_context.max_queued_writes = MAX_QUEUED_WRITES;
+    app_context.reads_weight = READS_WEIGHT;
+    app_context.writes_weight = WRITES_WEIGHT;
+    app_context.write_batch_size = WRITE_BATCH_SIZE;
     app_context.default_layer_type = DEFAULT_LAYER_TYPE;
     app_context.default_accuracy = DEFAULT_ACCURACY;
+    app_context.default_index_type = DEFAULT_INDEX_TYPE;
     app_context.bucket_size = BUCKET_SIZE;
     app_context.dimension_accuracy = DEFAULT_DIMENSION_ACCURACY;
     if (app_context.server_port == NULL) {
@@ -123,6 +150,23 @@ int parse_config(const char * const file)
             ret = -1;
         }
     }
+    if (cfg_nb_event_loops_s != NULL) {
+        app_context.nb_event_loops =
+            strtoul(cfg_nb_event_loops_s, &endptr, 10);
+        if (endptr == NULL || endptr == cfg_nb_event_loops_s ||
+            app_context.nb_event_loops <= 0U) {
+            ret = -1;
+        }
+    }
+    if (cfg_workers_cpus_s != NULL &&
+        parse_cpu_set(&app_context.workers_cpus, cfg_workers_cpus_s) != 0) {
+        ret = -1;
+    }
+    if (cfg_event_loops_cpus_s != NULL &&
+        parse_cpu_set(&app_context.event_loops_cpus,
+                      cfg_event_loops_cpus_s) != 0) {
+        ret = -1;
+    }
     if (cfg_max_queued_replies_s != NULL) {
         app_context.max_queued_replies =
             (size_t) strtoull(cfg_max_queued_replies_s, &endptr, 10);
@@ -131,6 +175,44 @@ int parse_config(const char * const file)
             ret = -1;
         }
     }
+    if (cfg_max_queued_reads_s != NULL) {
+        app_context.max_queued_reads =
+            (size_t) strtoull(cfg_max_queued_reads_s, &endptr, 10);
+        if (endptr == NULL || endptr == cfg_max_queued_reads_s ||
+            app_context.max_queued_reads <= (size_t) 0U) {
+            ret = -1;
+        }
+    }
+    if (cfg_max_queued_writes_s != NULL) {
+        app_context.max_queued_writes =
+            (size_t) strtoull(cfg_max_queued_writes_s, &endptr, 10);
+        if (endptr == NULL || endptr == cfg_max_queued_writes_s ||
+            app_context.max_queued_writes <= (size_t) 0U) {
+            ret = -1;
+        }
+    }
+    if (cfg_reads_weight_s != NULL) {
+        app_context.reads_weight = strtoul(cfg_reads_weight_s, &endptr, 10);
+        if (endptr == NULL || endptr == cfg_reads_weight_s ||
+            app_context.reads_weight <= 0U) {
+            ret = -1;
+        }
+    }
+    if (cfg_writes_weight_s != NULL) {
+        app_context.writes_weight = strtoul(cfg_writes_weight_s, &endptr, 10);
+        if (endptr == NULL || endptr == cfg_writes_weight_s ||
+            app_context.writes_weight <= 0U) {
+            ret = -1;
+        }
+    }
+    if (cfg_write_batch_size_s != NULL) {
+        app_context.write_batch_size =
+            (size_t) strtoull(cfg_write_batch_size_s, &endptr, 10);
+        if (endptr == NULL || endptr == cfg_write_batch_size_s ||
+            app_context.write_batch_size <= (size_t) 0U) {
+            ret = -1;
+        }
+    }
     if (cfg_default_layer_type_s != NULL) {
         if (strcasecmp(cfg_default_layer_type_s, "flat") == 0) {
             app_context.default_layer_type = LAYER_TYPE_FLAT;
@@ -160,6 +242,15 @@ int parse_config(const char * const file)
             ret = -1;
         }
     }
+    if (cfg_default_index_type_s != NULL) {
+        if (strcasecmp(cfg_default_index_type_s, "quadtree") == 0) {
+            app_context.default_index_type = INDEX_TYPE_QUADTREE;
+        } else if (strcasecmp(cfg_default_index_type_s, "morton") == 0) {
+            app_context.default_index_type = INDEX_TYPE_MORTON;
+        } else {
+            ret = -1;
+        }
+    }
     if (cfg_bucket_size_s != NULL) {
         app_context.bucket_size =
             (size_t) strtoull(cfg_bucket_size_s, &endptr, 10);
@@ -234,9 +325,18 @@ int parse_config(const char * const file)
     free(cfg_daemonize_s);
     free(cfg_timeout_s);    
     free(cfg_nb_workers_s);
+    free(cfg_nb_event_loops_s);
+    free(cfg_workers_cpus_s);
+    free(cfg_event_loops_cpus_s);
     free(cfg_max_queued_replies_s);
+    free(cfg_max_queued_reads_s);
+    free(cfg_max_queued_writes_s);
+    free(cfg_reads_weight_s);
+    free(cfg_writes_weight_s);
+    free(cfg_write_batch_size_s);
     free(cfg_default_layer_type_s);
     free(cfg_default_accuracy_s);
+    free(cfg_default_index_type_s);
     free(cfg_bucket_size_s);
     free(cfg_dimension_accuracy_s);
     free(cfg_journal_buffer_size_s);
@@ -296,4 +396,6 @@ void free_config(void)
     app_context.replication_slave_ip = NULL;
     free(app_context.replication_slave_port);
     app_context.replication_slave_port = NULL;
+    free_cpu_set(&app_context.workers_cpus);
+    free_cpu_set(&app_context.event_loops_cpus);
 }
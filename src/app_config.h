@@ -5,9 +5,27 @@
 #ifndef NB_WORKERS
 # define NB_WORKERS         10U
 #endif
+#ifndef NB_EVENT_LOOPS
+# define NB_EVENT_LOOPS     1U
+#endif
 #ifndef MAX_QUEUED_REPLIES
 # define MAX_QUEUED_REPLIES 10000U
 #endif
+#ifndef MAX_QUEUED_READS
+# define MAX_QUEUED_READS   10000U
+#endif
+#ifndef MAX_QUEUED_WRITES
+# define MAX_QUEUED_WRITES  10000U
+#endif
+#ifndef READS_WEIGHT
+# define READS_WEIGHT       1U
+#endif
+#ifndef WRITES_WEIGHT
+# define WRITES_WEIGHT      4U
+#endif
+#ifndef WRITE_BATCH_SIZE
+# define WRITE_BATCH_SIZE   32U
+#endif
 #ifndef BUCKET_SIZE
 # define BUCKET_SIZE 50U
 #endif
@@ -20,6 +38,9 @@
 #ifndef DEFAULT_LAYER_TYPE
 # define DEFAULT_LAYER_TYPE LAYER_TYPE_ELLIPSOIDAL
 #endif
+#ifndef DEFAULT_INDEX_TYPE
+# define DEFAULT_INDEX_TYPE INDEX_TYPE_QUADTREE
+#endif
 #ifndef DEFAULT_SERVER_PORT
 # define DEFAULT_SERVER_PORT "4269"
 #endif
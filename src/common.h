@@ -33,6 +33,9 @@
 #include <syslog.h>
 #include <sys/socket.h>
 #include <netdb.h>
+#ifdef HAVE_SYS_EVENTFD_H
+# include <sys/eventfd.h>
+#endif
 #include "ext/queue.h"
 #include "ext/tree.h"
 #include <yajl_parse.h>
@@ -42,20 +45,27 @@
 #include <event2/listener.h>
 #include "app_config.h"
 #include "slab.h"
+#include "pool.h"
 #include "cqueue.h"
+#include "prwlock.h"
+#include "cpu_affinity.h"
 #include "keys.h"
 #include "stack.h"
+#include "heap.h"
 #include "slipmap.h"
 #include "pandb.h"
 #include "key_nodes.h"
 #include "utils.h"
+#include "distances.h"
 #include "db_log.h"
 #include "log.h"
 
 #define INT_PROPERTY_COMMON_PREFIX     '_'
 #define INT_PROPERTY_TYPE              "_type"
+#define INT_PROPERTY_KEY               "_key"
 #define INT_PROPERTY_EXPIRES_AT        "_expires_at"
 #define INT_PROPERTY_POSITION          "_loc"
+#define INT_PROPERTY_POLYGON           "_polygon"
 #define INT_PROPERTY_DELETE_PREFIX     "_delete:"
 #define INT_PROPERTY_DELETE_ALL_PREFIX "_delete_all"
 #define INT_PROPERTY_ADD_INT_PREFIX    "_add_int:"
@@ -74,9 +84,18 @@ typedef struct AppContext_ {
     char *log_file_name;
     int timeout;
     unsigned int nb_workers;
+    unsigned int nb_event_loops;
+    CPUSet workers_cpus;
+    CPUSet event_loops_cpus;
     size_t max_queued_replies;
+    size_t max_queued_reads;
+    size_t max_queued_writes;
+    unsigned int reads_weight;
+    unsigned int writes_weight;
+    size_t write_batch_size;
     LayerType default_layer_type;
     Accuracy default_accuracy;
+    IndexType default_index_type;
     size_t bucket_size;
     Dimension dimension_accuracy;
     DBLog db_log;
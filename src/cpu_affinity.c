@@ -0,0 +1,106 @@
+
+#include "common.h"
+#include "cpu_affinity.h"
+#ifdef HAVE_SCHED_H
+# include <sched.h>
+#endif
+
+#ifdef CPU_SETSIZE
+# define MAX_CPUS ((unsigned long) CPU_SETSIZE)
+#else
+# define MAX_CPUS 1024UL
+#endif
+
+static int add_cpus_to_set(CPUSet * const cpu_set,
+                           const unsigned long first,
+                           const unsigned long last)
+{
+    unsigned int *cpus;
+    unsigned long cpu;
+    
+    if (first > last || last >= MAX_CPUS) {
+        return -1;
+    }
+    if ((cpus = realloc(cpu_set->cpus, (cpu_set->nb_cpus + last - first + 1U) *
+                        sizeof *cpus)) == NULL) {
+        return -1;
+    }
+    cpu_set->cpus = cpus;
+    for (cpu = first; cpu <= last; cpu++) {
+        cpus[cpu_set->nb_cpus++] = (unsigned int) cpu;
+    }
+    return 0;
+}
+
+int parse_cpu_set(CPUSet * const cpu_set, const char * const str)
+{
+    const char *pnt = str;
+    char *endptr;
+    unsigned long first;
+    unsigned long last;
+    
+    *cpu_set = (CPUSet) {
+        .cpus = NULL,
+        .nb_cpus = (size_t) 0U
+    };
+    for (;;) {
+        skip_spaces(&pnt);
+        first = strtoul(pnt, &endptr, 10);
+        if (endptr == pnt) {
+            break;
+        }
+        pnt = endptr;
+        last = first;
+        if (*pnt == '-') {
+            pnt++;
+            last = strtoul(pnt, &endptr, 10);
+            if (endptr == pnt) {
+                break;
+            }
+            pnt = endptr;
+        }
+        if (add_cpus_to_set(cpu_set, first, last) != 0) {
+            break;
+        }
+        skip_spaces(&pnt);
+        if (*pnt == 0) {
+            return 0;
+        }
+        if (*pnt++ != ',') {
+            break;
+        }
+    }
+    free_cpu_set(cpu_set);
+    
+    return -1;
+}
+
+void free_cpu_set(CPUSet * const cpu_set)
+{
+    free(cpu_set->cpus);
+    cpu_set->cpus = NULL;
+    cpu_set->nb_cpus = (size_t) 0U;
+}
+
+int pin_thread_to_cpu_set(const pthread_t thr,
+                          const CPUSet * const cpu_set, const size_t nth)
+{
+    if (cpu_set->nb_cpus <= (size_t) 0U) {
+        return 0;
+    }
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+    cpu_set_t cpus;
+    
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu_set->cpus[nth % cpu_set->nb_cpus], &cpus);
+    if (pthread_setaffinity_np(thr, sizeof cpus, &cpus) != 0) {
+        return -1;
+    }
+    return 0;
+#else
+    (void) thr;
+    (void) nth;
+    
+    return -1;
+#endif
+}
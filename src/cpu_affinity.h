@@ -0,0 +1,15 @@
+
+#ifndef __CPU_AFFINITY_H__
+#define __CPU_AFFINITY_H__ 1
+
+typedef struct CPUSet_ {
+    unsigned int *cpus;
+    size_t nb_cpus;
+} CPUSet;
+
+int parse_cpu_set(CPUSet * const cpu_set, const char * const str);
+void free_cpu_set(CPUSet * const cpu_set);
+int pin_thread_to_cpu_set(const pthread_t thr,
+                          const CPUSet * const cpu_set, const size_t nth);
+
+#endif
@@ -2,78 +2,334 @@
 #include "common.h"
 #include "cqueue.h"
 
+#ifdef HAVE_LINUX_FUTEX_H
+# include <linux/futex.h>
+# include <sys/syscall.h>
+#endif
+
+#if defined(__i386__) || defined(__x86_64__)
+# define cqueue_cpu_relax() __asm__ __volatile__("pause" ::: "memory")
+#else
+# define cqueue_cpu_relax() __asm__ __volatile__("" ::: "memory")
+#endif
+
+void init_cqueue_waiters(CQueueWaiters * const waiters)
+{
+    waiters->seq = 0U;
+    waiters->nb_waiters = 0U;
+    waiters->spin_rounds = CQUEUE_MIN_SPIN_ROUNDS;
+#ifndef HAVE_LINUX_FUTEX_H
+    pthread_mutex_init(&waiters->mtx, NULL);
+    pthread_cond_init(&waiters->cond, NULL);
+#endif
+}
+
+void free_cqueue_waiters(CQueueWaiters * const waiters)
+{
+#ifndef HAVE_LINUX_FUTEX_H
+    pthread_cond_destroy(&waiters->cond);
+    pthread_mutex_destroy(&waiters->mtx);
+#else
+    (void) waiters;
+#endif
+}
+
+uint32_t prepare_wait_cqueue_waiters(CQueueWaiters * const waiters)
+{
+    __atomic_add_fetch(&waiters->nb_waiters, 1U, __ATOMIC_SEQ_CST);
+
+    return __atomic_load_n(&waiters->seq, __ATOMIC_SEQ_CST);
+}
+
+void cancel_wait_cqueue_waiters(CQueueWaiters * const waiters)
+{
+    __atomic_sub_fetch(&waiters->nb_waiters, 1U, __ATOMIC_SEQ_CST);
+}
+
+void wait_cqueue_waiters(CQueueWaiters * const waiters, const uint32_t seq)
+{
+#ifdef HAVE_LINUX_FUTEX_H
+    syscall(SYS_futex, &waiters->seq, FUTEX_WAIT_PRIVATE, seq,
+            NULL, NULL, 0);
+#else
+    pthread_mutex_lock(&waiters->mtx);
+    while (__atomic_load_n(&waiters->seq, __ATOMIC_SEQ_CST) == seq) {
+        pthread_cond_wait(&waiters->cond, &waiters->mtx);
+    }
+    pthread_mutex_unlock(&waiters->mtx);
+#endif
+    cancel_wait_cqueue_waiters(waiters);
+}
+
+static void wake_cqueue_waiters_(CQueueWaiters * const waiters,
+                                 const _Bool all)
+{
+#ifdef HAVE_LINUX_FUTEX_H
+    __atomic_add_fetch(&waiters->seq, 1U, __ATOMIC_SEQ_CST);
+    syscall(SYS_futex, &waiters->seq, FUTEX_WAKE_PRIVATE,
+            all != 0 ? INT_MAX : 1, NULL, NULL, 0);
+#else
+    pthread_mutex_lock(&waiters->mtx);
+    __atomic_add_fetch(&waiters->seq, 1U, __ATOMIC_SEQ_CST);
+    if (all != 0) {
+        pthread_cond_broadcast(&waiters->cond);
+    } else {
+        pthread_cond_signal(&waiters->cond);
+    }
+    pthread_mutex_unlock(&waiters->mtx);
+#endif
+}
+
+void wake_cqueue_waiters(CQueueWaiters * const waiters, const _Bool all)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&waiters->nb_waiters, __ATOMIC_SEQ_CST) == 0U) {
+        return;
+    }
+    wake_cqueue_waiters_(waiters, all);
+}
+
+static void wake_cqueue_consumer(CQueue * const cqueue, const size_t pos)
+{
+    CQueueWaiters *consumer;
+    size_t nb_consumers = cqueue->nb_consumers;
+    size_t t = pos % nb_consumers;
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    do {
+        consumer = &cqueue->consumers[t];
+        if (__atomic_load_n(&consumer->nb_waiters, __ATOMIC_SEQ_CST) > 0U) {
+            wake_cqueue_waiters_(consumer, 0);
+            return;
+        }
+        if (++t >= cqueue->nb_consumers) {
+            t = (size_t) 0U;
+        }
+    } while (--nb_consumers > (size_t) 0U);
+}
+
 int init_cqueue(CQueue * const cqueue, const size_t nb_elements,
                 const size_t element_size)
 {
-    size_t cqueue_size;
-    
-    if (nb_elements < (size_t) 2U || SIZE_MAX / nb_elements < element_size) {
+    return init_cqueue_with_reserve(cqueue, nb_elements, (size_t) 0U,
+                                    element_size);
+}
+
+int init_cqueue_with_reserve(CQueue * const cqueue, const size_t nb_elements,
+                             const size_t nb_reserved_elements,
+                             const size_t element_size)
+{
+    size_t cell_size;
+    size_t t;
+
+    if (nb_elements < (size_t) 2U ||
+        nb_reserved_elements > SIZE_MAX - nb_elements ||
+        element_size > SIZE_MAX - CQUEUE_CELL_HEADER_SIZE -
+        CQUEUE_CELL_HEADER_SIZE) {
         return -1;
     }
-    cqueue->element_size = element_size;
-    cqueue_size = nb_elements * element_size;
-    if ((cqueue->cqueue = malloc(cqueue_size)) == NULL) {
+    cell_size = (CQUEUE_CELL_HEADER_SIZE + element_size +
+                 CQUEUE_CELL_HEADER_SIZE - (size_t) 1U) &
+        ~(CQUEUE_CELL_HEADER_SIZE - (size_t) 1U);
+    cqueue->nb_elements = nb_elements + nb_reserved_elements;
+    if (SIZE_MAX / cqueue->nb_elements < cell_size) {
         return -1;
     }
-    cqueue->cqueue_end = cqueue->cqueue + (cqueue_size - element_size);
-    cqueue->first_element = cqueue->last_element = NULL;
-    
+    if ((cqueue->cells = malloc(cqueue->nb_elements * cell_size)) == NULL) {
+        return -1;
+    }
+    cqueue->max_depth = nb_elements;
+    cqueue->element_size = element_size;
+    cqueue->cell_size = cell_size;
+    cqueue->push_pos = cqueue->shift_pos = (size_t) 0U;
+    t = (size_t) 0U;
+    do {
+        * (size_t *) (void *) (cqueue->cells + t * cell_size) = t;
+    } while (++t < cqueue->nb_elements);
+    init_cqueue_waiters(&cqueue->not_empty);
+    init_cqueue_waiters(&cqueue->not_full);
+    set_cqueue_consumers(cqueue, &cqueue->not_empty, (size_t) 1U);
+
     return 0;
 }
 
+void set_cqueue_consumers(CQueue * const cqueue,
+                          CQueueWaiters * const consumers,
+                          const size_t nb_consumers)
+{
+    assert(nb_consumers > (size_t) 0U);
+    cqueue->consumers = consumers;
+    cqueue->nb_consumers = nb_consumers;
+}
+
 void free_cqueue(CQueue * const cqueue)
 {
     if (cqueue == NULL) {
         return;
     }
-    free(cqueue->cqueue);
-    cqueue->cqueue = cqueue->cqueue_end = NULL;
-    cqueue->first_element = cqueue->last_element = NULL;
+    free(cqueue->cells);
+    cqueue->cells = NULL;
+    free_cqueue_waiters(&cqueue->not_empty);
+    free_cqueue_waiters(&cqueue->not_full);
     free(cqueue);
 }
 
-int push_cqueue(CQueue * const cqueue, const void * const pnt)
+static int push_cqueue_(CQueue * const cqueue, const void * const pnt,
+                        const size_t max_depth)
 {
-    unsigned char *new_element;
+    unsigned char *cell;
+    size_t pos;
+    size_t seq;
 
-    if (cqueue->last_element == NULL) {
-        assert(cqueue->first_element == NULL);
-        new_element = cqueue->first_element = cqueue->cqueue;
-    } else {
-        if (cqueue->last_element != cqueue->cqueue_end) {
-            new_element = cqueue->last_element + cqueue->element_size;
+    pos = __atomic_load_n(&cqueue->push_pos, __ATOMIC_RELAXED);
+    for (;;) {
+        if (max_depth < cqueue->nb_elements &&
+            (ptrdiff_t) (pos - __atomic_load_n(&cqueue->shift_pos,
+                                               __ATOMIC_RELAXED)) >=
+            (ptrdiff_t) max_depth) {
+            return -1;
+        }
+        cell = cqueue->cells + (pos % cqueue->nb_elements) * cqueue->cell_size;
+        seq = __atomic_load_n((size_t *) (void *) cell, __ATOMIC_ACQUIRE);
+        if (seq == pos) {
+            if (__atomic_compare_exchange_n(&cqueue->push_pos, &pos,
+                                            pos + (size_t) 1U, 1,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if ((ptrdiff_t) (seq - pos) < (ptrdiff_t) 0) {
+            return -1;
         } else {
-            new_element = cqueue->cqueue;
+            pos = __atomic_load_n(&cqueue->push_pos, __ATOMIC_RELAXED);
         }
-        if (new_element == cqueue->first_element) {
+    }
+    memcpy(cell + CQUEUE_CELL_HEADER_SIZE, pnt, cqueue->element_size);
+    __atomic_store_n((size_t *) (void *) cell, pos + (size_t) 1U,
+                     __ATOMIC_RELEASE);
+    wake_cqueue_consumer(cqueue, pos);
+
+    return 0;
+}
+
+int push_cqueue(CQueue * const cqueue, const void * const pnt)
+{
+    return push_cqueue_(cqueue, pnt, cqueue->max_depth);
+}
+
+int push_cqueue_reserved(CQueue * const cqueue, const void * const pnt)
+{
+    return push_cqueue_(cqueue, pnt, cqueue->nb_elements);
+}
+
+int shift_cqueue(CQueue * const cqueue, void * const pnt)
+{
+    unsigned char *cell;
+    size_t pos;
+    size_t seq;
+
+    pos = __atomic_load_n(&cqueue->shift_pos, __ATOMIC_RELAXED);
+    for (;;) {
+        cell = cqueue->cells + (pos % cqueue->nb_elements) * cqueue->cell_size;
+        seq = __atomic_load_n((size_t *) (void *) cell, __ATOMIC_ACQUIRE);
+        if (seq == pos + (size_t) 1U) {
+            if (__atomic_compare_exchange_n(&cqueue->shift_pos, &pos,
+                                            pos + (size_t) 1U, 1,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if ((ptrdiff_t) (seq - (pos + (size_t) 1U)) <
+                   (ptrdiff_t) 0) {
             return -1;
+        } else {
+            pos = __atomic_load_n(&cqueue->shift_pos, __ATOMIC_RELAXED);
         }
     }
-    memcpy(new_element, pnt, cqueue->element_size);
-    cqueue->last_element = new_element;
-    
+    memcpy(pnt, cell + CQUEUE_CELL_HEADER_SIZE, cqueue->element_size);
+    __atomic_store_n((size_t *) (void *) cell, pos + cqueue->nb_elements,
+                     __ATOMIC_RELEASE);
+    wake_cqueue_waiters(&cqueue->not_full, 0);
+
     return 0;
 }
 
-void * shift_cqueue(CQueue * const cqueue)
+size_t depth_cqueue(CQueue * const cqueue)
 {
-    unsigned char *next_element;
-    unsigned char *element;
+    const size_t shift_pos =
+        __atomic_load_n(&cqueue->shift_pos, __ATOMIC_SEQ_CST);
+    const size_t push_pos =
+        __atomic_load_n(&cqueue->push_pos, __ATOMIC_SEQ_CST);
     
-    if (cqueue->first_element == NULL) {
-        return NULL;
+    if ((ptrdiff_t) (push_pos - shift_pos) < (ptrdiff_t) 0) {
+        return (size_t) 0U;
     }
-    if (cqueue->first_element == cqueue->last_element) {    
-        cqueue->last_element = next_element = NULL;
-    } else {
-        if (cqueue->first_element != cqueue->cqueue_end) {
-            next_element = cqueue->first_element + cqueue->element_size;
-        } else {
-            next_element = cqueue->cqueue;
+    return push_pos - shift_pos;
+}
+
+int push_cqueue_wait(CQueue * const cqueue, const void * const pnt)
+{
+    unsigned int round;
+    uint32_t seq;
+
+    for (;;) {
+        round = 0U;
+        do {
+            if (push_cqueue(cqueue, pnt) == 0) {
+                return 0;
+            }
+            cqueue_cpu_relax();
+        } while (++round < CQUEUE_MIN_SPIN_ROUNDS);
+        seq = prepare_wait_cqueue_waiters(&cqueue->not_full);
+        if (push_cqueue(cqueue, pnt) == 0) {
+            cancel_wait_cqueue_waiters(&cqueue->not_full);
+            return 0;
         }
+        wait_cqueue_waiters(&cqueue->not_full, seq);
+    }
+}
+
+int shift_cqueues_wait(CQueue * const * const cqueues,
+                       const size_t nb_cqueues,
+                       CQueueWaiters * const waiters, void * const pnt,
+                       const volatile sig_atomic_t * const should_exit)
+{
+    unsigned int spin_rounds;
+    unsigned int round;
+    uint32_t seq;
+    size_t t;
+
+    for (;;) {
+        spin_rounds = waiters->spin_rounds;
+        round = 0U;
+        do {
+            if (*should_exit != 0) {
+                return 1;
+            }
+            for (t = (size_t) 0U; t < nb_cqueues; t++) {
+                if (shift_cqueue(cqueues[t], pnt) == 0) {
+                    if (round > 0U && spin_rounds < CQUEUE_MAX_SPIN_ROUNDS) {
+                        waiters->spin_rounds = spin_rounds * 2U;
+                    }
+                    return 0;
+                }
+            }
+            cqueue_cpu_relax();
+        } while (++round < spin_rounds);
+        if (spin_rounds > CQUEUE_MIN_SPIN_ROUNDS) {
+            waiters->spin_rounds = spin_rounds / 2U;
+        }
+        seq = prepare_wait_cqueue_waiters(waiters);
+        if (*should_exit != 0) {
+            cancel_wait_cqueue_waiters(waiters);
+            return 1;
+        }
+        for (t = (size_t) 0U; t < nb_cqueues; t++) {
+            if (shift_cqueue(cqueues[t], pnt) == 0) {
+                cancel_wait_cqueue_waiters(waiters);
+                return 0;
+            }
+        }
+        wait_cqueue_waiters(waiters, seq);
     }
-    element = cqueue->first_element;    
-    cqueue->first_element = next_element;
-    
-    return element;
 }
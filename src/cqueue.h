@@ -2,20 +2,68 @@
 #ifndef __CQUEUE_H__
 #define __CQUEUE_H__ 1
 
+#ifndef CQUEUE_CACHELINE_SIZE
+# define CQUEUE_CACHELINE_SIZE 64
+#endif
+#ifndef CQUEUE_CELL_HEADER_SIZE
+# define CQUEUE_CELL_HEADER_SIZE (size_t) 16U
+#endif
+#ifndef CQUEUE_MIN_SPIN_ROUNDS
+# define CQUEUE_MIN_SPIN_ROUNDS 16U
+#endif
+#ifndef CQUEUE_MAX_SPIN_ROUNDS
+# define CQUEUE_MAX_SPIN_ROUNDS 4096U
+#endif
+
+typedef struct CQueueWaiters_ {
+    uint32_t seq;
+    uint32_t nb_waiters;
+    unsigned int spin_rounds;
+#ifndef HAVE_LINUX_FUTEX_H
+    pthread_mutex_t mtx;
+    pthread_cond_t cond;
+#endif
+} __attribute__((aligned(CQUEUE_CACHELINE_SIZE))) CQueueWaiters;
+
 typedef struct CQueue_ {
-    unsigned char *cqueue;
-    unsigned char *cqueue_end;    
-    unsigned char *first_element;
-    unsigned char *last_element;
-    size_t cqueue_size;
+    unsigned char *cells;
+    size_t nb_elements;
+    size_t max_depth;
     size_t element_size;
+    size_t cell_size;
+    CQueueWaiters *consumers;
+    size_t nb_consumers;
+    CQueueWaiters not_empty;
+    CQueueWaiters not_full;
+    size_t push_pos __attribute__((aligned(CQUEUE_CACHELINE_SIZE)));
+    size_t shift_pos __attribute__((aligned(CQUEUE_CACHELINE_SIZE)));
 } CQueue;
 
+void init_cqueue_waiters(CQueueWaiters * const waiters);
+void free_cqueue_waiters(CQueueWaiters * const waiters);
+uint32_t prepare_wait_cqueue_waiters(CQueueWaiters * const waiters);
+void cancel_wait_cqueue_waiters(CQueueWaiters * const waiters);
+void wait_cqueue_waiters(CQueueWaiters * const waiters, const uint32_t seq);
+void wake_cqueue_waiters(CQueueWaiters * const waiters, const _Bool all);
+
 int init_cqueue(CQueue * const cqueue, const size_t nb_elements,
                 const size_t element_size);
+int init_cqueue_with_reserve(CQueue * const cqueue, const size_t nb_elements,
+                             const size_t nb_reserved_elements,
+                             const size_t element_size);
+void set_cqueue_consumers(CQueue * const cqueue,
+                          CQueueWaiters * const consumers,
+                          const size_t nb_consumers);
 
 void free_cqueue(CQueue * const cqueue);
 int push_cqueue(CQueue * const cqueue, const void * const pnt);
-void * shift_cqueue(CQueue * const cqueue);
+int push_cqueue_reserved(CQueue * const cqueue, const void * const pnt);
+int push_cqueue_wait(CQueue * const cqueue, const void * const pnt);
+int shift_cqueue(CQueue * const cqueue, void * const pnt);
+size_t depth_cqueue(CQueue * const cqueue);
+int shift_cqueues_wait(CQueue * const * const cqueues,
+                       const size_t nb_cqueues,
+                       CQueueWaiters * const waiters, void * const pnt,
+                       const volatile sig_atomic_t * const should_exit);
 
 #endif
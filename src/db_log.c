@@ -358,6 +358,20 @@ int replay_log_record(HttpHandlerContext * const context,
     return 0;
 }
 
+static int end_bulk_load_cb(void *context_, void *entry,
+                            const size_t sizeof_entry)
+{
+    HttpHandlerContext * const context = context_;
+    Layer * const layer = entry;
+    
+    (void) sizeof_entry;
+    if (end_bulk_load(&layer->pan_db) != 0) {
+        logfile(context, LOG_ERR,
+                "Unable to index layer [%s]", layer->name);
+    }
+    return 0;
+}
+
 int replay_log(HttpHandlerContext * const context)
 {
     DBLog * const db_log = &app_context.db_log;
@@ -372,9 +386,12 @@ int replay_log(HttpHandlerContext * const context)
     }
     init_buffered_read(&brc, db_log->db_log_fd);
     logfile_noformat(context, LOG_INFO, "Replaying journal...");
+    context->bulk_load_layers = 1;
     while ((res = replay_log_record(context, &brc)) == 0) {
         counter++;
     }
+    context->bulk_load_layers = 0;
+    slab_foreach(&context->layers_slab, end_bulk_load_cb, context);
     free_buffered_read(&brc);
     logfile(context, LOG_INFO, "%" PRIuMAX " transactions replayed.",
             counter);
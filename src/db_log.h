@@ -10,7 +10,7 @@
 # define DB_LOG_MAX_URI_LEN  (size_t) 10000U
 #endif
 #ifndef DB_LOG_MAX_BODY_LEN
-# define DB_LOG_MAX_BODY_LEN (size_t) 100000U
+# define DB_LOG_MAX_BODY_LEN ((size_t) 16U * 1024U * 1024U)
 #endif
 #ifndef DB_LOG_TMP_SUFFIX
 # define DB_LOG_TMP_SUFFIX ".tmp"
@@ -0,0 +1,1016 @@
+
+#include "common.h"
+#include "distances.h"
+#if defined(__SSE2__) && defined(HAVE_EMMINTRIN_H)
+# include <emmintrin.h>
+# define DISTANCES_SSE2 1
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+    defined(HAVE_IMMINTRIN_H)
+# include <immintrin.h>
+# define DISTANCES_AVX2 1
+#endif
+
+Dimension2 compute_square_distance(const PanDB * const pan_db,
+                                   const Position2D * const position1,
+                                   const Position2D * const position2)
+{
+    Dimension2 d_latitude = (Dimension2) position2->latitude -
+        (Dimension2) position1->latitude;
+    Dimension2 d_longitude = (Dimension2) position2->longitude -
+        (Dimension2) position1->longitude;
+    
+    if (pan_db == NULL) {
+        return (Dimension2) 0.0;
+    }
+    if (pan_db->layer_type != LAYER_TYPE_FLAT) {
+        assert(pan_db->layer_type == LAYER_TYPE_FLATWRAP);
+        
+        if (d_latitude > pan_db->qbounds.edge1.latitude) {
+            d_latitude = d_latitude - pan_db->qbounds.edge1.latitude +
+                pan_db->qbounds.edge0.latitude;
+        }
+        if (d_longitude > pan_db->qbounds.edge1.longitude) {
+            d_longitude = d_longitude - pan_db->qbounds.edge1.longitude +
+                    pan_db->qbounds.edge0.longitude;
+        }
+    }
+    return d_latitude * d_latitude + d_longitude * d_longitude;
+}
+
+Meters distance_between_flat_positions(const PanDB * const pan_db,
+                                       const Position2D * const p1,
+                                       const Position2D * const p2)
+{
+    assert(pan_db->layer_type == LAYER_TYPE_FLAT ||
+           pan_db->layer_type == LAYER_TYPE_FLATWRAP);
+    
+    return (Meters) sqrtf(compute_square_distance(pan_db, p1, p2));
+}
+
+// Adapted from an implementation by Chris Veness
+
+Meters vincenty_distance_between_geoidal_positions(const Position2D * const p1,
+                                                   const Position2D * const p2)
+{
+    const double a = 6378137.0;
+    const double b = 6356752.3142;
+    const double f = 1.0 / 298.257223563;
+    const double L = DEG_TO_RAD(p2->longitude - p1->longitude);
+    const double U1 = atan((1.0 - f) * tan(DEG_TO_RAD(p1->latitude)));
+    const double U2 = atan((1.0 - f) * tan(DEG_TO_RAD(p2->latitude)));
+    const double sinU1 = sin(U1);
+    const double cosU1 = cos(U1);
+    const double sinU2 = sin(U2);
+    const double cosU2 = cos(U2);    
+    double lambda = L;
+    double lambdaP;
+    double sinSigma;
+    double cosSigma;
+    double cosSqAlpha;
+    double cos2SigmaM;
+    double sigma = 0.0;
+    unsigned int iterLimit = 100U;
+    do {
+        const double sinLambda = sin(lambda);
+        const double cosLambda = cos(lambda);
+        sinSigma = sqrt((cosU2 * sinLambda) * (cosU2 * sinLambda) + 
+                        (cosU1 * sinU2 - sinU1 * cosU2 * cosLambda) *
+                        (cosU1 * sinU2 - sinU1 * cosU2 * cosLambda));
+        if (sinSigma == 0.0) {
+            return (Meters) 0.0;
+        }
+        cosSigma = sinU1 * sinU2 + cosU1 * cosU2 * cosLambda;
+        sigma = atan2(sinSigma, cosSigma);
+        const double sinAlpha = cosU1 * cosU2 * sinLambda / sinSigma;
+        cosSqAlpha = 1.0 - sinAlpha * sinAlpha;
+        cos2SigmaM = cosSigma - 2.0 * sinU1 * sinU2 / cosSqAlpha;
+        if (isnan(cos2SigmaM)) {
+            cos2SigmaM = 0.0;
+        }
+        const double C = f / 16.0 * cosSqAlpha *
+            (4.0 + f * (4.0 - 3.0 * cosSqAlpha));
+        lambdaP = lambda;
+        lambda = L + (1.0 - C) * f * sinAlpha *
+            (sigma + C * sinSigma *
+                (cos2SigmaM + C * cosSigma *
+                    (-1.0 + 2.0 * cos2SigmaM * cos2SigmaM))
+            );
+    } while (fabs(lambda-lambdaP) > 1E-12 && --iterLimit > 0U);
+    
+    if (iterLimit == 0) {
+        return hs_distance_between_geoidal_positions(p1, p2);
+    }
+    const double uSq = cosSqAlpha * (a * a - b * b) / (b * b);
+    const double A = 1.0 + uSq / 16384.0 *
+        (4096.0 + uSq *
+            (-768.0 + uSq * (320.0 - 175.0 * uSq))
+        );
+    const double B = uSq / 1024.0 *
+        (256.0 + uSq *
+            (-128.0 + uSq * (74.0 - 47.0 * uSq))
+        );
+    const double deltaSigma = B * sinSigma *
+        (cos2SigmaM + B / 4.0 *
+            (cosSigma * (-1.0 + 2.0 * cos2SigmaM * cos2SigmaM) -
+                B / 6.0 * cos2SigmaM *
+                (-3.0 + 4.0 * sinSigma * sinSigma) *
+                (-3.0 + 4.0 * cos2SigmaM * cos2SigmaM)
+            )
+        );
+    const double d = b * A * (sigma - deltaSigma);
+    
+    return (Meters) d;
+}
+
+Meters hs_distance_between_geoidal_positions(const Position2D * const p1,
+                                             const Position2D * const p2)
+{
+    const float lat1 = (float) DEG_TO_RAD(p1->latitude);
+    const float lon1 = (float) DEG_TO_RAD(p1->longitude);
+    const float lat2 = (float) DEG_TO_RAD(p2->latitude);
+    const float lon2 = (float) DEG_TO_RAD(p2->longitude);
+    const float dlat = lat2 - lat1;
+    const float dlon = lon2 - lon1;
+    const float sin_dlath = sinf(dlat / 2.0F);
+    const float sin_dlat2 = sin_dlath * sin_dlath;    
+    const float sin_dlonh = sinf(dlon / 2.0F);
+    const float sin_dlon2 = sin_dlonh * sin_dlonh;
+    const float a = sin_dlat2 + cosf(lat1) * cosf(lat2) * sin_dlon2;
+    const float c = 2.0F * atan2f(sqrtf(a), sqrtf(1.0F - a));
+    const float d = EARTH_RADIUS * c;
+    
+    return (Meters) d;
+}
+
+Meters gc_distance_between_geoidal_positions(const Position2D * const p1,
+                                             const Position2D * const p2)
+{
+    const float a = (float) DEG_TO_RAD(p1->latitude);
+    const float b = (float) DEG_TO_RAD(p2->latitude);
+    const float x = (float) DEG_TO_RAD(- p1->longitude);
+    const float y = (float) DEG_TO_RAD(- p2->longitude);
+    const float cosa = sinf(a) * sinf(b) + cosf(a) * cosf(b) * cosf(x - y);
+    float d = 0.0F;
+    if (cosa > 1.0) {
+        return 0.0F;
+    }
+    if (cosa < (1.0F - FLT_EPSILON)) {
+        d = acosf(cosa);
+    }
+    d *= EARTH_RADIUS;
+    if (d < 10.0F) {
+        d = fast_distance_between_geoidal_positions(p1, p2);
+    }
+    return d;
+}
+
+Meters fast_distance_between_geoidal_positions(const Position2D * const p1,
+                                               const Position2D * const p2)
+{
+    const float k = cosf(DEG_TO_RAD(p1->latitude));
+    const float dx = k * (p1->longitude - p2->longitude);
+    const float dy = p1->latitude - p2->latitude;
+    const float d = DEG_AVG_DISTANCE * sqrtf(dx * dx + dy * dy);
+    
+    return (Meters) d;
+}
+
+Meters rhomboid_distance_between_geoidal_positions(const Position2D * const p1,
+                                                   const Position2D * const p2)
+{
+    const float k = cosf(DEG_TO_RAD(p1->latitude));
+    const float dx = k * (p1->longitude - p2->longitude);
+    const float dy = p1->latitude - p2->latitude;
+    const float d = DEG_AVG_DISTANCE * (fabs(dx) + fabs(dy));
+    
+    return (Meters) d;
+}
+
+GeoidalTrig geoidal_trig(const Position2D * const position)
+{
+    const float latitude = (float) DEG_TO_RAD(position->latitude);
+    const float longitude = (float) DEG_TO_RAD(position->longitude);
+    const float cos_latitude = cosf(latitude);
+
+    return (GeoidalTrig) {
+        .sin_latitude = sinf(latitude),
+        .cos_latitude = cos_latitude,
+        .unit_x = cos_latitude * cosf(longitude),
+        .unit_y = cos_latitude * sinf(longitude)
+    };
+}
+
+typedef struct FlatQuery_ {
+    Dimension2 latitude;
+    Dimension2 longitude;
+    Dimension2 latitude_bound;
+    Dimension2 latitude_base;
+    Dimension2 longitude_bound;
+    Dimension2 longitude_base;
+} FlatQuery;
+
+typedef struct GeoQuery_ {
+    Dimension latitude;
+    Dimension longitude;
+    Dimension k;
+} GeoQuery;
+
+typedef void (*FlatDistancesKernel)(const FlatQuery * const query,
+                                    const Dimension * const latitudes,
+                                    const Dimension * const longitudes,
+                                    Meters * const distances,
+                                    const NbSlots count);
+
+typedef void (*GeoDistancesKernel)(const GeoQuery * const query,
+                                   const Dimension * const latitudes,
+                                   const Dimension * const longitudes,
+                                   Meters * const distances,
+                                   const NbSlots count);
+
+typedef void (*ChordsKernel)(const GeoidalTrig * const query,
+                             const Dimension * const unit_xs,
+                             const Dimension * const unit_ys,
+                             const Dimension * const sin_latitudes,
+                             Dimension * const chords,
+                             const NbSlots count);
+
+typedef struct DistancesKernelSet_ {
+    FlatDistancesKernel flat;
+    GeoDistancesKernel fast;
+    GeoDistancesKernel rhomboid;
+    ChordsKernel chords;
+} DistancesKernelSet;
+
+static void flat_distances_scalar(const FlatQuery * const query,
+                                  const Dimension * const latitudes,
+                                  const Dimension * const longitudes,
+                                  Meters * const distances,
+                                  const NbSlots count)
+{
+    Dimension2 d_latitude;
+    Dimension2 d_longitude;
+    NbSlots i;
+
+    for (i = (NbSlots) 0U; i < count; i++) {
+        d_latitude = (Dimension2) latitudes[i] - query->latitude;
+        d_longitude = (Dimension2) longitudes[i] - query->longitude;
+        if (d_latitude > query->latitude_bound) {
+            d_latitude = d_latitude - query->latitude_bound +
+                query->latitude_base;
+        }
+        if (d_longitude > query->longitude_bound) {
+            d_longitude = d_longitude - query->longitude_bound +
+                query->longitude_base;
+        }
+        distances[i] = (Meters)
+            sqrtf(d_latitude * d_latitude + d_longitude * d_longitude);
+    }
+}
+
+static void fast_distances_scalar(const GeoQuery * const query,
+                                  const Dimension * const latitudes,
+                                  const Dimension * const longitudes,
+                                  Meters * const distances,
+                                  const NbSlots count)
+{
+    float dx;
+    float dy;
+    NbSlots i;
+
+    for (i = (NbSlots) 0U; i < count; i++) {
+        dx = query->k * (query->longitude - longitudes[i]);
+        dy = query->latitude - latitudes[i];
+        distances[i] = (Meters) (DEG_AVG_DISTANCE * sqrtf(dx * dx + dy * dy));
+    }
+}
+
+static void rhomboid_distances_scalar(const GeoQuery * const query,
+                                      const Dimension * const latitudes,
+                                      const Dimension * const longitudes,
+                                      Meters * const distances,
+                                      const NbSlots count)
+{
+    float dx;
+    float dy;
+    NbSlots i;
+
+    for (i = (NbSlots) 0U; i < count; i++) {
+        dx = query->k * (query->longitude - longitudes[i]);
+        dy = query->latitude - latitudes[i];
+        distances[i] = (Meters) (DEG_AVG_DISTANCE * (fabsf(dx) + fabsf(dy)));
+    }
+}
+
+static void chords_scalar(const GeoidalTrig * const query,
+                          const Dimension * const unit_xs,
+                          const Dimension * const unit_ys,
+                          const Dimension * const sin_latitudes,
+                          Dimension * const chords,
+                          const NbSlots count)
+{
+    Dimension dx;
+    Dimension dy;
+    Dimension dz;
+    NbSlots i;
+
+    for (i = (NbSlots) 0U; i < count; i++) {
+        dx = unit_xs[i] - query->unit_x;
+        dy = unit_ys[i] - query->unit_y;
+        dz = sin_latitudes[i] - query->sin_latitude;
+        chords[i] = dx * dx + dy * dy + dz * dz;
+    }
+}
+
+#ifdef DISTANCES_SSE2
+static void flat_distances_sse2(const FlatQuery * const query,
+                                const Dimension * const latitudes,
+                                const Dimension * const longitudes,
+                                Meters * const distances,
+                                const NbSlots count)
+{
+    const __m128 latitude = _mm_set1_ps(query->latitude);
+    const __m128 longitude = _mm_set1_ps(query->longitude);
+    const __m128 latitude_bound = _mm_set1_ps(query->latitude_bound);
+    const __m128 latitude_base = _mm_set1_ps(query->latitude_base);
+    const __m128 longitude_bound = _mm_set1_ps(query->longitude_bound);
+    const __m128 longitude_base = _mm_set1_ps(query->longitude_base);
+    __m128 d_latitude;
+    __m128 d_longitude;
+    __m128 wrapped;
+    __m128 mask;
+    NbSlots i = (NbSlots) 0U;
+
+    for (; i + (NbSlots) 4U <= count; i += (NbSlots) 4U) {
+        d_latitude = _mm_sub_ps(_mm_loadu_ps(&latitudes[i]), latitude);
+        d_longitude = _mm_sub_ps(_mm_loadu_ps(&longitudes[i]), longitude);
+        mask = _mm_cmpgt_ps(d_latitude, latitude_bound);
+        wrapped = _mm_add_ps(_mm_sub_ps(d_latitude, latitude_bound),
+                             latitude_base);
+        d_latitude = _mm_or_ps(_mm_and_ps(mask, wrapped),
+                               _mm_andnot_ps(mask, d_latitude));
+        mask = _mm_cmpgt_ps(d_longitude, longitude_bound);
+        wrapped = _mm_add_ps(_mm_sub_ps(d_longitude, longitude_bound),
+                             longitude_base);
+        d_longitude = _mm_or_ps(_mm_and_ps(mask, wrapped),
+                                _mm_andnot_ps(mask, d_longitude));
+        _mm_storeu_ps(&distances[i],
+                      _mm_sqrt_ps(_mm_add_ps
+                                  (_mm_mul_ps(d_latitude, d_latitude),
+                                   _mm_mul_ps(d_longitude, d_longitude))));
+    }
+    flat_distances_scalar(query, &latitudes[i], &longitudes[i],
+                          &distances[i], count - i);
+}
+
+static void fast_distances_sse2(const GeoQuery * const query,
+                                const Dimension * const latitudes,
+                                const Dimension * const longitudes,
+                                Meters * const distances,
+                                const NbSlots count)
+{
+    const __m128 latitude = _mm_set1_ps(query->latitude);
+    const __m128 longitude = _mm_set1_ps(query->longitude);
+    const __m128 k = _mm_set1_ps(query->k);
+    const __m128 scale = _mm_set1_ps(DEG_AVG_DISTANCE);
+    __m128 dx;
+    __m128 dy;
+    NbSlots i = (NbSlots) 0U;
+
+    for (; i + (NbSlots) 4U <= count; i += (NbSlots) 4U) {
+        dx = _mm_mul_ps(k, _mm_sub_ps(longitude,
+                                      _mm_loadu_ps(&longitudes[i])));
+        dy = _mm_sub_ps(latitude, _mm_loadu_ps(&latitudes[i]));
+        _mm_storeu_ps(&distances[i],
+                      _mm_mul_ps(scale, _mm_sqrt_ps
+                                 (_mm_add_ps(_mm_mul_ps(dx, dx),
+                                             _mm_mul_ps(dy, dy)))));
+    }
+    fast_distances_scalar(query, &latitudes[i], &longitudes[i],
+                          &distances[i], count - i);
+}
+
+static void rhomboid_distances_sse2(const GeoQuery * const query,
+                                    const Dimension * const latitudes,
+                                    const Dimension * const longitudes,
+                                    Meters * const distances,
+                                    const NbSlots count)
+{
+    const __m128 latitude = _mm_set1_ps(query->latitude);
+    const __m128 longitude = _mm_set1_ps(query->longitude);
+    const __m128 k = _mm_set1_ps(query->k);
+    const __m128 scale = _mm_set1_ps(DEG_AVG_DISTANCE);
+    const __m128 sign = _mm_set1_ps(-0.0F);
+    __m128 dx;
+    __m128 dy;
+    NbSlots i = (NbSlots) 0U;
+
+    for (; i + (NbSlots) 4U <= count; i += (NbSlots) 4U) {
+        dx = _mm_mul_ps(k, _mm_sub_ps(longitude,
+                                      _mm_loadu_ps(&longitudes[i])));
+        dy = _mm_sub_ps(latitude, _mm_loadu_ps(&latitudes[i]));
+        _mm_storeu_ps(&distances[i],
+                      _mm_mul_ps(scale, _mm_add_ps(_mm_andnot_ps(sign, dx),
+                                                   _mm_andnot_ps(sign, dy))));
+    }
+    rhomboid_distances_scalar(query, &latitudes[i], &longitudes[i],
+                              &distances[i], count - i);
+}
+
+static void chords_sse2(const GeoidalTrig * const query,
+                        const Dimension * const unit_xs,
+                        const Dimension * const unit_ys,
+                        const Dimension * const sin_latitudes,
+                        Dimension * const chords,
+                        const NbSlots count)
+{
+    const __m128 unit_x = _mm_set1_ps(query->unit_x);
+    const __m128 unit_y = _mm_set1_ps(query->unit_y);
+    const __m128 sin_latitude = _mm_set1_ps(query->sin_latitude);
+    __m128 dx;
+    __m128 dy;
+    __m128 dz;
+    NbSlots i = (NbSlots) 0U;
+
+    for (; i + (NbSlots) 4U <= count; i += (NbSlots) 4U) {
+        dx = _mm_sub_ps(_mm_loadu_ps(&unit_xs[i]), unit_x);
+        dy = _mm_sub_ps(_mm_loadu_ps(&unit_ys[i]), unit_y);
+        dz = _mm_sub_ps(_mm_loadu_ps(&sin_latitudes[i]), sin_latitude);
+        _mm_storeu_ps(&chords[i],
+                      _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx),
+                                            _mm_mul_ps(dy, dy)),
+                                 _mm_mul_ps(dz, dz)));
+    }
+    chords_scalar(query, &unit_xs[i], &unit_ys[i], &sin_latitudes[i],
+                  &chords[i], count - i);
+}
+#endif
+
+#ifdef DISTANCES_AVX2
+__attribute__((target("avx2")))
+static void flat_distances_avx2(const FlatQuery * const query,
+                                const Dimension * const latitudes,
+                                const Dimension * const longitudes,
+                                Meters * const distances,
+                                const NbSlots count)
+{
+    const __m256 latitude = _mm256_set1_ps(query->latitude);
+    const __m256 longitude = _mm256_set1_ps(query->longitude);
+    const __m256 latitude_bound = _mm256_set1_ps(query->latitude_bound);
+    const __m256 latitude_base = _mm256_set1_ps(query->latitude_base);
+    const __m256 longitude_bound = _mm256_set1_ps(query->longitude_bound);
+    const __m256 longitude_base = _mm256_set1_ps(query->longitude_base);
+    __m256 d_latitude;
+    __m256 d_longitude;
+    __m256 wrapped;
+    NbSlots i = (NbSlots) 0U;
+
+    for (; i + (NbSlots) 8U <= count; i += (NbSlots) 8U) {
+        d_latitude = _mm256_sub_ps(_mm256_loadu_ps(&latitudes[i]), latitude);
+        d_longitude = _mm256_sub_ps(_mm256_loadu_ps(&longitudes[i]),
+                                    longitude);
+        wrapped = _mm256_add_ps(_mm256_sub_ps(d_latitude, latitude_bound),
+                                latitude_base);
+        d_latitude = _mm256_blendv_ps
+            (d_latitude, wrapped,
+             _mm256_cmp_ps(d_latitude, latitude_bound, _CMP_GT_OQ));
+        wrapped = _mm256_add_ps(_mm256_sub_ps(d_longitude, longitude_bound),
+                                longitude_base);
+        d_longitude = _mm256_blendv_ps
+            (d_longitude, wrapped,
+             _mm256_cmp_ps(d_longitude, longitude_bound, _CMP_GT_OQ));
+        _mm256_storeu_ps(&distances[i],
+                         _mm256_sqrt_ps(_mm256_add_ps
+                                        (_mm256_mul_ps(d_latitude, d_latitude),
+                                         _mm256_mul_ps(d_longitude,
+                                                       d_longitude))));
+    }
+    flat_distances_scalar(query, &latitudes[i], &longitudes[i],
+                          &distances[i], count - i);
+}
+
+__attribute__((target("avx2")))
+static void fast_distances_avx2(const GeoQuery * const query,
+                                const Dimension * const latitudes,
+                                const Dimension * const longitudes,
+                                Meters * const distances,
+                                const NbSlots count)
+{
+    const __m256 latitude = _mm256_set1_ps(query->latitude);
+    const __m256 longitude = _mm256_set1_ps(query->longitude);
+    const __m256 k = _mm256_set1_ps(query->k);
+    const __m256 scale = _mm256_set1_ps(DEG_AVG_DISTANCE);
+    __m256 dx;
+    __m256 dy;
+    NbSlots i = (NbSlots) 0U;
+
+    for (; i + (NbSlots) 8U <= count; i += (NbSlots) 8U) {
+        dx = _mm256_mul_ps(k, _mm256_sub_ps(longitude,
+                                            _mm256_loadu_ps(&longitudes[i])));
+        dy = _mm256_sub_ps(latitude, _mm256_loadu_ps(&latitudes[i]));
+        _mm256_storeu_ps(&distances[i],
+                         _mm256_mul_ps(scale, _mm256_sqrt_ps
+                                       (_mm256_add_ps
+                                        (_mm256_mul_ps(dx, dx),
+                                         _mm256_mul_ps(dy, dy)))));
+    }
+    fast_distances_scalar(query, &latitudes[i], &longitudes[i],
+                          &distances[i], count - i);
+}
+
+__attribute__((target("avx2")))
+static void rhomboid_distances_avx2(const GeoQuery * const query,
+                                    const Dimension * const latitudes,
+                                    const Dimension * const longitudes,
+                                    Meters * const distances,
+                                    const NbSlots count)
+{
+    const __m256 latitude = _mm256_set1_ps(query->latitude);
+    const __m256 longitude = _mm256_set1_ps(query->longitude);
+    const __m256 k = _mm256_set1_ps(query->k);
+    const __m256 scale = _mm256_set1_ps(DEG_AVG_DISTANCE);
+    const __m256 sign = _mm256_set1_ps(-0.0F);
+    __m256 dx;
+    __m256 dy;
+    NbSlots i = (NbSlots) 0U;
+
+    for (; i + (NbSlots) 8U <= count; i += (NbSlots) 8U) {
+        dx = _mm256_mul_ps(k, _mm256_sub_ps(longitude,
+                                            _mm256_loadu_ps(&longitudes[i])));
+        dy = _mm256_sub_ps(latitude, _mm256_loadu_ps(&latitudes[i]));
+        _mm256_storeu_ps(&distances[i],
+                         _mm256_mul_ps(scale, _mm256_add_ps
+                                       (_mm256_andnot_ps(sign, dx),
+                                        _mm256_andnot_ps(sign, dy))));
+    }
+    rhomboid_distances_scalar(query, &latitudes[i], &longitudes[i],
+                              &distances[i], count - i);
+}
+
+__attribute__((target("avx2")))
+static void chords_avx2(const GeoidalTrig * const query,
+                        const Dimension * const unit_xs,
+                        const Dimension * const unit_ys,
+                        const Dimension * const sin_latitudes,
+                        Dimension * const chords,
+                        const NbSlots count)
+{
+    const __m256 unit_x = _mm256_set1_ps(query->unit_x);
+    const __m256 unit_y = _mm256_set1_ps(query->unit_y);
+    const __m256 sin_latitude = _mm256_set1_ps(query->sin_latitude);
+    __m256 dx;
+    __m256 dy;
+    __m256 dz;
+    NbSlots i = (NbSlots) 0U;
+
+    for (; i + (NbSlots) 8U <= count; i += (NbSlots) 8U) {
+        dx = _mm256_sub_ps(_mm256_loadu_ps(&unit_xs[i]), unit_x);
+        dy = _mm256_sub_ps(_mm256_loadu_ps(&unit_ys[i]), unit_y);
+        dz = _mm256_sub_ps(_mm256_loadu_ps(&sin_latitudes[i]), sin_latitude);
+        _mm256_storeu_ps(&chords[i],
+                         _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx),
+                                                     _mm256_mul_ps(dy, dy)),
+                                       _mm256_mul_ps(dz, dz)));
+    }
+    chords_scalar(query, &unit_xs[i], &unit_ys[i], &sin_latitudes[i],
+                  &chords[i], count - i);
+}
+#endif
+
+static const DistancesKernelSet distances_kernel_sets[] = {
+    [DISTANCES_KERNELS_SCALAR] = {
+        .flat = flat_distances_scalar,
+        .fast = fast_distances_scalar,
+        .rhomboid = rhomboid_distances_scalar,
+        .chords = chords_scalar
+    },
+#ifdef DISTANCES_SSE2
+    [DISTANCES_KERNELS_SSE2] = {
+        .flat = flat_distances_sse2,
+        .fast = fast_distances_sse2,
+        .rhomboid = rhomboid_distances_sse2,
+        .chords = chords_sse2
+    },
+#endif
+#ifdef DISTANCES_AVX2
+    [DISTANCES_KERNELS_AVX2] = {
+        .flat = flat_distances_avx2,
+        .fast = fast_distances_avx2,
+        .rhomboid = rhomboid_distances_avx2,
+        .chords = chords_avx2
+    }
+#endif
+};
+
+static DistancesKernels distances_kernels = DISTANCES_KERNELS_SCALAR;
+
+static _Bool distances_kernels_supported(const DistancesKernels kernels)
+{
+    switch (kernels) {
+    case DISTANCES_KERNELS_SCALAR:
+        return 1;
+#ifdef DISTANCES_SSE2
+    case DISTANCES_KERNELS_SSE2:
+        return 1;
+#endif
+#ifdef DISTANCES_AVX2
+    case DISTANCES_KERNELS_AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+#endif
+    default:
+        return 0;
+    }
+}
+
+void init_distances(void)
+{
+    if (distances_kernels_supported(DISTANCES_KERNELS_AVX2)) {
+        distances_kernels = DISTANCES_KERNELS_AVX2;
+    } else if (distances_kernels_supported(DISTANCES_KERNELS_SSE2)) {
+        distances_kernels = DISTANCES_KERNELS_SSE2;
+    } else {
+        distances_kernels = DISTANCES_KERNELS_SCALAR;
+    }
+}
+
+int set_distances_kernels(const DistancesKernels kernels)
+{
+    if (!distances_kernels_supported(kernels)) {
+        return -1;
+    }
+    distances_kernels = kernels;
+
+    return 0;
+}
+
+DistancesKernels get_distances_kernels(void)
+{
+    return distances_kernels;
+}
+
+const char *distances_kernels_name(const DistancesKernels kernels)
+{
+    switch (kernels) {
+    case DISTANCES_KERNELS_SCALAR:
+        return "scalar";
+    case DISTANCES_KERNELS_SSE2:
+        return "sse2";
+    case DISTANCES_KERNELS_AVX2:
+        return "avx2";
+    }
+    return "unknown";
+}
+
+void batch_flat_distances(const PanDB * const pan_db,
+                          const Position2D * const position,
+                          const Dimension * const latitudes,
+                          const Dimension * const longitudes,
+                          Meters * const distances, const NbSlots count)
+{
+    FlatQuery query = {
+        .latitude = (Dimension2) position->latitude,
+        .longitude = (Dimension2) position->longitude,
+        .latitude_bound = (Dimension2) FLT_MAX,
+        .latitude_base = (Dimension2) 0.0,
+        .longitude_bound = (Dimension2) FLT_MAX,
+        .longitude_base = (Dimension2) 0.0
+    };
+    assert(pan_db->layer_type == LAYER_TYPE_FLAT ||
+           pan_db->layer_type == LAYER_TYPE_FLATWRAP);
+    if (pan_db->layer_type == LAYER_TYPE_FLATWRAP) {
+        query.latitude_bound = pan_db->qbounds.edge1.latitude;
+        query.latitude_base = pan_db->qbounds.edge0.latitude;
+        query.longitude_bound = pan_db->qbounds.edge1.longitude;
+        query.longitude_base = pan_db->qbounds.edge0.longitude;
+    }
+    distances_kernel_sets[distances_kernels].flat
+        (&query, latitudes, longitudes, distances, count);
+}
+
+void batch_fast_distances(const Position2D * const position,
+                          const Dimension * const latitudes,
+                          const Dimension * const longitudes,
+                          Meters * const distances, const NbSlots count)
+{
+    const GeoQuery query = {
+        .latitude = position->latitude,
+        .longitude = position->longitude,
+        .k = cosf(DEG_TO_RAD(position->latitude))
+    };
+    distances_kernel_sets[distances_kernels].fast
+        (&query, latitudes, longitudes, distances, count);
+}
+
+void batch_rhomboid_distances(const Position2D * const position,
+                              const Dimension * const latitudes,
+                              const Dimension * const longitudes,
+                              Meters * const distances, const NbSlots count)
+{
+    const GeoQuery query = {
+        .latitude = position->latitude,
+        .longitude = position->longitude,
+        .k = cosf(DEG_TO_RAD(position->latitude))
+    };
+    distances_kernel_sets[distances_kernels].rhomboid
+        (&query, latitudes, longitudes, distances, count);
+}
+
+typedef struct GcQuery_ {
+    const Position2D *position;
+    float sina;
+    float cosa;
+    float x;
+    float k;
+} GcQuery;
+
+static GcQuery gc_query(const Position2D * const position)
+{
+    const float a = (float) DEG_TO_RAD(position->latitude);
+
+    return (GcQuery) {
+        .position = position,
+        .sina = sinf(a),
+        .cosa = cosf(a),
+        .x = (float) DEG_TO_RAD(- position->longitude),
+        .k = cosf(DEG_TO_RAD(position->latitude))
+    };
+}
+
+static Meters gc_distance_from_trig(const GcQuery * const query,
+                                    const Dimension latitude,
+                                    const Dimension longitude,
+                                    const float sinb, const float cosb)
+{
+    const float y = (float) DEG_TO_RAD(- longitude);
+    const float cosa = query->sina * sinb + query->cosa * cosb *
+        cosf(query->x - y);
+    float d = 0.0F;
+    float dx;
+    float dy;
+
+    if (cosa > 1.0) {
+        return (Meters) 0.0F;
+    }
+    if (cosa < (1.0F - FLT_EPSILON)) {
+        d = acosf(cosa);
+    }
+    d *= EARTH_RADIUS;
+    if (d < 10.0F) {
+        dx = query->k * (query->position->longitude - longitude);
+        dy = query->position->latitude - latitude;
+        d = DEG_AVG_DISTANCE * sqrtf(dx * dx + dy * dy);
+    }
+    return (Meters) d;
+}
+
+void batch_gc_distances(const Position2D * const position,
+                        const Dimension * const latitudes,
+                        const Dimension * const longitudes,
+                        Meters * const distances, const NbSlots count)
+{
+    const GcQuery query = gc_query(position);
+    float b;
+    NbSlots i;
+
+    for (i = (NbSlots) 0U; i < count; i++) {
+        b = (float) DEG_TO_RAD(latitudes[i]);
+        distances[i] = gc_distance_from_trig(&query, latitudes[i],
+                                             longitudes[i], sinf(b), cosf(b));
+    }
+}
+
+typedef struct HsQuery_ {
+    float lat1;
+    float lon1;
+    float cos_lat1;
+} HsQuery;
+
+static HsQuery hs_query(const Position2D * const position)
+{
+    const float lat1 = (float) DEG_TO_RAD(position->latitude);
+
+    return (HsQuery) {
+        .lat1 = lat1,
+        .lon1 = (float) DEG_TO_RAD(position->longitude),
+        .cos_lat1 = cosf(lat1)
+    };
+}
+
+static Meters hs_distance_from_trig(const HsQuery * const query,
+                                    const Dimension latitude,
+                                    const Dimension longitude,
+                                    const float cos_lat2)
+{
+    const float lat2 = (float) DEG_TO_RAD(latitude);
+    const float sin_dlath = sinf((lat2 - query->lat1) / 2.0F);
+    const float sin_dlonh =
+        sinf(((float) DEG_TO_RAD(longitude) - query->lon1) / 2.0F);
+    const float a = sin_dlath * sin_dlath + query->cos_lat1 * cos_lat2 *
+        (sin_dlonh * sin_dlonh);
+
+    return (Meters) (EARTH_RADIUS * (2.0F * atan2f(sqrtf(a),
+                                                   sqrtf(1.0F - a))));
+}
+
+void batch_hs_distances(const Position2D * const position,
+                        const Dimension * const latitudes,
+                        const Dimension * const longitudes,
+                        Meters * const distances, const NbSlots count)
+{
+    const HsQuery query = hs_query(position);
+    NbSlots i;
+
+    for (i = (NbSlots) 0U; i < count; i++) {
+        distances[i] = hs_distance_from_trig
+            (&query, latitudes[i], longitudes[i],
+             cosf((float) DEG_TO_RAD(latitudes[i])));
+    }
+}
+
+void batch_vincenty_distances(const Position2D * const position,
+                              const Dimension * const latitudes,
+                              const Dimension * const longitudes,
+                              Meters * const distances, const NbSlots count)
+{
+    Position2D scanned_position;
+    NbSlots i;
+
+    for (i = (NbSlots) 0U; i < count; i++) {
+        scanned_position.latitude = latitudes[i];
+        scanned_position.longitude = longitudes[i];
+        distances[i] = vincenty_distance_between_geoidal_positions
+            (position, &scanned_position);
+    }
+}
+
+void batch_position_distances(const PanDB * const pan_db,
+                              const Position2D * const position,
+                              const Dimension * const latitudes,
+                              const Dimension * const longitudes,
+                              Meters * const distances, const NbSlots count)
+{
+    if (pan_db->layer_type != LAYER_TYPE_SPHERICAL &&
+        pan_db->layer_type != LAYER_TYPE_ELLIPSOIDAL) {
+        batch_flat_distances(pan_db, position, latitudes, longitudes,
+                             distances, count);
+        return;
+    }
+    switch (pan_db->accuracy) {
+    case ACCURACY_VINCENTY:
+        batch_vincenty_distances(position, latitudes, longitudes,
+                                 distances, count);
+        break;
+    case ACCURACY_HS:
+        batch_hs_distances(position, latitudes, longitudes,
+                           distances, count);
+        break;
+    case ACCURACY_RHOMBOID:
+        batch_rhomboid_distances(position, latitudes, longitudes,
+                                 distances, count);
+        break;
+    default:
+        batch_gc_distances(position, latitudes, longitudes,
+                           distances, count);
+    }
+}
+
+#if COMPACT_SLOTS
+// Compact buckets hold fixed-point coordinates and no cached trigonometry
+int batch_distances(const PanDB * const pan_db,
+                    const Position2D * const position,
+                    const Bucket * const bucket,
+                    const NbSlots offset, const NbSlots count,
+                    const Meters max_distance,
+                    Meters * const distances)
+{
+    Dimension latitudes[DISTANCES_BATCH_SIZE];
+    Dimension longitudes[DISTANCES_BATCH_SIZE];
+    NbSlots i;
+
+    (void) max_distance;
+    assert(count <= DISTANCES_BATCH_SIZE);
+    for (i = (NbSlots) 0U; i < count; i++) {
+        latitudes[i] =
+            (Dimension) SLOT_DIMENSION(bucket->latitudes[offset + i]);
+        longitudes[i] =
+            (Dimension) SLOT_DIMENSION(bucket->longitudes[offset + i]);
+    }
+    batch_position_distances(pan_db, position, latitudes, longitudes,
+                             distances, count);
+    return 0;
+}
+#else
+static NbSlots chord_candidates(const Position2D * const position,
+                               const Bucket * const bucket,
+                               const NbSlots offset, const NbSlots count,
+                               const Meters max_distance,
+                               const Dimension margin,
+                               NbSlots * const candidates)
+{
+    const GeoidalTrig query = geoidal_trig(position);
+    Dimension chords[DISTANCES_BATCH_SIZE];
+    Dimension max_chord;
+    double angle;
+    NbSlots nb_candidates = (NbSlots) 0U;
+    NbSlots i;
+
+    assert(count <= DISTANCES_BATCH_SIZE);
+    angle = (double) max_distance /
+        ((double) EARTH_RADIUS * NEAREST_GEOIDAL_DISTANCE_SLACK);
+    if (max_distance < (Meters) 0.0 || angle >= M_PI) {
+        for (i = (NbSlots) 0U; i < count; i++) {
+            candidates[i] = i;
+        }
+        return count;
+    }
+    max_chord = (Dimension) (2.0 * sin(angle / 2.0)) + margin;
+    distances_kernel_sets[distances_kernels].chords
+        (&query, &bucket->unit_xs[offset], &bucket->unit_ys[offset],
+         &bucket->sin_latitudes[offset], chords, count);
+    for (i = (NbSlots) 0U; i < count; i++) {
+        if (chords[i] <= max_chord * max_chord) {
+            candidates[nb_candidates++] = i;
+        }
+    }
+    return nb_candidates;
+}
+
+int batch_distances(const PanDB * const pan_db,
+                    const Position2D * const position,
+                    const Bucket * const bucket,
+                    const NbSlots offset, const NbSlots count,
+                    const Meters max_distance,
+                    Meters * const distances)
+{
+    const Dimension * const latitudes = &bucket->latitudes[offset];
+    const Dimension * const longitudes = &bucket->longitudes[offset];
+    NbSlots candidates[DISTANCES_BATCH_SIZE];
+    NbSlots nb_candidates;
+    NbSlots i;
+    NbSlots j;
+
+    if (pan_db->layer_type != LAYER_TYPE_SPHERICAL &&
+        pan_db->layer_type != LAYER_TYPE_ELLIPSOIDAL) {
+        batch_flat_distances(pan_db, position, latitudes, longitudes,
+                             distances, count);
+        return 0;
+    }
+    if (pan_db->accuracy == ACCURACY_RHOMBOID) {
+        batch_rhomboid_distances(position, latitudes, longitudes,
+                                 distances, count);
+        return 0;
+    }
+    assert(bucket->unit_xs != NULL);
+    nb_candidates = chord_candidates
+        (position, bucket, offset, count, max_distance,
+         pan_db->accuracy == ACCURACY_HS ||
+         pan_db->accuracy == ACCURACY_VINCENTY ?
+         DISTANCES_CHORD_MARGIN : DISTANCES_GC_CHORD_MARGIN, candidates);
+    for (i = (NbSlots) 0U; i < count; i++) {
+        distances[i] = HUGE_VALF;
+    }
+    switch (pan_db->accuracy) {
+    case ACCURACY_VINCENTY: {
+        Position2D scanned_position;
+
+        for (j = (NbSlots) 0U; j < nb_candidates; j++) {
+            i = candidates[j];
+            scanned_position.latitude = latitudes[i];
+            scanned_position.longitude = longitudes[i];
+            distances[i] = vincenty_distance_between_geoidal_positions
+                (position, &scanned_position);
+        }
+        break;
+    }
+    case ACCURACY_HS: {
+        const HsQuery query = hs_query(position);
+
+        for (j = (NbSlots) 0U; j < nb_candidates; j++) {
+            i = candidates[j];
+            distances[i] = hs_distance_from_trig
+                (&query, latitudes[i], longitudes[i],
+                 bucket->cos_latitudes[offset + i]);
+        }
+        break;
+    }
+    case ACCURACY_GC:
+    case ACCURACY_FAST: {
+        const GcQuery query = gc_query(position);
+
+        for (j = (NbSlots) 0U; j < nb_candidates; j++) {
+            i = candidates[j];
+            distances[i] = gc_distance_from_trig
+                (&query, latitudes[i], longitudes[i],
+                 bucket->sin_latitudes[offset + i],
+                 bucket->cos_latitudes[offset + i]);
+        }
+        break;
+    }
+    default:
+        assert(0);
+        return -1;
+    }
+    return 0;
+}
+#endif
@@ -0,0 +1,104 @@
+
+#ifndef __DISTANCES_H__
+#define __DISTANCES_H__ 1
+
+#ifndef DISTANCES_BATCH_SIZE
+# define DISTANCES_BATCH_SIZE ((NbSlots) 64U)
+#endif
+
+#ifndef DISTANCES_CHORD_MARGIN
+# define DISTANCES_CHORD_MARGIN 1e-5F
+#endif
+#ifndef DISTANCES_GC_CHORD_MARGIN
+# define DISTANCES_GC_CHORD_MARGIN 1e-3F
+#endif
+
+typedef struct GeoidalTrig_ {
+    Dimension sin_latitude;
+    Dimension cos_latitude;
+    Dimension unit_x;
+    Dimension unit_y;
+} GeoidalTrig;
+
+typedef enum DistancesKernels_ {
+    DISTANCES_KERNELS_SCALAR, DISTANCES_KERNELS_SSE2, DISTANCES_KERNELS_AVX2
+} DistancesKernels;
+
+Dimension2 compute_square_distance(const PanDB * const pan_db,
+                                   const Position2D * const position1,
+                                   const Position2D * const position2);
+
+Meters distance_between_flat_positions(const PanDB * const pan_db,
+                                       const Position2D * const p1,
+                                       const Position2D * const p2);
+
+Meters vincenty_distance_between_geoidal_positions(const Position2D * const p1,
+                                                   const Position2D * const p2);
+
+Meters hs_distance_between_geoidal_positions(const Position2D * const p1,
+                                             const Position2D * const p2);
+
+Meters gc_distance_between_geoidal_positions(const Position2D * const p1,
+                                             const Position2D * const p2);
+
+Meters fast_distance_between_geoidal_positions(const Position2D * const p1,
+                                               const Position2D * const p2);
+
+Meters rhomboid_distance_between_geoidal_positions(const Position2D * const p1,
+                                                   const Position2D * const p2);
+
+GeoidalTrig geoidal_trig(const Position2D * const position);
+
+void init_distances(void);
+
+int set_distances_kernels(const DistancesKernels kernels);
+
+DistancesKernels get_distances_kernels(void);
+
+const char *distances_kernels_name(const DistancesKernels kernels);
+
+void batch_flat_distances(const PanDB * const pan_db,
+                          const Position2D * const position,
+                          const Dimension * const latitudes,
+                          const Dimension * const longitudes,
+                          Meters * const distances, const NbSlots count);
+
+void batch_fast_distances(const Position2D * const position,
+                          const Dimension * const latitudes,
+                          const Dimension * const longitudes,
+                          Meters * const distances, const NbSlots count);
+
+void batch_rhomboid_distances(const Position2D * const position,
+                              const Dimension * const latitudes,
+                              const Dimension * const longitudes,
+                              Meters * const distances, const NbSlots count);
+
+void batch_gc_distances(const Position2D * const position,
+                        const Dimension * const latitudes,
+                        const Dimension * const longitudes,
+                        Meters * const distances, const NbSlots count);
+
+void batch_hs_distances(const Position2D * const position,
+                        const Dimension * const latitudes,
+                        const Dimension * const longitudes,
+                        Meters * const distances, const NbSlots count);
+
+void batch_vincenty_distances(const Position2D * const position,
+                              const Dimension * const latitudes,
+                              const Dimension * const longitudes,
+                              Meters * const distances, const NbSlots count);
+
+void batch_position_distances(const PanDB * const pan_db,
+                              const Position2D * const position,
+                              const Dimension * const latitudes,
+                              const Dimension * const longitudes,
+                              Meters * const distances, const NbSlots count);
+
+int batch_distances(const PanDB * const pan_db,
+                    const Position2D * const position,
+                    const Bucket * const bucket,
+                    const NbSlots offset, const NbSlots count,
+                    const Meters max_distance,
+                    Meters * const distances);
+
+#endif
@@ -2,15 +2,42 @@
 #include "common.h"
 #include "http_server.h"
 #include "domain_layers.h"
+#include "query_parser.h"
+
+typedef struct LayersCreateOptParseCBContext_ {
+    IndexType index_type;
+} LayersCreateOptParseCBContext;
+
+static int layers_create_opt_parse_cb(void * const context_,
+                                      const BinVal *key, const BinVal *value)
+{
+    LayersCreateOptParseCBContext * context = context_;
+    char *svalue = value->val;
+    
+    skip_spaces((const char * *) &svalue);
+    if (*svalue == 0) {
+        return 0;
+    }
+    if (BINVAL_IS_EQUAL_TO_CONST_STRING(key, "index")) {
+        if (strcasecmp(svalue, "quadtree") == 0) {
+            context->index_type = INDEX_TYPE_QUADTREE;
+        } else if (strcasecmp(svalue, "morton") == 0) {
+            context->index_type = INDEX_TYPE_MORTON;
+        } else {
+            return -1;
+        }
+        return 0;
+    }
+    return 0;
+}
 
 int handle_domain_layers(struct evhttp_request * const req,
                          HttpHandlerContext * const context,
-                         char *uri, char *opts, _Bool * const write_to_log,
+                         char *uri, char *opts,
                          const _Bool fake_req)
 {
     Key *layer_name;
     
-    (void) opts;
     if (req->type == EVHTTP_REQ_GET) {
         Op op;
         LayersIndexOp * const index_op = &op.layers_index_op;
@@ -22,15 +49,11 @@ int handle_domain_layers(struct evhttp_request * const req,
             .type = OP_TYPE_LAYERS_INDEX,
             .req = req,
             .fake_req = fake_req,
-            .op_tid = ++context->op_tid
+            .op_tid = next_op_tid(context)
         };
-        pthread_mutex_lock(&context->mtx_cqueue);
-        if (push_cqueue(context->cqueue, index_op) != 0) {
-            pthread_mutex_unlock(&context->mtx_cqueue);
+        if (dispatch_op(context, &op) != 0) {
             return HTTP_SERVUNAVAIL;
         }
-        pthread_mutex_unlock(&context->mtx_cqueue);
-        pthread_cond_signal(&context->cond_cqueue);
         
         return 0;
     }
@@ -41,6 +64,13 @@ int handle_domain_layers(struct evhttp_request * const req,
         if (*uri == 0) {
             return HTTP_NOTFOUND;
         }
+        LayersCreateOptParseCBContext cb_context = {
+            .index_type = INDEX_TYPE_NONE
+        };
+        if (opts != NULL &&
+            query_parse(opts, layers_create_opt_parse_cb, &cb_context) != 0) {
+            return HTTP_BADREQUEST;
+        }
         if ((layer_name = new_key_from_c_string(uri)) == NULL) {
             return HTTP_SERVUNAVAIL;
         }
@@ -48,17 +78,13 @@ int handle_domain_layers(struct evhttp_request * const req,
             .type = OP_TYPE_LAYERS_CREATE,
             .req = req,
             .fake_req = fake_req,
-            .op_tid = ++context->op_tid,
-            .layer_name = layer_name
+            .op_tid = next_op_tid(context),
+            .layer_name = layer_name,
+            .index_type = cb_context.index_type
         };
-        pthread_mutex_lock(&context->mtx_cqueue);
-        if (push_cqueue(context->cqueue, create_op) != 0) {
-            pthread_mutex_unlock(&context->mtx_cqueue);
+        if (dispatch_journaled_op(context, &op) != 0) {
             return HTTP_SERVUNAVAIL;
         }
-        pthread_mutex_unlock(&context->mtx_cqueue);
-        pthread_cond_signal(&context->cond_cqueue);
-        *write_to_log = 1;
         
         return 0;
     }
@@ -76,17 +102,12 @@ int handle_domain_layers(struct evhttp_request * const req,
             .type = OP_TYPE_LAYERS_DELETE,
             .req = req,
             .fake_req = fake_req,
-            .op_tid = ++context->op_tid,
+            .op_tid = next_op_tid(context),
             .layer_name = layer_name
         };
-        pthread_mutex_lock(&context->mtx_cqueue);
-        if (push_cqueue(context->cqueue, delete_op) != 0) {
-            pthread_mutex_unlock(&context->mtx_cqueue);
+        if (dispatch_journaled_op(context, &op) != 0) {
             return HTTP_SERVUNAVAIL;
         }
-        pthread_mutex_unlock(&context->mtx_cqueue);
-        pthread_cond_signal(&context->cond_cqueue);
-        *write_to_log = 1;
         
         return 0;
     }
@@ -137,6 +158,9 @@ static Layer *register_new_layer(HttpHandlerContext * const context_,
         remove_entry_from_slab(&context->layers_slab, layer);
         return NULL;
     }
+    if (context->bulk_load_layers != 0) {
+        begin_bulk_load(&layer->pan_db);
+    }
     context->nb_layers++;
 
     return layer;
@@ -183,6 +207,8 @@ int handle_op_layers_create(LayersCreateOp * const create_op,
     release_key(create_op->layer_name);
     if (pan_db == NULL) {
         assert(status < 0);
+    } else if (status > 0 && create_op->index_type != INDEX_TYPE_NONE) {
+        pan_db->index_type = create_op->index_type;
     }
     if (create_op->fake_req != 0) {
         return 0;
@@ -303,8 +329,9 @@ int add_layer_name_to_json_gen(void *context_, void *entry,
     AddLayerNameToJsonCBContext *context = context_;
     yajl_gen json_gen = context->json_gen;    
     Layer * const layer = entry;
-    const PanDB * const pan_db = &layer->pan_db;
+    PanDB * const pan_db = &layer->pan_db;
     
+    prwlock_rdlock(&pan_db->rwlock_db);
     yajl_gen_map_open(json_gen);
     yajl_gen_string(json_gen,
                     (const unsigned char *) "name",
@@ -374,6 +401,15 @@ int add_layer_name_to_json_gen(void *context_, void *entry,
                     (const unsigned char *) accuracy,
                     (unsigned int) strlen(accuracy));
     
+    yajl_gen_string(json_gen,
+                    (const unsigned char *) "index",
+                    (unsigned int) sizeof "index" - (size_t) 1U);
+    const char * const index_type =
+        pan_db->index_type == INDEX_TYPE_MORTON ? "morton" : "quadtree";
+    yajl_gen_string(json_gen,
+                    (const unsigned char *) index_type,
+                    (unsigned int) strlen(index_type));
+    
     yajl_gen_string(json_gen,
                     (const unsigned char *) "latitude_accuracy",
                     (unsigned int) sizeof "latitude_accuracy" - (size_t) 1U);
@@ -394,6 +430,8 @@ int add_layer_name_to_json_gen(void *context_, void *entry,
     yajl_gen_array_close(json_gen);
     
     yajl_gen_map_close(json_gen);    
+    prwlock_unlock(&pan_db->rwlock_db);
+    
     return 0;
 }
 
@@ -4,7 +4,7 @@
 
 int handle_domain_layers(struct evhttp_request * const req,
                          HttpHandlerContext * const context,
-                         char *uri, char *opts, _Bool * const write_to_log,
+                         char *uri, char *opts,
                          const _Bool fake_req);
 
 int handle_op_layers_create(LayersCreateOp * const create_op,
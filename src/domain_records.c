@@ -5,6 +5,7 @@
 #include "domain_layers.h"
 #include "query_parser.h"
 #include "expirables.h"
+#include "polygons.h"
 
 #ifndef PROPERTIES_DEFAULT_SLIP_MAP_BUFFER_SIZE
 # define PROPERTIES_DEFAULT_SLIP_MAP_BUFFER_SIZE (size_t) 32U
@@ -36,16 +37,30 @@ static int records_put_opt_parse_cb(void * const context_,
             return -1;
         }
         char *endptr;
-        put_op->position.latitude = (Dimension) strtod(svalue, &endptr);
+        const double latitude = strtod(svalue, &endptr);
         if (endptr == NULL || endptr == svalue) {
             return -1;
         }
-        put_op->position.longitude = (Dimension) strtod(sep, &endptr);
+        const double longitude = strtod(sep, &endptr);
         if (endptr == NULL || endptr == sep) {
             return -1;
         }
         *zeroed1 = ',';
-        put_op->position_set = 1;
+        put_op->position_set =
+            make_slot_position(&put_op->position, latitude, longitude) == 0;
+    } else if (BINVAL_IS_EQUAL_TO_CONST_STRING(key, INT_PROPERTY_POLYGON)) {
+        char *svalue = value->val;
+        skip_spaces((const char * *) &svalue);
+        free(put_op->polygon_vertices);
+        put_op->polygon_vertices = NULL;
+        put_op->polygon_set = 1;
+        if (*svalue == 0) {
+            return 0;
+        }
+        if (parse_polygon(svalue, &put_op->polygon_vertices,
+                          &put_op->polygon_nb_vertices) != 0) {
+            return -1;
+        }
     } else if (BINVAL_IS_EQUAL_TO_CONST_STRING(key, INT_PROPERTY_EXPIRES_AT)) {
         char *svalue = value->val;
         skip_spaces((const char * *) &svalue);
@@ -87,6 +102,118 @@ static int records_put_opt_parse_cb(void * const context_,
     return 0;
 }
 
+static int records_import_opt_parse_cb(void * const context_,
+                                       const BinVal *key, const BinVal *value)
+{
+    RecordsPutOptParseCBContext * const context = context_;
+    RecordsPutOp * const put_op = context->put_op;
+    
+    if (BINVAL_IS_EQUAL_TO_CONST_STRING(key, INT_PROPERTY_KEY)) {
+        if (value->size <= (size_t) 0U || *value->val == 0) {
+            return -1;
+        }
+        release_key(put_op->key);
+        if ((put_op->key = new_key_from_c_string(value->val)) == NULL) {
+            return -1;
+        }
+        return 0;
+    }
+    return records_put_opt_parse_cb(context_, key, value);
+}
+
+static void free_records_put_ops(RecordsPutOp * const put_ops,
+                                 const size_t nb_put_ops)
+{
+    RecordsPutOp *put_op;
+    size_t t;
+    
+    for (t = (size_t) 0U; t < nb_put_ops; t++) {
+        put_op = &put_ops[t];
+        release_key(put_op->key);
+        free_slip_map(&put_op->properties);
+        free_slip_map(&put_op->special_properties);
+        free(put_op->polygon_vertices);
+    }
+    free(put_ops);
+}
+
+static int records_import_parse(RecordsImportOp * const import_op,
+                                char * const body)
+{
+    RecordsPutOp *put_ops;
+    RecordsPutOp *put_op;
+    char *line = body;
+    char *eol;
+    char *zeroed;
+    size_t nb_lines = (size_t) 1U;
+    int ret;
+    
+    for (eol = body; (eol = strchr(eol, '\n')) != NULL; eol++) {
+        nb_lines++;
+    }
+    if ((put_ops = malloc(nb_lines * sizeof *put_ops)) == NULL) {
+        return -1;
+    }
+    import_op->put_ops = put_ops;
+    import_op->nb_put_ops = (size_t) 0U;
+    do {
+        if ((eol = strchr(line, '\n')) != NULL) {
+            *eol = 0;
+        }
+        zeroed = NULL;
+        if (*line != 0 && line[strlen(line) - (size_t) 1U] == '\r') {
+            zeroed = &line[strlen(line) - (size_t) 1U];
+            *zeroed = 0;
+        }
+        ret = 0;
+        if (*line != 0) {
+            put_op = &put_ops[import_op->nb_put_ops++];
+            *put_op = (RecordsPutOp) {
+                .type = OP_TYPE_RECORDS_PUT,
+                .req = import_op->req,
+                .fake_req = 1,
+                .op_tid = import_op->op_tid,
+                .layer_name = NULL,
+                .key = NULL,
+                .position = {
+                    .latitude  = (SlotDimension) -1,
+                    .longitude = (SlotDimension) -1
+                },
+                .position_set = 0,
+                .properties = NULL,
+                .special_properties = NULL,
+                .polygon_vertices = NULL,
+                .polygon_nb_vertices = (NbSlots) 0U,
+                .polygon_set = 0,
+                .expires_at = (time_t) 0
+            };
+            RecordsPutOptParseCBContext cb_context = {
+                .put_op = put_op
+            };
+            if (query_parse(line, records_import_opt_parse_cb,
+                            &cb_context) != 0 || put_op->key == NULL) {
+                ret = -1;
+            }
+        }
+        if (zeroed != NULL) {
+            *zeroed = '\r';
+        }
+        if (eol == NULL) {
+            break;
+        }
+        *eol = '\n';
+        line = eol + 1;
+    } while (ret == 0);
+    if (ret != 0 || import_op->nb_put_ops <= (size_t) 0U) {
+        free_records_put_ops(put_ops, import_op->nb_put_ops);
+        import_op->put_ops = NULL;
+        import_op->nb_put_ops = (size_t) 0U;
+        
+        return -1;
+    }
+    return 0;
+}
+
 typedef struct RecordsOptParseCBContext_ {
     _Bool with_links;
 } RecordsOptParseCBContext;
@@ -116,7 +243,7 @@ static int records_opt_parse_cb(void * const context_,
 
 int handle_domain_records(struct evhttp_request * const req,
                           HttpHandlerContext * const context,
-                          char *uri, char *opts, _Bool * const write_to_log,
+                          char *uri, char *opts,
                           const _Bool fake_req)
 {
     Key *layer_name;
@@ -157,21 +284,17 @@ int handle_domain_records(struct evhttp_request * const req,
             .type = OP_TYPE_RECORDS_GET,
             .req = req,
             .fake_req = fake_req,
-            .op_tid = ++context->op_tid,
+            .op_tid = next_op_tid(context),
             .layer_name = layer_name,
             .key = key,
             .with_links = cb_context.with_links
         };        
-        pthread_mutex_lock(&context->mtx_cqueue);
-        if (push_cqueue(context->cqueue, get_op) != 0) {
-            pthread_mutex_unlock(&context->mtx_cqueue);            
+        if (dispatch_op(context, &op) != 0) {
             release_key(layer_name);
             release_key(key);        
             
             return HTTP_SERVUNAVAIL;
         }
-        pthread_mutex_unlock(&context->mtx_cqueue);
-        pthread_cond_signal(&context->cond_cqueue);
         
         return 0;
     }
@@ -205,16 +328,19 @@ int handle_domain_records(struct evhttp_request * const req,
             .type = OP_TYPE_RECORDS_PUT,
             .req = req,
             .fake_req = fake_req,
-            .op_tid = ++context->op_tid,
+            .op_tid = next_op_tid(context),
             .layer_name = layer_name,
             .key = key,
             .position = {
-                .latitude  = (Dimension) -1,
-                .longitude = (Dimension) -1
+                .latitude  = (SlotDimension) -1,
+                .longitude = (SlotDimension) -1
             },
             .position_set = 0,
             .properties = NULL,
             .special_properties = NULL,
+            .polygon_vertices = NULL,
+            .polygon_nb_vertices = (NbSlots) 0U,
+            .polygon_set = 0,
             .expires_at = (time_t) 0
         };
         RecordsPutOptParseCBContext cb_context = {
@@ -223,23 +349,20 @@ int handle_domain_records(struct evhttp_request * const req,
         if (query_parse(body, records_put_opt_parse_cb, &cb_context) != 0) {
             free_slip_map(&put_op->properties);
             free_slip_map(&put_op->special_properties);
+            free(put_op->polygon_vertices);
             release_key(layer_name);
             release_key(key);
             return HTTP_BADREQUEST;
         }
-        pthread_mutex_lock(&context->mtx_cqueue);
-        if (push_cqueue(context->cqueue, put_op) != 0) {
-            pthread_mutex_unlock(&context->mtx_cqueue);            
+        if (dispatch_journaled_op(context, &op) != 0) {
             free_slip_map(&put_op->properties);
             free_slip_map(&put_op->special_properties);            
+            free(put_op->polygon_vertices);
             release_key(layer_name);
             release_key(key);
             
             return HTTP_SERVUNAVAIL;
         }
-        pthread_mutex_unlock(&context->mtx_cqueue);
-        pthread_cond_signal(&context->cond_cqueue);
-        *write_to_log = 1;
         
         return 0;
     }
@@ -268,24 +391,61 @@ int handle_domain_records(struct evhttp_request * const req,
             .type = OP_TYPE_RECORDS_DELETE,
             .req = req,
             .fake_req = fake_req,
-            .op_tid = ++context->op_tid,
+            .op_tid = next_op_tid(context),
             .layer_name = layer_name,
             .key = key
         };
-        pthread_mutex_lock(&context->mtx_cqueue);
-        if (push_cqueue(context->cqueue, delete_op) != 0) {
-            pthread_mutex_unlock(&context->mtx_cqueue);            
+        if (dispatch_journaled_op(context, &op) != 0) {
             release_key(layer_name);
             release_key(key);
             
             return HTTP_SERVUNAVAIL;
         }
-        pthread_mutex_unlock(&context->mtx_cqueue);
-        pthread_cond_signal(&context->cond_cqueue);
-        *write_to_log = 1;
         
         return 0;
     }    
+    
+    if (req->type == EVHTTP_REQ_POST) {
+        Op op;
+        RecordsImportOp * const import_op = &op.records_import_op;
+        
+        if (*uri == 0 || strchr(uri, '/') != NULL) {
+            return HTTP_NOTFOUND;
+        }
+        if (evbuffer_get_length(evhttp_request_get_input_buffer(req)) >
+            DB_LOG_MAX_BODY_LEN) {
+            return HTTP_ENTITYTOOLARGE;
+        }
+        if ((layer_name = new_key_from_c_string(uri)) == NULL) {
+            return HTTP_SERVUNAVAIL;
+        }
+        evbuffer_add(evhttp_request_get_input_buffer(req), "", (size_t) 1U);
+        char *body =
+            (char *) evbuffer_pullup(evhttp_request_get_input_buffer(req), -1);
+        
+        *import_op = (RecordsImportOp) {
+            .type = OP_TYPE_RECORDS_IMPORT,
+            .req = req,
+            .fake_req = fake_req,
+            .op_tid = next_op_tid(context),
+            .layer_name = layer_name,
+            .put_ops = NULL,
+            .nb_put_ops = (size_t) 0U,
+            .barrier = NULL
+        };
+        if (records_import_parse(import_op, body) != 0) {
+            release_key(layer_name);
+            return HTTP_BADREQUEST;
+        }
+        if (dispatch_journaled_op(context, &op) != 0) {
+            free_records_put_ops(import_op->put_ops, import_op->nb_put_ops);
+            release_key(layer_name);
+            
+            return HTTP_SERVUNAVAIL;
+        }
+        
+        return 0;
+    }
     return HTTP_NOTFOUND;
 }
 
@@ -412,23 +572,11 @@ static int records_put_apply_special_properties_cb(void * const context_,
     return 0;
 }
 
-int handle_op_records_put(RecordsPutOp * const put_op,
-                          HttpHandlerContext * const context)
+static int records_put_in_layer(RecordsPutOp * const put_op,
+                                HttpHandlerContext * const context,
+                                PanDB * const pan_db)
 {
     yajl_gen json_gen;
-    PanDB *pan_db;
-
-    if (get_pan_db_by_layer_name(context, put_op->layer_name->val,
-                                 AUTOMATICALLY_CREATE_LAYERS, &pan_db) < 0) {
-        release_key(put_op->layer_name);
-        release_key(put_op->key);
-        free_slip_map(&put_op->properties);
-        free_slip_map(&put_op->special_properties);        
-        
-        return HTTP_NOTFOUND;
-    }
-    release_key(put_op->layer_name);
-
     int status;    
     KeyNode *key_node;
     status = get_key_node_from_key(pan_db, put_op->key, 1, &key_node);
@@ -437,28 +585,62 @@ int handle_op_records_put(RecordsPutOp * const put_op,
         assert(status <= 0);
         free_slip_map(&put_op->properties);
         free_slip_map(&put_op->special_properties);        
+        free(put_op->polygon_vertices);
         return HTTP_NOTFOUND;
     }
     assert(status > 0);
+    if (put_op->polygon_set != 0) {
+        Polygon *polygon = NULL;
+        
+        if (put_op->polygon_vertices != NULL) {
+            polygon = new_polygon(put_op->polygon_vertices,
+                                  put_op->polygon_nb_vertices);
+            free(put_op->polygon_vertices);
+            put_op->polygon_vertices = NULL;
+            if (polygon == NULL || add_polygon(pan_db, polygon) != 0) {
+                free(polygon);
+                if (status == 2) {
+                    RB_REMOVE(KeyNodes_, &pan_db->key_nodes, key_node);
+                    free_key_node(pan_db, key_node);
+                }
+                free_slip_map(&put_op->properties);
+                free_slip_map(&put_op->special_properties);
+                
+                return HTTP_SERVUNAVAIL;
+            }
+            polygon->key_node = key_node;
+        }
+        if (key_node->polygon != NULL) {
+            remove_polygon(pan_db, key_node->polygon);
+        }
+        key_node->polygon = polygon;
+    }
     const Rectangle2D * const qbounds = &pan_db->qbounds;
+    const Position2D position = SLOT_POSITION(&put_op->position);
     if (put_op->position_set != 0 &&
-        !(put_op->position.latitude >= qbounds->edge0.latitude &&
-          put_op->position.longitude >= qbounds->edge0.longitude &&
-          put_op->position.latitude < qbounds->edge1.latitude &&
-          put_op->position.longitude < qbounds->edge1.longitude)) {
+        !(position.latitude >= qbounds->edge0.latitude &&
+          position.longitude >= qbounds->edge0.longitude &&
+          position.latitude < qbounds->edge1.latitude &&
+          position.longitude < qbounds->edge1.longitude)) {
         put_op->position_set = 0;
     }
     if (status > 0 && put_op->position_set != 0 && key_node->slot != NULL) {
 #if PROJECTION
-        const Position2D * const previous_position =
+        const SlotPosition * const previous_position =
             &key_node->slot->real_position;
 #else
-        const Position2D * const previous_position =
+        const SlotPosition * const previous_position =
             &key_node->slot->position;
 #endif
         if (previous_position->latitude == put_op->position.latitude &&
             previous_position->longitude == put_op->position.longitude) {
             put_op->position_set = 0;
+        } else if (move_slot(pan_db, key_node->slot,
+                             &put_op->position) == 0) {
+#if PROJECTION
+            key_node->slot->real_position = put_op->position;
+#endif
+            put_op->position_set = 0;
         } else {
             remove_entry_from_key_node(pan_db, key_node, 0);
             assert(key_node->slot != NULL);
@@ -475,7 +657,7 @@ int handle_op_records_put(RecordsPutOp * const put_op,
             .real_position = put_op->position,
 #endif
             .position = put_op->position,
-            .key_node = key_node
+            .key_node = KEY_NODE_REF(pan_db, key_node)
         };
         if (add_slot(pan_db, &slot, &new_slot) != 0) {
             RB_REMOVE(KeyNodes_, &pan_db->key_nodes, key_node);
@@ -515,7 +697,7 @@ int handle_op_records_put(RecordsPutOp * const put_op,
                 .ts = put_op->expires_at,
                 .key_node = key_node
             };
-            expirable = add_entry_to_slab(&context->expirables_slab,
+            expirable = add_entry_to_slab(&pan_db->expirables_slab,
                                           &new_expirable);
             key_node->expirable = expirable;
             add_expirable_to_tree(pan_db, expirable);
@@ -530,7 +712,7 @@ int handle_op_records_put(RecordsPutOp * const put_op,
     } else if (expirable != NULL) {
         assert(expirable->key_node == key_node);
         remove_expirable_from_tree(pan_db, expirable);        
-        remove_entry_from_slab(&context->expirables_slab, expirable);
+        remove_entry_from_slab(&pan_db->expirables_slab, expirable);
         key_node->expirable = NULL;
     }
     if (put_op->fake_req != 0) {
@@ -563,21 +745,35 @@ int handle_op_records_put(RecordsPutOp * const put_op,
     return 0;
 }
 
-int handle_op_records_get(RecordsGetOp * const get_op,
+int handle_op_records_put(RecordsPutOp * const put_op,
                           HttpHandlerContext * const context)
 {
-    yajl_gen json_gen;
     PanDB *pan_db;
+    int ret;
 
-    if (get_pan_db_by_layer_name(context, get_op->layer_name->val,
+    if (get_pan_db_by_layer_name(context, put_op->layer_name->val,
                                  AUTOMATICALLY_CREATE_LAYERS, &pan_db) < 0) {
-        release_key(get_op->layer_name);
-        release_key(get_op->key);
+        release_key(put_op->layer_name);
+        release_key(put_op->key);
+        free_slip_map(&put_op->properties);
+        free_slip_map(&put_op->special_properties);        
+        free(put_op->polygon_vertices);
         
         return HTTP_NOTFOUND;
     }
-    release_key(get_op->layer_name);
+    release_key(put_op->layer_name);
+    prwlock_wrlock(&pan_db->rwlock_db);
+    ret = records_put_in_layer(put_op, context, pan_db);
+    prwlock_unlock(&pan_db->rwlock_db);
+    
+    return ret;
+}
 
+static int records_get_in_layer(RecordsGetOp * const get_op,
+                                HttpHandlerContext * const context,
+                                PanDB * const pan_db)
+{
+    yajl_gen json_gen;
     int status;
     KeyNode *key_node;
     status = get_key_node_from_key(pan_db, get_op->key, 0, &key_node);
@@ -614,21 +810,32 @@ int handle_op_records_get(RecordsGetOp * const get_op,
     return 0;
 }
 
-int handle_op_records_delete(RecordsDeleteOp * const delete_op,
-                             HttpHandlerContext * const context)
+int handle_op_records_get(RecordsGetOp * const get_op,
+                          HttpHandlerContext * const context)
 {
-    yajl_gen json_gen;
     PanDB *pan_db;
+    int ret;
 
-    if (get_pan_db_by_layer_name(context, delete_op->layer_name->val, 0,
-                                 &pan_db) < 0) {
-        release_key(delete_op->layer_name);
-        release_key(delete_op->key);
+    if (get_pan_db_by_layer_name(context, get_op->layer_name->val,
+                                 AUTOMATICALLY_CREATE_LAYERS, &pan_db) < 0) {
+        release_key(get_op->layer_name);
+        release_key(get_op->key);
         
         return HTTP_NOTFOUND;
     }
-    release_key(delete_op->layer_name);
+    release_key(get_op->layer_name);
+    prwlock_rdlock(&pan_db->rwlock_db);
+    ret = records_get_in_layer(get_op, context, pan_db);
+    prwlock_unlock(&pan_db->rwlock_db);
+    
+    return ret;
+}
 
+static int records_delete_in_layer(RecordsDeleteOp * const delete_op,
+                                   HttpHandlerContext * const context,
+                                   PanDB * const pan_db)
+{
+    yajl_gen json_gen;
     int status;
     KeyNode *key_node;
     status = get_key_node_from_key(pan_db, delete_op->key, 0, &key_node);
@@ -676,3 +883,126 @@ int handle_op_records_delete(RecordsDeleteOp * const delete_op,
     
     return 0;
 }
+
+int handle_op_records_delete(RecordsDeleteOp * const delete_op,
+                             HttpHandlerContext * const context)
+{
+    PanDB *pan_db;
+    int ret;
+
+    if (get_pan_db_by_layer_name(context, delete_op->layer_name->val, 0,
+                                 &pan_db) < 0) {
+        release_key(delete_op->layer_name);
+        release_key(delete_op->key);
+        
+        return HTTP_NOTFOUND;
+    }
+    release_key(delete_op->layer_name);
+    prwlock_wrlock(&pan_db->rwlock_db);
+    ret = records_delete_in_layer(delete_op, context, pan_db);
+    prwlock_unlock(&pan_db->rwlock_db);
+    
+    return ret;
+}
+
+int handle_op_records_import(RecordsImportOp * const import_op,
+                             HttpHandlerContext * const context)
+{
+    yajl_gen json_gen;
+    PanDB *pan_db;
+    SubSlots nb_stored = (SubSlots) 0U;
+    size_t t;
+    int bulk_load;
+    int ret = 0;
+    
+    if (get_pan_db_by_layer_name(context, import_op->layer_name->val,
+                                 AUTOMATICALLY_CREATE_LAYERS, &pan_db) < 0) {
+        release_key(import_op->layer_name);
+        free_records_put_ops(import_op->put_ops, import_op->nb_put_ops);
+        
+        return HTTP_NOTFOUND;
+    }
+    release_key(import_op->layer_name);
+    prwlock_wrlock(&pan_db->rwlock_db);
+    bulk_load = begin_bulk_load(pan_db);
+    for (t = (size_t) 0U; t < import_op->nb_put_ops; t++) {
+        if (records_put_in_layer(&import_op->put_ops[t],
+                                 context, pan_db) == 0) {
+            nb_stored++;
+        }
+    }
+    if (bulk_load > 0 && end_bulk_load(pan_db) != 0) {
+        ret = HTTP_SERVUNAVAIL;
+    }
+    prwlock_unlock(&pan_db->rwlock_db);
+    free(import_op->put_ops);
+    if (ret != 0 || import_op->fake_req != 0) {
+        return ret;
+    }
+    OpReply *op_reply = malloc(sizeof *op_reply);
+    if (op_reply == NULL) {
+        return HTTP_SERVUNAVAIL;
+    }
+    RecordsImportOpReply * const import_op_reply =
+        &op_reply->records_import_op_reply;
+    
+    *import_op_reply = (RecordsImportOpReply) {
+        .type = OP_TYPE_RECORDS_IMPORT,
+        .req = import_op->req,
+        .op_tid = import_op->op_tid,
+        .json_gen = NULL
+    };
+    if ((json_gen = new_json_gen(op_reply)) == NULL) {
+        free(op_reply);
+        return HTTP_SERVUNAVAIL;
+    }
+    import_op_reply->json_gen = json_gen;
+    yajl_gen_string(json_gen, (const unsigned char *) "status",
+                    (unsigned int) sizeof "status" - (size_t) 1U);
+    yajl_gen_string(json_gen, (const unsigned char *) "stored",
+                    (unsigned int) sizeof "stored" - (size_t) 1U);
+    yajl_gen_string(json_gen, (const unsigned char *) "records",
+                    (unsigned int) sizeof "records" - (size_t) 1U);
+    yajl_gen_integer(json_gen, (long) nb_stored);
+    send_op_reply(context, op_reply);
+    
+    return 0;
+}
+
+int handle_op_records_write_batch(Op * const ops, const size_t nb_ops,
+                                  int * const rets,
+                                  HttpHandlerContext * const context)
+{
+    const Key *layer_name;
+    PanDB *pan_db;
+    Op *op;
+    size_t t;
+    
+    if (ops[0].bare_op.type == OP_TYPE_RECORDS_PUT) {
+        layer_name = ops[0].records_put_op.layer_name;
+    } else {
+        assert(ops[0].bare_op.type == OP_TYPE_RECORDS_DELETE);
+        layer_name = ops[0].records_delete_op.layer_name;
+    }
+    if (get_pan_db_by_layer_name(context, layer_name->val,
+                                 0, &pan_db) < 0) {
+        return -1;
+    }
+    prwlock_wrlock(&pan_db->rwlock_db);
+    for (t = (size_t) 0U; t < nb_ops; t++) {
+        op = &ops[t];
+        if (op->bare_op.type == OP_TYPE_RECORDS_PUT) {
+            release_key(op->records_put_op.layer_name);
+            rets[t] = records_put_in_layer(&op->records_put_op,
+                                           context, pan_db);
+        } else {
+            assert(op->bare_op.type == OP_TYPE_RECORDS_DELETE);
+            release_key(op->records_delete_op.layer_name);
+            rets[t] = records_delete_in_layer(&op->records_delete_op,
+                                              context, pan_db);
+        }
+    }
+    prwlock_unlock(&pan_db->rwlock_db);
+    
+    return 0;
+}
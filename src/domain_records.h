@@ -4,7 +4,7 @@
 
 int handle_domain_records(struct evhttp_request * const req,
                           HttpHandlerContext * const context,
-                          char *uri, char *opts, _Bool * const write_to_log,
+                          char *uri, char *opts,
                           const _Bool fake_req);
 
 int handle_op_records_put(RecordsPutOp * const put_op,
@@ -16,4 +16,11 @@ int handle_op_records_get(RecordsGetOp * const get_op,
 int handle_op_records_delete(RecordsDeleteOp * const get_op,
                              HttpHandlerContext * const context);
 
+int handle_op_records_import(RecordsImportOp * const import_op,
+                             HttpHandlerContext * const context);
+
+int handle_op_records_write_batch(Op * const ops, const size_t nb_ops,
+                                  int * const rets,
+                                  HttpHandlerContext * const context);
+
 #endif
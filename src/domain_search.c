@@ -4,16 +4,26 @@
 #include "domain_layers.h"
 #include "domain_search.h"
 #include "query_parser.h"
+#include "polygons.h"
 
 #define DEFAULT_SEARCH_LIMIT 250
+#define DEFAULT_NEAREST_K    10
+#define DEFAULT_GRID_CELLS   10
+#define MAX_GRID_CELLS       65536
 
 typedef struct SearchOptParseCBContext_ {
     Dimension radius;
     SubSlots limit;
+    SubSlots k;
+    NbSlots cols;
+    NbSlots rows;
+    Key *sum_property;
     Dimension epsilon;
     _Bool with_properties;
     _Bool with_content;
     _Bool with_links;
+    _Bool sort_by_distance;
+    _Bool count_only;
 } SearchOptParseCBContext;
 
 static int search_opt_parse_cb(void * const context_,
@@ -44,6 +54,39 @@ static int search_opt_parse_cb(void * const context_,
         context->limit = limit;
         return 0;
     }
+    if (BINVAL_IS_EQUAL_TO_CONST_STRING(key, "k")) {
+        char *endptr;
+        SubSlots k = (SubSlots) strtoul(svalue, &endptr, 10);
+        if (endptr == NULL || endptr == svalue || k <= (SubSlots) 0U) {
+            return -1;
+        }
+        context->k = k;
+        return 0;
+    }
+    if (BINVAL_IS_EQUAL_TO_CONST_STRING(key, "cols") ||
+        BINVAL_IS_EQUAL_TO_CONST_STRING(key, "rows")) {
+        char *endptr;
+        unsigned long v = strtoul(svalue, &endptr, 10);
+        if (endptr == NULL || endptr == svalue || v <= 0UL ||
+            v > MAX_GRID_CELLS) {
+            return -1;
+        }
+        if (BINVAL_IS_EQUAL_TO_CONST_STRING(key, "cols")) {
+            context->cols = (NbSlots) v;
+        } else {
+            context->rows = (NbSlots) v;
+        }
+        return 0;
+    }
+    if (BINVAL_IS_EQUAL_TO_CONST_STRING(key, "sum")) {
+        if (context->sum_property != NULL) {
+            release_key(context->sum_property);
+        }
+        if ((context->sum_property = new_key_from_c_string(svalue)) == NULL) {
+            return -1;
+        }
+        return 0;
+    }
     if (BINVAL_IS_EQUAL_TO_CONST_STRING(key, "epsilon")) {
         char *endptr;
         Dimension epsilon = (Dimension) strtod(svalue, &endptr);
@@ -53,6 +96,22 @@ static int search_opt_parse_cb(void * const context_,
         context->epsilon = epsilon;
         return 0;
     }
+    if (BINVAL_IS_EQUAL_TO_CONST_STRING(key, "sort")) {
+        if (strcasecmp(svalue, "distance") != 0) {
+            return -1;
+        }
+        context->sort_by_distance = 1;
+        return 0;
+    }
+    if (BINVAL_IS_EQUAL_TO_CONST_STRING(key, "count")) {
+        char *endptr;
+        unsigned long v = strtoul(svalue, &endptr, 10);
+        if (endptr == NULL || endptr == svalue) {
+            return -1;
+        }
+        context->count_only = (v != 0);
+        return 0;
+    }
     if (BINVAL_IS_EQUAL_TO_CONST_STRING(key, "properties")) {
         char *endptr;
         unsigned long v = strtoul(svalue, &endptr, 10);
@@ -92,13 +151,136 @@ static int search_opt_parse_cb(void * const context_,
     return 0;
 }
 
+static int parse_rect(char *query, Rectangle2D * const rect)
+{
+    Dimension * const dimensions[4] = {
+        &rect->edge0.latitude, &rect->edge0.longitude,
+        &rect->edge1.latitude, &rect->edge1.longitude
+    };
+    char *endptr;
+    unsigned int t = 0U;
+    
+    for (;;) {
+        skip_spaces((const char * *) &query);
+        *dimensions[t] = (Dimension) strtod(query, &endptr);
+        if (endptr == NULL || endptr == query) {
+            return -1;
+        }
+        if (++t >= 4U) {
+            break;
+        }
+        query = endptr;
+        skip_spaces((const char * *) &query);
+        if (*query++ != ',') {
+            return -1;
+        }
+    }
+    untangle_rect(rect);
+    
+    return 0;
+}
+
+typedef struct PolygonParseCBContext_ {
+    Position2D *vertices;
+    NbSlots nb_vertices;
+} PolygonParseCBContext;
+
+static int polygon_parse_cb(void * const context_,
+                            const BinVal *key, const BinVal *value)
+{
+    PolygonParseCBContext * const context = context_;
+    
+    if (!BINVAL_IS_EQUAL_TO_CONST_STRING(key, "polygon")) {
+        return 0;
+    }
+    if (context->vertices != NULL) {
+        return -1;
+    }
+    return parse_polygon(value->val, &context->vertices,
+                         &context->nb_vertices);
+}
+
+static int handle_domain_search_in_polygon(struct evhttp_request * const req,
+                                           HttpHandlerContext * const context,
+                                           char *uri, char *opts,
+                                           const _Bool fake_req)
+{
+    Key *layer_name;
+    Op op;
+    char *sep;
+    
+    if ((sep = strchr(uri, '/')) == NULL ||
+        strcasecmp(sep + 1, "in_polygon") != 0) {
+        return HTTP_NOTFOUND;
+    }
+    *sep = 0;
+    if (*uri == 0 || (layer_name = new_key_from_c_string(uri)) == NULL) {
+        *sep = '/';
+        return HTTP_SERVUNAVAIL;
+    }
+    *sep = '/';
+    SearchOptParseCBContext cb_context = {
+        .limit = DEFAULT_SEARCH_LIMIT,
+        .with_properties = 1,
+        .with_links = 0,
+        .sum_property = NULL
+    };
+    if (opts != NULL &&
+        query_parse(opts, search_opt_parse_cb, &cb_context) != 0) {
+        release_key(layer_name);
+        if (cb_context.sum_property != NULL) {
+            release_key(cb_context.sum_property);
+        }
+        return HTTP_BADREQUEST;
+    }
+    if (cb_context.sum_property != NULL) {
+        release_key(cb_context.sum_property);
+    }
+    evbuffer_add(evhttp_request_get_input_buffer(req), "", (size_t) 1U);
+    const char *body =
+        (char *) evbuffer_pullup(evhttp_request_get_input_buffer(req), -1);
+    PolygonParseCBContext polygon_context = {
+        .vertices = NULL,
+        .nb_vertices = (NbSlots) 0U
+    };
+    if (query_parse(body, polygon_parse_cb, &polygon_context) != 0 ||
+        polygon_context.vertices == NULL) {
+        free(polygon_context.vertices);
+        release_key(layer_name);
+        return HTTP_BADREQUEST;
+    }
+    SearchInPolygonOp * const in_polygon_op = &op.search_in_polygon_op;
+    *in_polygon_op = (SearchInPolygonOp) {
+        .type = OP_TYPE_SEARCH_IN_POLYGON,
+        .req = req,
+        .fake_req = fake_req,
+        .op_tid = next_op_tid(context),
+        .layer_name = layer_name,
+        .vertices = polygon_context.vertices,
+        .nb_vertices = polygon_context.nb_vertices,
+        .limit = cb_context.limit,
+        .with_properties = cb_context.with_properties,
+        .with_links = cb_context.with_links
+    };
+    if (dispatch_op(context, &op) != 0) {
+        free(in_polygon_op->vertices);
+        release_key(layer_name);
+        
+        return HTTP_SERVUNAVAIL;
+    }
+    return 0;
+}
+
 int handle_domain_search(struct evhttp_request * const req,
                          HttpHandlerContext * const context,
-                         char *uri, char *opts, _Bool * const write_to_log,
+                         char *uri, char *opts,
                          const _Bool fake_req)
 {
-    (void) write_to_log;
     
+    if (req->type == EVHTTP_REQ_POST) {
+        return handle_domain_search_in_polygon(req, context, uri, opts,
+                                               fake_req);
+    }
     if (req->type != EVHTTP_REQ_GET) {
         return HTTP_NOTFOUND;
     }
@@ -134,16 +316,30 @@ int handle_domain_search(struct evhttp_request * const req,
     SearchOptParseCBContext cb_context = {
         .radius = (Dimension) 0.0,
         .limit = DEFAULT_SEARCH_LIMIT,
+        .k = DEFAULT_NEAREST_K,
+        .cols = DEFAULT_GRID_CELLS,
+        .rows = DEFAULT_GRID_CELLS,
+        .sum_property = NULL,
         .epsilon = (Dimension) -1.0,
         .with_properties = 1,
         .with_content = 1,
-        .with_links = 0
+        .with_links = 0,
+        .sort_by_distance = 0,
+        .count_only = 0
     };
     if (opts != NULL &&
         query_parse(opts, search_opt_parse_cb, &cb_context) != 0) {
         release_key(layer_name);
+        if (cb_context.sum_property != NULL) {
+            release_key(cb_context.sum_property);
+        }
         return HTTP_BADREQUEST;
     }
+    if (cb_context.sum_property != NULL &&
+        strcasecmp(search_type, "grid") != 0) {
+        release_key(cb_context.sum_property);
+        cb_context.sum_property = NULL;
+    }
     query = sep;
     if (strcasecmp(search_type, "nearby") == 0) {
         SearchNearbyOp * const nearby_op = &op.search_nearby_op;
@@ -153,7 +349,7 @@ int handle_domain_search(struct evhttp_request * const req,
             .type = OP_TYPE_SEARCH_NEARBY,
             .req = req,
             .fake_req = fake_req,
-            .op_tid = ++context->op_tid,
+            .op_tid = next_op_tid(context),
             .layer_name = layer_name,
             .position = {
                 .latitude  = (Dimension) -1,
@@ -163,7 +359,9 @@ int handle_domain_search(struct evhttp_request * const req,
             .limit = cb_context.limit,
             .epsilon = cb_context.epsilon,
             .with_properties = cb_context.with_properties,
-            .with_links = cb_context.with_links
+            .with_links = cb_context.with_links,
+            .sort_by_distance = cb_context.sort_by_distance,
+            .count_only = cb_context.count_only
         };
         if (*query == 0 || (sep = strchr(query, ',')) == NULL) {
             release_key(layer_name);
@@ -188,35 +386,34 @@ int handle_domain_search(struct evhttp_request * const req,
             return HTTP_BADREQUEST;
         }
         *zeroed2 = ',';
-        pthread_mutex_lock(&context->mtx_cqueue);
-        if (push_cqueue(context->cqueue, nearby_op) != 0) {
-            pthread_mutex_unlock(&context->mtx_cqueue);
+        if (dispatch_op(context, &op) != 0) {
             release_key(layer_name);
             
             return HTTP_SERVUNAVAIL;
         }
-        pthread_mutex_unlock(&context->mtx_cqueue);
-        pthread_cond_signal(&context->cond_cqueue);
         return 0;
     }
 
-    if (strcasecmp(search_type, "in_rect") == 0) {
-        SearchInRectOp * const in_rect_op = &op.search_in_rect_op;
-        
+    if (strcasecmp(search_type, "nearest") == 0) {
+        SearchNearestOp * const nearest_op = &op.search_nearest_op;
+
         *zeroed1 = '/';
-        *in_rect_op = (SearchInRectOp) {
-            .type = OP_TYPE_SEARCH_IN_RECT,
+        *nearest_op = (SearchNearestOp) {
+            .type = OP_TYPE_SEARCH_NEAREST,
             .req = req,
             .fake_req = fake_req,
-            .op_tid = ++context->op_tid,
+            .op_tid = next_op_tid(context),
             .layer_name = layer_name,
-            .rect = { { 0, 0 }, { 0, 0 } },
-            .limit = cb_context.limit,
-            .epsilon = cb_context.epsilon,
+            .position = {
+                .latitude  = (Dimension) -1,
+                .longitude = (Dimension) -1
+            },
+            .max_distance = cb_context.radius > (Dimension) 0.0 ?
+                cb_context.radius : (Dimension) -1.0,
+            .limit = cb_context.k,
             .with_properties = cb_context.with_properties,
             .with_links = cb_context.with_links
-         };
-        
+        };
         if (*query == 0 || (sep = strchr(query, ',')) == NULL) {
             release_key(layer_name);
             return HTTP_BADREQUEST;
@@ -229,35 +426,106 @@ int handle_domain_search(struct evhttp_request * const req,
             return HTTP_BADREQUEST;
         }
         char *endptr;
-        in_rect_op->rect.edge0.latitude = (Dimension) strtod(query, &endptr);
+        nearest_op->position.latitude = (Dimension) strtod(query, &endptr);
         if (endptr == NULL || endptr == query) {
             release_key(layer_name);            
             return HTTP_BADREQUEST;
         }
+        nearest_op->position.longitude = (Dimension) strtod(sep, &endptr);
+        if (endptr == NULL || endptr == sep) {
+            release_key(layer_name);            
+            return HTTP_BADREQUEST;
+        }
         *zeroed2 = ',';
+        if (dispatch_op(context, &op) != 0) {
+            release_key(layer_name);
+            
+            return HTTP_SERVUNAVAIL;
+        }
+        return 0;
+    }
+
+    if (strcasecmp(search_type, "in_rect") == 0) {
+        SearchInRectOp * const in_rect_op = &op.search_in_rect_op;
         
-        query = sep;
-        skip_spaces((const char * *) &query);
-        if (*query == 0 || (sep = strchr(query, ',')) == NULL) {
+        *zeroed1 = '/';
+        *in_rect_op = (SearchInRectOp) {
+            .type = OP_TYPE_SEARCH_IN_RECT,
+            .req = req,
+            .fake_req = fake_req,
+            .op_tid = next_op_tid(context),
+            .layer_name = layer_name,
+            .rect = { { 0, 0 }, { 0, 0 } },
+            .limit = cb_context.limit,
+            .epsilon = cb_context.epsilon,
+            .with_properties = cb_context.with_properties,
+            .with_links = cb_context.with_links,
+            .count_only = cb_context.count_only
+         };
+        if (parse_rect(query, &in_rect_op->rect) != 0) {
             release_key(layer_name);
             return HTTP_BADREQUEST;
         }
-        zeroed2 = sep;
-        *sep++ = 0;
-        skip_spaces((const char * *) &sep);
-        if (*sep == 0) {
+        if (dispatch_op(context, &op) != 0) {
             release_key(layer_name);
-            return HTTP_BADREQUEST;
+            
+            return HTTP_SERVUNAVAIL;
         }
-        in_rect_op->rect.edge0.longitude = (Dimension) strtod(query, &endptr);
-        if (endptr == NULL || endptr == query) {
-            release_key(layer_name);            
+        return 0;
+    }
+    
+    if (strcasecmp(search_type, "grid") == 0) {
+        SearchGridOp * const grid_op = &op.search_grid_op;
+
+        *zeroed1 = '/';
+        *grid_op = (SearchGridOp) {
+            .type = OP_TYPE_SEARCH_GRID,
+            .req = req,
+            .fake_req = fake_req,
+            .op_tid = next_op_tid(context),
+            .layer_name = layer_name,
+            .sum_property = cb_context.sum_property,
+            .rect = { { 0, 0 }, { 0, 0 } },
+            .cols = cb_context.cols,
+            .rows = cb_context.rows
+        };
+        if ((size_t) grid_op->cols * (size_t) grid_op->rows >
+            (size_t) MAX_GRID_CELLS ||
+            parse_rect(query, &grid_op->rect) != 0) {
+            release_key(layer_name);
+            if (grid_op->sum_property != NULL) {
+                release_key(grid_op->sum_property);
+            }
             return HTTP_BADREQUEST;
         }
-        *zeroed2 = ',';
-        
-        query = sep;
-        skip_spaces((const char * *) &query);
+        if (dispatch_op(context, &op) != 0) {
+            release_key(layer_name);
+            if (grid_op->sum_property != NULL) {
+                release_key(grid_op->sum_property);
+            }
+            return HTTP_SERVUNAVAIL;
+        }
+        return 0;
+    }
+    
+    if (strcasecmp(search_type, "containing") == 0) {
+        SearchContainingOp * const containing_op = &op.search_containing_op;
+
+        *zeroed1 = '/';
+        *containing_op = (SearchContainingOp) {
+            .type = OP_TYPE_SEARCH_CONTAINING,
+            .req = req,
+            .fake_req = fake_req,
+            .op_tid = next_op_tid(context),
+            .layer_name = layer_name,
+            .position = {
+                .latitude  = (Dimension) -1,
+                .longitude = (Dimension) -1
+            },
+            .limit = cb_context.limit,
+            .with_properties = cb_context.with_properties,
+            .with_links = cb_context.with_links
+        };
         if (*query == 0 || (sep = strchr(query, ',')) == NULL) {
             release_key(layer_name);
             return HTTP_BADREQUEST;
@@ -269,34 +537,23 @@ int handle_domain_search(struct evhttp_request * const req,
             release_key(layer_name);
             return HTTP_BADREQUEST;
         }
-        in_rect_op->rect.edge1.latitude = (Dimension) strtod(query, &endptr);
+        char *endptr;
+        containing_op->position.latitude = (Dimension) strtod(query, &endptr);
         if (endptr == NULL || endptr == query) {
             release_key(layer_name);            
             return HTTP_BADREQUEST;
         }
-        *zeroed2 = ',';
-
-        query = sep;
-        skip_spaces((const char * *) &query);
-        if (*query == 0) {
-            release_key(layer_name);
-            return HTTP_BADREQUEST;
-        }
-        in_rect_op->rect.edge1.longitude = (Dimension) strtod(query, &endptr);
-        if (endptr == NULL || endptr == query) {
+        containing_op->position.longitude = (Dimension) strtod(sep, &endptr);
+        if (endptr == NULL || endptr == sep) {
             release_key(layer_name);            
             return HTTP_BADREQUEST;
         }
-        untangle_rect(&in_rect_op->rect);
-        pthread_mutex_lock(&context->mtx_cqueue);
-        if (push_cqueue(context->cqueue, in_rect_op) != 0) {
-            pthread_mutex_unlock(&context->mtx_cqueue);
+        *zeroed2 = ',';
+        if (dispatch_op(context, &op) != 0) {
             release_key(layer_name);
             
             return HTTP_SERVUNAVAIL;
         }
-        pthread_mutex_unlock(&context->mtx_cqueue);
-        pthread_cond_signal(&context->cond_cqueue);
         return 0;
     }
     
@@ -311,7 +568,7 @@ int handle_domain_search(struct evhttp_request * const req,
             .type = OP_TYPE_SEARCH_IN_KEYS,
             .req = req,
             .fake_req = fake_req,
-            .op_tid = ++context->op_tid,
+            .op_tid = next_op_tid(context),
             .layer_name = layer_name,
             .pattern = NULL,
             .limit = cb_context.limit,
@@ -323,16 +580,12 @@ int handle_domain_search(struct evhttp_request * const req,
             release_key(layer_name);            
             return HTTP_SERVUNAVAIL;
         }
-        pthread_mutex_lock(&context->mtx_cqueue);
-        if (push_cqueue(context->cqueue, in_keys_op) != 0) {
-            pthread_mutex_unlock(&context->mtx_cqueue);
+        if (dispatch_op(context, &op) != 0) {
             release_key(layer_name);
             release_key(in_keys_op->pattern);            
             
             return HTTP_SERVUNAVAIL;
         }
-        pthread_mutex_unlock(&context->mtx_cqueue);
-        pthread_cond_signal(&context->cond_cqueue);
         return 0;
     }
     return HTTP_NOTFOUND;
@@ -350,7 +603,7 @@ static int find_near_cb(void * const context_,
 {
     FindNearCBContext * const context = context_;
     yajl_gen json_gen = context->json_gen;
-    KeyNode * const key_node = slot->key_node;
+    KeyNode * const key_node = DEREF_KEY_NODE(context->pan_db, slot->key_node);
 
     assert(key_node != NULL);
     yajl_gen_map_open(json_gen);
@@ -415,20 +668,11 @@ static int find_in_rect_cluster_cb(void * const context_,
     return find_near_cluster_cb(context_, position, radius, children);
 }
 
-int handle_op_search_nearby(SearchNearbyOp * const nearby_op,
-                            HttpHandlerContext * const context)
+static int search_nearby_in_layer(SearchNearbyOp * const nearby_op,
+                                  HttpHandlerContext * const context,
+                                  PanDB * const pan_db)
 {
     yajl_gen json_gen;
-    PanDB *pan_db;
-        
-    if (get_pan_db_by_layer_name(context, nearby_op->layer_name->val,
-                                 AUTOMATICALLY_CREATE_LAYERS, &pan_db) < 0) {
-        assert(pan_db == NULL);        
-        release_key(nearby_op->layer_name);
-        
-        return HTTP_NOTFOUND;
-    }
-    release_key(nearby_op->layer_name);
     
     if (nearby_op->fake_req != 0) {
         return 0;
@@ -451,6 +695,23 @@ int handle_op_search_nearby(SearchNearbyOp * const nearby_op,
         return HTTP_SERVUNAVAIL;
     }        
     nearby_op_reply->json_gen = json_gen;        
+    if (nearby_op->count_only != 0) {
+        SubSlots count;
+        
+        if (count_near(pan_db, &nearby_op->position, nearby_op->radius,
+                       &count) != 0) {
+            yajl_gen_free(json_gen);
+            free(op_reply);
+            return HTTP_SERVUNAVAIL;
+        }
+        yajl_gen_string(json_gen,
+                        (const unsigned char *) "count",
+                        (unsigned int) sizeof "count" - (size_t) 1U);
+        yajl_gen_integer(json_gen, (long) count);
+        send_op_reply(context, op_reply);
+        
+        return 0;
+    }
     yajl_gen_string(json_gen,
                     (const unsigned char *) "matches",
                     (unsigned int) sizeof "matches" - (size_t) 1U);
@@ -462,9 +723,17 @@ int handle_op_search_nearby(SearchNearbyOp * const nearby_op,
         .with_properties = nearby_op->with_properties,
         .with_links = nearby_op->with_links
     };
-    const int ret = find_near(pan_db, find_near_cb, &cb_context,
-                              &nearby_op->position,
-                              nearby_op->radius, nearby_op->limit);
+    int ret;
+    if (nearby_op->sort_by_distance != 0) {
+        ret = find_nearest(pan_db, find_near_cb, &cb_context,
+                           &nearby_op->position,
+                           nearby_op->radius, nearby_op->limit);
+    } else {
+        ret = find_near(pan_db, find_near_cb, find_near_cluster_cb,
+                        &cb_context, &nearby_op->position,
+                        nearby_op->radius, nearby_op->limit,
+                        nearby_op->epsilon);
+    }
 
     yajl_gen_array_close(json_gen);
     
@@ -491,71 +760,172 @@ int handle_op_search_nearby(SearchNearbyOp * const nearby_op,
     return 0;
 }
 
-typedef struct FindInRectCBContext_ {
-    PanDB *pan_db;
-    yajl_gen json_gen;
-    _Bool with_properties;
-    _Bool with_links;
-} FindInRectCBContext;
-
-int handle_op_search_in_rect(SearchInRectOp * const in_rect_op,
-                             HttpHandlerContext * const context)
+int handle_op_search_nearby(SearchNearbyOp * const nearby_op,
+                            HttpHandlerContext * const context)
 {
-    yajl_gen json_gen;
     PanDB *pan_db;
+    int ret;
         
-    if (get_pan_db_by_layer_name(context, in_rect_op->layer_name->val,
+    if (get_pan_db_by_layer_name(context, nearby_op->layer_name->val,
                                  AUTOMATICALLY_CREATE_LAYERS, &pan_db) < 0) {
         assert(pan_db == NULL);        
-        release_key(in_rect_op->layer_name);
+        release_key(nearby_op->layer_name);
         
         return HTTP_NOTFOUND;
     }
-    release_key(in_rect_op->layer_name);
+    release_key(nearby_op->layer_name);
+    prwlock_rdlock(&pan_db->rwlock_db);
+    ret = search_nearby_in_layer(nearby_op, context, pan_db);
+    prwlock_unlock(&pan_db->rwlock_db);
     
-    if (in_rect_op->fake_req != 0) {
+    return ret;
+}
+
+static int search_nearest_in_layer(SearchNearestOp * const nearest_op,
+                                   HttpHandlerContext * const context,
+                                   PanDB * const pan_db)
+{
+    yajl_gen json_gen;
+    
+    if (nearest_op->fake_req != 0) {
         return 0;
     }
     OpReply *op_reply = malloc(sizeof *op_reply);
     if (op_reply == NULL) {
         return HTTP_SERVUNAVAIL;
     }
-    SearchInRectOpReply * const in_rect_op_reply =
-        &op_reply->search_in_rect_op_reply;
+    SearchNearestOpReply * const nearest_op_reply =
+        &op_reply->search_nearest_op_reply;
     
-    *in_rect_op_reply = (SearchInRectOpReply) {
-        .type = OP_TYPE_SEARCH_IN_RECT,
-        .req = in_rect_op->req,         
-        .op_tid = in_rect_op->op_tid,
+    *nearest_op_reply = (SearchNearestOpReply) {
+        .type = OP_TYPE_SEARCH_NEAREST,
+        .req = nearest_op->req,         
+        .op_tid = nearest_op->op_tid,
         .json_gen = NULL
     };
     if ((json_gen = new_json_gen(op_reply)) == NULL) {
         free(op_reply);
         return HTTP_SERVUNAVAIL;
     }        
-    in_rect_op_reply->json_gen = json_gen;        
+    nearest_op_reply->json_gen = json_gen;        
     yajl_gen_string(json_gen,
                     (const unsigned char *) "matches",
                     (unsigned int) sizeof "matches" - (size_t) 1U);
     yajl_gen_array_open(json_gen);
     
-    FindInRectCBContext cb_context = {
+    FindNearCBContext cb_context = {
         .pan_db = pan_db,
         .json_gen = json_gen,
-        .with_properties = in_rect_op->with_properties,
-        .with_links = in_rect_op->with_links
+        .with_properties = nearest_op->with_properties,
+        .with_links = nearest_op->with_links
     };
-    const int ret = find_in_rect(pan_db, find_in_rect_cb,
-                                 find_in_rect_cluster_cb,
-                                 &cb_context, &in_rect_op->rect,
-                                 in_rect_op->limit, in_rect_op->epsilon);
-
+    const int ret = find_nearest(pan_db, find_near_cb, &cb_context,
+                                 &nearest_op->position,
+                                 nearest_op->max_distance, nearest_op->limit);
     yajl_gen_array_close(json_gen);
-    
     if (ret != 0) {
         yajl_gen_free(json_gen);
-        if ((json_gen = new_json_gen(op_reply)) == NULL) {
-            free(op_reply);
+        free(op_reply);
+        return HTTP_SERVUNAVAIL;
+    }
+    send_op_reply(context, op_reply);
+    
+    return 0;
+}
+
+int handle_op_search_nearest(SearchNearestOp * const nearest_op,
+                             HttpHandlerContext * const context)
+{
+    PanDB *pan_db;
+    int ret;
+        
+    if (get_pan_db_by_layer_name(context, nearest_op->layer_name->val,
+                                 AUTOMATICALLY_CREATE_LAYERS, &pan_db) < 0) {
+        assert(pan_db == NULL);        
+        release_key(nearest_op->layer_name);
+        
+        return HTTP_NOTFOUND;
+    }
+    release_key(nearest_op->layer_name);
+    prwlock_rdlock(&pan_db->rwlock_db);
+    ret = search_nearest_in_layer(nearest_op, context, pan_db);
+    prwlock_unlock(&pan_db->rwlock_db);
+    
+    return ret;
+}
+
+typedef struct FindInRectCBContext_ {
+    PanDB *pan_db;
+    yajl_gen json_gen;
+    _Bool with_properties;
+    _Bool with_links;
+} FindInRectCBContext;
+
+static int search_in_rect_in_layer(SearchInRectOp * const in_rect_op,
+                                   HttpHandlerContext * const context,
+                                   PanDB * const pan_db)
+{
+    yajl_gen json_gen;
+    
+    if (in_rect_op->fake_req != 0) {
+        return 0;
+    }
+    OpReply *op_reply = malloc(sizeof *op_reply);
+    if (op_reply == NULL) {
+        return HTTP_SERVUNAVAIL;
+    }
+    SearchInRectOpReply * const in_rect_op_reply =
+        &op_reply->search_in_rect_op_reply;
+    
+    *in_rect_op_reply = (SearchInRectOpReply) {
+        .type = OP_TYPE_SEARCH_IN_RECT,
+        .req = in_rect_op->req,         
+        .op_tid = in_rect_op->op_tid,
+        .json_gen = NULL
+    };
+    if ((json_gen = new_json_gen(op_reply)) == NULL) {
+        free(op_reply);
+        return HTTP_SERVUNAVAIL;
+    }        
+    in_rect_op_reply->json_gen = json_gen;        
+    if (in_rect_op->count_only != 0) {
+        SubSlots count;
+        
+        if (count_in_rect(pan_db, &in_rect_op->rect, &count) != 0) {
+            yajl_gen_free(json_gen);
+            free(op_reply);
+            return HTTP_SERVUNAVAIL;
+        }
+        yajl_gen_string(json_gen,
+                        (const unsigned char *) "count",
+                        (unsigned int) sizeof "count" - (size_t) 1U);
+        yajl_gen_integer(json_gen, (long) count);
+        send_op_reply(context, op_reply);
+        
+        return 0;
+    }
+    yajl_gen_string(json_gen,
+                    (const unsigned char *) "matches",
+                    (unsigned int) sizeof "matches" - (size_t) 1U);
+    yajl_gen_array_open(json_gen);
+    
+    FindInRectCBContext cb_context = {
+        .pan_db = pan_db,
+        .json_gen = json_gen,
+        .with_properties = in_rect_op->with_properties,
+        .with_links = in_rect_op->with_links
+    };
+    const int ret = find_in_rect(pan_db, find_in_rect_cb,
+                                 find_in_rect_cluster_cb,
+                                 &cb_context, &in_rect_op->rect,
+                                 in_rect_op->limit, in_rect_op->epsilon);
+
+    yajl_gen_array_close(json_gen);
+    
+    if (ret != 0) {
+        yajl_gen_free(json_gen);
+        if ((json_gen = new_json_gen(op_reply)) == NULL) {
+            free(op_reply);
             return HTTP_SERVUNAVAIL;
         }        
         in_rect_op_reply->json_gen = json_gen;        
@@ -575,23 +945,403 @@ int handle_op_search_in_rect(SearchInRectOp * const in_rect_op,
     return 0;
 }
 
-int handle_op_search_in_keys(SearchInKeysOp * const in_keys_op,
+int handle_op_search_in_rect(SearchInRectOp * const in_rect_op,
                              HttpHandlerContext * const context)
 {
+    PanDB *pan_db;
+    int ret;
+        
+    if (get_pan_db_by_layer_name(context, in_rect_op->layer_name->val,
+                                 AUTOMATICALLY_CREATE_LAYERS, &pan_db) < 0) {
+        assert(pan_db == NULL);        
+        release_key(in_rect_op->layer_name);
+        
+        return HTTP_NOTFOUND;
+    }
+    release_key(in_rect_op->layer_name);
+    prwlock_rdlock(&pan_db->rwlock_db);
+    ret = search_in_rect_in_layer(in_rect_op, context, pan_db);
+    prwlock_unlock(&pan_db->rwlock_db);
+    
+    return ret;
+}
+
+typedef struct GridCBContext_ {
+    const PanDB *pan_db;
+    const Key *sum_property;
+    double *sums;
+} GridCBContext;
+
+static int grid_cb(void * const context_, Slot * const slot,
+                   const NbSlots cell)
+{
+    GridCBContext * const context = context_;
+    KeyNode * const key_node = DEREF_KEY_NODE(context->pan_db, slot->key_node);
+    const void *value;
+    size_t value_len;
+    char *endptr;
+    
+    assert(key_node != NULL);
+    if (find_in_slip_map(&key_node->properties, context->sum_property->val,
+                         context->sum_property->len - (size_t) 1U,
+                         &value, &value_len) == 0 ||
+        value_len <= (size_t) 0U ||
+        value_len >= sizeof "-1.7976931348623157e+308") {
+        return 0;
+    }
+    char buf[value_len + (size_t) 1U];
+    memcpy(buf, value, value_len);
+    buf[value_len] = 0;
+    const double v = strtod(buf, &endptr);
+    if (endptr == NULL || endptr == buf) {
+        return 0;
+    }
+    context->sums[cell] += v;
+    
+    return 0;
+}
+
+static void grid_to_json(yajl_gen json_gen, const char * const name,
+                         const size_t name_len,
+                         const SubSlots * const counts,
+                         const double * const sums,
+                         const NbSlots cols, const NbSlots rows)
+{
+    NbSlots row;
+    NbSlots col;
+    size_t cell = (size_t) 0U;
+    
+    yajl_gen_string(json_gen, (const unsigned char *) name,
+                    (unsigned int) name_len);
+    yajl_gen_array_open(json_gen);
+    for (row = (NbSlots) 0U; row < rows; row++) {
+        yajl_gen_array_open(json_gen);
+        for (col = (NbSlots) 0U; col < cols; col++) {
+            if (sums != NULL) {
+                yajl_gen_double(json_gen, sums[cell]);
+            } else {
+                yajl_gen_integer(json_gen, (long) counts[cell]);
+            }
+            cell++;
+        }
+        yajl_gen_array_close(json_gen);
+    }
+    yajl_gen_array_close(json_gen);
+}
+
+static int search_grid_in_layer(SearchGridOp * const grid_op,
+                                HttpHandlerContext * const context,
+                                PanDB * const pan_db)
+{
+    const size_t nb_cells = (size_t) grid_op->cols * (size_t) grid_op->rows;
+    SubSlots *counts;
+    double *sums = NULL;
     yajl_gen json_gen;
+    int ret;
+    
+    if (grid_op->fake_req != 0) {
+        return 0;
+    }
+    if ((counts = malloc(nb_cells * sizeof *counts)) == NULL) {
+        return HTTP_SERVUNAVAIL;
+    }
+    GridCBContext cb_context = {
+        .pan_db = pan_db,
+        .sum_property = grid_op->sum_property,
+        .sums = NULL
+    };
+    if (grid_op->sum_property != NULL) {
+        if ((sums = calloc(nb_cells, sizeof *sums)) == NULL) {
+            free(counts);
+            return HTTP_SERVUNAVAIL;
+        }
+        cb_context.sums = sums;
+        ret = grid_in_rect(pan_db, &grid_op->rect,
+                           grid_op->cols, grid_op->rows, counts,
+                           grid_cb, &cb_context);
+    } else {
+        ret = grid_in_rect(pan_db, &grid_op->rect,
+                           grid_op->cols, grid_op->rows, counts,
+                           NULL, NULL);
+    }
+    if (ret != 0) {
+        free(sums);
+        free(counts);
+        return HTTP_SERVUNAVAIL;
+    }
+    OpReply *op_reply = malloc(sizeof *op_reply);
+    if (op_reply == NULL) {
+        free(sums);
+        free(counts);
+        return HTTP_SERVUNAVAIL;
+    }
+    SearchGridOpReply * const grid_op_reply = &op_reply->search_grid_op_reply;
+    
+    *grid_op_reply = (SearchGridOpReply) {
+        .type = OP_TYPE_SEARCH_GRID,
+        .req = grid_op->req,
+        .op_tid = grid_op->op_tid,
+        .json_gen = NULL
+    };
+    if ((json_gen = new_json_gen(op_reply)) == NULL) {
+        free(op_reply);
+        free(sums);
+        free(counts);
+        return HTTP_SERVUNAVAIL;
+    }
+    grid_op_reply->json_gen = json_gen;
+    yajl_gen_string(json_gen,
+                    (const unsigned char *) "cols",
+                    (unsigned int) sizeof "cols" - (size_t) 1U);
+    yajl_gen_integer(json_gen, (long) grid_op->cols);
+    yajl_gen_string(json_gen,
+                    (const unsigned char *) "rows",
+                    (unsigned int) sizeof "rows" - (size_t) 1U);
+    yajl_gen_integer(json_gen, (long) grid_op->rows);
+    grid_to_json(json_gen, "cells", sizeof "cells" - (size_t) 1U,
+                 counts, NULL, grid_op->cols, grid_op->rows);
+    if (sums != NULL) {
+        grid_to_json(json_gen, "sums", sizeof "sums" - (size_t) 1U,
+                     counts, sums, grid_op->cols, grid_op->rows);
+    }
+    free(sums);
+    free(counts);
+    send_op_reply(context, op_reply);
+    
+    return 0;
+}
+
+int handle_op_search_grid(SearchGridOp * const grid_op,
+                          HttpHandlerContext * const context)
+{
     PanDB *pan_db;
-    Key * const pattern = in_keys_op->pattern;
+    int ret;
         
-    assert(pattern != NULL);
-    if (get_pan_db_by_layer_name(context, in_keys_op->layer_name->val,
+    if (get_pan_db_by_layer_name(context, grid_op->layer_name->val,
                                  AUTOMATICALLY_CREATE_LAYERS, &pan_db) < 0) {
         assert(pan_db == NULL);        
-        release_key(in_keys_op->layer_name);
-        release_key(pattern);
+        release_key(grid_op->layer_name);
+        if (grid_op->sum_property != NULL) {
+            release_key(grid_op->sum_property);
+        }
+        return HTTP_NOTFOUND;
+    }
+    release_key(grid_op->layer_name);
+    prwlock_rdlock(&pan_db->rwlock_db);
+    ret = search_grid_in_layer(grid_op, context, pan_db);
+    prwlock_unlock(&pan_db->rwlock_db);
+    if (grid_op->sum_property != NULL) {
+        release_key(grid_op->sum_property);
+    }
+    return ret;
+}
+
+static int find_in_polygon_cb(void * const context_,
+                              Slot * const slot, const Meters distance)
+{
+    return find_near_cb(context_, slot, distance);
+}
+
+static int search_in_polygon_in_layer(SearchInPolygonOp * const in_polygon_op,
+                                      HttpHandlerContext * const context,
+                                      PanDB * const pan_db)
+{
+    yajl_gen json_gen;
+    
+    if (in_polygon_op->fake_req != 0) {
+        return 0;
+    }
+    OpReply *op_reply = malloc(sizeof *op_reply);
+    if (op_reply == NULL) {
+        return HTTP_SERVUNAVAIL;
+    }
+    SearchInPolygonOpReply * const in_polygon_op_reply =
+        &op_reply->search_in_polygon_op_reply;
+    
+    *in_polygon_op_reply = (SearchInPolygonOpReply) {
+        .type = OP_TYPE_SEARCH_IN_POLYGON,
+        .req = in_polygon_op->req,
+        .op_tid = in_polygon_op->op_tid,
+        .json_gen = NULL
+    };
+    if ((json_gen = new_json_gen(op_reply)) == NULL) {
+        free(op_reply);
+        return HTTP_SERVUNAVAIL;
+    }        
+    in_polygon_op_reply->json_gen = json_gen;        
+    yajl_gen_string(json_gen,
+                    (const unsigned char *) "matches",
+                    (unsigned int) sizeof "matches" - (size_t) 1U);
+    yajl_gen_array_open(json_gen);
+    
+    FindNearCBContext cb_context = {
+        .pan_db = pan_db,
+        .json_gen = json_gen,
+        .with_properties = in_polygon_op->with_properties,
+        .with_links = in_polygon_op->with_links
+    };
+    const int ret = find_in_polygon(pan_db, find_in_polygon_cb, &cb_context,
+                                    in_polygon_op->vertices,
+                                    in_polygon_op->nb_vertices,
+                                    in_polygon_op->limit);
+    
+    yajl_gen_array_close(json_gen);
+    
+    if (ret != 0) {
+        yajl_gen_free(json_gen);
+        if ((json_gen = new_json_gen(op_reply)) == NULL) {
+            free(op_reply);
+            return HTTP_SERVUNAVAIL;
+        }        
+        in_polygon_op_reply->json_gen = json_gen;        
+        yajl_gen_string(json_gen,
+                        (const unsigned char *) "overflow",
+                        (unsigned int) sizeof "overflow" - (size_t) 1U);
+        yajl_gen_bool(json_gen, 1);
+        yajl_gen_string(json_gen,
+                        (const unsigned char *) "matches",
+                        (unsigned int) sizeof "matches" - (size_t) 1U);
+        yajl_gen_array_open(json_gen);
+        yajl_gen_array_close(json_gen);        
+    }
+    
+    send_op_reply(context, op_reply);
+    
+    return 0;
+}
+
+int handle_op_search_in_polygon(SearchInPolygonOp * const in_polygon_op,
+                                HttpHandlerContext * const context)
+{
+    PanDB *pan_db;
+    int ret;
+        
+    if (get_pan_db_by_layer_name(context, in_polygon_op->layer_name->val,
+                                 AUTOMATICALLY_CREATE_LAYERS, &pan_db) < 0) {
+        assert(pan_db == NULL);        
+        release_key(in_polygon_op->layer_name);
+        free(in_polygon_op->vertices);
         
         return HTTP_NOTFOUND;
     }
-    release_key(in_keys_op->layer_name);
+    release_key(in_polygon_op->layer_name);
+    prwlock_rdlock(&pan_db->rwlock_db);
+    ret = search_in_polygon_in_layer(in_polygon_op, context, pan_db);
+    prwlock_unlock(&pan_db->rwlock_db);
+    free(in_polygon_op->vertices);
+    
+    return ret;
+}
+
+static int find_containing_cb(void * const context_,
+                              Polygon * const polygon)
+{
+    FindNearCBContext * const context = context_;
+    yajl_gen json_gen = context->json_gen;
+    
+    yajl_gen_map_open(json_gen);
+    key_node_to_json(polygon->key_node, json_gen, context->pan_db,
+                     context->with_properties, context->with_links);
+    yajl_gen_map_close(json_gen);
+    
+    return 0;
+}
+
+static int search_containing_in_layer(SearchContainingOp * const containing_op,
+                                      HttpHandlerContext * const context,
+                                      PanDB * const pan_db)
+{
+    yajl_gen json_gen;
+    
+    if (containing_op->fake_req != 0) {
+        return 0;
+    }
+    OpReply *op_reply = malloc(sizeof *op_reply);
+    if (op_reply == NULL) {
+        return HTTP_SERVUNAVAIL;
+    }
+    SearchContainingOpReply * const containing_op_reply =
+        &op_reply->search_containing_op_reply;
+    
+    *containing_op_reply = (SearchContainingOpReply) {
+        .type = OP_TYPE_SEARCH_CONTAINING,
+        .req = containing_op->req,
+        .op_tid = containing_op->op_tid,
+        .json_gen = NULL
+    };
+    if ((json_gen = new_json_gen(op_reply)) == NULL) {
+        free(op_reply);
+        return HTTP_SERVUNAVAIL;
+    }        
+    containing_op_reply->json_gen = json_gen;        
+    yajl_gen_string(json_gen,
+                    (const unsigned char *) "matches",
+                    (unsigned int) sizeof "matches" - (size_t) 1U);
+    yajl_gen_array_open(json_gen);
+    
+    FindNearCBContext cb_context = {
+        .pan_db = pan_db,
+        .json_gen = json_gen,
+        .with_properties = containing_op->with_properties,
+        .with_links = containing_op->with_links
+    };
+    const int ret = find_containing(pan_db, find_containing_cb, &cb_context,
+                                    &containing_op->position,
+                                    containing_op->limit);
+    
+    yajl_gen_array_close(json_gen);
+    
+    if (ret != 0) {
+        yajl_gen_free(json_gen);
+        if ((json_gen = new_json_gen(op_reply)) == NULL) {
+            free(op_reply);
+            return HTTP_SERVUNAVAIL;
+        }        
+        containing_op_reply->json_gen = json_gen;        
+        yajl_gen_string(json_gen,
+                        (const unsigned char *) "overflow",
+                        (unsigned int) sizeof "overflow" - (size_t) 1U);
+        yajl_gen_bool(json_gen, 1);
+        yajl_gen_string(json_gen,
+                        (const unsigned char *) "matches",
+                        (unsigned int) sizeof "matches" - (size_t) 1U);
+        yajl_gen_array_open(json_gen);
+        yajl_gen_array_close(json_gen);        
+    }
+    
+    send_op_reply(context, op_reply);
+    
+    return 0;
+}
+
+int handle_op_search_containing(SearchContainingOp * const containing_op,
+                                HttpHandlerContext * const context)
+{
+    PanDB *pan_db;
+    int ret;
+        
+    if (get_pan_db_by_layer_name(context, containing_op->layer_name->val,
+                                 AUTOMATICALLY_CREATE_LAYERS, &pan_db) < 0) {
+        assert(pan_db == NULL);        
+        release_key(containing_op->layer_name);
+        
+        return HTTP_NOTFOUND;
+    }
+    release_key(containing_op->layer_name);
+    prwlock_rdlock(&pan_db->rwlock_db);
+    ret = search_containing_in_layer(containing_op, context, pan_db);
+    prwlock_unlock(&pan_db->rwlock_db);
+    
+    return ret;
+}
+
+static int search_in_keys_in_layer(SearchInKeysOp * const in_keys_op,
+                                   HttpHandlerContext * const context,
+                                   PanDB * const pan_db)
+{
+    yajl_gen json_gen;
+    Key * const pattern = in_keys_op->pattern;
+        
     if (in_keys_op->fake_req != 0) {
         release_key(pattern);
         return 0;
@@ -698,3 +1448,27 @@ emptyresult:
     
     return 0;    
 }
+
+int handle_op_search_in_keys(SearchInKeysOp * const in_keys_op,
+                             HttpHandlerContext * const context)
+{
+    PanDB *pan_db;
+    int ret;
+    Key * const pattern = in_keys_op->pattern;
+        
+    assert(pattern != NULL);
+    if (get_pan_db_by_layer_name(context, in_keys_op->layer_name->val,
+                                 AUTOMATICALLY_CREATE_LAYERS, &pan_db) < 0) {
+        assert(pan_db == NULL);        
+        release_key(in_keys_op->layer_name);
+        release_key(pattern);
+        
+        return HTTP_NOTFOUND;
+    }
+    release_key(in_keys_op->layer_name);
+    prwlock_rdlock(&pan_db->rwlock_db);
+    ret = search_in_keys_in_layer(in_keys_op, context, pan_db);
+    prwlock_unlock(&pan_db->rwlock_db);
+    
+    return ret;
+}
@@ -4,15 +4,27 @@
 
 int handle_domain_search(struct evhttp_request * const req,
                          HttpHandlerContext * const context,
-                         char *uri, char *opts, _Bool * const write_to_log,
+                         char *uri, char *opts,
                          const _Bool fake_req);
 
 int handle_op_search_nearby(SearchNearbyOp * const nearby_op,
                             HttpHandlerContext * const context);
 
+int handle_op_search_nearest(SearchNearestOp * const nearest_op,
+                             HttpHandlerContext * const context);
+
 int handle_op_search_in_rect(SearchInRectOp * const in_rect_op,
                              HttpHandlerContext * const context);
 
+int handle_op_search_grid(SearchGridOp * const grid_op,
+                          HttpHandlerContext * const context);
+
+int handle_op_search_in_polygon(SearchInPolygonOp * const in_polygon_op,
+                                HttpHandlerContext * const context);
+
+int handle_op_search_containing(SearchContainingOp * const containing_op,
+                                HttpHandlerContext * const context);
+
 int handle_op_search_in_keys(SearchInKeysOp * const in_keys_op,
                              HttpHandlerContext * const context);
 
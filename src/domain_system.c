@@ -11,11 +11,10 @@ static int handle_special_op_system_rewrite(HttpHandlerContext * const context,
 
 int handle_domain_system(struct evhttp_request * const req,
                          HttpHandlerContext * const context,
-                         char *uri, char *opts, _Bool * const write_to_log,
+                         char *uri, char *opts,
                          const _Bool fake_req)
 {
     (void) opts;
-    (void) write_to_log;
     if (strcasecmp(uri, "ping") == 0) {
         Op op;
         SystemPingOp * const ping_op = &op.system_ping_op;
@@ -24,15 +23,11 @@ int handle_domain_system(struct evhttp_request * const req,
             .type = OP_TYPE_SYSTEM_PING,
             .req = req,
             .fake_req = fake_req,
-            .op_tid = ++context->op_tid
+            .op_tid = next_op_tid(context)
         };
-        pthread_mutex_lock(&context->mtx_cqueue);        
-        if (push_cqueue(context->cqueue, ping_op) != 0) {
-            pthread_mutex_unlock(&context->mtx_cqueue);
+        if (dispatch_op(context, &op) != 0) {
             return HTTP_SERVUNAVAIL;
         }
-        pthread_mutex_unlock(&context->mtx_cqueue);
-        pthread_cond_signal(&context->cond_cqueue);
         
         return 0;
     }
@@ -74,7 +69,7 @@ int handle_domain_system(struct evhttp_request * const req,
             .type = OP_TYPE_SYSTEM_PING,
             .req = req,
             .fake_req = fake_req,
-            .op_tid = ++context->op_tid            
+            .op_tid = next_op_tid(context)            
         };
         return handle_special_op_system_rewrite(context, rewrite_op);
     }
@@ -256,14 +251,31 @@ static int rebuild_journal_record_cb(void *context_, KeyNode * const key_node)
         }
         cb_context.first = 0;
 #if PROJECTION
-    const Position2D * const position = &key_node->slot->real_position;
+    const SlotPosition * const position = &key_node->slot->real_position;
 #else
-    const Position2D * const position = &key_node->slot->position;
+    const SlotPosition * const position = &key_node->slot->position;
 #endif
-        evbuffer_add_printf(body_buffer, 
-                            INT_PROPERTY_POSITION "=%f,%f",
-                            (double) position->latitude,
-                            (double) position->longitude);
+        evbuffer_add_printf(body_buffer, INT_PROPERTY_POSITION "="
+                            SLOT_DIMENSION_FORMAT "," SLOT_DIMENSION_FORMAT,
+                            SLOT_DIMENSION(position->latitude),
+                            SLOT_DIMENSION(position->longitude));
+    }
+    if (key_node->polygon != NULL) {
+        const Polygon * const polygon = key_node->polygon;
+        NbSlots i;
+        
+        if (cb_context.first == 0) {
+            evbuffer_add(body_buffer, "&", (size_t) 1U);
+        }
+        cb_context.first = 0;
+        evbuffer_add(body_buffer, INT_PROPERTY_POLYGON "=",
+                     sizeof INT_PROPERTY_POLYGON "=" - (size_t) 1U);
+        for (i = (NbSlots) 0U; i < polygon->nb_vertices; i++) {
+            evbuffer_add_printf(body_buffer, i == (NbSlots) 0U ?
+                                "%f,%f" : ",%f,%f",
+                                (double) polygon->vertices[i].latitude,
+                                (double) polygon->vertices[i].longitude);
+        }
     }
     if (key_node->expirable != NULL) {
         if (cb_context.first == 0) {
@@ -321,12 +333,14 @@ static int rebuild_journal_layer_cb(void *context_, void *entry,
         evbuffer_free(log_buffer);
         return -1;
     }
+    const char * const index_type =
+        layer->pan_db.index_type == INDEX_TYPE_MORTON ? "morton" : "quadtree";
     const size_t uri_len = context->context->encoded_api_base_uri_len +
         sizeof "layers/" - (size_t) 1U + encoded_layer_name.size +
-        sizeof ".json" - (size_t) 1U;
-    evbuffer_add_printf(log_buffer, "%x %zx:%slayers/%s.json %zx:",
+        sizeof ".json?index=" - (size_t) 1U + strlen(index_type);
+    evbuffer_add_printf(log_buffer, "%x %zx:%slayers/%s.json?index=%s %zx:",
                         verb, uri_len, context->context->encoded_api_base_uri,
-                        encoded_layer_name.val, (size_t) 0U);
+                        encoded_layer_name.val, index_type, (size_t) 0U);
     evbuffer_add(log_buffer, DB_LOG_RECORD_COOKIE_TAIL,
                  sizeof DB_LOG_RECORD_COOKIE_TAIL - (size_t) 1U);
     
@@ -427,13 +441,21 @@ static int handle_special_op_system_rewrite(HttpHandlerContext * const context,
         db_log->db_log_fd == -1) {
         return HTTP_NOCONTENT;
     }
+    if (pthread_mutex_trylock(&context->mtx_journal_rewrite) != 0) {
+        return HTTP_NOTMODIFIED;
+    }
     if (db_log->journal_rewrite_process != (pid_t) -1) {
+        pthread_mutex_unlock(&context->mtx_journal_rewrite);
         return HTTP_NOTMODIFIED;
     }
     stop_workers(context);
+    pthread_mutex_lock(&context->mtx_db_log);
     flush_db_log(1);
     pid_t child = fork();
     if (child == (pid_t) -1) {
+        pthread_mutex_unlock(&context->mtx_db_log);
+        start_workers(context);
+        pthread_mutex_unlock(&context->mtx_journal_rewrite);
         return HTTP_SERVUNAVAIL;
     }
     if (child == (pid_t) 0) {
@@ -443,7 +465,9 @@ static int handle_special_op_system_rewrite(HttpHandlerContext * const context,
     db_log->journal_rewrite_process = child;
     db_log->offset_before_fork = lseek(db_log->db_log_fd,
                                        (off_t) 0, SEEK_CUR);
+    pthread_mutex_unlock(&context->mtx_db_log);
     start_workers(context);
+    pthread_mutex_unlock(&context->mtx_journal_rewrite);
 
     yajl_gen json_gen;
     OpReply *op_reply = malloc(sizeof *op_reply);
@@ -9,7 +9,7 @@
 
 int handle_domain_system(struct evhttp_request * const req,
                          HttpHandlerContext * const context,
-                         char *uri, char *opts, _Bool * const write_to_log,
+                         char *uri, char *opts,
                          const _Bool fake_req);
 
 int handle_op_system_ping(SystemPingOp * const ping_op,
@@ -64,11 +64,15 @@ static int has_expired_keys_in_layer(void *cb_context_, void *entry,
     if (expirables == NULL) {
         return 0;
     }
+    prwlock_rdlock(&pan_db->rwlock_db);
     const Expirable * const expirable = RB_MIN(Expirables_, expirables);
     if (expirable != NULL && now >= expirable->ts) {
+        prwlock_unlock(&pan_db->rwlock_db);
         cb_context->has_expired_keys = 1;
         return 1;
     }
+    prwlock_unlock(&pan_db->rwlock_db);
+    
     return 0;
 }
     
@@ -78,10 +82,10 @@ static _Bool has_expired_keys(HttpHandlerContext * const context)
         .context = context,
         .has_expired_keys = 0
     };    
-    pthread_rwlock_rdlock(&context->rwlock_layers);
+    prwlock_rdlock(&context->rwlock_layers);
     slab_foreach(&context->layers_slab, has_expired_keys_in_layer,
                  &cb_context);
-    pthread_rwlock_unlock(&context->rwlock_layers);
+    prwlock_unlock(&context->rwlock_layers);
     
     return cb_context.has_expired_keys;
 }
@@ -108,6 +112,7 @@ static int purge_expired_keys_from_layer(void *cb_context_, void *entry,
     if (expirables == NULL) {
         return 0;
     }
+    prwlock_wrlock(&pan_db->rwlock_db);
     for (expirable = RB_MIN(Expirables_, expirables); expirable != NULL;
          expirable = next) {
         if (now < expirable->ts) {
@@ -120,6 +125,7 @@ static int purge_expired_keys_from_layer(void *cb_context_, void *entry,
         assert(key_node->expirable == expirable);
         if (key_node->slot != NULL) {
             if (remove_entry_from_key_node(pan_db, key_node, 0) != 0) {
+                prwlock_unlock(&pan_db->rwlock_db);
                 return -1;
             }
             key_node->slot = NULL;
@@ -129,6 +135,7 @@ static int purge_expired_keys_from_layer(void *cb_context_, void *entry,
         free_key_node(pan_db, key_node);
         cb_context->did_purge = 1;
     }
+    prwlock_unlock(&pan_db->rwlock_db);
 #if SPREAD_EXPIRATION
     return 1;
 #else
@@ -145,10 +152,30 @@ int purge_expired_keys(HttpHandlerContext * const context)
         .context = context,
         .did_purge = 0
     };
-    pthread_rwlock_wrlock(&context->rwlock_layers);
+    prwlock_rdlock(&context->rwlock_layers);
     slab_foreach(&context->layers_slab, purge_expired_keys_from_layer,
                  &cb_context);
-    pthread_rwlock_unlock(&context->rwlock_layers);
+    prwlock_unlock(&context->rwlock_layers);
     
     return (int) cb_context.did_purge;
 }
+
+int handle_op_system_expire(SystemExpireOp * const expire_op,
+                            HttpHandlerContext * const context)
+{
+    int ret;
+
+    (void) expire_op;
+    ret = purge_expired_keys(context);
+#if SPREAD_EXPIRATION
+    if (ret != 0 && context->nb_layers > (size_t) 1U &&
+        1000000L / (long) context->nb_layers < 10000L) {
+        while (purge_expired_keys(context) > 0);
+    }
+#endif
+    __atomic_store_n(&context->expiration_did_purge, ret != 0,
+                     __ATOMIC_SEQ_CST);
+    __atomic_store_n(&context->expiration_op_pending, 0, __ATOMIC_SEQ_CST);
+
+    return 0;
+}
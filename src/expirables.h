@@ -13,4 +13,7 @@ int remove_expirable_from_tree(PanDB * const pan_db,
 
 int purge_expired_keys(HttpHandlerContext * const context);
 
+int handle_op_system_expire(SystemExpireOp * const expire_op,
+                            HttpHandlerContext * const context);
+
 #endif
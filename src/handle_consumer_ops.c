@@ -2,6 +2,7 @@
 #include "common.h"
 #include "http_server.h"
 #include "handle_consumer_ops.h"
+#include "public.h"
 
 static int send_json_gen(yajl_gen json_gen, const OpReply * const op_reply)
 {
@@ -103,6 +104,15 @@ static int handle_consumer_op_records_delete(OpReply * const op_reply)
     return send_json_gen(json_gen, op_reply);
 }
 
+static int handle_consumer_op_records_import(OpReply * const op_reply)
+{
+    RecordsImportOpReply * const records_import_op_reply =
+        &op_reply->records_import_op_reply;
+    yajl_gen json_gen = records_import_op_reply->json_gen;
+    
+    return send_json_gen(json_gen, op_reply);
+}
+
 static int handle_consumer_op_search_nearby(OpReply * const op_reply)
 {
     SearchNearbyOpReply * const search_nearby_op_reply =
@@ -112,6 +122,15 @@ static int handle_consumer_op_search_nearby(OpReply * const op_reply)
     return send_json_gen(json_gen, op_reply);
 }
 
+static int handle_consumer_op_search_nearest(OpReply * const op_reply)
+{
+    SearchNearestOpReply * const search_nearest_op_reply =
+        &op_reply->search_nearest_op_reply;
+    yajl_gen json_gen = search_nearest_op_reply->json_gen;
+    
+    return send_json_gen(json_gen, op_reply);
+}
+
 static int handle_consumer_op_search_in_rect(OpReply * const op_reply)
 {
     SearchInRectOpReply * const search_in_rect_op_reply =
@@ -121,6 +140,33 @@ static int handle_consumer_op_search_in_rect(OpReply * const op_reply)
     return send_json_gen(json_gen, op_reply);
 }
 
+static int handle_consumer_op_search_grid(OpReply * const op_reply)
+{
+    SearchGridOpReply * const search_grid_op_reply =
+        &op_reply->search_grid_op_reply;
+    yajl_gen json_gen = search_grid_op_reply->json_gen;
+    
+    return send_json_gen(json_gen, op_reply);
+}
+
+static int handle_consumer_op_search_in_polygon(OpReply * const op_reply)
+{
+    SearchInPolygonOpReply * const search_in_polygon_op_reply =
+        &op_reply->search_in_polygon_op_reply;
+    yajl_gen json_gen = search_in_polygon_op_reply->json_gen;
+    
+    return send_json_gen(json_gen, op_reply);
+}
+
+static int handle_consumer_op_search_containing(OpReply * const op_reply)
+{
+    SearchContainingOpReply * const search_containing_op_reply =
+        &op_reply->search_containing_op_reply;
+    yajl_gen json_gen = search_containing_op_reply->json_gen;
+    
+    return send_json_gen(json_gen, op_reply);
+}
+
 static int handle_consumer_op_search_in_keys(OpReply * const op_reply)
 {
     SearchInKeysOpReply * const search_in_keys_op_reply =
@@ -130,15 +176,41 @@ static int handle_consumer_op_search_in_keys(OpReply * const op_reply)
     return send_json_gen(json_gen, op_reply);
 }
 
-void consumer_cb(struct bufferevent * const bev, void *context_)
+static int handle_consumer_op_public_get(OpReply * const op_reply)
+{
+    PublicGetOpReply * const public_get_op_reply =
+        &op_reply->public_get_op_reply;
+    struct evhttp_request * const req = public_get_op_reply->req;
+    const char *content_type = public_get_op_reply->content_type;
+    
+    if (public_get_op_reply->status == HTTP_NOTFOUND) {
+        evhttp_send_error(req, HTTP_NOTFOUND, "Not Found");
+        return 0;
+    }
+    if (public_get_op_reply->status != HTTP_OK) {
+        return public_get_op_reply->status;
+    }
+    if (content_type == NULL) {
+        content_type = DEFAULT_CONTENT_TYPE_FOR_PUBLIC_DATA;
+    }
+    evhttp_add_header(req->output_headers, "Content-Type", content_type);
+    evhttp_send_reply(req, HTTP_OK, "OK", public_get_op_reply->evb);
+    evbuffer_free(public_get_op_reply->evb);
+    public_get_op_reply->evb = NULL;
+    free(public_get_op_reply->content_type);
+    public_get_op_reply->content_type = NULL;
+    
+    return 0;
+}
+
+size_t consume_op_replies(HttpLoop * const loop)
 {
     OpReply *op_reply;
+    size_t nb_replies = (size_t) 0U;
     int ret = -1;
 
-    (void) context_;
-    while (evbuffer_get_length(bev->input) >= sizeof op_reply) {
-        assert(bufferevent_read(bev, &op_reply, sizeof op_reply)
-               == sizeof op_reply);
+    while (shift_cqueue(loop->replies_cqueue, &op_reply) == 0) {
+        nb_replies++;
         switch (op_reply->bare_op_reply.type) {
         case OP_TYPE_ERROR:
             ret = handle_consumer_op_error(op_reply);
@@ -167,15 +239,33 @@ void consumer_cb(struct bufferevent * const bev, void *context_)
         case OP_TYPE_RECORDS_DELETE:
             ret = handle_consumer_op_records_delete(op_reply);
             break;
+        case OP_TYPE_RECORDS_IMPORT:
+            ret = handle_consumer_op_records_import(op_reply);
+            break;
         case OP_TYPE_SEARCH_NEARBY:
             ret = handle_consumer_op_search_nearby(op_reply);
             break;
+        case OP_TYPE_SEARCH_NEAREST:
+            ret = handle_consumer_op_search_nearest(op_reply);
+            break;
         case OP_TYPE_SEARCH_IN_RECT:
             ret = handle_consumer_op_search_in_rect(op_reply);
             break;
+        case OP_TYPE_SEARCH_GRID:
+            ret = handle_consumer_op_search_grid(op_reply);
+            break;
+        case OP_TYPE_SEARCH_IN_POLYGON:
+            ret = handle_consumer_op_search_in_polygon(op_reply);
+            break;
+        case OP_TYPE_SEARCH_CONTAINING:
+            ret = handle_consumer_op_search_containing(op_reply);
+            break;
         case OP_TYPE_SEARCH_IN_KEYS:
             ret = handle_consumer_op_search_in_keys(op_reply);
             break;
+        case OP_TYPE_PUBLIC_GET:
+            ret = handle_consumer_op_public_get(op_reply);
+            break;
         default:
             ret = -1;
         }
@@ -188,5 +278,16 @@ void consumer_cb(struct bufferevent * const bev, void *context_)
         op_reply->bare_op_reply.op_tid = (OpTID) 0;
         free(op_reply);
     }
+    return nb_replies;
 }
 
+void consumer_cb(evutil_socket_t fd, short event, void *loop_)
+{
+    HttpLoop * const loop = loop_;
+    unsigned char buf[64];
+
+    (void) event;
+    while (read(fd, buf, sizeof buf) > (ssize_t) 0);
+    __atomic_store_n(&loop->replies_notified, 0, __ATOMIC_SEQ_CST);
+    consume_op_replies(loop);
+}
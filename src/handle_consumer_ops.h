@@ -2,6 +2,8 @@
 #ifndef __HANDLE_CONSUMER_OPS_H__
 #define __HANDLE_CONSUMER_OPS__ 1
 
-void consumer_cb(struct bufferevent * const bev, void *context_);
+size_t consume_op_replies(HttpLoop * const loop);
+
+void consumer_cb(evutil_socket_t fd, short event, void *loop_);
 
 #endif
@@ -0,0 +1,146 @@
+
+#include "common.h"
+#include "heap.h"
+
+PntHeap *new_pnt_heap(size_t initial_nb_elements,
+                      const size_t element_size, PntHeapCmpCB cmp_cb)
+{
+    PntHeap *pnt_heap;
+    
+    if (element_size == 0U) {
+        return NULL;
+    }
+    if (initial_nb_elements <= (size_t) 0U) {
+        initial_nb_elements = HEAP_CHUNK_SIZE / element_size;
+        if (initial_nb_elements <= 0U) {
+            initial_nb_elements = (size_t) 1U;
+        }
+    }
+    if (SIZE_MAX / initial_nb_elements < element_size) {
+        return NULL;
+    }
+    if ((pnt_heap = malloc(sizeof *pnt_heap)) == NULL) {
+        return NULL;
+    }
+    *pnt_heap = (PntHeap) {
+        .heap = NULL,
+        .tmp = NULL,
+        .heap_size = initial_nb_elements,
+        .element_size = element_size,
+        .nb_elements = (size_t) 0U,
+        .cmp_cb = cmp_cb
+    };
+    if ((pnt_heap->heap = malloc(initial_nb_elements * element_size)) == NULL ||
+        (pnt_heap->tmp = malloc(element_size)) == NULL) {
+        free_pnt_heap(pnt_heap);
+        return NULL;
+    }
+    return pnt_heap;
+}
+
+void free_pnt_heap(PntHeap * const pnt_heap)
+{
+    if (pnt_heap == NULL) {
+        return;
+    }
+    free(pnt_heap->heap);
+    pnt_heap->heap = NULL;
+    free(pnt_heap->tmp);
+    pnt_heap->tmp = NULL;
+    free(pnt_heap);
+}
+
+static inline void *pnt_heap_element(PntHeap * const pnt_heap,
+                                     const size_t i)
+{
+    return pnt_heap->heap + i * pnt_heap->element_size;
+}
+
+static void swap_pnt_heap_elements(PntHeap * const pnt_heap,
+                                   const size_t i, const size_t j)
+{
+    const size_t element_size = pnt_heap->element_size;
+    
+    memcpy(pnt_heap->tmp, pnt_heap_element(pnt_heap, i), element_size);
+    memcpy(pnt_heap_element(pnt_heap, i),
+           pnt_heap_element(pnt_heap, j), element_size);
+    memcpy(pnt_heap_element(pnt_heap, j), pnt_heap->tmp, element_size);
+}
+
+int push_pnt_heap(PntHeap * const pnt_heap, const void * const pnt)
+{
+    unsigned char *new_heap;
+    size_t new_heap_size;
+    size_t i;
+    size_t parent;
+    
+    if (pnt_heap->nb_elements >= pnt_heap->heap_size) {
+        if (pnt_heap->heap_size > SIZE_MAX / 2U / pnt_heap->element_size) {
+            return -1;
+        }
+        new_heap_size = pnt_heap->heap_size * (size_t) 2U;
+        new_heap = realloc(pnt_heap->heap,
+                           new_heap_size * pnt_heap->element_size);
+        if (new_heap == NULL) {
+            return -1;
+        }
+        pnt_heap->heap = new_heap;
+        pnt_heap->heap_size = new_heap_size;
+    }
+    i = pnt_heap->nb_elements++;
+    memcpy(pnt_heap_element(pnt_heap, i), pnt, pnt_heap->element_size);
+    while (i > (size_t) 0U) {
+        parent = (i - (size_t) 1U) / (size_t) 2U;
+        if (pnt_heap->cmp_cb(pnt_heap_element(pnt_heap, i),
+                             pnt_heap_element(pnt_heap, parent)) >= 0) {
+            break;
+        }
+        swap_pnt_heap_elements(pnt_heap, i, parent);
+        i = parent;
+    }
+    return 0;
+}
+
+int pop_pnt_heap(PntHeap * const pnt_heap, void * const pnt)
+{
+    const size_t nb_elements = pnt_heap->nb_elements;
+    size_t i = (size_t) 0U;
+    size_t child;
+    
+    if (nb_elements <= (size_t) 0U) {
+        return -1;
+    }
+    memcpy(pnt, pnt_heap_element(pnt_heap, 0U), pnt_heap->element_size);
+    if ((pnt_heap->nb_elements = nb_elements - (size_t) 1U) <= (size_t) 0U) {
+        return 0;
+    }
+    memcpy(pnt_heap_element(pnt_heap, 0U),
+           pnt_heap_element(pnt_heap, pnt_heap->nb_elements),
+           pnt_heap->element_size);
+    for (;;) {
+        child = i * (size_t) 2U + (size_t) 1U;
+        if (child >= pnt_heap->nb_elements) {
+            break;
+        }
+        if (child + (size_t) 1U < pnt_heap->nb_elements &&
+            pnt_heap->cmp_cb(pnt_heap_element(pnt_heap, child + (size_t) 1U),
+                             pnt_heap_element(pnt_heap, child)) < 0) {
+            child++;
+        }
+        if (pnt_heap->cmp_cb(pnt_heap_element(pnt_heap, child),
+                             pnt_heap_element(pnt_heap, i)) >= 0) {
+            break;
+        }
+        swap_pnt_heap_elements(pnt_heap, i, child);
+        i = child;
+    }
+    return 0;
+}
+
+void *peek_pnt_heap(PntHeap * const pnt_heap)
+{
+    if (pnt_heap->nb_elements <= (size_t) 0U) {
+        return NULL;
+    }
+    return pnt_heap_element(pnt_heap, 0U);
+}
@@ -0,0 +1,31 @@
+
+#ifndef __HEAP_H__
+#define __HEAP_H__ 1
+
+#ifndef HEAP_CHUNK_SIZE
+# define HEAP_CHUNK_SIZE ((size_t) 4096U)
+#endif
+
+typedef int (*PntHeapCmpCB)(const void * const pnt1, const void * const pnt2);
+
+typedef struct PntHeap_ {
+    unsigned char *heap;
+    unsigned char *tmp;
+    size_t heap_size;
+    size_t element_size;
+    size_t nb_elements;
+    PntHeapCmpCB cmp_cb;
+} PntHeap;
+
+PntHeap *new_pnt_heap(size_t initial_nb_elements,
+                      const size_t element_size, PntHeapCmpCB cmp_cb);
+
+void free_pnt_heap(PntHeap * const pnt_heap);
+
+int push_pnt_heap(PntHeap * const pnt_heap, const void * const pnt);
+
+int pop_pnt_heap(PntHeap * const pnt_heap, void * const pnt);
+
+void *peek_pnt_heap(PntHeap * const pnt_heap);
+
+#endif
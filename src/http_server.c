@@ -21,34 +21,132 @@ static void http_close_cb(struct evhttp_connection * const cnx,
     evhttp_connection_set_closecb(cnx, NULL, NULL);
 }
 
+static __thread HttpLoop *current_loop;
+static __thread _Bool replies_batched;
+static __thread HttpLoop *batched_replies_loop;
+
+static void notify_replies_consumer(HttpLoop * const loop)
+{
+    if (__atomic_load_n(&loop->replies_notified, __ATOMIC_SEQ_CST) != 0 ||
+        __atomic_exchange_n(&loop->replies_notified, 1,
+                            __ATOMIC_SEQ_CST) != 0) {
+        return;
+    }
+#ifdef HAVE_SYS_EVENTFD_H
+    const uint64_t one = (uint64_t) 1U;
+#else
+    const unsigned char one = 1U;
+#endif
+    while (write(loop->replies_notification_fds[1], &one, sizeof one)
+           == (ssize_t) -1 && errno == EINTR);
+}
+
+static HttpLoop *get_loop_for_req(HttpHandlerContext * const context,
+                                  struct evhttp_request * const req)
+{
+    struct evhttp_connection *cnx;
+    struct event_base *base;
+    unsigned int t;
+    
+    if (context->nb_loops <= 1U ||
+        (cnx = evhttp_request_get_connection(req)) == NULL) {
+        return &context->loops[0];
+    }
+    base = evhttp_connection_get_base(cnx);
+    t = context->nb_loops;
+    while (t-- > 1U) {
+        if (context->loops[t].event_base == base) {
+            return &context->loops[t];
+        }
+    }
+    return &context->loops[0];
+}
+
 int send_op_reply(HttpHandlerContext * const context,
                   const OpReply * const op_reply)
 {
-    pthread_mutex_t fake_mutex = PTHREAD_MUTEX_INITIALIZER;
-    pthread_cond_t fake_cond = PTHREAD_COND_INITIALIZER;
-    struct timeval tv;
-    struct timespec ts;
+    HttpLoop * const loop =
+        get_loop_for_req(context, op_reply->bare_op_reply.req);
     
-    while (evbuffer_get_length(context->publisher_bev->output) >=
-           app_context.max_queued_replies * sizeof op_reply ||
-           bufferevent_write(context->publisher_bev, &op_reply,
-                             sizeof op_reply) != 0) {        
-        if (gettimeofday(&tv, NULL) != 0) {
-            break;
+    if (replies_batched == 0) {
+        push_cqueue_wait(loop->replies_cqueue, &op_reply);
+        notify_replies_consumer(loop);
+        
+        return 0;
+    }
+    if (batched_replies_loop != loop) {
+        if (batched_replies_loop != NULL) {
+            notify_replies_consumer(batched_replies_loop);
         }
-        ts = (struct timespec) {
-            .tv_sec = tv.tv_sec + 1L,
-            .tv_nsec = tv.tv_usec * 1000L
-        };
-        pthread_mutex_lock(&fake_mutex);
-        pthread_cond_timedwait(&fake_cond, &fake_mutex, &ts);
-        pthread_mutex_unlock(&fake_mutex);
+        batched_replies_loop = loop;
+    }
+    if (push_cqueue(loop->replies_cqueue, &op_reply) != 0) {
+        notify_replies_consumer(loop);
+        push_cqueue_wait(loop->replies_cqueue, &op_reply);
     }
-    bufferevent_flush(context->publisher_bev, EV_WRITE, BEV_FLUSH);
+    return 0;
+}
+
+static void begin_op_replies_batch(void)
+{
+    replies_batched = 1;
+}
+
+static void end_op_replies_batch(void)
+{
+    replies_batched = 0;
+    if (batched_replies_loop != NULL) {
+        notify_replies_consumer(batched_replies_loop);
+        batched_replies_loop = NULL;
+    }
+}
+
+static int init_replies_notification(HttpLoop * const loop)
+{
+    int * const fds = loop->replies_notification_fds;
+    
+#ifdef HAVE_SYS_EVENTFD_H
+    if ((fds[0] = eventfd(0U, EFD_NONBLOCK | EFD_CLOEXEC)) == -1) {
+        return -1;
+    }
+    fds[1] = fds[0];
+#else
+    if (pipe(fds) != 0) {
+        fds[0] = fds[1] = -1;
+        return -1;
+    }
+    if (evutil_make_socket_nonblocking(fds[0]) != 0 ||
+        evutil_make_socket_nonblocking(fds[1]) != 0) {
+        close(fds[0]);
+        close(fds[1]);
+        fds[0] = fds[1] = -1;
+        return -1;
+    }
+#endif
+    loop->replies_notified = 0;
     
     return 0;
 }
 
+static void free_replies_notification(HttpLoop * const loop)
+{
+    int * const fds = loop->replies_notification_fds;
+    
+    if (fds[0] != -1) {
+        close(fds[0]);
+    }
+    if (fds[1] != -1 && fds[1] != fds[0]) {
+        close(fds[1]);
+    }
+    fds[0] = fds[1] = -1;
+}
+
+OpTID next_op_tid(HttpHandlerContext * const context)
+{
+    return __atomic_add_fetch(&context->op_tid, (OpTID) 1U,
+                              __ATOMIC_RELAXED);
+}
+
 yajl_gen new_json_gen(const OpReply * const op_reply)
 {
     yajl_gen json_gen = yajl_gen_alloc(NULL);
@@ -67,123 +165,455 @@ yajl_gen new_json_gen(const OpReply * const op_reply)
     return json_gen;
 }
 
-static int worker_do_work(HttpHandlerContext * const context)
+static CQueue *get_lane_for_key(HttpHandlerContext * const context,
+                                const Key * const layer_name,
+                                const Key * const key)
 {
-    Op *op_;
-    Op op;
+    const uint32_t h = hash_key(key, hash_key(layer_name, KEY_HASH_SEED));
+    
+    return context->workers[h % app_context.nb_workers].lane;
+}
+
+static int dispatch_barrier_op(HttpHandlerContext * const context,
+                               const Op * const op)
+{
+    Worker * const workers = context->workers;
+    const unsigned int nb_workers = app_context.nb_workers;
+    LaneBarrier *barrier;
+    Op barrier_op = *op;
+    unsigned int t;
+
+    if ((barrier = malloc(sizeof *barrier)) == NULL) {
+        return -1;
+    }
+    *barrier = (LaneBarrier) {
+        .nb_pending = nb_workers,
+        .nb_refs = nb_workers,
+        .done = 0
+    };
+    if (barrier_op.bare_op.type == OP_TYPE_LAYERS_CREATE) {
+        barrier_op.layers_create_op.barrier = barrier;
+    } else if (barrier_op.bare_op.type == OP_TYPE_RECORDS_IMPORT) {
+        barrier_op.records_import_op.barrier = barrier;
+    } else {
+        assert(barrier_op.bare_op.type == OP_TYPE_LAYERS_DELETE);
+        barrier_op.layers_delete_op.barrier = barrier;
+    }
+    pthread_mutex_lock(&context->mtx_lanes_barrier);
+    for (t = 0U; t < nb_workers; t++) {
+        if (depth_cqueue(workers[t].lane) >= workers[t].lane->nb_elements) {
+            pthread_mutex_unlock(&context->mtx_lanes_barrier);
+            free(barrier);
+            return -1;
+        }
+    }
+    for (t = 0U; t < nb_workers; t++) {
+        if (push_cqueue_reserved(workers[t].lane, &barrier_op) != 0) {
+            assert(0);
+        }
+    }
+    pthread_mutex_unlock(&context->mtx_lanes_barrier);
+    
+    return 0;
+}
+
+int dispatch_op(HttpHandlerContext * const context, const Op * const op)
+{
+    const OpType type = op->bare_op.type;
+    
+    if (context->lanes_enabled == 0) {
+        return push_cqueue(context->cqueue, op);
+    }
+    if (type == OP_TYPE_RECORDS_PUT) {
+        return push_cqueue(get_lane_for_key(context,
+                                            op->records_put_op.layer_name,
+                                            op->records_put_op.key), op);
+    }
+    if (type == OP_TYPE_RECORDS_GET) {
+        return push_cqueue(get_lane_for_key(context,
+                                            op->records_get_op.layer_name,
+                                            op->records_get_op.key), op);
+    }
+    if (type == OP_TYPE_RECORDS_DELETE) {
+        return push_cqueue(get_lane_for_key(context,
+                                            op->records_delete_op.layer_name,
+                                            op->records_delete_op.key), op);
+    }
+    if (type == OP_TYPE_PUBLIC_GET) {
+        return push_cqueue(get_lane_for_key(context,
+                                            op->public_get_op.layer_name,
+                                            op->public_get_op.key), op);
+    }
+    if (type == OP_TYPE_LAYERS_CREATE || type == OP_TYPE_LAYERS_DELETE ||
+        type == OP_TYPE_RECORDS_IMPORT) {
+        return dispatch_barrier_op(context, op);
+    }
+    if (type == OP_TYPE_SEARCH_NEARBY || type == OP_TYPE_SEARCH_NEAREST ||
+        type == OP_TYPE_SEARCH_IN_RECT || type == OP_TYPE_SEARCH_GRID ||
+        type == OP_TYPE_SEARCH_IN_POLYGON ||
+        type == OP_TYPE_SEARCH_CONTAINING || type == OP_TYPE_SEARCH_IN_KEYS) {
+        return push_cqueue(context->reads_cqueue, op);
+    }
+    return push_cqueue(context->cqueue, op);
+}
+
+int dispatch_journaled_op(HttpHandlerContext * const context,
+                          const Op * const op)
+{
+    struct evhttp_request * const req = op->bare_op.req;
+    int ret;
+    
+    if (op->bare_op.fake_req != 0) {
+        return dispatch_op(context, op);
+    }
+    pthread_mutex_lock(&context->mtx_db_log);
+    if ((ret = dispatch_op(context, op)) == 0) {
+        add_to_db_log(context, req->type, evhttp_request_get_uri(req),
+                      evhttp_request_get_input_buffer(req), 1);
+    }
+    pthread_mutex_unlock(&context->mtx_db_log);
+    
+    return ret;
+}
+
+static void send_error_op_reply(HttpHandlerContext * const context,
+                                const Op * const op)
+{
+    OpReply *op_reply = malloc(sizeof *op_reply);
+    if (op_reply == NULL) {
+        return;
+    }
+    ErrorOpReply * const error_op_reply = &op_reply->error_op_reply;
+    yajl_gen json_gen;                
+    
+    *error_op_reply = (ErrorOpReply) {
+        .type = OP_TYPE_ERROR,
+        .req = op->bare_op.req,
+        .op_tid = op->bare_op.op_tid,
+        .json_gen = NULL                        
+    };
+    if ((json_gen = new_json_gen(op_reply)) == NULL) {
+        free(op_reply);
+        return;
+    }
+    error_op_reply->json_gen = json_gen;
+    yajl_gen_string(json_gen, (const unsigned char *) "error",
+                    (unsigned int) sizeof "error" - (size_t) 1U);
+    yajl_gen_string(json_gen, (const unsigned char *) "error",
+                    (unsigned int) sizeof "error" - (size_t) 1U);
+    send_op_reply(context, op_reply);
+    yajl_gen_free(json_gen);
+}
+
+static int process_op(HttpHandlerContext * const context, Op * const op_)
+{
+    Op op = *op_;
     
-    pthread_mutex_lock(&context->mtx_cqueue);
-stab:
-    if (context->should_exit != 0) {
-        pthread_mutex_unlock(&context->mtx_cqueue);        
-        return 1;
+    if (op.bare_op.type == OP_TYPE_SYSTEM_EXPIRE) {
+        return handle_op_system_expire(&op.system_expire_op, context);
     }
-    op_ = shift_cqueue(context->cqueue);
-    if (op_ != NULL && op_->bare_op.req != NULL) {
+    if (op.bare_op.req != NULL) {
         int ret = -1;
-        op = *op_;
-        pthread_mutex_unlock(&context->mtx_cqueue);
         if (op.bare_op.type == OP_TYPE_SYSTEM_PING) {
             ret = handle_op_system_ping(&op.system_ping_op, context);
         } else if (op.bare_op.type == OP_TYPE_LAYERS_CREATE) {
-            pthread_rwlock_wrlock(&context->rwlock_layers);
+            prwlock_wrlock(&context->rwlock_layers);
             ret = handle_op_layers_create(&op.layers_create_op, context);
-            pthread_rwlock_unlock(&context->rwlock_layers);
+            prwlock_unlock(&context->rwlock_layers);
         } else if (op.bare_op.type == OP_TYPE_LAYERS_DELETE) {
-            pthread_rwlock_wrlock(&context->rwlock_layers);
+            prwlock_wrlock(&context->rwlock_layers);
             ret = handle_op_layers_delete(&op.layers_delete_op, context);
-            pthread_rwlock_unlock(&context->rwlock_layers);
+            prwlock_unlock(&context->rwlock_layers);
         } else if (op.bare_op.type == OP_TYPE_LAYERS_INDEX) {
-            pthread_rwlock_rdlock(&context->rwlock_layers);
+            prwlock_rdlock(&context->rwlock_layers);
             ret = handle_op_layers_index(&op.layers_index_op, context);
-            pthread_rwlock_unlock(&context->rwlock_layers);
+            prwlock_unlock(&context->rwlock_layers);
         } else if (op.bare_op.type == OP_TYPE_RECORDS_PUT) {
-            pthread_rwlock_wrlock(&context->rwlock_layers);
+#if AUTOMATICALLY_CREATE_LAYERS
+            prwlock_wrlock(&context->rwlock_layers);
+#else
+            prwlock_rdlock(&context->rwlock_layers);
+#endif
             ret = handle_op_records_put(&op.records_put_op, context);
-            pthread_rwlock_unlock(&context->rwlock_layers);
+            prwlock_unlock(&context->rwlock_layers);
         } else if (op.bare_op.type == OP_TYPE_RECORDS_GET) {
 #if AUTOMATICALLY_CREATE_LAYERS
-            pthread_rwlock_wrlock(&context->rwlock_layers);
+            prwlock_wrlock(&context->rwlock_layers);
 #else
-            pthread_rwlock_rdlock(&context->rwlock_layers);
+            prwlock_rdlock(&context->rwlock_layers);
 #endif
             ret = handle_op_records_get(&op.records_get_op, context);
-            pthread_rwlock_unlock(&context->rwlock_layers);
+            prwlock_unlock(&context->rwlock_layers);
         } else if (op.bare_op.type == OP_TYPE_RECORDS_DELETE) {
-            pthread_rwlock_wrlock(&context->rwlock_layers);
+            prwlock_rdlock(&context->rwlock_layers);
             ret = handle_op_records_delete(&op.records_delete_op, context);
-            pthread_rwlock_unlock(&context->rwlock_layers);
+            prwlock_unlock(&context->rwlock_layers);
+        } else if (op.bare_op.type == OP_TYPE_RECORDS_IMPORT) {
+#if AUTOMATICALLY_CREATE_LAYERS
+            prwlock_wrlock(&context->rwlock_layers);
+#else
+            prwlock_rdlock(&context->rwlock_layers);
+#endif
+            ret = handle_op_records_import(&op.records_import_op, context);
+            prwlock_unlock(&context->rwlock_layers);
         } else if (op.bare_op.type == OP_TYPE_SEARCH_NEARBY) {
 #if AUTOMATICALLY_CREATE_LAYERS
-            pthread_rwlock_wrlock(&context->rwlock_layers);
+            prwlock_wrlock(&context->rwlock_layers);
 #else
-            pthread_rwlock_rdlock(&context->rwlock_layers);
+            prwlock_rdlock(&context->rwlock_layers);
 #endif
             ret = handle_op_search_nearby(&op.search_nearby_op, context);
-            pthread_rwlock_unlock(&context->rwlock_layers);
+            prwlock_unlock(&context->rwlock_layers);
+        } else if (op.bare_op.type == OP_TYPE_SEARCH_NEAREST) {
+#if AUTOMATICALLY_CREATE_LAYERS
+            prwlock_wrlock(&context->rwlock_layers);
+#else
+            prwlock_rdlock(&context->rwlock_layers);
+#endif
+            ret = handle_op_search_nearest(&op.search_nearest_op, context);
+            prwlock_unlock(&context->rwlock_layers);
         } else if (op.bare_op.type == OP_TYPE_SEARCH_IN_RECT) {
 #if AUTOMATICALLY_CREATE_LAYERS
-            pthread_rwlock_wrlock(&context->rwlock_layers);
+            prwlock_wrlock(&context->rwlock_layers);
 #else
-            pthread_rwlock_rdlock(&context->rwlock_layers);
+            prwlock_rdlock(&context->rwlock_layers);
 #endif
             ret = handle_op_search_in_rect(&op.search_in_rect_op, context);
-            pthread_rwlock_unlock(&context->rwlock_layers);
+            prwlock_unlock(&context->rwlock_layers);
+        } else if (op.bare_op.type == OP_TYPE_SEARCH_GRID) {
+#if AUTOMATICALLY_CREATE_LAYERS
+            prwlock_wrlock(&context->rwlock_layers);
+#else
+            prwlock_rdlock(&context->rwlock_layers);
+#endif
+            ret = handle_op_search_grid(&op.search_grid_op, context);
+            prwlock_unlock(&context->rwlock_layers);
+        } else if (op.bare_op.type == OP_TYPE_SEARCH_IN_POLYGON) {
+#if AUTOMATICALLY_CREATE_LAYERS
+            prwlock_wrlock(&context->rwlock_layers);
+#else
+            prwlock_rdlock(&context->rwlock_layers);
+#endif
+            ret = handle_op_search_in_polygon(&op.search_in_polygon_op,
+                                              context);
+            prwlock_unlock(&context->rwlock_layers);
+        } else if (op.bare_op.type == OP_TYPE_SEARCH_CONTAINING) {
+#if AUTOMATICALLY_CREATE_LAYERS
+            prwlock_wrlock(&context->rwlock_layers);
+#else
+            prwlock_rdlock(&context->rwlock_layers);
+#endif
+            ret = handle_op_search_containing(&op.search_containing_op,
+                                              context);
+            prwlock_unlock(&context->rwlock_layers);
         } else if (op.bare_op.type == OP_TYPE_SEARCH_IN_KEYS) {
 #if AUTOMATICALLY_CREATE_LAYERS
-            pthread_rwlock_wrlock(&context->rwlock_layers);
+            prwlock_wrlock(&context->rwlock_layers);
 #else
-            pthread_rwlock_rdlock(&context->rwlock_layers);
+            prwlock_rdlock(&context->rwlock_layers);
 #endif
             ret = handle_op_search_in_keys(&op.search_in_keys_op, context);
-            pthread_rwlock_unlock(&context->rwlock_layers);
+            prwlock_unlock(&context->rwlock_layers);
+        } else if (op.bare_op.type == OP_TYPE_PUBLIC_GET) {
+            prwlock_rdlock(&context->rwlock_layers);
+            ret = handle_op_public_get(&op.public_get_op, context);
+            prwlock_unlock(&context->rwlock_layers);
         } else {
             assert(0);
         }
         if (ret != 0 && op.bare_op.fake_req == 0) {
-            OpReply *op_reply = malloc(sizeof *op_reply);
-            if (op_reply == NULL) {
-                return 0;
-            }
-            ErrorOpReply * const error_op_reply =
-                &op_reply->error_op_reply;
-            yajl_gen json_gen;                
-            
-            *error_op_reply = (ErrorOpReply) {
-                .type = OP_TYPE_ERROR,
-                .req = op.bare_op.req,
-                .op_tid = op.bare_op.op_tid,
-                .json_gen = NULL                        
-            };
-            if ((json_gen = new_json_gen(op_reply)) == NULL) {
-                free(op_reply);
-                return 0;
-            }
-            error_op_reply->json_gen = json_gen;
-            yajl_gen_string(json_gen, (const unsigned char *) "error",
-                            (unsigned int) sizeof "error" - (size_t) 1U);
-            yajl_gen_string(json_gen, (const unsigned char *) "error",
-                            (unsigned int) sizeof "error" - (size_t) 1U);
-            send_op_reply(context, op_reply);
-            yajl_gen_free(json_gen);
+            send_error_op_reply(context, &op);
         }
-    } else {
-        pthread_cond_wait(&context->cond_cqueue, &context->mtx_cqueue);
-        goto stab;
     }
     return 0;
 }
 
-static void *worker_thread(void *context_)
+static LaneBarrier *get_op_lane_barrier(const Op * const op)
 {
-    HttpHandlerContext * const context = context_;
+    if (op->bare_op.type == OP_TYPE_LAYERS_CREATE) {
+        return op->layers_create_op.barrier;
+    }
+    if (op->bare_op.type == OP_TYPE_LAYERS_DELETE) {
+        return op->layers_delete_op.barrier;
+    }
+    if (op->bare_op.type == OP_TYPE_RECORDS_IMPORT) {
+        return op->records_import_op.barrier;
+    }
+    return NULL;
+}
+
+static int wait_for_lane_barrier(Worker * const worker, Op * const op,
+                                 LaneBarrier * const barrier)
+{
+    HttpHandlerContext * const context = worker->context;
+    uint32_t seq;
+    
+    for (;;) {
+        seq = prepare_wait_cqueue_waiters(worker->waiters);
+        if (__atomic_load_n(&barrier->done, __ATOMIC_SEQ_CST) != 0) {
+            cancel_wait_cqueue_waiters(worker->waiters);
+            break;
+        }
+        if (context->should_exit != 0) {
+            cancel_wait_cqueue_waiters(worker->waiters);
+            worker->pending_barrier_op = *op;
+            worker->has_pending_barrier = 1;
+            return 1;
+        }
+        wait_cqueue_waiters(worker->waiters, seq);
+    }
+    if (__atomic_sub_fetch(&barrier->nb_refs, 1U, __ATOMIC_SEQ_CST) == 0U) {
+        free(barrier);
+    }
+    return 0;
+}
+
+static int arrive_at_lane_barrier(Worker * const worker, Op * const op,
+                                  LaneBarrier * const barrier)
+{
+    HttpHandlerContext * const context = worker->context;
+    unsigned int t;
+    
+    if (__atomic_sub_fetch(&barrier->nb_pending, 1U,
+                           __ATOMIC_SEQ_CST) == 0U) {
+        process_op(context, op);
+        __atomic_store_n(&barrier->done, 1, __ATOMIC_SEQ_CST);
+        t = app_context.nb_workers;
+        while (t-- > 0U) {
+            wake_cqueue_waiters(&context->workers_waiters[t], 1);
+        }
+    }
+    return wait_for_lane_barrier(worker, op, barrier);
+}
+
+static _Bool is_batchable_write_op(const Op * const op)
+{
+    return op->bare_op.type == OP_TYPE_RECORDS_PUT ||
+        op->bare_op.type == OP_TYPE_RECORDS_DELETE;
+}
+
+static const Key *get_write_op_layer_name(const Op * const op)
+{
+    if (op->bare_op.type == OP_TYPE_RECORDS_PUT) {
+        return op->records_put_op.layer_name;
+    }
+    assert(op->bare_op.type == OP_TYPE_RECORDS_DELETE);
+    
+    return op->records_delete_op.layer_name;
+}
+
+static _Bool is_same_layer_write_op(const Op * const op,
+                                    const Key * const layer_name)
+{
+    const Key *op_layer_name;
+    
+    if (is_batchable_write_op(op) == 0) {
+        return 0;
+    }
+    op_layer_name = get_write_op_layer_name(op);
+    
+    return op_layer_name->len == layer_name->len &&
+        memcmp(op_layer_name->val, layer_name->val, layer_name->len) == 0;
+}
+
+static int process_write_batch(Worker * const worker, const Op * const op)
+{
+    HttpHandlerContext * const context = worker->context;
+    Op * const batch = worker->write_batch;
+    int * const rets = worker->write_batch_rets;
+    const Key * const layer_name = get_write_op_layer_name(op);
+    size_t nb_ops = (size_t) 1U;
+    size_t t;
+    int ret;
+    
+    batch[0] = *op;
+    while (nb_ops < app_context.write_batch_size &&
+           shift_cqueue(worker->lane, &batch[nb_ops]) == 0) {
+        if (is_same_layer_write_op(&batch[nb_ops], layer_name) == 0) {
+            worker->carry_op = batch[nb_ops];
+            worker->has_carry_op = 1;
+            break;
+        }
+        nb_ops++;
+    }
+    if (nb_ops == (size_t) 1U) {
+        return process_op(context, &batch[0]);
+    }
+    begin_op_replies_batch();
+#if AUTOMATICALLY_CREATE_LAYERS
+    prwlock_wrlock(&context->rwlock_layers);
+#else
+    prwlock_rdlock(&context->rwlock_layers);
+#endif
+    ret = handle_op_records_write_batch(batch, nb_ops, rets, context);
+    prwlock_unlock(&context->rwlock_layers);
+    for (t = (size_t) 0U; t < nb_ops; t++) {
+        if (ret != 0) {
+            process_op(context, &batch[t]);
+        } else if (rets[t] != 0 && batch[t].bare_op.fake_req == 0) {
+            send_error_op_reply(context, &batch[t]);
+        }
+    }
+    end_op_replies_batch();
+    
+    return 0;
+}
+
+static int worker_do_work(Worker * const worker)
+{
+    HttpHandlerContext * const context = worker->context;
+    CQueue *cqueues[3] = { context->cqueue, worker->lane,
+                           context->reads_cqueue };
+    LaneBarrier *barrier;
+    Op op;
+
+    if (worker->has_pending_barrier != 0) {
+        worker->has_pending_barrier = 0;
+        worker->has_carry_op = 0;
+        worker->sched_slot = 0U;
+        op = worker->pending_barrier_op;
+        return wait_for_lane_barrier(worker, &op, get_op_lane_barrier(&op));
+    }
+    if (worker->has_carry_op != 0) {
+        worker->has_carry_op = 0;
+        op = worker->carry_op;
+    } else {
+        if (worker->sched_slot >= app_context.writes_weight) {
+            cqueues[1] = context->reads_cqueue;
+            cqueues[2] = worker->lane;
+        }
+        if (++worker->sched_slot >=
+            app_context.writes_weight + app_context.reads_weight) {
+            worker->sched_slot = 0U;
+        }
+        if (shift_cqueues_wait(cqueues, sizeof cqueues / sizeof cqueues[0],
+                               worker->waiters, &op,
+                               &context->should_exit) != 0) {
+            return 1;
+        }
+    }
+    if ((barrier = get_op_lane_barrier(&op)) != NULL) {
+        return arrive_at_lane_barrier(worker, &op, barrier);
+    }
+    if (app_context.write_batch_size > (size_t) 1U &&
+        is_batchable_write_op(&op) != 0) {
+        return process_write_batch(worker, &op);
+    }
+    return process_op(context, &op);
+}
+
+static void *worker_thread(void *worker_)
+{
+    Worker * const worker = worker_;
+    HttpHandlerContext * const context = worker->context;
     uint32_t thr_id;
     
     evutil_secure_rng_get_bytes(&thr_id, sizeof thr_id);
     logfile(context, LOG_INFO,
             "Starting worker thread: [%" PRIu32 "]", thr_id);
 
-    while (worker_do_work(context) == 0);
+    while (worker_do_work(worker) == 0);
+    __atomic_sub_fetch(&context->nb_active_workers, 1U, __ATOMIC_SEQ_CST);
     
     logfile(context, LOG_INFO, "Exited worker thread: [%" PRIu32 "]", thr_id);
     
@@ -257,10 +687,8 @@ static int process_api_request(HttpHandlerContext * const context,
         return -1;
     }
     char * const uri_part = domain + strlen(domain) + (size_t) 1U;
-    _Bool write_to_log = 0;
     const int ret = scanned_domain->domain_handler(req, context,
                                                    uri_part, opts,
-                                                   &write_to_log,
                                                    fake_req);
     free(decoded_uri);
     if (ret != 0) {
@@ -269,10 +697,6 @@ static int process_api_request(HttpHandlerContext * const context,
         }
         return -1;
     }
-    if (fake_req == 0 && write_to_log != 0) {
-        add_to_db_log(context, req->type, uri,
-                      evhttp_request_get_input_buffer(req), 1);
-    }
     return 0;    
 }
 
@@ -341,16 +765,29 @@ int fake_request(HttpHandlerContext * const context,
     req.input_buffer = evbuffer_new();
     evbuffer_add(req.input_buffer, body, body_len);
     if (add_to_journal != 0) {
-        add_to_db_log(context, verb, uri, req.input_buffer, 1);
+        pthread_mutex_lock(&context->mtx_db_log);
     }
     while (process_request(context, &req, 1) != 0) {
+        if (add_to_journal != 0) {
+            pthread_mutex_unlock(&context->mtx_db_log);
+        }
         usleep(1000000U / 25U);
+        if (add_to_journal != 0) {
+            pthread_mutex_lock(&context->mtx_db_log);
+        }
+    }
+    if (add_to_journal != 0) {
+        add_to_db_log(context, verb, uri, req.input_buffer, 1);
+        pthread_mutex_unlock(&context->mtx_db_log);
     }
     evbuffer_free(req.input_buffer);
     if (in_main_thread == 0) {
         return 0;
     }
-    worker_do_work(context);
+    Op op;
+    if (shift_cqueue(context->cqueue, &op) == 0) {
+        process_op(context, &op);
+    }
     
     return 0;
 }
@@ -363,15 +800,6 @@ static void free_layer_slab_entry_cb(void *layer_)
     free_pan_db(&layer->pan_db);
 }
 
-static void free_expirables_slab_entry_cb(void *expirable_)
-{
-    Expirable * const expirable = expirable_;
-    *expirable = (Expirable) {
-        .ts = (time_t) 0,
-        .key_node = NULL
-    };
-}
-
 static void sigterm_cb(const int sig)
 {
     (void) sig;
@@ -440,36 +868,133 @@ static void set_signals(void)
     sigprocmask(SIG_SETMASK, &sigs, NULL);    
 }
 
-int start_workers(HttpHandlerContext * const context)
+static int init_workers(HttpHandlerContext * const context)
 {
-    assert(context->thr_workers == NULL);
-    context->should_exit = 0;
-    unsigned int nb_workers = app_context.nb_workers;
+    const unsigned int nb_workers = app_context.nb_workers;
+    size_t lane_queued_ops;
+    Worker *worker;
+    void *workers_waiters;
+    unsigned int t;
+    
     assert(nb_workers > 0U);
-    pthread_t *thr_workers = malloc(nb_workers * sizeof *thr_workers);
-    if (thr_workers == NULL) {
+    if ((context->workers = calloc(nb_workers,
+                                   sizeof *context->workers)) == NULL) {
+        return -1;
+    }
+    if (posix_memalign(&workers_waiters, CQUEUE_CACHELINE_SIZE,
+                       nb_workers * sizeof *context->workers_waiters) != 0) {
+        free(context->workers);
+        context->workers = NULL;
         return -1;
     }
-    context->thr_workers = thr_workers;    
-    unsigned int t = nb_workers;
+    context->workers_waiters = workers_waiters;
+    lane_queued_ops = app_context.max_queued_writes / nb_workers;
+    if (lane_queued_ops < LANE_MIN_QUEUED_OPS) {
+        lane_queued_ops = LANE_MIN_QUEUED_OPS;
+    }
+    for (t = 0U; t < nb_workers; t++) {
+        worker = &context->workers[t];
+        init_cqueue_waiters(&context->workers_waiters[t]);
+        worker->context = context;
+        worker->waiters = &context->workers_waiters[t];
+        worker->has_pending_barrier = 0;
+        worker->has_carry_op = 0;
+        worker->sched_slot = 0U;
+        if ((worker->write_batch =
+             calloc(app_context.write_batch_size,
+                    sizeof *worker->write_batch)) == NULL ||
+            (worker->write_batch_rets =
+             calloc(app_context.write_batch_size,
+                    sizeof *worker->write_batch_rets)) == NULL) {
+            return -1;
+        }
+        if ((worker->lane = malloc(sizeof *worker->lane)) == NULL ||
+            init_cqueue_with_reserve(worker->lane, lane_queued_ops,
+                                     LANE_RESERVED_OPS,
+                                     sizeof(Op)) != 0) {
+            free(worker->lane);
+            worker->lane = NULL;
+            return -1;
+        }
+        set_cqueue_consumers(worker->lane, worker->waiters, (size_t) 1U);
+    }
+    set_cqueue_consumers(context->cqueue, context->workers_waiters,
+                         (size_t) nb_workers);
+    set_cqueue_consumers(context->reads_cqueue, context->workers_waiters,
+                         (size_t) nb_workers);
+    
+    return 0;
+}
+
+static void free_workers(HttpHandlerContext * const context)
+{
+    unsigned int t;
+    
+    if (context->workers == NULL) {
+        return;
+    }
+    t = app_context.nb_workers;
     while (t-- > 0U) {
-        pthread_create(&thr_workers[t], NULL, worker_thread, context);
+        free_cqueue(context->workers[t].lane);
+        free(context->workers[t].write_batch);
+        free(context->workers[t].write_batch_rets);
+        free_cqueue_waiters(&context->workers_waiters[t]);
+    }
+    free(context->workers);
+    context->workers = NULL;
+    free(context->workers_waiters);
+    context->workers_waiters = NULL;
+}
+
+int start_workers(HttpHandlerContext * const context)
+{
+    Worker * const workers = context->workers;
+    
+    assert(context->workers_started == 0);
+    context->should_exit = 0;
+    context->nb_active_workers = app_context.nb_workers;
+    context->workers_started = 1;
+    context->lanes_enabled = 1;
+    unsigned int t = app_context.nb_workers;
+    while (t-- > 0U) {
+        pthread_create(&workers[t].thr, NULL, worker_thread, &workers[t]);
+        if (pin_thread_to_cpu_set(workers[t].thr, &app_context.workers_cpus,
+                                  (size_t) t) != 0) {
+            logfile(context, LOG_WARNING,
+                    "Unable to set the CPU affinity of worker %u", t);
+        }
     }
     return 0;
 }
 
 int stop_workers(HttpHandlerContext * const context)
 {
-    pthread_t * const thr_workers = context->thr_workers;
+    Worker * const workers = context->workers;
+    unsigned int t;
+    
+    if (context->workers_started == 0) {
+        return 0;
+    }
     context->should_exit = 1;
-    context->thr_workers = thr_workers;    
-    pthread_cond_broadcast(&context->cond_cqueue);
-    unsigned int t = app_context.nb_workers;
+    t = app_context.nb_workers;
+    while (t-- > 0U) {
+        wake_cqueue_waiters(workers[t].waiters, 1);
+    }
+    while (__atomic_load_n(&context->nb_active_workers,
+                           __ATOMIC_SEQ_CST) > 0U) {
+        if (current_loop == NULL ||
+            consume_op_replies(current_loop) == (size_t) 0U) {
+            usleep(1000U);
+        }
+    }
+    if (current_loop != NULL) {
+        consume_op_replies(current_loop);
+    }
+    t = app_context.nb_workers;
     while (t-- > 0U) {
-        pthread_join(thr_workers[t], NULL);
+        pthread_join(workers[t].thr, NULL);
     }
-    free(thr_workers);
-    context->thr_workers = NULL;
+    context->workers_started = 0;
     
     return 0;
 }
@@ -481,7 +1006,9 @@ static void flush_log_db(evutil_socket_t fd, short event,
     
     (void) event;
     (void) fd;
+    pthread_mutex_lock(&context->mtx_db_log);
     flush_db_log(1);
+    pthread_mutex_unlock(&context->mtx_db_log);
     struct timeval tv = {
         .tv_sec = app_context.db_log.fsync_period,
         .tv_usec = 0L
@@ -489,6 +1016,29 @@ static void flush_log_db(evutil_socket_t fd, short event,
     evtimer_add(&context->ev_flush_log_db, &tv);
 }
 
+static int dispatch_expiration_op(HttpHandlerContext * const context)
+{
+    Op op;
+    SystemExpireOp * const expire_op = &op.system_expire_op;
+    
+    if (__atomic_exchange_n(&context->expiration_op_pending, 1,
+                            __ATOMIC_SEQ_CST) != 0) {
+        return 0;
+    }
+    *expire_op = (SystemExpireOp) {
+        .type = OP_TYPE_SYSTEM_EXPIRE,
+        .req = NULL,
+        .fake_req = 1,
+        .op_tid = next_op_tid(context)
+    };
+    if (dispatch_op(context, &op) != 0) {
+        __atomic_store_n(&context->expiration_op_pending, 0,
+                         __ATOMIC_SEQ_CST);
+        return -1;
+    }
+    return 0;
+}
+
 static void expiration_cron(evutil_socket_t fd, short event,
                             void * const context_)
 {
@@ -504,21 +1054,19 @@ static void expiration_cron(evutil_socket_t fd, short event,
         .tv_usec = 0L
     };
 #if SPREAD_EXPIRATION
-    const int ret = purge_expired_keys(context);
-    if (ret != 0 && context->nb_layers > (size_t) 1U) {
+    if (__atomic_load_n(&context->expiration_did_purge,
+                        __ATOMIC_SEQ_CST) != 0 &&
+        context->nb_layers > (size_t) 1U) {
         const long required_usec = 1000000L / (long) context->nb_layers;
-        if (required_usec < 10000L) {
-            while (purge_expired_keys(context) > 0);
-        } else {
+        if (required_usec >= 10000L) {
             tv = (struct timeval) {
                 .tv_sec = 0L,
                 .tv_usec = required_usec
             };
         }
     }
-#else
-    purge_expired_keys(context);
 #endif
+    dispatch_expiration_op(context);
     evtimer_add(&context->ev_expiration_cron, &tv);
 }
 
@@ -563,19 +1111,257 @@ static int close_log_file(HttpHandlerContext * const context)
     return 0;
 }
 
+static int init_http_loop(HttpHandlerContext * const context,
+                          HttpLoop * const loop,
+                          struct event_base * const loop_event_base)
+{
+    loop->context = context;
+    loop->event_base = loop_event_base;
+    loop->event_http = NULL;
+    loop->replies_notification_fds[0] = loop->replies_notification_fds[1] = -1;
+    if ((loop->replies_cqueue = malloc(sizeof *loop->replies_cqueue)) == NULL) {
+        return -1;
+    }
+    if (init_cqueue(loop->replies_cqueue, app_context.max_queued_replies,
+                    sizeof(OpReply *)) != 0) {
+        free(loop->replies_cqueue);
+        loop->replies_cqueue = NULL;
+        return -1;
+    }
+    if (loop_event_base == NULL || init_replies_notification(loop) != 0) {
+        return -1;
+    }
+    event_assign(&loop->ev_replies, loop_event_base,
+                 loop->replies_notification_fds[0],
+                 EV_READ | EV_PERSIST, consumer_cb, loop);
+    event_add(&loop->ev_replies, NULL);
+    if ((loop->event_http = evhttp_new(loop_event_base)) == NULL) {
+        return -1;
+    }
+    evhttp_set_timeout(loop->event_http, app_context.timeout);
+    evhttp_set_gencb(loop->event_http, http_dispatcher_cb, context);
+    
+    return 0;
+}
+
+static void free_http_loop(HttpLoop * const loop)
+{
+    if (loop->replies_notification_fds[0] != -1) {
+        event_del(&loop->ev_replies);
+    }
+    if (loop->event_http != NULL) {
+        evhttp_free(loop->event_http);
+        loop->event_http = NULL;
+    }
+    free_cqueue(loop->replies_cqueue);
+    loop->replies_cqueue = NULL;
+    free_replies_notification(loop);
+}
+
+static int init_http_loops(HttpHandlerContext * const context)
+{
+    HttpLoop *loop;
+    unsigned int nb_loops = app_context.nb_event_loops;
+    unsigned int t;
+    
+    if (nb_loops > 1U && app_context.replication_master_ip != NULL) {
+        logfile(context, LOG_WARNING,
+                "Replication master enabled - using a single event loop");
+        nb_loops = 1U;
+    }
+    if ((context->loops = calloc(nb_loops, sizeof *context->loops)) == NULL) {
+        return -1;
+    }
+    context->nb_loops = nb_loops;
+    for (t = 0U; t < nb_loops; t++) {
+        loop = &context->loops[t];
+        loop->replies_notification_fds[0] =
+            loop->replies_notification_fds[1] = -1;
+    }
+    for (t = 0U; t < nb_loops; t++) {
+        loop = &context->loops[t];
+        if (init_http_loop(context, loop,
+                           t == 0U ? context->event_base :
+                           event_base_new()) != 0) {
+            return -1;
+        }
+    }
+    current_loop = &context->loops[0];
+    context->loops[0].thr = pthread_self();
+    
+    return 0;
+}
+
+static void free_http_loops(HttpHandlerContext * const context)
+{
+    HttpLoop *loop;
+    unsigned int t;
+    
+    if (context->loops == NULL) {
+        return;
+    }
+    t = context->nb_loops;
+    while (t-- > 0U) {
+        loop = &context->loops[t];
+        free_http_loop(loop);
+        if (t > 0U && loop->event_base != NULL) {
+            event_base_free(loop->event_base);
+        }
+    }
+    free(context->loops);
+    context->loops = NULL;
+    context->nb_loops = 0U;
+    current_loop = NULL;
+}
+
+static evutil_socket_t open_listening_socket(const char * const ip,
+                                             const char * const port)
+{
+    struct evutil_addrinfo hints;
+    struct evutil_addrinfo *ai;
+    evutil_socket_t fd;
+    
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = EVUTIL_AI_PASSIVE | EVUTIL_AI_ADDRCONFIG;
+    if (evutil_getaddrinfo(ip, port, &hints, &ai) != 0) {
+        return -1;
+    }
+    if ((fd = socket(ai->ai_family, SOCK_STREAM, IPPROTO_TCP)) == -1) {
+        evutil_freeaddrinfo(ai);
+        return -1;
+    }
+#ifdef SO_REUSEPORT
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof on);
+#endif
+    if (evutil_make_socket_nonblocking(fd) != 0 ||
+        evutil_make_listen_socket_reuseable(fd) != 0 ||
+        bind(fd, ai->ai_addr, ai->ai_addrlen) != 0 ||
+        listen(fd, LISTEN_BACKLOG) != 0) {
+        evutil_closesocket(fd);
+        evutil_freeaddrinfo(ai);
+        return -1;
+    }
+    evutil_freeaddrinfo(ai);
+    
+    return fd;
+}
+
+static int bind_http_loops(HttpHandlerContext * const context)
+{
+    evutil_socket_t fd = -1;
+    unsigned int t;
+    
+    if (context->nb_loops == 1U) {
+        return evhttp_bind_socket(context->loops[0].event_http,
+                                  app_context.server_ip,
+                                  (unsigned short)
+                                  strtoul(app_context.server_port, NULL, 10));
+    }
+    for (t = 0U; t < context->nb_loops; t++) {
+#ifdef SO_REUSEPORT
+        fd = open_listening_socket(app_context.server_ip,
+                                   app_context.server_port);
+#else
+        if (t == 0U) {
+            fd = open_listening_socket(app_context.server_ip,
+                                       app_context.server_port);
+        } else {
+            fd = dup(fd);
+        }
+#endif
+        if (fd == -1) {
+            return -1;
+        }
+        if (evhttp_accept_socket(context->loops[t].event_http, fd) != 0) {
+            evutil_closesocket(fd);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void *http_loop_thread(void *loop_)
+{
+    HttpLoop * const loop = loop_;
+    sigset_t sigs;
+    
+    sigfillset(&sigs);
+    pthread_sigmask(SIG_BLOCK, &sigs, NULL);
+    current_loop = loop;
+    event_base_dispatch(loop->event_base);
+    current_loop = NULL;
+    
+    return NULL;
+}
+
+static void stop_http_loops(HttpHandlerContext * const context)
+{
+    HttpLoop *loop;
+    unsigned int t;
+    
+    t = context->nb_loops;
+    while (t-- > 1U) {
+        loop = &context->loops[t];
+        if (loop->running == 0) {
+            continue;
+        }
+        event_base_loopbreak(loop->event_base);
+        pthread_join(loop->thr, NULL);
+        loop->running = 0;
+        consume_op_replies(loop);
+    }
+}
+
+static int start_http_loops(HttpHandlerContext * const context)
+{
+    HttpLoop *loop;
+    unsigned int t;
+    
+    for (t = 1U; t < context->nb_loops; t++) {
+        loop = &context->loops[t];
+        if (pthread_create(&loop->thr, NULL, http_loop_thread, loop) != 0) {
+            stop_http_loops(context);
+            return -1;
+        }
+        loop->running = 1;
+        if (pin_thread_to_cpu_set(loop->thr, &app_context.event_loops_cpus,
+                                  (size_t) t) != 0) {
+            logfile(context, LOG_WARNING,
+                    "Unable to set the CPU affinity of event loop %u", t);
+        }
+    }
+    if (pin_thread_to_cpu_set(pthread_self(), &app_context.event_loops_cpus,
+                              (size_t) 0U) != 0) {
+        logfile_noformat(context, LOG_WARNING,
+                         "Unable to set the CPU affinity of the main loop");
+    }
+    return 0;
+}
+
 int http_server(void)
 {
     HttpHandlerContext http_handler_context = {
         .should_exit = 0,
-        .thr_workers = NULL,
+        .workers = NULL,
+        .workers_waiters = NULL,
+        .workers_started = 0,
+        .lanes_enabled = 0,
+        .bulk_load_layers = 0,
         .event_base = NULL,
         .op_tid = (OpTID) 0U,
         .encoded_api_base_uri = NULL,
         .encoded_public_base_uri = NULL,
         .cqueue = NULL,
-        .publisher_bev = NULL,
-        .consumer_bev = NULL,
+        .reads_cqueue = NULL,
+        .loops = NULL,
+        .nb_loops = 0U,
+        .nb_active_workers = 0U,
         .nb_layers = (size_t) 0U,
+        .expiration_op_pending = 0,
+        .expiration_did_purge = 0,
         .log_file_name = NULL,
         .log_fd = -1,
         .rm_context = NULL,
@@ -590,26 +1376,33 @@ int http_server(void)
     }
     logfile_noformat(&http_handler_context, LOG_INFO,
                      PACKAGE_STRING " started.");
-    struct evhttp *event_http;
-    struct bufferevent *bev_pair[2];
     set_signals();
     if (init_slab(&http_handler_context.layers_slab,
                   sizeof(Layer), "layers") != 0) {
         return -1;
     }
-    if (init_slab(&http_handler_context.expirables_slab,
-                  sizeof(Expirable), "expirables") != 0) {
-        return -1;
-    }
     http_handler_context.cqueue = malloc(sizeof *http_handler_context.cqueue);
     if (http_handler_context.cqueue == NULL ||
         init_cqueue(http_handler_context.cqueue,
                     app_context.max_queued_replies, sizeof(Op)) != 0) {
         return -1;
     }
-    pthread_mutex_init(&http_handler_context.mtx_cqueue, NULL);
-    pthread_cond_init(&http_handler_context.cond_cqueue, NULL);
-    pthread_rwlock_init(&http_handler_context.rwlock_layers, NULL);
+    http_handler_context.reads_cqueue =
+        malloc(sizeof *http_handler_context.reads_cqueue);
+    if (http_handler_context.reads_cqueue == NULL ||
+        init_cqueue(http_handler_context.reads_cqueue,
+                    app_context.max_queued_reads, sizeof(Op)) != 0) {
+        return -1;
+    }
+    if (init_workers(&http_handler_context) != 0) {
+        return -1;
+    }
+    pthread_mutex_init(&http_handler_context.mtx_lanes_barrier, NULL);
+    pthread_mutex_init(&http_handler_context.mtx_db_log, NULL);
+    pthread_mutex_init(&http_handler_context.mtx_journal_rewrite, NULL);
+    if (init_prwlock(&http_handler_context.rwlock_layers) != 0) {
+        return -1;
+    }
     http_handler_context.encoded_api_base_uri = ENCODED_API_BASE_URI;
     http_handler_context.encoded_api_base_uri_len =
         strlen(http_handler_context.encoded_api_base_uri);
@@ -619,27 +1412,14 @@ int http_server(void)
     evthread_use_pthreads();
     event_base = event_base_new();
     http_handler_context.event_base = event_base;
-    if (bufferevent_pair_new(event_base,
-                             BEV_OPT_CLOSE_ON_FREE |
-                             BEV_OPT_THREADSAFE |
-                             BEV_OPT_DEFER_CALLBACKS, bev_pair) != 0) {
-        return -1;
+    if (init_http_loops(&http_handler_context) != 0) {
+        logfile_error(&http_handler_context, "Unable to set up event loops");
+        goto bye;
+    }
+    if (bind_http_loops(&http_handler_context) != 0) {
+        logfile_error(&http_handler_context, "Unable to listen");
+        goto bye;
     }
-    bufferevent_enable(bev_pair[0], EV_READ);
-    bufferevent_disable(bev_pair[1], EV_READ);
-    bufferevent_setwatermark(bev_pair[0], EV_READ, sizeof(struct OpReply *),
-                             sizeof(struct OpReply *) * (size_t) 100U);
-    http_handler_context.consumer_bev = bev_pair[0];
-    http_handler_context.publisher_bev = bev_pair[1];    
-    event_http = evhttp_new(event_base);
-    evhttp_bind_socket(event_http,
-                       app_context.server_ip,
-                       (unsigned short) strtoul(app_context.server_port,
-                                                NULL, 10));
-    evhttp_set_timeout(event_http, app_context.timeout);
-    evhttp_set_gencb(event_http, http_dispatcher_cb, &http_handler_context);
-    bufferevent_setcb(http_handler_context.consumer_bev,
-                      consumer_cb, NULL, NULL, &http_handler_context);
     if (app_context.db_log.fsync_period > 0) {
         evtimer_assign(&http_handler_context.ev_flush_log_db, event_base,
                        flush_log_db, &http_handler_context);
@@ -676,10 +1456,13 @@ int http_server(void)
         .tv_usec = 0L
     };
     evtimer_add(&http_handler_context.ev_expiration_cron, &tv);
-    
-    event_base_dispatch(event_base);
-    
+    if (start_http_loops(&http_handler_context) != 0) {
+        logfile_error(&http_handler_context, "Unable to start event loops");
+    } else {
+        event_base_dispatch(event_base);
+    }
     stop_workers(&http_handler_context);
+    stop_http_loops(&http_handler_context);
     if (app_context.db_log.fsync_period > 0) {
         evtimer_del(&http_handler_context.ev_flush_log_db);
     }
@@ -687,17 +1470,16 @@ int http_server(void)
 bye:
     stop_replication_master(&http_handler_context);    
     stop_replication_slave(&http_handler_context);        
-    bufferevent_free(http_handler_context.publisher_bev);
-    bufferevent_free(http_handler_context.consumer_bev);
-    evhttp_free(event_http);
+    free_http_loops(&http_handler_context);
     event_base_free(event_base);
+    free_workers(&http_handler_context);
+    pthread_mutex_destroy(&http_handler_context.mtx_lanes_barrier);
+    pthread_mutex_destroy(&http_handler_context.mtx_db_log);
+    pthread_mutex_destroy(&http_handler_context.mtx_journal_rewrite);
     free_cqueue(http_handler_context.cqueue);
-    pthread_cond_destroy(&http_handler_context.cond_cqueue);
-    pthread_mutex_destroy(&http_handler_context.mtx_cqueue);
-    pthread_rwlock_destroy(&http_handler_context.rwlock_layers);
+    free_cqueue(http_handler_context.reads_cqueue);
+    free_prwlock(&http_handler_context.rwlock_layers);
     free_slab(&http_handler_context.layers_slab, free_layer_slab_entry_cb);
-    free_slab(&http_handler_context.expirables_slab,
-              free_expirables_slab_entry_cb);
     close_log_file(&http_handler_context);
     app_context.http_handler_context = NULL;
     
@@ -16,6 +16,15 @@
 #ifndef MAX_URI_LEN
 # define MAX_URI_LEN (size_t) 10000U
 #endif
+#ifndef LISTEN_BACKLOG
+# define LISTEN_BACKLOG 128
+#endif
+#ifndef LANE_MIN_QUEUED_OPS
+# define LANE_MIN_QUEUED_OPS (size_t) 64U
+#endif
+#ifndef LANE_RESERVED_OPS
+# define LANE_RESERVED_OPS (size_t) 64U
+#endif
 #ifndef BEAUTIFY_JSON
 # ifdef DEBUG
 #  define BEAUTIFY_JSON 1
@@ -30,6 +39,7 @@ typedef enum OpType_ {
         
     OP_TYPE_SYSTEM_PING,
     OP_TYPE_SYSTEM_REWRITE,        
+    OP_TYPE_SYSTEM_EXPIRE,
         
     OP_TYPE_LAYERS_CREATE,
     OP_TYPE_LAYERS_DELETE,
@@ -38,14 +48,27 @@ typedef enum OpType_ {
     OP_TYPE_RECORDS_PUT,
     OP_TYPE_RECORDS_GET,
     OP_TYPE_RECORDS_DELETE,        
+    OP_TYPE_RECORDS_IMPORT,
         
     OP_TYPE_SEARCH_NEARBY,
+    OP_TYPE_SEARCH_NEAREST,
     OP_TYPE_SEARCH_IN_RECT,
+    OP_TYPE_SEARCH_GRID,
+    OP_TYPE_SEARCH_IN_POLYGON,
+    OP_TYPE_SEARCH_CONTAINING,
     OP_TYPE_SEARCH_IN_KEYS,
+        
+    OP_TYPE_PUBLIC_GET,
 } OpType;
 
 typedef uint_fast64_t OpTID;
 
+typedef struct LaneBarrier_ {
+    unsigned int nb_pending;
+    unsigned int nb_refs;
+    int done;
+} LaneBarrier;
+
 typedef struct BareOp_ {
     OpType type;
     struct evhttp_request *req;
@@ -67,12 +90,21 @@ typedef struct SystemRewriteOp_ {
     OpTID op_tid;    
 } SystemRewriteOp;
 
+typedef struct SystemExpireOp_ {
+    OpType type;
+    struct evhttp_request *req;
+    _Bool fake_req;    
+    OpTID op_tid;    
+} SystemExpireOp;
+
 typedef struct LayersCreateOp_ {
     OpType type;
     struct evhttp_request *req;
     _Bool fake_req;    
     OpTID op_tid;
     Key *layer_name;
+    IndexType index_type;
+    LaneBarrier *barrier;
 } LayersCreateOp;
 
 typedef struct LayersDeleteOp_ {
@@ -81,6 +113,7 @@ typedef struct LayersDeleteOp_ {
     _Bool fake_req;    
     OpTID op_tid;
     Key *layer_name;
+    LaneBarrier *barrier;
 } LayersDeleteOp;
 
 typedef struct LayersIndexOp_ {
@@ -98,10 +131,13 @@ typedef struct RecordsPutOp_ {
     OpTID op_tid;
     Key *layer_name;    
     Key *key;    
-    Position2D position;
+    SlotPosition position;
     SlipMap *properties;
     SlipMap *special_properties;    
+    Position2D *polygon_vertices;
+    NbSlots polygon_nb_vertices;
     _Bool position_set;
+    _Bool polygon_set;
     time_t expires_at;
 } RecordsPutOp;
 
@@ -124,6 +160,17 @@ typedef struct RecordsDeleteOp_ {
     Key *key;    
 } RecordsDeleteOp;
 
+typedef struct RecordsImportOp_ {
+    OpType type;
+    struct evhttp_request *req;
+    _Bool fake_req;    
+    OpTID op_tid;
+    Key *layer_name;
+    RecordsPutOp *put_ops;
+    size_t nb_put_ops;
+    LaneBarrier *barrier;
+} RecordsImportOp;
+
 typedef struct SearchNearbyOp_ {
     OpType type;
     struct evhttp_request *req;
@@ -136,8 +183,23 @@ typedef struct SearchNearbyOp_ {
     Dimension epsilon;
     _Bool with_properties;
     _Bool with_links;    
+    _Bool sort_by_distance;
+    _Bool count_only;
 } SearchNearbyOp;
 
+typedef struct SearchNearestOp_ {
+    OpType type;
+    struct evhttp_request *req;
+    _Bool fake_req;    
+    OpTID op_tid;
+    Key *layer_name;    
+    Position2D position;
+    Dimension max_distance;
+    SubSlots limit;
+    _Bool with_properties;
+    _Bool with_links;    
+} SearchNearestOp;
+
 typedef struct SearchInRectOp_ {
     OpType type;
     struct evhttp_request *req;
@@ -149,8 +211,46 @@ typedef struct SearchInRectOp_ {
     Dimension epsilon;
     _Bool with_properties;
     _Bool with_links;    
+    _Bool count_only;
 } SearchInRectOp;
 
+typedef struct SearchGridOp_ {
+    OpType type;
+    struct evhttp_request *req;
+    _Bool fake_req;    
+    OpTID op_tid;
+    Key *layer_name;
+    Key *sum_property;
+    Rectangle2D rect;
+    NbSlots cols;
+    NbSlots rows;
+} SearchGridOp;
+
+typedef struct SearchInPolygonOp_ {
+    OpType type;
+    struct evhttp_request *req;
+    _Bool fake_req;    
+    OpTID op_tid;
+    Key *layer_name;
+    Position2D *vertices;
+    NbSlots nb_vertices;
+    SubSlots limit;
+    _Bool with_properties;
+    _Bool with_links;    
+} SearchInPolygonOp;
+
+typedef struct SearchContainingOp_ {
+    OpType type;
+    struct evhttp_request *req;
+    _Bool fake_req;    
+    OpTID op_tid;
+    Key *layer_name;
+    Position2D position;
+    SubSlots limit;
+    _Bool with_properties;
+    _Bool with_links;    
+} SearchContainingOp;
+
 typedef struct SearchInKeysOp_ {
     OpType type;
     struct evhttp_request *req;
@@ -164,19 +264,35 @@ typedef struct SearchInKeysOp_ {
     _Bool with_links;    
 } SearchInKeysOp;
 
+typedef struct PublicGetOp_ {
+    OpType type;
+    struct evhttp_request *req;
+    _Bool fake_req;    
+    OpTID op_tid;
+    Key *layer_name;
+    Key *key;
+} PublicGetOp;
+
 typedef union Op_ {
     BareOp          bare_op;
     SystemPingOp    system_ping_op;
     SystemRewriteOp system_rewrite_op;    
+    SystemExpireOp  system_expire_op;
     LayersCreateOp  layers_create_op;
     LayersDeleteOp  layers_delete_op;
     LayersIndexOp   layers_index_op;
     RecordsPutOp    records_put_op;
     RecordsGetOp    records_get_op;
     RecordsDeleteOp records_delete_op;    
+    RecordsImportOp records_import_op;
     SearchNearbyOp  search_nearby_op;
+    SearchNearestOp search_nearest_op;
     SearchInRectOp  search_in_rect_op;
+    SearchGridOp    search_grid_op;
+    SearchInPolygonOp search_in_polygon_op;
+    SearchContainingOp search_containing_op;
     SearchInKeysOp  search_in_keys_op;
+    PublicGetOp     public_get_op;
 } Op;
 
 typedef struct BareOpReply_ {
@@ -249,6 +365,13 @@ typedef struct RecordsDeleteOpReply_ {
     yajl_gen json_gen;
 } RecordsDeleteOpReply;
 
+typedef struct RecordsImportOpReply_ {
+    OpType type;
+    struct evhttp_request *req;
+    OpTID op_tid;
+    yajl_gen json_gen;
+} RecordsImportOpReply;
+
 typedef struct SearchNearbyOpReply_ {
     OpType type;
     struct evhttp_request *req;
@@ -256,6 +379,13 @@ typedef struct SearchNearbyOpReply_ {
     yajl_gen json_gen;
 } SearchNearbyOpReply;
 
+typedef struct SearchNearestOpReply_ {
+    OpType type;
+    struct evhttp_request *req;
+    OpTID op_tid;
+    yajl_gen json_gen;
+} SearchNearestOpReply;
+
 typedef struct SearchInRectOpReply_ {
     OpType type;
     struct evhttp_request *req;
@@ -263,6 +393,27 @@ typedef struct SearchInRectOpReply_ {
     yajl_gen json_gen;
 } SearchInRectOpReply;
 
+typedef struct SearchGridOpReply_ {
+    OpType type;
+    struct evhttp_request *req;
+    OpTID op_tid;
+    yajl_gen json_gen;
+} SearchGridOpReply;
+
+typedef struct SearchInPolygonOpReply_ {
+    OpType type;
+    struct evhttp_request *req;
+    OpTID op_tid;
+    yajl_gen json_gen;
+} SearchInPolygonOpReply;
+
+typedef struct SearchContainingOpReply_ {
+    OpType type;
+    struct evhttp_request *req;
+    OpTID op_tid;
+    yajl_gen json_gen;
+} SearchContainingOpReply;
+
 typedef struct SearchInKeysOpReply_ {
     OpType type;
     struct evhttp_request *req;
@@ -270,6 +421,16 @@ typedef struct SearchInKeysOpReply_ {
     yajl_gen json_gen;
 } SearchInKeysOpReply;
 
+typedef struct PublicGetOpReply_ {
+    OpType type;
+    struct evhttp_request *req;
+    OpTID op_tid;
+    yajl_gen json_gen;
+    int status;
+    struct evbuffer *evb;
+    char *content_type;
+} PublicGetOpReply;
+
 typedef union OpReply_ {
     BareOpReply          bare_op_reply;
     ErrorOpReply         error_op_reply;    
@@ -281,9 +442,15 @@ typedef union OpReply_ {
     RecordsPutOpReply    records_put_op_reply;
     RecordsGetOpReply    records_get_op_reply;
     RecordsDeleteOpReply records_delete_op_reply;    
+    RecordsImportOpReply records_import_op_reply;
     SearchNearbyOpReply  search_nearby_op_reply;
+    SearchNearestOpReply search_nearest_op_reply;
     SearchInRectOpReply  search_in_rect_op_reply;
+    SearchGridOpReply    search_grid_op_reply;
+    SearchInPolygonOpReply search_in_polygon_op_reply;
+    SearchContainingOpReply search_containing_op_reply;
     SearchInKeysOpReply  search_in_keys_op_reply;    
+    PublicGetOpReply     public_get_op_reply;
 } OpReply;
 
 typedef struct Layer_ {
@@ -291,9 +458,40 @@ typedef struct Layer_ {
     PanDB pan_db;
 } Layer;
 
+typedef struct HttpLoop_ {
+    struct HttpHandlerContext_ *context;
+    struct event_base *event_base;
+    struct evhttp *event_http;
+    CQueue *replies_cqueue;
+    int replies_notification_fds[2];
+    int replies_notified;
+    struct event ev_replies;
+    pthread_t thr;
+    _Bool running;
+} HttpLoop;
+
+typedef struct Worker_ {
+    struct HttpHandlerContext_ *context;
+    CQueueWaiters *waiters;
+    CQueue *lane;
+    pthread_t thr;
+    Op pending_barrier_op;
+    Op carry_op;
+    Op *write_batch;
+    int *write_batch_rets;
+    unsigned int sched_slot;
+    _Bool has_pending_barrier;
+    _Bool has_carry_op;
+} Worker;
+
 typedef struct HttpHandlerContext_ {
     sig_atomic_t should_exit;
-    pthread_t *thr_workers;
+    Worker *workers;
+    CQueueWaiters *workers_waiters;
+    _Bool workers_started;
+    _Bool lanes_enabled;
+    _Bool bulk_load_layers;
+    pthread_mutex_t mtx_lanes_barrier;
     struct event_base *event_base;
     OpTID op_tid;
     const char *encoded_api_base_uri;
@@ -301,16 +499,19 @@ typedef struct HttpHandlerContext_ {
     const char *encoded_public_base_uri;
     size_t encoded_public_base_uri_len;
     CQueue *cqueue;
-    pthread_mutex_t mtx_cqueue;
-    pthread_cond_t cond_cqueue;
-    pthread_rwlock_t rwlock_layers;
-    struct bufferevent *publisher_bev;
-    struct bufferevent *consumer_bev;
+    CQueue *reads_cqueue;
+    PRWLock rwlock_layers;
+    HttpLoop *loops;
+    unsigned int nb_loops;
+    pthread_mutex_t mtx_db_log;
+    pthread_mutex_t mtx_journal_rewrite;
+    unsigned int nb_active_workers;
     Slab layers_slab;
     size_t nb_layers;
     struct event ev_flush_log_db;
     struct event ev_expiration_cron;
-    Slab expirables_slab;
+    int expiration_op_pending;
+    int expiration_did_purge;
     time_t now;
     char *log_file_name;
     int log_fd;
@@ -321,7 +522,6 @@ typedef struct HttpHandlerContext_ {
 typedef int (*DomainHandler)(struct evhttp_request * const req,
                              HttpHandlerContext * const context,
                              char *uri, char *opts,
-                             _Bool * const write_to_log,
                              const _Bool fake_req);
 
 typedef struct Domain_ {
@@ -333,6 +533,13 @@ int http_server(void);
 
 yajl_gen new_json_gen(const OpReply * const op_reply);
 
+OpTID next_op_tid(HttpHandlerContext * const context);
+
+int dispatch_op(HttpHandlerContext * const context, const Op * const op);
+
+int dispatch_journaled_op(HttpHandlerContext * const context,
+                          const Op * const op);
+
 int send_op_reply(HttpHandlerContext * const context,
                   const OpReply * const op_reply);
 
@@ -3,6 +3,7 @@
 #include "http_server.h"
 #include "key_nodes.h"
 #include "expirables.h"
+#include "polygons.h"
 
 RB_GENERATE(KeyNodes_, KeyNode_, entry, key_node_cmp);
 
@@ -26,6 +27,34 @@ int key_node_cmp(const KeyNode * const kn1, const KeyNode * const kn2)
     return ret;
 }
 
+KeyNode *new_key_node_entry(PanDB * const db,
+                            const KeyNode * const template_key_node)
+{
+#if COMPACT_SLOTS
+    return add_entry_to_pool(&db->key_nodes_pool, template_key_node);
+#else
+    KeyNode *key_node;
+
+    (void) db;
+    if ((key_node = malloc(sizeof *key_node)) == NULL) {
+        return NULL;
+    }
+    *key_node = *template_key_node;
+
+    return key_node;
+#endif
+}
+
+void free_key_node_entry(PanDB * const db, KeyNode * const key_node)
+{
+#if COMPACT_SLOTS
+    remove_entry_from_pool(&db->key_nodes_pool, key_node);
+#else
+    (void) db;
+    free(key_node);
+#endif
+}
+
 int get_key_node_from_key(PanDB * const db, Key * const key,
                           const _Bool create,
                           KeyNode * * const key_node)
@@ -33,6 +62,13 @@ int get_key_node_from_key(PanDB * const db, Key * const key,
     KeyNode *found_key_node;
     KeyNode scanned_key_node = { .key = key };
     KeyNode *new_key_node;
+    const KeyNode template_key_node = {
+        .key = key,
+        .slot = NULL,
+        .polygon = NULL,
+        .properties = NULL,
+        .expirable = NULL
+    };
 
     *key_node = NULL;
     found_key_node = RB_FIND(KeyNodes_, &db->key_nodes, &scanned_key_node);
@@ -43,19 +79,13 @@ int get_key_node_from_key(PanDB * const db, Key * const key,
     if (create == 0) {
         return 0;
     }
-    if ((new_key_node = malloc(sizeof *new_key_node)) == NULL) {
+    if ((new_key_node = new_key_node_entry(db, &template_key_node)) == NULL) {
         return -1;
     }
     retain_key(key);
-    *new_key_node = (KeyNode) {
-        .key = key,
-        .slot = NULL,
-        .properties = NULL,
-        .expirable = NULL
-    };
     if (RB_INSERT(KeyNodes_, &db->key_nodes, new_key_node) != NULL) {
         release_key(key);
-        free(new_key_node);
+        free_key_node_entry(db, new_key_node);
         return -1;
     }
     *key_node = new_key_node;
@@ -73,13 +103,16 @@ void free_key_node(PanDB * const db, KeyNode * const key_node)
     key_node->key = NULL;
     free_slip_map(&key_node->properties);
     key_node->properties = NULL;
-    HttpHandlerContext * context = db->context;
+    if (key_node->polygon != NULL) {
+        remove_polygon(db, key_node->polygon);
+        key_node->polygon = NULL;
+    }
     if (key_node->expirable != NULL) {
         remove_expirable_from_tree(db, key_node->expirable);        
-        remove_entry_from_slab(&context->expirables_slab, key_node->expirable);
+        remove_entry_from_slab(&db->expirables_slab, key_node->expirable);
         key_node->expirable = NULL;
     }
-    free(key_node);
+    free_key_node_entry(db, key_node);
 }
 
 SubSlots count_key_nodes(const KeyNodes * const key_nodes_)
@@ -6,6 +6,11 @@ RB_PROTOTYPE(KeyNodes_, KeyNode_, entry, key_node_cmp);
 
 int key_node_cmp(const KeyNode * const kn1, const KeyNode * const kn2);
 
+KeyNode *new_key_node_entry(PanDB * const db,
+                            const KeyNode * const template_key_node);
+
+void free_key_node_entry(PanDB * const db, KeyNode * const key_node);
+
 int get_key_node_from_key(PanDB * const db, Key * const key,
                           const _Bool create,
                           KeyNode * * const key_node);
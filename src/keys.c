@@ -115,3 +115,16 @@ Key *new_key_with_leading_zero(const void * const val, const size_t len)
     
     return key;    
 }
+
+uint32_t hash_key(const Key * const key, const uint32_t seed)
+{
+    const unsigned char *pnt = (const unsigned char *) key->val;
+    size_t len = key->len;
+    uint32_t h = seed;
+
+    while (len-- > (size_t) 0U) {
+        h ^= (uint32_t) *pnt++;
+        h *= 16777619U;
+    }
+    return h;
+}
@@ -2,6 +2,10 @@
 #ifndef __KEYS_H__
 #define __KEYS_H__ 1
 
+#ifndef KEY_HASH_SEED
+# define KEY_HASH_SEED 2166136261U
+#endif
+
 typedef struct Key_ {
     size_t len;
     unsigned int ref_count;
@@ -16,5 +20,6 @@ Key *new_key(const void * const val, const size_t len);
 Key *new_key_from_c_string(const char *ckey);
 Key *new_key_from_uri_encoded_c_string(const char * const uckey);
 Key *new_key_with_leading_zero(const void * const val, const size_t len);
+uint32_t hash_key(const Key * const key, const uint32_t seed);
 
 #endif
@@ -0,0 +1,896 @@
+
+#include "common.h"
+#include "morton.h"
+
+#define MORTON_EVEN_BITS 0x5555555555555555ULL
+#define MORTON_ODD_BITS  0xaaaaaaaaaaaaaaaaULL
+
+typedef struct MortonBox_ {
+    uint64_t zmin;
+    uint64_t zmax;
+} MortonBox;
+
+typedef struct MortonBatch_ {
+    const PanDB *db;
+    Dimension latitudes[DISTANCES_BATCH_SIZE];
+    Dimension longitudes[DISTANCES_BATCH_SIZE];
+    Slot *slots[DISTANCES_BATCH_SIZE];
+    NbSlots count;
+    MortonScanCB cb;
+    void *context_cb;
+} MortonBatch;
+
+int init_morton_index(PanDB * const db)
+{
+    MortonIndex * const morton = &db->morton;
+
+    morton->nb_runs = 0U;
+    morton->pending = NULL;
+    morton->nb_pending = (NbSlots) 0U;
+
+    return 0;
+}
+
+void free_morton_index(PanDB * const db)
+{
+    MortonIndex * const morton = &db->morton;
+    unsigned int t;
+
+    for (t = 0U; t < morton->nb_runs; t++) {
+        free(morton->runs[t].entries);
+    }
+    free(morton->pending);
+    init_morton_index(db);
+}
+
+static uint64_t spread_bits(const uint32_t value)
+{
+    uint64_t x = (uint64_t) value;
+
+    x = (x | (x << 16)) & 0x0000ffff0000ffffULL;
+    x = (x | (x << 8)) & 0x00ff00ff00ff00ffULL;
+    x = (x | (x << 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    x = (x | (x << 2)) & 0x3333333333333333ULL;
+    x = (x | (x << 1)) & 0x5555555555555555ULL;
+
+    return x;
+}
+
+static uint32_t compact_bits(const uint64_t value)
+{
+    uint64_t x = value & MORTON_EVEN_BITS;
+
+    x = (x | (x >> 1)) & 0x3333333333333333ULL;
+    x = (x | (x >> 2)) & 0x0f0f0f0f0f0f0f0fULL;
+    x = (x | (x >> 4)) & 0x00ff00ff00ff00ffULL;
+    x = (x | (x >> 8)) & 0x0000ffff0000ffffULL;
+    x = (x | (x >> 16)) & 0x00000000ffffffffULL;
+
+    return (uint32_t) x;
+}
+
+static uint32_t quantize_dimension(const double d,
+                                   const Dimension d0, const Dimension d1)
+{
+    const double q = floor((d - (double) d0) /
+                           ((double) d1 - (double) d0) * 4294967296.0);
+
+    if (!(q > 0.0)) {
+        return 0U;
+    }
+    if (q >= 4294967295.0) {
+        return UINT32_MAX;
+    }
+    return (uint32_t) q;
+}
+
+static uint64_t morton_code_for(const PanDB * const db,
+                                const double latitude, const double longitude)
+{
+    const Rectangle2D * const qbounds = &db->qbounds;
+    const uint32_t x = quantize_dimension(longitude,
+                                          qbounds->edge0.longitude,
+                                          qbounds->edge1.longitude);
+    const uint32_t y = quantize_dimension(latitude,
+                                          qbounds->edge0.latitude,
+                                          qbounds->edge1.latitude);
+
+    return spread_bits(x) | (spread_bits(y) << 1);
+}
+
+static uint64_t morton_code(const PanDB * const db,
+                            const Position2D * const position)
+{
+    return morton_code_for(db, (double) position->latitude,
+                           (double) position->longitude);
+}
+
+static uint64_t slot_morton_code(const PanDB * const db,
+                                 const SlotPosition * const position)
+{
+    return morton_code_for(db, SLOT_DIMENSION(position->latitude),
+                           SLOT_DIMENSION(position->longitude));
+}
+
+#if COMPACT_SLOTS
+// Morton cells are narrower than a fixed-point unit, so the centre of a
+// cell rounds back to the exact fixed-point coordinate of its slot.
+
+static Dimension decode_dimension(const uint32_t q,
+                                  const Dimension d0, const Dimension d1)
+{
+    const double d = (double) d0 + ((double) q + 0.5) / 4294967296.0 *
+        ((double) d1 - (double) d0);
+
+    return (Dimension) SLOT_DIMENSION(lrint(d * FIXED_DIMENSION_SCALE));
+}
+#endif
+
+static Position2D morton_entry_position(const PanDB * const db,
+                                        const MortonEntry * const entry)
+{
+#if COMPACT_SLOTS
+    const Rectangle2D * const qbounds = &db->qbounds;
+
+    return (Position2D) {
+        .latitude = decode_dimension(compact_bits(entry->code >> 1),
+                                     qbounds->edge0.latitude,
+                                     qbounds->edge1.latitude),
+        .longitude = decode_dimension(compact_bits(entry->code),
+                                      qbounds->edge0.longitude,
+                                      qbounds->edge1.longitude)
+    };
+#else
+    (void) db;
+    return entry->position;
+#endif
+}
+
+static MortonBox morton_box(const PanDB * const db,
+                            const Rectangle2D * const rect)
+{
+#if COMPACT_SLOTS
+    // Codes are computed from fixed-point positions, that can round to a
+    // float lying on the edge of the rectangle: widen the box by one step,
+    // callbacks filter positions against the rectangle anyway.
+    return (MortonBox) {
+        .zmin = morton_code_for(db,
+                                nextafterf(rect->edge0.latitude, -HUGE_VALF),
+                                nextafterf(rect->edge0.longitude, -HUGE_VALF)),
+        .zmax = morton_code_for(db,
+                                nextafterf(rect->edge1.latitude, HUGE_VALF),
+                                nextafterf(rect->edge1.longitude, HUGE_VALF))
+    };
+#else
+    return (MortonBox) {
+        .zmin = morton_code(db, &rect->edge0),
+        .zmax = morton_code(db, &rect->edge1)
+    };
+#endif
+}
+
+static int code_is_in_box(const uint64_t code, const MortonBox * const box)
+{
+    const uint64_t x = code & MORTON_EVEN_BITS;
+    const uint64_t y = code & MORTON_ODD_BITS;
+
+    return x >= (box->zmin & MORTON_EVEN_BITS) &&
+        x <= (box->zmax & MORTON_EVEN_BITS) &&
+        y >= (box->zmin & MORTON_ODD_BITS) &&
+        y <= (box->zmax & MORTON_ODD_BITS);
+}
+
+static uint64_t load_bits(const uint64_t code, const unsigned int bit,
+                          const _Bool one)
+{
+    const uint64_t mask = (uint64_t) 1U << bit;
+    const uint64_t same_dimension = (mask - (uint64_t) 1U) &
+        ((bit & 1U) != 0U ? MORTON_ODD_BITS : MORTON_EVEN_BITS);
+
+    if (one != 0) {
+        return (code & ~same_dimension) | mask;
+    }
+    return (code & ~mask) | same_dimension;
+}
+
+// Smallest code in the box greater than a code outside of it (BIGMIN)
+static int next_code_in_box(const uint64_t code, const MortonBox * const box,
+                            uint64_t * const next)
+{
+    uint64_t zmin = box->zmin;
+    uint64_t zmax = box->zmax;
+    uint64_t mask;
+    unsigned int bit = 64U;
+    unsigned int bits;
+    _Bool found = 0;
+
+    while (bit-- > 0U) {
+        mask = (uint64_t) 1U << bit;
+        bits = ((code & mask) != 0U ? 4U : 0U) |
+            ((zmin & mask) != 0U ? 2U : 0U) | ((zmax & mask) != 0U ? 1U : 0U);
+        switch (bits) {
+        case 1U:
+            *next = load_bits(zmin, bit, 1);
+            found = 1;
+            zmax = load_bits(zmax, bit, 0);
+            break;
+        case 3U:
+            *next = zmin;
+            return 1;
+        case 4U:
+            return found;
+        case 5U:
+            zmin = load_bits(zmin, bit, 1);
+            break;
+        default:
+            assert(bits == 0U || bits == 7U);
+        }
+    }
+    return found;
+}
+
+static size_t lower_bound(const MortonEntry * const entries,
+                          size_t first, size_t last, const uint64_t code)
+{
+    size_t middle;
+
+    while (first < last) {
+        middle = first + (last - first) / (size_t) 2U;
+        if (entries[middle].code < code) {
+            first = middle + (size_t) 1U;
+        } else {
+            last = middle;
+        }
+    }
+    return first;
+}
+
+static int flush_morton_batch(MortonBatch * const batch)
+{
+    const NbSlots count = batch->count;
+
+    if (count <= (NbSlots) 0U) {
+        return 0;
+    }
+    batch->count = (NbSlots) 0U;
+
+    return batch->cb(batch->context_cb, batch->latitudes, batch->longitudes,
+                     batch->slots, count);
+}
+
+static int push_morton_entry(MortonBatch * const batch,
+                             const MortonEntry * const entry)
+{
+    const Position2D position = morton_entry_position(batch->db, entry);
+
+    batch->latitudes[batch->count] = position.latitude;
+    batch->longitudes[batch->count] = position.longitude;
+    batch->slots[batch->count] = DEREF_SLOT(batch->db, entry->slot);
+    if (++batch->count < DISTANCES_BATCH_SIZE) {
+        return 0;
+    }
+    return flush_morton_batch(batch);
+}
+
+// First live entry of a run that is in a box, starting at a given index
+static size_t seek_morton_run(const MortonRun * const run, size_t i,
+                              const MortonBox * const box)
+{
+    const MortonEntry *entry;
+    uint64_t next = box->zmax;
+
+    while (i < run->nb_entries) {
+        entry = &run->entries[i];
+        if (entry->code > box->zmax) {
+            break;
+        }
+        if (code_is_in_box(entry->code, box) == 0) {
+            if (next_code_in_box(entry->code, box, &next) == 0) {
+                break;
+            }
+            i = lower_bound(run->entries, i + (size_t) 1U,
+                            run->nb_entries, next);
+            continue;
+        }
+        if (entry->slot != NULL_REF) {
+            return i;
+        }
+        i++;
+    }
+    return run->nb_entries;
+}
+
+static int scan_morton_run(const MortonRun * const run,
+                           const MortonBox * const box,
+                           MortonBatch * const batch)
+{
+    size_t i;
+    int ret;
+
+    i = lower_bound(run->entries, (size_t) 0U, run->nb_entries, box->zmin);
+    while ((i = seek_morton_run(run, i, box)) < run->nb_entries) {
+        if ((ret = push_morton_entry(batch, &run->entries[i++])) != 0) {
+            return ret;
+        }
+    }
+    return 0;
+}
+
+int scan_morton_index(const PanDB * const db,
+                      const Rectangle2D * const rect,
+                      MortonScanCB cb, void * const context_cb)
+{
+    const MortonIndex * const morton = &db->morton;
+    const MortonEntry *entry;
+    MortonBatch batch;
+    MortonBox box;
+    unsigned int t;
+    NbSlots i;
+    int ret;
+
+    if (rect->edge0.latitude > rect->edge1.latitude ||
+        rect->edge0.longitude > rect->edge1.longitude) {
+        return 0;
+    }
+    box = morton_box(db, rect);
+    batch.db = db;
+    batch.count = (NbSlots) 0U;
+    batch.cb = cb;
+    batch.context_cb = context_cb;
+    for (t = 0U; t < morton->nb_runs; t++) {
+        if ((ret = scan_morton_run(&morton->runs[t], &box, &batch)) != 0) {
+            return ret;
+        }
+    }
+    for (i = (NbSlots) 0U; i < morton->nb_pending; i++) {
+        entry = &morton->pending[i];
+        if (code_is_in_box(entry->code, &box) == 0) {
+            continue;
+        }
+        if ((ret = push_morton_entry(&batch, entry)) != 0) {
+            return ret;
+        }
+    }
+    return flush_morton_batch(&batch);
+}
+
+// Live entries closest to a position along the curve, in every run
+int sample_morton_index(const PanDB * const db,
+                        const Position2D * const position,
+                        const size_t nb_neighbors,
+                        MortonScanCB cb, void * const context_cb)
+{
+    const MortonIndex * const morton = &db->morton;
+    const uint64_t code = morton_code(db, position);
+    const MortonRun *run;
+    MortonBatch batch;
+    unsigned int t;
+    size_t found;
+    size_t first;
+    size_t i;
+    NbSlots j;
+    int ret;
+
+    batch.db = db;
+    batch.count = (NbSlots) 0U;
+    batch.cb = cb;
+    batch.context_cb = context_cb;
+    for (t = 0U; t < morton->nb_runs; t++) {
+        run = &morton->runs[t];
+        first = lower_bound(run->entries, (size_t) 0U, run->nb_entries, code);
+        found = (size_t) 0U;
+        for (i = first; i < run->nb_entries && found < nb_neighbors; i++) {
+            if (run->entries[i].slot == NULL_REF) {
+                continue;
+            }
+            found++;
+            if ((ret = push_morton_entry(&batch, &run->entries[i])) != 0) {
+                return ret;
+            }
+        }
+        found = (size_t) 0U;
+        for (i = first; i > (size_t) 0U && found < nb_neighbors; i--) {
+            if (run->entries[i - (size_t) 1U].slot == NULL_REF) {
+                continue;
+            }
+            found++;
+            if ((ret = push_morton_entry(&batch,
+                                         &run->entries[i - (size_t) 1U]))
+                != 0) {
+                return ret;
+            }
+        }
+    }
+    for (j = (NbSlots) 0U; j < morton->nb_pending; j++) {
+        if ((ret = push_morton_entry(&batch, &morton->pending[j])) != 0) {
+            return ret;
+        }
+    }
+    return flush_morton_batch(&batch);
+}
+
+static int morton_entry_cmp(const void * const entry1_,
+                            const void * const entry2_)
+{
+    const MortonEntry * const entry1 = entry1_;
+    const MortonEntry * const entry2 = entry2_;
+
+    if (entry1->code < entry2->code) {
+        return -1;
+    }
+    if (entry1->code > entry2->code) {
+        return 1;
+    }
+    return 0;
+}
+
+// Shallowest level whose cells are smaller than epsilon in both dimensions
+static unsigned int morton_cell_depth(const PanDB * const db,
+                                      const Dimension epsilon)
+{
+    const Rectangle2D * const qbounds = &db->qbounds;
+    double width = (double) qbounds->edge1.longitude -
+        (double) qbounds->edge0.longitude;
+    double height = (double) qbounds->edge1.latitude -
+        (double) qbounds->edge0.latitude;
+    unsigned int depth = 0U;
+
+    while (depth < 32U &&
+           (width >= (double) epsilon || height >= (double) epsilon)) {
+        width /= 2.0;
+        height /= 2.0;
+        depth++;
+    }
+    return depth;
+}
+
+static uint64_t morton_cell_prefix(const uint64_t code,
+                                   const unsigned int depth)
+{
+    if (depth <= 0U) {
+        return (uint64_t) 0U;
+    }
+    return code >> (64U - depth * 2U);
+}
+
+static Rectangle2D morton_cell_rect(const PanDB * const db,
+                                    const uint64_t code,
+                                    const unsigned int depth)
+{
+    const Rectangle2D * const qbounds = &db->qbounds;
+    const double scale = ldexp(1.0, - (int) depth);
+    const double width = ((double) qbounds->edge1.longitude -
+                          (double) qbounds->edge0.longitude) * scale;
+    const double height = ((double) qbounds->edge1.latitude -
+                           (double) qbounds->edge0.latitude) * scale;
+    double x = 0.0;
+    double y = 0.0;
+
+    if (depth > 0U) {
+        x = (double) (compact_bits(code) >> (32U - depth));
+        y = (double) (compact_bits(code >> 1) >> (32U - depth));
+    }
+    return (Rectangle2D) { {
+        (Dimension) ((double) qbounds->edge0.latitude + y * height),
+        (Dimension) ((double) qbounds->edge0.longitude + x * width)
+    }, {
+        (Dimension) ((double) qbounds->edge0.latitude + (y + 1.0) * height),
+        (Dimension) ((double) qbounds->edge0.longitude + (x + 1.0) * width)
+    } };
+}
+
+typedef struct MortonCell_ {
+    uint64_t prefix;
+    Rectangle2D rect;
+    _Bool clusterable;
+    SubSlots children;
+    double sum_latitudes;
+    double sum_longitudes;
+    double sum_squares;
+    const MortonEntry **entries;
+    size_t nb_entries;
+    size_t allocated_entries;
+} MortonCell;
+
+static int add_entry_to_morton_cell(MortonCell * const cell,
+                                    const MortonEntry * const entry,
+                                    const SubSlots max_children,
+                                    MortonBatch * const batch)
+{
+    const MortonEntry **entries;
+    size_t allocated_entries;
+    const Position2D position = morton_entry_position(batch->db, entry);
+    const double latitude = (double) position.latitude -
+        (double) cell->rect.edge0.latitude;
+    const double longitude = (double) position.longitude -
+        (double) cell->rect.edge0.longitude;
+
+    if (cell->clusterable == 0) {
+        return push_morton_entry(batch, entry);
+    }
+    cell->children++;
+    cell->sum_latitudes += latitude;
+    cell->sum_longitudes += longitude;
+    cell->sum_squares += latitude * latitude + longitude * longitude;
+    if (cell->children > max_children) {
+        return 0;
+    }
+    if (cell->nb_entries >= cell->allocated_entries) {
+        allocated_entries = cell->allocated_entries * (size_t) 2U +
+            (size_t) 16U;
+        if ((entries = realloc(cell->entries, allocated_entries *
+                               sizeof *entries)) == NULL) {
+            return -1;
+        }
+        cell->entries = entries;
+        cell->allocated_entries = allocated_entries;
+    }
+    cell->entries[cell->nb_entries++] = entry;
+
+    return 0;
+}
+
+static int close_morton_cell(MortonCell * const cell,
+                             const SubSlots max_children,
+                             MortonClusterCB cluster_cb,
+                             MortonBatch * const batch)
+{
+    const double children = (double) cell->children;
+    Position2D centroid;
+    double mean_latitude;
+    double mean_longitude;
+    double variance;
+    size_t i;
+    int ret;
+
+    if (cell->children > max_children) {
+        mean_latitude = cell->sum_latitudes / children;
+        mean_longitude = cell->sum_longitudes / children;
+        variance = cell->sum_squares / children -
+            mean_latitude * mean_latitude - mean_longitude * mean_longitude;
+        centroid = (Position2D) {
+            .latitude = (Dimension) ((double) cell->rect.edge0.latitude +
+                                     mean_latitude),
+            .longitude = (Dimension) ((double) cell->rect.edge0.longitude +
+                                      mean_longitude)
+        };
+        return cluster_cb(batch->context_cb, &centroid,
+                          (Dimension) sqrt(variance > 0.0 ? variance : 0.0),
+                          (NbSlots) cell->children);
+    }
+    for (i = (size_t) 0U; i < cell->nb_entries; i++) {
+        if ((ret = push_morton_entry(batch, cell->entries[i])) != 0) {
+            return ret;
+        }
+    }
+    return 0;
+}
+
+int cluster_morton_index(const PanDB * const db,
+                         const Rectangle2D * const rect,
+                         const Dimension epsilon, const SubSlots min_children,
+                         MortonScanCB cb, MortonCellCB cell_cb,
+                         MortonClusterCB cluster_cb, void * const context_cb)
+{
+    const MortonIndex * const morton = &db->morton;
+    const unsigned int depth = morton_cell_depth(db, epsilon);
+    const SubSlots max_children = min_children > (SubSlots) 1U ?
+        min_children : (SubSlots) 1U;
+    MortonEntry pending[MORTON_PENDING_ENTRIES];
+    MortonRun runs[MORTON_MAX_RUNS + 1U];
+    size_t cursors[MORTON_MAX_RUNS + 1U];
+    const MortonEntry *entry;
+    MortonBatch batch;
+    MortonCell cell;
+    MortonBox box;
+    unsigned int nb_runs = 0U;
+    unsigned int best;
+    unsigned int t;
+    NbSlots nb_pending = (NbSlots) 0U;
+    NbSlots i;
+    _Bool has_cell = 0;
+    int ret = 0;
+
+    if (rect->edge0.latitude > rect->edge1.latitude ||
+        rect->edge0.longitude > rect->edge1.longitude) {
+        return 0;
+    }
+    box = morton_box(db, rect);
+    for (t = 0U; t < morton->nb_runs; t++) {
+        runs[nb_runs] = morton->runs[t];
+        cursors[nb_runs] = seek_morton_run
+            (&runs[nb_runs], lower_bound(runs[nb_runs].entries, (size_t) 0U,
+                                         runs[nb_runs].nb_entries, box.zmin),
+             &box);
+        nb_runs++;
+    }
+    for (i = (NbSlots) 0U; i < morton->nb_pending; i++) {
+        if (code_is_in_box(morton->pending[i].code, &box) != 0) {
+            pending[nb_pending++] = morton->pending[i];
+        }
+    }
+    qsort(pending, (size_t) nb_pending, sizeof *pending, morton_entry_cmp);
+    runs[nb_runs] = (MortonRun) {
+        .entries = pending,
+        .nb_entries = (size_t) nb_pending,
+        .nb_removed = (size_t) 0U
+    };
+    cursors[nb_runs++] = (size_t) 0U;
+    batch.db = db;
+    batch.count = (NbSlots) 0U;
+    batch.cb = cb;
+    batch.context_cb = context_cb;
+    cell.entries = NULL;
+    cell.allocated_entries = (size_t) 0U;
+    for (;;) {
+        best = nb_runs;
+        for (t = 0U; t < nb_runs; t++) {
+            if (cursors[t] < runs[t].nb_entries &&
+                (best >= nb_runs || runs[t].entries[cursors[t]].code <
+                 runs[best].entries[cursors[best]].code)) {
+                best = t;
+            }
+        }
+        if (best >= nb_runs) {
+            break;
+        }
+        entry = &runs[best].entries[cursors[best]];
+        cursors[best] = seek_morton_run(&runs[best],
+                                        cursors[best] + (size_t) 1U, &box);
+        if (has_cell != 0 &&
+            cell.prefix != morton_cell_prefix(entry->code, depth)) {
+            has_cell = 0;
+            if ((ret = close_morton_cell(&cell, max_children,
+                                         cluster_cb, &batch)) != 0) {
+                break;
+            }
+        }
+        if (has_cell == 0) {
+            has_cell = 1;
+            cell.prefix = morton_cell_prefix(entry->code, depth);
+            cell.rect = morton_cell_rect(db, entry->code, depth);
+            cell.clusterable = cell_cb == NULL ||
+                cell_cb(context_cb, &cell.rect) != 0;
+            cell.children = (SubSlots) 0U;
+            cell.sum_latitudes = cell.sum_longitudes = 0.0;
+            cell.sum_squares = 0.0;
+            cell.nb_entries = (size_t) 0U;
+        }
+        if ((ret = add_entry_to_morton_cell(&cell, entry, max_children,
+                                            &batch)) != 0) {
+            break;
+        }
+    }
+    if (ret == 0 && has_cell != 0) {
+        ret = close_morton_cell(&cell, max_children, cluster_cb, &batch);
+    }
+    if (ret == 0) {
+        ret = flush_morton_batch(&batch);
+    }
+    free(cell.entries);
+
+    return ret;
+}
+
+static size_t live_entries(const MortonRun * const run)
+{
+    return run->nb_entries - run->nb_removed;
+}
+
+static int merge_morton_runs(const MortonRun * const run0,
+                             const MortonRun * const run1,
+                             MortonRun * const merged)
+{
+    const size_t nb_entries = live_entries(run0) + live_entries(run1);
+    const MortonEntry *entry;
+    size_t i = (size_t) 0U;
+    size_t j = (size_t) 0U;
+    size_t k = (size_t) 0U;
+
+    if ((merged->entries = malloc((nb_entries + (size_t) 1U) *
+                                  sizeof *merged->entries)) == NULL) {
+        return -1;
+    }
+    while (i < run0->nb_entries || j < run1->nb_entries) {
+        if (j >= run1->nb_entries ||
+            (i < run0->nb_entries &&
+             run0->entries[i].code <= run1->entries[j].code)) {
+            entry = &run0->entries[i++];
+        } else {
+            entry = &run1->entries[j++];
+        }
+        if (entry->slot != NULL_REF) {
+            merged->entries[k++] = *entry;
+        }
+    }
+    assert(k == nb_entries);
+    merged->nb_entries = nb_entries;
+    merged->nb_removed = (size_t) 0U;
+
+    return 0;
+}
+
+// Sorts the pending entries into a new run, then merges runs of
+// comparable sizes so that there are only O(log n) of them to scan
+static int flush_morton_pending(PanDB * const db)
+{
+    MortonIndex * const morton = &db->morton;
+    MortonRun *last;
+    MortonRun merged;
+    MortonRun run = {
+        .nb_entries = (size_t) morton->nb_pending,
+        .nb_removed = (size_t) 0U
+    };
+
+    if ((run.entries = malloc(run.nb_entries * sizeof *run.entries)) == NULL) {
+        return -1;
+    }
+    memcpy(run.entries, morton->pending, run.nb_entries * sizeof *run.entries);
+    qsort(run.entries, run.nb_entries, sizeof *run.entries, morton_entry_cmp);
+    while (morton->nb_runs > 0U) {
+        last = &morton->runs[morton->nb_runs - 1U];
+        if (morton->nb_runs < MORTON_MAX_RUNS &&
+            live_entries(last) > live_entries(&run)) {
+            break;
+        }
+        if (merge_morton_runs(last, &run, &merged) != 0) {
+            if (morton->nb_runs < MORTON_MAX_RUNS) {
+                break;
+            }
+            free(run.entries);
+            return -1;
+        }
+        free(last->entries);
+        free(run.entries);
+        morton->nb_runs--;
+        run = merged;
+    }
+    morton->runs[morton->nb_runs++] = run;
+    morton->nb_pending = (NbSlots) 0U;
+
+    return 0;
+}
+
+static int add_morton_entry(PanDB * const db, Slot * const slot,
+                            const SlotPosition * const position)
+{
+    MortonIndex * const morton = &db->morton;
+
+    if (morton->pending == NULL &&
+        (morton->pending = malloc(MORTON_PENDING_ENTRIES *
+                                  sizeof *morton->pending)) == NULL) {
+        return -1;
+    }
+    if (morton->nb_pending >= MORTON_PENDING_ENTRIES &&
+        flush_morton_pending(db) != 0) {
+        return -1;
+    }
+    morton->pending[morton->nb_pending++] = (MortonEntry) {
+        .code = slot_morton_code(db, position),
+#if !COMPACT_SLOTS
+        .position = *position,
+#endif
+        .slot = SLOT_REF(db, slot)
+    };
+    return 0;
+}
+
+static MortonEntry *find_morton_entry(MortonIndex * const morton,
+                                      const SlotRef slot,
+                                      const uint64_t code,
+                                      unsigned int * const run_index)
+{
+    MortonRun *run;
+    unsigned int t;
+    NbSlots j;
+    size_t i;
+
+    for (j = (NbSlots) 0U; j < morton->nb_pending; j++) {
+        if (morton->pending[j].slot == slot &&
+            morton->pending[j].code == code) {
+            *run_index = morton->nb_runs;
+            return &morton->pending[j];
+        }
+    }
+    for (t = 0U; t < morton->nb_runs; t++) {
+        run = &morton->runs[t];
+        i = lower_bound(run->entries, (size_t) 0U, run->nb_entries, code);
+        for (; i < run->nb_entries && run->entries[i].code == code; i++) {
+            if (run->entries[i].slot == slot) {
+                *run_index = t;
+                return &run->entries[i];
+            }
+        }
+    }
+    return NULL;
+}
+
+static void compact_morton_run(MortonIndex * const morton,
+                               const unsigned int t)
+{
+    MortonRun * const run = &morton->runs[t];
+    MortonEntry *entries;
+    size_t i;
+    size_t k = (size_t) 0U;
+
+    for (i = (size_t) 0U; i < run->nb_entries; i++) {
+        if (run->entries[i].slot != NULL_REF) {
+            run->entries[k++] = run->entries[i];
+        }
+    }
+    assert(k == live_entries(run));
+    if (k <= (size_t) 0U) {
+        free(run->entries);
+        morton->nb_runs--;
+        memmove(run, run + 1, (morton->nb_runs - t) * sizeof *run);
+        return;
+    }
+    if ((entries = realloc(run->entries, k * sizeof *entries)) != NULL) {
+        run->entries = entries;
+    }
+    run->nb_entries = k;
+    run->nb_removed = (size_t) 0U;
+}
+
+static int remove_morton_entry(PanDB * const db, const Slot * const slot,
+                               const uint64_t code)
+{
+    MortonIndex * const morton = &db->morton;
+    MortonEntry *entry;
+    MortonRun *run;
+    unsigned int t;
+
+    if ((entry = find_morton_entry(morton, SLOT_REF(db, slot),
+                                   code, &t)) == NULL) {
+        return -1;
+    }
+    if (t >= morton->nb_runs) {
+        *entry = morton->pending[--morton->nb_pending];
+        return 0;
+    }
+    run = &morton->runs[t];
+    entry->slot = NULL_REF;
+    if (++run->nb_removed > run->nb_entries / (size_t) 2U) {
+        compact_morton_run(morton, t);
+    }
+    return 0;
+}
+
+int add_slot_to_morton_index(PanDB * const db, Slot * const slot)
+{
+    return add_morton_entry(db, slot, &slot->position);
+}
+
+int remove_slot_from_morton_index(PanDB * const db, const Slot * const slot)
+{
+    return remove_morton_entry(db, slot,
+                               slot_morton_code(db, &slot->position));
+}
+
+int move_slot_in_morton_index(PanDB * const db, Slot * const slot,
+                              const SlotPosition * const position)
+{
+    const uint64_t code = slot_morton_code(db, &slot->position);
+    MortonEntry *entry;
+    unsigned int t;
+
+    if (slot_morton_code(db, position) == code) {
+        if ((entry = find_morton_entry(&db->morton, SLOT_REF(db, slot),
+                                       code, &t)) == NULL) {
+            return -1;
+        }
+#if !COMPACT_SLOTS
+        entry->position = *position;
+#endif
+    } else {
+        if (add_morton_entry(db, slot, position) != 0) {
+            return -1;
+        }
+        if (remove_morton_entry(db, slot, code) != 0) {
+            assert(0);
+        }
+    }
+    slot->position = *position;
+
+    return 0;
+}
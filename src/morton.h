@@ -0,0 +1,49 @@
+
+#ifndef __MORTON_H__
+#define __MORTON_H__ 1
+
+#ifndef MORTON_PENDING_ENTRIES
+# define MORTON_PENDING_ENTRIES ((NbSlots) 256U)
+#endif
+
+typedef int (*MortonScanCB)(void * const context,
+                            const Dimension * const latitudes,
+                            const Dimension * const longitudes,
+                            Slot * const * const slots,
+                            const NbSlots count);
+
+typedef int (*MortonCellCB)(void * const context,
+                           const Rectangle2D * const cell);
+
+typedef int (*MortonClusterCB)(void * const context,
+                               const Position2D * const centroid,
+                               const Dimension deviation,
+                               const NbSlots children);
+
+int init_morton_index(PanDB * const db);
+
+void free_morton_index(PanDB * const db);
+
+int add_slot_to_morton_index(PanDB * const db, Slot * const slot);
+
+int remove_slot_from_morton_index(PanDB * const db, const Slot * const slot);
+
+int move_slot_in_morton_index(PanDB * const db, Slot * const slot,
+                              const SlotPosition * const position);
+
+int scan_morton_index(const PanDB * const db,
+                      const Rectangle2D * const rect,
+                      MortonScanCB cb, void * const context_cb);
+
+int sample_morton_index(const PanDB * const db,
+                        const Position2D * const position,
+                        const size_t nb_neighbors,
+                        MortonScanCB cb, void * const context_cb);
+
+int cluster_morton_index(const PanDB * const db,
+                         const Rectangle2D * const rect,
+                         const Dimension epsilon, const SubSlots min_children,
+                         MortonScanCB cb, MortonCellCB cell_cb,
+                         MortonClusterCB cluster_cb, void * const context_cb);
+
+#endif
@@ -1,6 +1,8 @@
 
 #include "common.h"
 #include "pandb.h"
+#include "polygons.h"
+#include "morton.h"
 
 static void get_qrects_from_qbounds(Rectangle2D qrects[4],
                                     const Rectangle2D * const qbounds)
@@ -41,27 +43,39 @@ static int position_is_in_rect(const Position2D * const position,
     return 0;
 }
 
+static unsigned int find_part_for_position(const Rectangle2D * const qrects,
+                                           const Position2D * const position)
+{
+    unsigned int t = 4U;
+    
+    do {
+        t--;
+        if (position_is_in_rect(position, &qrects[t])) {
+            return t;
+        }
+    } while (t > 0U);
+    
+    return 4U;
+}
+
 static Node *find_node_for_position(const QuadNode * const quad_node,
                                     const Rectangle2D * const qrects,
                                     const Position2D * const position,
                                     Rectangle2D * const rect_pnt,
                                     unsigned int *part_id)
 {
-    unsigned int t = 4U;
+    const unsigned int t = find_part_for_position(qrects, position);
     
     assert(quad_node->type == NODE_TYPE_QUAD_NODE);
-    do {
-        t--;
-        if (position_is_in_rect(position, &qrects[t])) {
-            if (rect_pnt != NULL) {
-                *rect_pnt = qrects[t];
-            }
-            if (part_id != NULL) {
-                *part_id = t;
-            }
-            return quad_node->nodes[t];
+    if (t < 4U) {
+        if (rect_pnt != NULL) {
+            *rect_pnt = qrects[t];
         }
-    } while (t > 0U);
+        if (part_id != NULL) {
+            *part_id = t;
+        }
+        return quad_node->nodes[t];
+    }
 #ifdef DEBUG
     print_position(position);    
     print_quad_rects(qrects);
@@ -73,54 +87,207 @@ static Node *find_node_for_position(const QuadNode * const quad_node,
 
 int init_slot(Slot * const slot)
 {
-    slot->key_node = NULL;
-    slot->bucket_node = NULL;
+    slot->key_node = NULL_REF;
+    slot->bucket_node = NULL_REF;
     
     return 0;
 }
 
+int make_slot_position(SlotPosition * const slot_position,
+                       const double latitude, const double longitude)
+{
+#if COMPACT_SLOTS
+    const double fixed_latitude = round(latitude * FIXED_DIMENSION_SCALE);
+    const double fixed_longitude = round(longitude * FIXED_DIMENSION_SCALE);
+
+    if (!(fixed_latitude >= (double) INT32_MIN &&
+          fixed_latitude <= (double) INT32_MAX &&
+          fixed_longitude >= (double) INT32_MIN &&
+          fixed_longitude <= (double) INT32_MAX)) {
+        return -1;
+    }
+    slot_position->latitude = (FixedDimension) fixed_latitude;
+    slot_position->longitude = (FixedDimension) fixed_longitude;
+#else
+    slot_position->latitude = (Dimension) latitude;
+    slot_position->longitude = (Dimension) longitude;
+#endif
+    return 0;
+}
+
 void free_slot(Slot * const slot)
 {
     if (slot == NULL) {
         return;
     }
-    assert(slot->key_node != NULL);
-    slot->key_node = NULL;
-    assert(slot->bucket_node != NULL);
-    slot->bucket_node = NULL;
+    assert(slot->key_node != NULL_REF);
+    slot->key_node = NULL_REF;
+    slot->bucket_node = NULL_REF;
+}
+
+static Slot *new_slot_entry(PanDB * const db, const Slot * const slot)
+{
+#if COMPACT_SLOTS
+    return add_entry_to_pool(&db->slots_pool, slot);
+#else
+    return add_entry_to_slab(&db->slots_slab, slot);
+#endif
+}
+
+static void free_slot_entry(PanDB * const db, Slot * const slot)
+{
+    free_slot(slot);
+#if COMPACT_SLOTS
+    remove_entry_from_pool(&db->slots_pool, slot);
+#else
+    remove_entry_from_slab(&db->slots_slab, slot);
+#endif
+}
+
+// Compact buckets do not cache the trigonometry of their slots,
+// distances recompute it from the coordinates instead
+static _Bool bucket_has_trig(const PanDB * const db)
+{
+    return COMPACT_SLOTS == 0 &&
+        (db->layer_type == LAYER_TYPE_SPHERICAL ||
+         db->layer_type == LAYER_TYPE_ELLIPSOIDAL);
+}
+
+static inline Position2D bucket_position(const Bucket * const bucket,
+                                         const NbSlots i)
+{
+    return (Position2D) {
+        .latitude = (Dimension) SLOT_DIMENSION(bucket->latitudes[i]),
+        .longitude = (Dimension) SLOT_DIMENSION(bucket->longitudes[i])
+    };
 }
 
 static int init_bucket(Bucket * const bucket)
 {
-    init_slab(&bucket->slab, sizeof(Slot), "slots");
+    bucket->latitudes = NULL;
+    bucket->longitudes = NULL;
+    bucket->sin_latitudes = NULL;
+    bucket->cos_latitudes = NULL;
+    bucket->unit_xs = NULL;
+    bucket->unit_ys = NULL;
+    bucket->slots = NULL;
     bucket->bucket_size = (NbSlots) BUCKET_SIZE;
     bucket->busy_slots = (NbSlots) 0U;
+    bucket->allocated_slots = (NbSlots) 0U;
     
     return 0;    
 }
 
-static int free_bucket_cb(void *context, void *entry,
-                          const size_t sizeof_entry)
+static void free_bucket(Bucket * const bucket)
+{
+    if (bucket == NULL) {
+        return;
+    }
+    free(bucket->latitudes);
+    bucket->latitudes = NULL;
+    free(bucket->longitudes);
+    bucket->longitudes = NULL;
+    free(bucket->sin_latitudes);
+    bucket->sin_latitudes = NULL;
+    free(bucket->cos_latitudes);
+    bucket->cos_latitudes = NULL;
+    free(bucket->unit_xs);
+    bucket->unit_xs = NULL;
+    free(bucket->unit_ys);
+    bucket->unit_ys = NULL;
+    free(bucket->slots);
+    bucket->slots = NULL;
+    bucket->bucket_size = (NbSlots) 0U;
+    bucket->busy_slots = (NbSlots) 0U;    
+    bucket->allocated_slots = (NbSlots) 0U;
+}
+
+static int grow_dimensions(Dimension * * const dimensions,
+                           const NbSlots allocated_slots)
 {
-    Slot *slot = entry;
+    Dimension *tmp;
     
-    (void) context;
-    (void) sizeof_entry;
+    if ((tmp = realloc(*dimensions,
+                       allocated_slots * sizeof *tmp)) == NULL) {
+        return -1;
+    }
+    *dimensions = tmp;
     
-    free_slot(slot);
+    return 0;
+}
+
+#if COMPACT_SLOTS
+static int grow_slot_dimensions(SlotDimension * * const dimensions,
+                                const NbSlots allocated_slots)
+{
+    SlotDimension *tmp;
+
+    if ((tmp = realloc(*dimensions,
+                       allocated_slots * sizeof *tmp)) == NULL) {
+        return -1;
+    }
+    *dimensions = tmp;
+
+    return 0;
+}
+#else
+# define grow_slot_dimensions grow_dimensions
+#endif
+
+static int grow_bucket(Bucket * const bucket, const _Bool with_trig)
+{
+    NbSlots allocated_slots = bucket->allocated_slots;
+    SlotRef *slots;
+    
+    if (allocated_slots <= (NbSlots) 0U) {
+        allocated_slots = BUCKET_INITIAL_SLOTS;
+    } else {
+        allocated_slots *= (NbSlots) 2U;
+    }
+    if (grow_slot_dimensions(&bucket->latitudes, allocated_slots) != 0 ||
+        grow_slot_dimensions(&bucket->longitudes, allocated_slots) != 0) {
+        return -1;
+    }
+    if (with_trig != 0 &&
+        (grow_dimensions(&bucket->sin_latitudes, allocated_slots) != 0 ||
+         grow_dimensions(&bucket->cos_latitudes, allocated_slots) != 0 ||
+         grow_dimensions(&bucket->unit_xs, allocated_slots) != 0 ||
+         grow_dimensions(&bucket->unit_ys, allocated_slots) != 0)) {
+        return -1;
+    }
+    if ((slots = realloc(bucket->slots,
+                         allocated_slots * sizeof *slots)) == NULL) {
+        return -1;
+    }
+    bucket->slots = slots;
+    bucket->allocated_slots = allocated_slots;
     
     return 0;
 }
 
-static void free_bucket(Bucket * const bucket)
+static void remove_slot_from_bucket(const PanDB * const db,
+                                    Bucket * const bucket,
+                                    Slot * const slot)
 {
-    if (bucket == NULL) {
-        return;
+    const NbSlots i = slot->bucket_index;
+    NbSlots last;
+    
+    assert(bucket->busy_slots > (NbSlots) 0U);
+    assert(i < bucket->busy_slots);
+    assert(DEREF_SLOT(db, bucket->slots[i]) == slot);
+    last = --bucket->busy_slots;
+    if (i != last) {
+        bucket->latitudes[i] = bucket->latitudes[last];
+        bucket->longitudes[i] = bucket->longitudes[last];
+        if (bucket->unit_xs != NULL) {
+            bucket->sin_latitudes[i] = bucket->sin_latitudes[last];
+            bucket->cos_latitudes[i] = bucket->cos_latitudes[last];
+            bucket->unit_xs[i] = bucket->unit_xs[last];
+            bucket->unit_ys[i] = bucket->unit_ys[last];
+        }
+        bucket->slots[i] = bucket->slots[last];
+        DEREF_SLOT(db, bucket->slots[i])->bucket_index = i;
     }
-    slab_foreach((Slab *) &bucket->slab, free_bucket_cb, NULL);
-    free_slab(&bucket->slab, NULL);
-    bucket->bucket_size = (NbSlots) 0U;
-    bucket->busy_slots = (NbSlots) 0U;    
 }
 
 static int init_bucket_node(BucketNode * const bucket_node,
@@ -134,7 +301,8 @@ static int init_bucket_node(BucketNode * const bucket_node,
     return 0;
 }
 
-static void free_bucket_node(BucketNode * const bucket_node)
+static void free_bucket_node(PanDB * const db,
+                             BucketNode * const bucket_node)
 {
     if (bucket_node == NULL) {
         return;
@@ -142,15 +310,28 @@ static void free_bucket_node(BucketNode * const bucket_node)
     free_bucket(&bucket_node->bucket);
     bucket_node->type = NODE_TYPE_NONE;
     bucket_node->parent = NULL;
+#if COMPACT_SLOTS
+    remove_entry_from_pool(&db->bucket_nodes_pool, bucket_node);
+#else
+    (void) db;
     free(bucket_node);
+#endif
 }
 
-static BucketNode *new_bucket_node(const QuadNode * const parent)
+static BucketNode *new_bucket_node(PanDB * const db,
+                                   const QuadNode * const parent)
 {
     BucketNode *bucket_node;
 
     assert(parent->type == NODE_TYPE_QUAD_NODE);
+#if COMPACT_SLOTS
+    const BucketNode empty_bucket_node = { .type = NODE_TYPE_NONE };
+    bucket_node = add_entry_to_pool(&db->bucket_nodes_pool,
+                                    &empty_bucket_node);
+#else
+    (void) db;
     bucket_node = malloc(sizeof *bucket_node);
+#endif
     if (bucket_node == NULL) {
         return NULL;
     }
@@ -159,31 +340,34 @@ static BucketNode *new_bucket_node(const QuadNode * const parent)
     return bucket_node;
 }
 
-static int init_quad_node(QuadNode * const quad_node)
+static int init_quad_node(PanDB * const db, QuadNode * const quad_node)
 {
     quad_node->type = NODE_TYPE_QUAD_NODE;
     quad_node->parent = NULL;
     quad_node->sub_slots = (SubSlots) 0U;
-    quad_node->nodes[0] = (Node *) new_bucket_node(quad_node);
+    quad_node->mean_latitude = 0.0;
+    quad_node->mean_longitude = 0.0;
+    quad_node->square_deviations = 0.0;
+    quad_node->nodes[0] = (Node *) new_bucket_node(db, quad_node);
     if (quad_node->nodes[0] == NULL) {
         return -1;
     }
-    quad_node->nodes[1] = (Node *) new_bucket_node(quad_node);
+    quad_node->nodes[1] = (Node *) new_bucket_node(db, quad_node);
     if (quad_node->nodes[1] == NULL) {
-        free_bucket_node((BucketNode *) quad_node->nodes[0]);
+        free_bucket_node(db, (BucketNode *) quad_node->nodes[0]);
         return -1;
     }
-    quad_node->nodes[2] = (Node *) new_bucket_node(quad_node);
+    quad_node->nodes[2] = (Node *) new_bucket_node(db, quad_node);
     if (quad_node->nodes[2] == NULL) {
-        free_bucket_node((BucketNode *) quad_node->nodes[0]);
-        free_bucket_node((BucketNode *) quad_node->nodes[1]);
+        free_bucket_node(db, (BucketNode *) quad_node->nodes[0]);
+        free_bucket_node(db, (BucketNode *) quad_node->nodes[1]);
         return -1;
     }
-    quad_node->nodes[3] = (Node *) new_bucket_node(quad_node);
+    quad_node->nodes[3] = (Node *) new_bucket_node(db, quad_node);
     if (quad_node->nodes[3] == NULL) {
-        free_bucket_node((BucketNode *) quad_node->nodes[0]);
-        free_bucket_node((BucketNode *) quad_node->nodes[1]);
-        free_bucket_node((BucketNode *) quad_node->nodes[2]);
+        free_bucket_node(db, (BucketNode *) quad_node->nodes[0]);
+        free_bucket_node(db, (BucketNode *) quad_node->nodes[1]);
+        free_bucket_node(db, (BucketNode *) quad_node->nodes[2]);
         return -1;
     }
     
@@ -205,7 +389,7 @@ static void free_quad_node(QuadNode * const quad_node)
     free(quad_node);
 }
 
-static QuadNode *new_quad_node(void)
+static QuadNode *new_quad_node(PanDB * const db)
 {
     QuadNode *quad_node;
     
@@ -213,7 +397,7 @@ static QuadNode *new_quad_node(void)
     if (quad_node == NULL) {
         return NULL;
     }
-    if (init_quad_node(quad_node) != 0) {
+    if (init_quad_node(db, quad_node) != 0) {
         free(quad_node);
         return NULL;
     }
@@ -221,84 +405,148 @@ static QuadNode *new_quad_node(void)
     return quad_node;
 }
 
+static void add_position_to_quad_node(QuadNode * const quad_node,
+                                      const Position2D * const position)
+{
+    const double dlat = position->latitude - quad_node->mean_latitude;
+    const double dlon = position->longitude - quad_node->mean_longitude;
+    
+    quad_node->sub_slots++;
+    quad_node->mean_latitude += dlat / (double) quad_node->sub_slots;
+    quad_node->mean_longitude += dlon / (double) quad_node->sub_slots;
+    quad_node->square_deviations +=
+        dlat * (position->latitude - quad_node->mean_latitude) +
+        dlon * (position->longitude - quad_node->mean_longitude);
+}
+
+static void remove_position_from_quad_node(QuadNode * const quad_node,
+                                           const Position2D * const position)
+{
+    assert(quad_node->sub_slots > (SubSlots) 0U);
+    if (quad_node->sub_slots <= (SubSlots) 1U) {
+        quad_node->sub_slots = (SubSlots) 0U;
+        quad_node->mean_latitude = 0.0;
+        quad_node->mean_longitude = 0.0;
+        quad_node->square_deviations = 0.0;
+        return;
+    }
+    const double dlat = position->latitude - quad_node->mean_latitude;
+    const double dlon = position->longitude - quad_node->mean_longitude;
+    
+    quad_node->sub_slots--;
+    quad_node->mean_latitude -= dlat / (double) quad_node->sub_slots;
+    quad_node->mean_longitude -= dlon / (double) quad_node->sub_slots;
+    quad_node->square_deviations -=
+        dlat * (position->latitude - quad_node->mean_latitude) +
+        dlon * (position->longitude - quad_node->mean_longitude);
+    if (quad_node->square_deviations < 0.0) {
+        quad_node->square_deviations = 0.0;
+    }
+}
+
+static void store_bucket_position(Bucket * const bucket, const NbSlots i,
+                                  const SlotPosition * const position,
+                                  const _Bool with_trig)
+{
+    bucket->latitudes[i] = position->latitude;
+    bucket->longitudes[i] = position->longitude;
+    if (with_trig != 0) {
+        const Position2D trig_position = SLOT_POSITION(position);
+        const GeoidalTrig trig = geoidal_trig(&trig_position);
+        
+        bucket->sin_latitudes[i] = trig.sin_latitude;
+        bucket->cos_latitudes[i] = trig.cos_latitude;
+        bucket->unit_xs[i] = trig.unit_x;
+        bucket->unit_ys[i] = trig.unit_y;
+    }
+}
+
 static int add_slot_to_bucket(PanDB * const db, BucketNode * const bucket_node,
-                              const Slot * const slot, int update_sub_slots,
-                              Slot * * const new_slot)
+                              Slot * const slot, int update_sub_slots)
 {
+    const _Bool with_trig = bucket_has_trig(db);
+    const Position2D position = SLOT_POSITION(&slot->position);
     QuadNode *parent;
     Bucket *bucket;
+    NbSlots i;
     
-    (void) db;
-    *new_slot = NULL;
     assert(bucket_node != NULL);    
     assert(bucket_node->type == NODE_TYPE_BUCKET_NODE);
+    assert(slot->key_node != NULL_REF);
     bucket = &bucket_node->bucket;
-    *new_slot = add_entry_to_slab(&bucket->slab, slot);
-    if (*new_slot == NULL) {
+    if (bucket->busy_slots >= bucket->allocated_slots &&
+        grow_bucket(bucket, with_trig) != 0) {
         return -1;
     }
-    assert(slot->key_node != NULL);
-    * *new_slot = *slot;
-    (*new_slot)->bucket_node = bucket_node;
-    bucket->busy_slots++;
+    i = bucket->busy_slots++;
+    store_bucket_position(bucket, i, &slot->position, with_trig);
+    bucket->slots[i] = SLOT_REF(db, slot);
+    slot->bucket_node = BUCKET_NODE_REF(db, bucket_node);
+    slot->bucket_index = i;
     if (update_sub_slots == 1) {
         parent = bucket_node->parent;
         while (parent != NULL) {
-            parent->sub_slots++;
+            add_position_to_quad_node(parent, &position);
             parent = parent->parent;
         }
     } else if (update_sub_slots == 2) {
-        bucket_node->parent->sub_slots++;
+        add_position_to_quad_node(bucket_node->parent, &position);
     }
     return 0;
 }
 
-typedef struct RebalanceBucketCBContext_ {
-    PanDB *db;
-    QuadNode *quad_node_;
-    Rectangle2D *qrects_;
-} RebalanceBucketCBContext;
+static void relink_bucket_slots(PanDB * const db,
+                                BucketNode * const bucket_node)
+{
+    const Bucket * const bucket = &bucket_node->bucket;
+    Slot *slot;
+    NbSlots i;
+    
+    for (i = (NbSlots) 0U; i < bucket->busy_slots; i++) {
+        slot = DEREF_SLOT(db, bucket->slots[i]);
+        slot->bucket_node = BUCKET_NODE_REF(db, bucket_node);
+        slot->bucket_index = i;
+    }
+}
 
-static int rebalance_bucket_cb(void *context_, void *entry,
-                               const size_t sizeof_entry)
+static int rebalance_bucket(PanDB * const db, const Bucket * const bucket,
+                            QuadNode * const quad_node_,
+                            const Rectangle2D * const qrects_)
 {
     Node * target_node;    
-    Slot * scanned_slot = (Slot *) entry;
-    BucketNode * target_bucket;
-    RebalanceBucketCBContext *context = context_;
-    Slot *new_slot;
-    
-    (void) sizeof_entry;
-    target_node = find_node_for_position
-        (context->quad_node_, context->qrects_,
-         &scanned_slot->position, NULL, NULL);
-    target_bucket = &target_node->bucket_node;    
-    add_slot_to_bucket(context->db, target_bucket, scanned_slot, 2, &new_slot);
-    scanned_slot->key_node->slot = new_slot;
+    Slot * scanned_slot;
+    Position2D scanned_position;
+    NbSlots i;
     
+    for (i = (NbSlots) 0U; i < bucket->busy_slots; i++) {
+        scanned_slot = DEREF_SLOT(db, bucket->slots[i]);
+        scanned_position = bucket_position(bucket, i);
+        target_node = find_node_for_position
+            (quad_node_, qrects_, &scanned_position, NULL, NULL);
+        if (add_slot_to_bucket(db, &target_node->bucket_node,
+                               scanned_slot, 2) != 0) {
+            return -1;
+        }
+    }
     return 0;
 }
 
-int add_slot(PanDB * const db, const Slot * const slot,
-             Slot * * const new_slot)
+static int add_slot_to_quad_tree(PanDB * const db, Slot * const slot)
 {
+    const Position2D position = SLOT_POSITION(&slot->position);
     Rectangle2D qrects[4];
     Rectangle2D qrect;
     QuadNode *scanned_node;
     Node *scanned_node_child;
     Rectangle2D qbounds = db->qbounds;
-    KeyNode *key_node;
     unsigned int part_id;
     
-    *new_slot = NULL;
     scanned_node = &db->root;
-    key_node = slot->key_node;
-    assert(key_node != NULL);
     
     rescan:
     get_qrects_from_qbounds(qrects, &qbounds);        
     scanned_node_child = find_node_for_position(scanned_node, qrects,
-                                                &slot->position,
+                                                &position,
                                                 &qrect, &part_id);    
     assert(((BareNode *) scanned_node_child)->parent == scanned_node);
     if (scanned_node_child->bare_node.type == NODE_TYPE_BUCKET_NODE) {        
@@ -310,8 +558,9 @@ int add_slot(PanDB * const db, const Slot * const slot,
             db->latitude_accuracy ||
             qrect.edge1.longitude - qrect.edge0.longitude <
             db->longitude_accuracy) {
-            add_slot_to_bucket(db, bucket_node, slot, 1, new_slot);
-            key_node->slot = *new_slot;
+            if (add_slot_to_bucket(db, bucket_node, slot, 1) != 0) {
+                return -1;
+            }
         } else {
             QuadNode *quad_node_;
             Rectangle2D qrects_[4];
@@ -319,27 +568,34 @@ int add_slot(PanDB * const db, const Slot * const slot,
             BucketNode * target_bucket;
             Bucket *bucket;
             
-            quad_node_ = new_quad_node();            
+            if ((quad_node_ = new_quad_node(db)) == NULL) {
+                return -1;
+            }
             quad_node_->parent = scanned_node;
             assert(quad_node_->parent->type == NODE_TYPE_QUAD_NODE);
             get_qrects_from_qbounds(qrects_, &qrect);            
             bucket = &bucket_node->bucket;
             assert(bucket != NULL);
             
-            RebalanceBucketCBContext context = {
-                    .db = db,
-                    .quad_node_ = quad_node_,
-                    .qrects_ = qrects_
-            };
-            slab_foreach(&bucket->slab, rebalance_bucket_cb, &context);
-            free_bucket_node(&scanned_node->nodes[part_id]->bucket_node);
+            if (rebalance_bucket(db, bucket, quad_node_, qrects_) != 0) {
+                relink_bucket_slots(db, bucket_node);
+                part_id = 4U;
+                while (part_id-- > 0U) {
+                    free_bucket_node
+                        (db, &quad_node_->nodes[part_id]->bucket_node);
+                }
+                free_quad_node(quad_node_);
+                return -1;
+            }
+            free_bucket_node(db, &scanned_node->nodes[part_id]->bucket_node);
             scanned_node->nodes[part_id] = (Node *) quad_node_;
 
             target_node = find_node_for_position
-                (quad_node_, qrects_, &slot->position, &qrect, &part_id);
+                (quad_node_, qrects_, &position, &qrect, &part_id);
             target_bucket = &target_node->bucket_node;
-            add_slot_to_bucket(db, target_bucket, slot, 1, new_slot);
-            key_node->slot = *new_slot;
+            if (add_slot_to_bucket(db, target_bucket, slot, 1) != 0) {
+                return -1;
+            }
         }
     } else if (scanned_node_child->bare_node.type == NODE_TYPE_QUAD_NODE) {
         scanned_node = &scanned_node_child->quad_node;
@@ -351,53 +607,234 @@ int add_slot(PanDB * const db, const Slot * const slot,
     return 0;
 }
 
-typedef struct PackOldChildNodeCB_ {
-    PanDB *db;
-    BucketNode *new_node;
-} PackOldChildNodeCB;
+static int add_slot_to_bulk_load(PanDB * const db, Slot * const slot)
+{
+    BulkLoad * const bulk_load = &db->bulk_load;
+    
+    if (bulk_load->nb_slots >= bulk_load->allocated_slots) {
+        size_t allocated_slots = bulk_load->allocated_slots * (size_t) 2U;
+        Slot * *slots;
+        
+        if (allocated_slots <= (size_t) 0U) {
+            allocated_slots = BULK_LOAD_INITIAL_SLOTS;
+        }
+        if ((slots = realloc(bulk_load->slots,
+                             allocated_slots * sizeof *slots)) == NULL) {
+            return -1;
+        }
+        bulk_load->slots = slots;
+        bulk_load->allocated_slots = allocated_slots;
+    }
+    slot->bucket_node = NULL_REF;
+    slot->bucket_index = (NbSlots) bulk_load->nb_slots;
+    bulk_load->slots[bulk_load->nb_slots++] = slot;
+    
+    return 0;
+}
+
+static void remove_slot_from_bulk_load(PanDB * const db,
+                                       const Slot * const slot)
+{
+    BulkLoad * const bulk_load = &db->bulk_load;
+    const size_t i = (size_t) slot->bucket_index;
+    
+    assert(i < bulk_load->nb_slots);
+    assert(bulk_load->slots[i] == slot);
+    if (i != --bulk_load->nb_slots) {
+        bulk_load->slots[i] = bulk_load->slots[bulk_load->nb_slots];
+        bulk_load->slots[i]->bucket_index = (NbSlots) i;
+    }
+}
 
-static int pack_old_child_node_cb(void *context_, void *entry,
-                                  const size_t sizeof_entry)
+int add_slot(PanDB * const db, const Slot * const slot_,
+             Slot * * const new_slot)
 {
-    PackOldChildNodeCB *context = context_;
-    Slot *slot = entry;
-    Slot *new_slot;
+    Slot *slot;
+    int ret;
     
-    (void) sizeof_entry;
-    add_slot_to_bucket(context->db, context->new_node,
-                       slot, 0, &new_slot);
-    slot->key_node->slot = new_slot;
+    *new_slot = NULL;
+    assert(slot_->key_node != NULL_REF);
+    if ((slot = new_slot_entry(db, slot_)) == NULL) {
+        return -1;
+    }
+    if (db->index_type == INDEX_TYPE_MORTON) {
+        const Position2D position = SLOT_POSITION(&slot->position);
+
+        slot->bucket_node = NULL_REF;
+        if ((ret = add_slot_to_morton_index(db, slot)) == 0) {
+            add_position_to_quad_node(&db->root, &position);
+        }
+    } else if (db->bulk_load.active != 0) {
+        ret = add_slot_to_bulk_load(db, slot);
+    } else {
+        ret = add_slot_to_quad_tree(db, slot);
+    }
+    if (ret != 0) {
+        free_slot_entry(db, slot);
+        return -1;
+    }
+    *new_slot = slot;
+    
+    return 0;
+}
+
+static void get_quad_node_qbounds(const PanDB * const db,
+                                  const QuadNode * const quad_node,
+                                  Rectangle2D * const qbounds)
+{
+    const QuadNode * const parent = quad_node->parent;
+    Rectangle2D qrects[4];
+    unsigned int t = 4U;
+    
+    if (parent == NULL) {
+        *qbounds = db->qbounds;
+        return;
+    }
+    get_quad_node_qbounds(db, parent, qbounds);
+    get_qrects_from_qbounds(qrects, qbounds);
+    do {
+        t--;
+        if (parent->nodes[t] == (const Node *) quad_node) {
+            *qbounds = qrects[t];
+            return;
+        }
+    } while (t > 0U);
+    assert(0);
+}
+
+static int move_morton_slot(PanDB * const db, Slot * const slot,
+                            const SlotPosition * const new_position)
+{
+    const Position2D previous_position = SLOT_POSITION(&slot->position);
+    const Position2D position = SLOT_POSITION(new_position);
+    
+    if (move_slot_in_morton_index(db, slot, new_position) != 0) {
+        return -1;
+    }
+    remove_position_from_quad_node(&db->root, &previous_position);
+    add_position_to_quad_node(&db->root, &position);
+    
+    return 0;
+}
+
+int move_slot(PanDB * const db, Slot * const slot,
+              const SlotPosition * const new_position)
+{
+    BucketNode * const bucket_node = DEREF_BUCKET_NODE(db, slot->bucket_node);
+    const SlotPosition previous_slot_position = slot->position;
+    const Position2D previous_position = SLOT_POSITION(&slot->position);
+    const Position2D position_ = SLOT_POSITION(new_position);
+    const Position2D * const position = &position_;
+    QuadNode *scanned_node;
+    Rectangle2D qbounds;
+    Rectangle2D qrects[4];
+    Rectangle2D qrect;
+    Node *target_node;
+    
+    if (db->index_type == INDEX_TYPE_MORTON) {
+        return move_morton_slot(db, slot, new_position);
+    }
+    if (bucket_node == NULL) {
+        assert(db->bulk_load.active != 0);
+        slot->position = *new_position;
+        return 0;
+    }
+    assert(bucket_node->type == NODE_TYPE_BUCKET_NODE);
+    scanned_node = bucket_node->parent;
+    get_quad_node_qbounds(db, scanned_node, &qbounds);
+    if (position_is_in_rect(position, &qbounds) == 0) {
+        return 1;
+    }
+    get_qrects_from_qbounds(qrects, &qbounds);
+    target_node = find_node_for_position(scanned_node, qrects, position,
+                                         &qrect, NULL);
+    if (target_node == (Node *) bucket_node) {
+        slot->position = *new_position;
+        store_bucket_position(&bucket_node->bucket, slot->bucket_index,
+                              new_position, bucket_has_trig(db));
+    } else {
+        BucketNode * const target_bucket_node = &target_node->bucket_node;
+        
+        if (target_node->bare_node.type != NODE_TYPE_BUCKET_NODE ||
+            (target_bucket_node->bucket.busy_slots >=
+             target_bucket_node->bucket.bucket_size &&
+             qrect.edge1.latitude - qrect.edge0.latitude >=
+             db->latitude_accuracy &&
+             qrect.edge1.longitude - qrect.edge0.longitude >=
+             db->longitude_accuracy)) {
+            return 1;
+        }
+        remove_slot_from_bucket(db, &bucket_node->bucket, slot);
+        slot->position = *new_position;
+        if (add_slot_to_bucket(db, target_bucket_node, slot, 0) != 0) {
+            slot->position = previous_slot_position;
+            if (add_slot_to_bucket(db, bucket_node, slot, 0) != 0) {
+                assert(0);
+            }
+            return -1;
+        }
+    }
+    do {
+        remove_position_from_quad_node(scanned_node, &previous_position);
+        add_position_to_quad_node(scanned_node, position);
+        scanned_node = scanned_node->parent;
+    } while (scanned_node != NULL);
     
     return 0;
 }
 
+static void pack_old_child_node(PanDB * const db, BucketNode * const new_node,
+                                const BucketNode * const old_child_node)
+{
+    const Bucket * const bucket = &old_child_node->bucket;
+    NbSlots i;
+    
+    for (i = (NbSlots) 0U; i < bucket->busy_slots; i++) {
+        if (add_slot_to_bucket(db, new_node,
+                               DEREF_SLOT(db, bucket->slots[i]), 0) != 0) {
+            assert(0);
+        }
+    }
+}
+
 int remove_entry_from_key_node(PanDB * const db,
                                KeyNode * const key_node,
                                const _Bool should_free_key_node)
 {
     Slot * const slot = key_node->slot;
+    Position2D position;
     BucketNode *bucket_node;
     QuadNode *scanned_node;
     Bucket *bucket;
 
     assert(slot != NULL);
     assert(key_node->key != NULL);
+    position = SLOT_POSITION(&slot->position);
     if (should_free_key_node != 0) {
         RB_REMOVE(KeyNodes_, &db->key_nodes, key_node);        
         key_node->slot = NULL;
         free_key_node(db, key_node);
     }
-    bucket_node = slot->bucket_node;
-    assert(bucket_node != NULL);
+    if (db->index_type == INDEX_TYPE_MORTON) {
+        if (remove_slot_from_morton_index(db, slot) != 0) {
+            assert(0);
+        }
+        free_slot_entry(db, slot);
+        remove_position_from_quad_node(&db->root, &position);
+        
+        return 0;
+    }
+    bucket_node = DEREF_BUCKET_NODE(db, slot->bucket_node);
+    if (bucket_node == NULL) {
+        remove_slot_from_bulk_load(db, slot);
+        free_slot_entry(db, slot);
+        
+        return 0;
+    }
     assert(bucket_node->type == NODE_TYPE_BUCKET_NODE);
     bucket = &bucket_node->bucket;
-    free_slot(slot);    
-    remove_entry_from_slab(&bucket->slab, slot);
-    
-    assert(bucket->busy_slots > (NbSlots) 0U);
-    if (bucket->busy_slots > (NbSlots) 0U) {
-        bucket->busy_slots--;
-    }
+    remove_slot_from_bucket(db, bucket, slot);
+    free_slot_entry(db, slot);
     if (bucket_node->parent->parent != NULL &&
         bucket->busy_slots <= bucket->bucket_size / (NbSlots) 2U) {
         NbSlots busy_slots_in_siblings = (NbSlots) 0U;
@@ -418,20 +855,25 @@ int remove_entry_from_key_node(PanDB * const db,
         } while (t-- != 0U);
         if (only_buckets != 0 && busy_slots_in_siblings <
             bucket->bucket_size / (NbSlots) 6U * (NbSlots) 5U) {
+            const _Bool with_trig = bucket_has_trig(db);
             BucketNode *old_child_node;
             BucketNode *new_node;
-            PackOldChildNodeCB context;
             
-            new_node = new_bucket_node(scanned_node->parent);
-            context = (PackOldChildNodeCB) {
-                .db = db,
-                .new_node = new_node
-            };
+            new_node = new_bucket_node(db, scanned_node->parent);
+            while (new_node != NULL &&
+                   new_node->bucket.allocated_slots < busy_slots_in_siblings) {
+                if (grow_bucket(&new_node->bucket, with_trig) != 0) {
+                    free_bucket_node(db, new_node);
+                    new_node = NULL;
+                }
+            }
+            if (new_node == NULL) {
+                goto update_sub_slots;
+            }
             t = 3U;
             do {
                 old_child_node = &scanned_node->nodes[t]->bucket_node;
-                slab_foreach((Slab *) &old_child_node->bucket.slab,
-                             pack_old_child_node_cb, &context);
+                pack_old_child_node(db, new_node, old_child_node);
             } while (t-- != 0U);
             assert(new_node->bucket.busy_slots == busy_slots_in_siblings);
             t = 3U;
@@ -446,20 +888,20 @@ int remove_entry_from_key_node(PanDB * const db,
             t = 3U;
             do {
                 old_child_node = &scanned_node->nodes[t]->bucket_node;
-                free_bucket_node(old_child_node);
+                free_bucket_node(db, old_child_node);
             } while (t-- != 0U);
             free_quad_node(scanned_node);
             scanned_node = NULL;
             bucket_node = new_node;
         }
     }
+update_sub_slots:
     scanned_node = bucket_node->parent;
     assert(scanned_node != NULL);
     do {
         assert(scanned_node->type == NODE_TYPE_QUAD_NODE);
-        assert(scanned_node->sub_slots > (SubSlots) 0U);
         if (scanned_node->sub_slots > (SubSlots) 0U) {
-            scanned_node->sub_slots--;   
+            remove_position_from_quad_node(scanned_node, &position);
         }
         scanned_node = scanned_node->parent;
     } while (scanned_node != NULL);
@@ -476,156 +918,199 @@ int remove_entry(PanDB * const db, Key * const key)
     key_node = RB_FIND(KeyNodes_, &db->key_nodes, &scanned_key_node);
     if (key_node != NULL) {
         assert(key_node->slot != NULL);
-        assert(key_node->slot->bucket_node != NULL);
-        assert(key_node->slot->bucket_node->type == NODE_TYPE_BUCKET_NODE);
         remove_entry_from_key_node(db, key_node, 1);
         return 1;
     }
     return 0;
 }
 
-static int rectangle2d_intersect(const Rectangle2D * const r1,
-                                 const Rectangle2D * const r2)
+int begin_bulk_load(PanDB * const db)
 {
-    if (!(r1->edge0.longitude > r2->edge1.longitude ||
-          r1->edge1.longitude < r2->edge0.longitude ||
-          r1->edge0.latitude > r2->edge1.latitude ||
-          r1->edge1.latitude < r2->edge0.latitude)) {        
-        return 1;
+    if (db->index_type == INDEX_TYPE_MORTON || db->bulk_load.active != 0) {
+        return 0;
     }
-    return 0;
+    db->bulk_load.active = 1;
+    
+    return 1;
 }
 
-typedef struct FindNearIntCBContext_ {    
-    const PanDB *db;
-    const Position2D *position;
-    Meters distance;
-    SubSlots limit;
-    FindNearCB cb;
-    void *context_cb;
-} FindNearIntCBContext;
+static void drop_bulk_loaded_slot(PanDB * const db, Slot * const slot)
+{
+    KeyNode * const key_node = DEREF_KEY_NODE(db, slot->key_node);
+    
+    free_slot_entry(db, slot);
+    RB_REMOVE(KeyNodes_, &db->key_nodes, key_node);
+    key_node->slot = NULL;
+    free_key_node(db, key_node);
+}
 
-static int find_near_context_cb(void *context_, void *entry,
-                                const size_t sizeof_entry)
+static _Bool quad_tree_is_empty(const QuadNode * const root)
 {
-    FindNearIntCBContext *context = context_;
-    Slot *scanned_slot = entry;
-    Meters cd;
+    unsigned int t = 4U;
     
-    (void) sizeof_entry;
-    if (context->db->layer_type == LAYER_TYPE_SPHERICAL ||
-        context->db->layer_type == LAYER_TYPE_ELLIPSOIDAL) {
-        switch (context->db->accuracy) {
-        case ACCURACY_VINCENTY:
-            cd = vincenty_distance_between_geoidal_positions
-                (context->position, &scanned_slot->position);
-            break;
-        case ACCURACY_HS:
-            cd = hs_distance_between_geoidal_positions
-                (context->position, &scanned_slot->position);
-            break;
-        case ACCURACY_GC:
-            cd = gc_distance_between_geoidal_positions
-                (context->position, &scanned_slot->position);            
-            break;
-        case ACCURACY_FAST:
-            cd = gc_distance_between_geoidal_positions
-                (context->position, &scanned_slot->position);            
-            break;
-        case ACCURACY_RHOMBOID:
-            cd = rhomboid_distance_between_geoidal_positions
-                (context->position, &scanned_slot->position);
-            break;
-        default:
-            assert(0);
+    do {
+        t--;
+        if (root->nodes[t]->bare_node.type != NODE_TYPE_BUCKET_NODE ||
+            root->nodes[t]->bucket_node.bucket.busy_slots > (NbSlots) 0U) {
+            return 0;
+        }
+    } while (t > 0U);
+    
+    return 1;
+}
+
+static void merge_quad_node_stats(QuadNode * const quad_node,
+                                  const QuadNode * const child)
+{
+    const SubSlots sub_slots = quad_node->sub_slots + child->sub_slots;
+    double dlat;
+    double dlon;
+    double weight;
+    
+    if (child->sub_slots <= (SubSlots) 0U) {
+        return;
+    }
+    dlat = child->mean_latitude - quad_node->mean_latitude;
+    dlon = child->mean_longitude - quad_node->mean_longitude;
+    weight = (double) child->sub_slots / (double) sub_slots;
+    quad_node->square_deviations += child->square_deviations +
+        (dlat * dlat + dlon * dlon) * (double) quad_node->sub_slots * weight;
+    quad_node->mean_latitude += dlat * weight;
+    quad_node->mean_longitude += dlon * weight;
+    quad_node->sub_slots = sub_slots;
+}
+
+static int bulk_load_bucket(PanDB * const db, BucketNode * const bucket_node,
+                            Slot * * const slots, const size_t nb_slots)
+{
+    const _Bool with_trig = bucket_has_trig(db);
+    size_t i;
+    
+    while ((size_t) bucket_node->bucket.allocated_slots < nb_slots) {
+        if (grow_bucket(&bucket_node->bucket, with_trig) != 0) {
+            for (i = (size_t) 0U; i < nb_slots; i++) {
+                drop_bulk_loaded_slot(db, slots[i]);
+            }
             return -1;
         }
-    } else {
-        cd = distance_between_flat_positions(context->db,
-                                             context->position,
-                                             &scanned_slot->position);
-    }
-    if (cd <= context->distance) {
-       if (scanned_slot->key_node != NULL) {
-           if (context->cb != NULL) {               
-               const int ret =
-                   context->cb(context->context_cb, scanned_slot, cd);
-               if (ret != 0) {
-                   return ret;
-               }
-               if (context->limit-- <= (SubSlots) 1U) {
-                   return 1;
-               }
-           }
-           return 0;
-       } else {
-           printf("=== [NULL KEY] => %.3f/%.3f (%.2f)\n",
-                  scanned_slot->position.latitude,
-                  scanned_slot->position.longitude,
-                  cd);
-       }
+    }
+    for (i = (size_t) 0U; i < nb_slots; i++) {
+        if (add_slot_to_bucket(db, bucket_node, slots[i], 2) != 0) {
+            assert(0);
+        }
     }
     return 0;
 }
 
-static int find_near_in_zone(Rectangle2D * const matching_rect,
-                             PntStack *stack_inspect,
-                             const PanDB * const db,
-                             FindNearCB cb,
-                             void * const context_cb,
-                             const Position2D * const position,
-                             const Meters distance,
-                             const SubSlots limit)
+static int bulk_load_quad_node(PanDB * const db, QuadNode * const quad_node,
+                               const Rectangle2D * const qbounds,
+                               Slot * * const slots, Slot * * const scratch,
+                               const size_t nb_slots)
 {
-    const QuadNode *scanned_node;
-    Rectangle2D scanned_qbounds = db->qbounds;
-    Rectangle2D scanned_children_qbounds[4];
+    Rectangle2D qrects[4];
+    size_t firsts[4] = { (size_t) 0U, (size_t) 0U, (size_t) 0U, (size_t) 0U };
+    Position2D position;
+    size_t i;
     unsigned int t;
-    Node *scanned_node_child;
-    Rectangle2D *scanned_child_qbound;
-    QuadNodeWithBounds qnb;
-    QuadNodeWithBounds *sqnb;    
+    int ret = 0;
     
-    scanned_node = &db->root;    
-    FindNearIntCBContext context = {
-        .db = db,
-        .position = position,
-        .distance = distance,
-        .cb = cb,
-        .context_cb = context_cb,
-        .limit = limit
-    };
-    for (;;) {
-        assert(scanned_node->type == NODE_TYPE_QUAD_NODE);
-        get_qrects_from_qbounds(scanned_children_qbounds, &scanned_qbounds);
-        t = 0U;
-        do {
-            scanned_node_child = scanned_node->nodes[t];
-            scanned_child_qbound = &scanned_children_qbounds[t];
-            if (rectangle2d_intersect(scanned_child_qbound,
-                                      matching_rect) == 0) {
-                continue;
+    get_qrects_from_qbounds(qrects, qbounds);
+    for (i = (size_t) 0U; i < nb_slots; i++) {
+        position = SLOT_POSITION(&slots[i]->position);
+        t = find_part_for_position(qrects, &position);
+        assert(t < 4U);
+        firsts[t]++;
+    }
+    for (t = 1U; t < 4U; t++) {
+        firsts[t] += firsts[t - 1U];
+    }
+    i = nb_slots;
+    while (i-- > (size_t) 0U) {
+        position = SLOT_POSITION(&slots[i]->position);
+        t = find_part_for_position(qrects, &position);
+        scratch[--firsts[t]] = slots[i];
+    }
+    for (t = 0U; t < 4U; t++) {
+        const Rectangle2D * const qrect = &qrects[t];
+        BucketNode * const bucket_node = &quad_node->nodes[t]->bucket_node;
+        const size_t first = firsts[t];
+        const size_t count = (t < 3U ? firsts[t + 1U] : nb_slots) - first;
+        QuadNode *child;
+        
+        if (count <= (size_t) 0U) {
+            continue;
+        }
+        assert(bucket_node->type == NODE_TYPE_BUCKET_NODE);
+        if (count <= (size_t) bucket_node->bucket.bucket_size ||
+            qrect->edge1.latitude - qrect->edge0.latitude <
+            db->latitude_accuracy ||
+            qrect->edge1.longitude - qrect->edge0.longitude <
+            db->longitude_accuracy ||
+            (child = new_quad_node(db)) == NULL) {
+            if (bulk_load_bucket(db, bucket_node,
+                                 scratch + first, count) != 0) {
+                ret = -1;
             }
-            if (scanned_node_child->bare_node.type == NODE_TYPE_BUCKET_NODE) {
-                const Bucket *bucket = &scanned_node_child->bucket_node.bucket;
-                const int ret = slab_foreach((Slab *) &bucket->slab,
-                                             find_near_context_cb, &context);
-                if (ret != 0) {
-                    return ret;
-                }
-                continue;
+            continue;
+        }
+        child->parent = quad_node;
+        free_bucket_node(db, bucket_node);
+        quad_node->nodes[t] = (Node *) child;
+        if (bulk_load_quad_node(db, child, qrect, scratch + first,
+                                slots + first, count) != 0) {
+            ret = -1;
+        }
+        merge_quad_node_stats(quad_node, child);
+    }
+    return ret;
+}
+
+int end_bulk_load(PanDB * const db)
+{
+    BulkLoad * const bulk_load = &db->bulk_load;
+    Slot * *scratch = NULL;
+    size_t i;
+    int ret = 0;
+    
+    if (bulk_load->active == 0) {
+        return 0;
+    }
+    bulk_load->active = 0;
+    if (bulk_load->nb_slots > (size_t) 0U &&
+        quad_tree_is_empty(&db->root) != 0) {
+        scratch = malloc(bulk_load->nb_slots * sizeof *scratch);
+    }
+    if (scratch != NULL) {
+        ret = bulk_load_quad_node(db, &db->root, &db->qbounds,
+                                  bulk_load->slots, scratch,
+                                  bulk_load->nb_slots);
+        free(scratch);
+    } else {
+        for (i = (size_t) 0U; i < bulk_load->nb_slots; i++) {
+            if (add_slot_to_quad_tree(db, bulk_load->slots[i]) != 0) {
+                drop_bulk_loaded_slot(db, bulk_load->slots[i]);
+                ret = -1;
             }
-            assert(scanned_node_child->bare_node.type == NODE_TYPE_QUAD_NODE);
-            qnb.quad_node = &scanned_node_child->quad_node;
-            qnb.qrect = *scanned_child_qbound;
-            push_pnt_stack(stack_inspect, &qnb);
-        } while (t++ < 3U);
-        sqnb = pop_pnt_stack(stack_inspect);
-        if (sqnb == NULL) {
-            break;
         }
-        scanned_node = sqnb->quad_node;
-        scanned_qbounds = sqnb->qrect;
+    }
+    free(bulk_load->slots);
+    *bulk_load = (BulkLoad) {
+        .slots = NULL,
+        .nb_slots = (size_t) 0U,
+        .allocated_slots = (size_t) 0U,
+        .active = 0
+    };
+    return ret;
+}
+
+static int rectangle2d_intersect(const Rectangle2D * const r1,
+                                 const Rectangle2D * const r2)
+{
+    if (!(r1->edge0.longitude > r2->edge1.longitude ||
+          r1->edge1.longitude < r2->edge0.longitude ||
+          r1->edge0.latitude > r2->edge1.latitude ||
+          r1->edge1.latitude < r2->edge0.latitude)) {        
+        return 1;
     }
     return 0;
 }
@@ -739,302 +1224,2195 @@ static unsigned int find_zones(const PanDB * const db,
     return (unsigned int) (rect_pnt - &rects[0]);
 }
 
-int find_near(const PanDB * const db,
-              FindNearCB cb, void * const context_cb,
-              const Position2D * const position, const Meters distance,
-              const SubSlots limit)
+static inline Dimension dimension_clamp(const Dimension d,
+                                        const Dimension d0,
+                                        const Dimension d1)
 {
-    if (limit <= (SubSlots) 0) {
-        return 0;
+    return d < d0 ? d0 : (d > d1 ? d1 : d);
+}
+
+static Dimension gap_to_range(const Dimension d,
+                              const Dimension d0, const Dimension d1)
+{
+    if (d < d0) {
+        return d0 - d;
     }
-    Rectangle2D matching_rects[4];
-    Rectangle2D *matching_rect = &matching_rects[0];    
-    PntStack *stack_inspect;
+    if (d > d1) {
+        return d - d1;
+    }
+    return (Dimension) 0.0;
+}
 
-    const Dimension dlat = distance / DEG_AVG_DISTANCE;
-    const Dimension dlon = distance /
-        fabs(cosf((float) DEG_TO_RAD(position->latitude)) * DEG_AVG_DISTANCE);
-    const Rectangle2D rect = { {
-        position->latitude - dlat, position->longitude - dlon
-    }, {
-        position->latitude + dlat, position->longitude + dlon
-    } };
-    unsigned int nb_zones;
+static Dimension wrapped_gap_to_range(const Dimension d,
+                                      const Dimension d0, const Dimension d1,
+                                      const Dimension span)
+{
+    Dimension up;
+    Dimension down;
+    
+    if (d >= d0 && d <= d1) {
+        return (Dimension) 0.0;
+    }
+    up = fmodf(d0 - d + span, span);
+    down = fmodf(d - d1 + span, span);
+    
+    return dimension_min(up, down);
+}
+
+static Meters min_distance_to_geoidal_rect(const PanDB * const db,
+                                           const Position2D * const position,
+                                           const Rectangle2D * const rect)
+{
+    const Dimension gap_lat = gap_to_range(position->latitude,
+                                           rect->edge0.latitude,
+                                           rect->edge1.latitude);
+    const Dimension gap_lon = wrapped_gap_to_range(position->longitude,
+                                                   rect->edge0.longitude,
+                                                   rect->edge1.longitude,
+                                                   (Dimension) 360.0);
+    Position2D closest;
+    Dimension latitude;
+    
+    if (gap_lat <= (Dimension) 0.0 && gap_lon <= (Dimension) 0.0) {
+        return (Meters) 0.0;
+    }
+    if (db->accuracy == ACCURACY_RHOMBOID) {
+        return DEG_AVG_DISTANCE *
+            (fabsf(cosf(DEG_TO_RAD(position->latitude))) * gap_lon + gap_lat);
+    }
+    if (gap_lon <= (Dimension) 0.0) {
+        closest.longitude = position->longitude;
+        closest.latitude = dimension_clamp(position->latitude,
+                                           rect->edge0.latitude,
+                                           rect->edge1.latitude);
+    } else {
+        if (fmodf(rect->edge0.longitude - position->longitude + 360.0F,
+                  360.0F) <= gap_lon) {
+            closest.longitude = rect->edge0.longitude;
+        } else {
+            closest.longitude = rect->edge1.longitude;
+        }
+        if (gap_lon >= (Dimension) 90.0) {
+            latitude = position->latitude >= (Dimension) 0.0 ?
+                (Dimension) 90.0 : (Dimension) -90.0;
+        } else {
+            latitude = (Dimension)
+                (atan(tan(DEG_TO_RAD(position->latitude)) /
+                      cos(DEG_TO_RAD(gap_lon))) * 180.0 / M_PI);
+        }
+        closest.latitude = dimension_clamp(latitude,
+                                           rect->edge0.latitude,
+                                           rect->edge1.latitude);
+    }
+    return hs_distance_between_geoidal_positions(position, &closest) *
+        NEAREST_GEOIDAL_DISTANCE_SLACK;
+}
+
+static Meters min_distance_to_rect(const PanDB * const db,
+                                   const Position2D * const position,
+                                   const Rectangle2D * const rect)
+{
+    Dimension gap_lat;
+    Dimension gap_lon;
+    
+    if (db->layer_type == LAYER_TYPE_SPHERICAL ||
+        db->layer_type == LAYER_TYPE_ELLIPSOIDAL) {
+        return min_distance_to_geoidal_rect(db, position, rect);
+    }
+    if (db->layer_type == LAYER_TYPE_FLATWRAP) {
+        gap_lat = wrapped_gap_to_range(position->latitude,
+                                       rect->edge0.latitude,
+                                       rect->edge1.latitude,
+                                       db->qbounds.edge1.latitude -
+                                       db->qbounds.edge0.latitude);
+        gap_lon = wrapped_gap_to_range(position->longitude,
+                                       rect->edge0.longitude,
+                                       rect->edge1.longitude,
+                                       db->qbounds.edge1.longitude -
+                                       db->qbounds.edge0.longitude);
+    } else {
+        gap_lat = gap_to_range(position->latitude,
+                               rect->edge0.latitude, rect->edge1.latitude);
+        gap_lon = gap_to_range(position->longitude,
+                               rect->edge0.longitude, rect->edge1.longitude);
+    }
+    return (Meters) sqrtf(gap_lat * gap_lat + gap_lon * gap_lon);
+}
+
+typedef struct NearestCandidate_ {
+    Meters distance;
+    const Node *node;
+    Slot *slot;
+    Rectangle2D qrect;
+} NearestCandidate;
+
+typedef struct FindNearestIntCBContext_ {
+    const PanDB *db;
+    const Position2D *position;
+    Meters max_distance;
+    PntHeap *candidates;
+} FindNearestIntCBContext;
+
+static int nearest_candidate_cmp(const void * const candidate1_,
+                                 const void * const candidate2_)
+{
+    const NearestCandidate * const candidate1 = candidate1_;
+    const NearestCandidate * const candidate2 = candidate2_;
+    
+    if (candidate1->distance < candidate2->distance) {
+        return -1;
+    }
+    if (candidate1->distance > candidate2->distance) {
+        return 1;
+    }
+    return (candidate1->slot == NULL) - (candidate2->slot == NULL);
+}
+
+static int push_nearest_slots(FindNearestIntCBContext * const context,
+                              const Bucket * const bucket)
+{
+    const NbSlots busy_slots = bucket->busy_slots;
+    Meters distances[DISTANCES_BATCH_SIZE];
+    NearestCandidate candidate;
+    NbSlots offset;
+    NbSlots count;
+    NbSlots i;
+    
+    for (offset = (NbSlots) 0U; offset < busy_slots; offset += count) {
+        count = busy_slots - offset;
+        if (count > DISTANCES_BATCH_SIZE) {
+            count = DISTANCES_BATCH_SIZE;
+        }
+        if (batch_distances(context->db, context->position, bucket,
+                            offset, count, context->max_distance,
+                            distances) != 0) {
+            return -1;
+        }
+        for (i = (NbSlots) 0U; i < count; i++) {
+            if (context->max_distance >= (Meters) 0.0 &&
+                distances[i] > context->max_distance) {
+                continue;
+            }
+            candidate = (NearestCandidate) {
+                .distance = distances[i],
+                .node = NULL,
+                .slot = DEREF_SLOT(context->db, bucket->slots[offset + i])
+            };
+            if (push_pnt_heap(context->candidates, &candidate) != 0) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+static int push_nearest_children(FindNearestIntCBContext * const context,
+                                 const NearestCandidate * const candidate)
+{
+    const QuadNode * const quad_node = &candidate->node->quad_node;
+    Rectangle2D children_qbounds[4];
+    NearestCandidate child;
+    unsigned int t;
+    
+    get_qrects_from_qbounds(children_qbounds, &candidate->qrect);
+    for (t = 0U; t < 4U; t++) {
+        child = (NearestCandidate) {
+            .distance = min_distance_to_rect(context->db, context->position,
+                                             &children_qbounds[t]),
+            .node = quad_node->nodes[t],
+            .slot = NULL,
+            .qrect = children_qbounds[t]
+        };
+        if (context->max_distance >= (Meters) 0.0 &&
+            child.distance > context->max_distance) {
+            continue;
+        }
+        if (push_pnt_heap(context->candidates, &child) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+typedef struct FindNearestMortonContext_ {
+    const PanDB *db;
+    const Position2D *position;
+    Meters distance;
+    NearestCandidate *candidates;
+    size_t nb_candidates;
+    size_t allocated_candidates;
+} FindNearestMortonContext;
+
+static int nearest_morton_candidate_cmp(const void * const candidate1_,
+                                        const void * const candidate2_)
+{
+    const NearestCandidate * const candidate1 = candidate1_;
+    const NearestCandidate * const candidate2 = candidate2_;
+    
+    if (candidate1->distance != candidate2->distance) {
+        return candidate1->distance < candidate2->distance ? -1 : 1;
+    }
+    if (candidate1->slot != candidate2->slot) {
+        return (uintptr_t) candidate1->slot < (uintptr_t) candidate2->slot ?
+            -1 : 1;
+    }
+    return 0;
+}
+
+static int find_nearest_in_morton_batch(void * const context_,
+                                        const Dimension * const latitudes,
+                                        const Dimension * const longitudes,
+                                        Slot * const * const slots,
+                                        const NbSlots count)
+{
+    FindNearestMortonContext * const context = context_;
+    Meters distances[DISTANCES_BATCH_SIZE];
+    NearestCandidate *candidates;
+    size_t allocated_candidates;
+    NbSlots i;
+    
+    batch_position_distances(context->db, context->position,
+                             latitudes, longitudes, distances, count);
+    for (i = (NbSlots) 0U; i < count; i++) {
+        if (distances[i] > context->distance) {
+            continue;
+        }
+        if (context->nb_candidates >= context->allocated_candidates) {
+            allocated_candidates = context->allocated_candidates * 2U;
+            if ((candidates = realloc(context->candidates,
+                                      allocated_candidates *
+                                      sizeof *candidates)) == NULL) {
+                return -1;
+            }
+            context->candidates = candidates;
+            context->allocated_candidates = allocated_candidates;
+        }
+        context->candidates[context->nb_candidates++] = (NearestCandidate) {
+            .distance = distances[i],
+            .node = NULL,
+            .slot = slots[i]
+        };
+    }
+    return 0;
+}
+
+static unsigned int wrap_range(const Dimension d0, const Dimension d1,
+                               const Dimension b0, const Dimension b1,
+                               Dimension ranges[2][2])
+{
+    const Dimension span = b1 - b0;
+    Dimension r0 = d0;
+    Dimension r1 = d1;
+    
+    if (r1 - r0 >= span) {
+        ranges[0][0] = b0;
+        ranges[0][1] = b1;
+        return 1U;
+    }
+    if (r0 < b0) {
+        r0 += span;
+        r1 += span;
+    } else if (r0 >= b1) {
+        r0 -= span;
+        r1 -= span;
+    }
+    ranges[0][0] = r0;
+    if (r1 <= b1) {
+        ranges[0][1] = r1;
+        return 1U;
+    }
+    ranges[0][1] = b1;
+    ranges[1][0] = b0;
+    ranges[1][1] = r1 - span;
+    
+    return 2U;
+}
+
+// Zones covering every position within a distance, corners included.
+// On geoidal layers, the longitude span is the exact one of a circle
+// on a sphere, optionally widened by an angular margin, and latitudes
+// are never wrapped.
+static unsigned int find_radius_zones(const PanDB * const db,
+                                      const Position2D * const position,
+                                      const Meters distance,
+                                      const double margin,
+                                      Rectangle2D matching_rects[4])
+{
+    const Rectangle2D * const qbounds = &db->qbounds;
+    Dimension latitudes[2][2];
+    Dimension longitudes[2][2];
+    Dimension dlat = distance;
+    Dimension dlon = distance;
+    unsigned int nb_latitudes;
+    unsigned int nb_longitudes;
+    unsigned int nb_zones = 0U;
+    unsigned int i;
+    unsigned int j;
+    
+    if (db->layer_type == LAYER_TYPE_SPHERICAL ||
+        db->layer_type == LAYER_TYPE_ELLIPSOIDAL) {
+        const double angle = hypot((double) distance /
+                                   ((double) EARTH_RADIUS *
+                                    NEAREST_GEOIDAL_DISTANCE_SLACK), margin);
+        
+        dlat = (Dimension) (angle * 180.0 / M_PI);
+        if (fabsf(position->latitude) + dlat >= (Dimension) 90.0) {
+            dlon = (Dimension) 180.0;
+        } else {
+            dlon = (Dimension)
+                (asin(sin(angle) / cos(DEG_TO_RAD(position->latitude))) *
+                 180.0 / M_PI);
+        }
+    }
     if (db->layer_type == LAYER_TYPE_FLAT) {
-        matching_rects[0] = rect;        
-        nb_zones = 1U;
+        matching_rects[0] = (Rectangle2D) { {
+            position->latitude - dlat, position->longitude - dlon
+        }, {
+            position->latitude + dlat, position->longitude + dlon
+        } };
+        return 1U;
+    }
+    if (db->layer_type == LAYER_TYPE_FLATWRAP) {
+        nb_latitudes = wrap_range(position->latitude - dlat,
+                                  position->latitude + dlat,
+                                  qbounds->edge0.latitude,
+                                  qbounds->edge1.latitude, latitudes);
     } else {
-        nb_zones = find_zones(db, &rect, matching_rects);
+        latitudes[0][0] = dimension_max(position->latitude - dlat,
+                                        qbounds->edge0.latitude);
+        latitudes[0][1] = dimension_min(position->latitude + dlat,
+                                        qbounds->edge1.latitude);
+        nb_latitudes = 1U;
+    }
+    nb_longitudes = wrap_range(position->longitude - dlon,
+                               position->longitude + dlon,
+                               qbounds->edge0.longitude,
+                               qbounds->edge1.longitude, longitudes);
+    for (i = 0U; i < nb_latitudes; i++) {
+        for (j = 0U; j < nb_longitudes; j++) {
+            matching_rects[nb_zones++] = (Rectangle2D) { {
+                latitudes[i][0], longitudes[j][0]
+            }, {
+                latitudes[i][1], longitudes[j][1]
+            } };
+        }
+    }
+    return nb_zones;
+}
+
+// Collects the slots within a radius grown from the layer density until
+// it holds enough of them, then reports them by increasing distance
+static int find_nearest_in_morton_index(const PanDB * const db,
+                                        FindNearestCB cb,
+                                        void * const context_cb,
+                                        const Position2D * const position,
+                                        const Meters max_distance,
+                                        SubSlots limit)
+{
+    const SubSlots nb_slots = db->root.sub_slots;
+    const _Bool geoidal = db->layer_type == LAYER_TYPE_SPHERICAL ||
+        db->layer_type == LAYER_TYPE_ELLIPSOIDAL;
+    const Dimension height =
+        db->qbounds.edge1.latitude - db->qbounds.edge0.latitude;
+    const Dimension width =
+        db->qbounds.edge1.longitude - db->qbounds.edge0.longitude;
+    Rectangle2D matching_rects[4];
+    NearestCandidate *candidate;
+    Slot *previous_slot = NULL;
+    Meters sampled_distance;
+    Meters max_span;
+    unsigned int nb_zones;
+    unsigned int t;
+    size_t i;
+    int ret = 0;
+    
+    if (nb_slots <= (SubSlots) 0U) {
+        return 0;
+    }
+    FindNearestMortonContext context = {
+        .db = db,
+        .position = position,
+        .distance = (Meters) sqrt((double) limit / (double) nb_slots *
+                                  (double) height * (double) width),
+        .nb_candidates = (size_t) 0U,
+        .allocated_candidates = DEFAULT_HEAP_SIZE_FOR_SEARCHES
+    };
+    if (geoidal != 0) {
+        context.distance *= DEG_AVG_DISTANCE;
+        max_span = (Meters) (EARTH_RADIUS * M_PI);
+    } else {
+        max_span = sqrtf(height * height + width * width);
+    }
+    if ((context.candidates = malloc(context.allocated_candidates *
+                                     sizeof *context.candidates)) == NULL) {
+        return -1;
+    }
+    // The entries next to the position along the curve bound the distance
+    // to its nearest neighbors, and are usually much closer than the
+    // density of the whole layer suggests.
+    sampled_distance = context.distance;
+    context.distance = (Meters) HUGE_VALF;
+    if ((ret = sample_morton_index(db, position, (size_t) limit,
+                                   find_nearest_in_morton_batch,
+                                   &context)) != 0) {
+        free(context.candidates);
+        return ret;
+    }
+    if (context.nb_candidates >= (size_t) limit) {
+        qsort(context.candidates, context.nb_candidates,
+              sizeof *context.candidates, nearest_morton_candidate_cmp);
+        sampled_distance = context.candidates[limit - (SubSlots) 1U].distance;
+    }
+    context.distance = sampled_distance;
+    if (max_distance >= (Meters) 0.0 && context.distance > max_distance) {
+        context.distance = max_distance;
+    }
+    for (;;) {
+        context.nb_candidates = (size_t) 0U;
+        nb_zones = find_radius_zones(db, position, context.distance, 0.0,
+                                      matching_rects);
+        for (t = 0U; ret == 0 && t < nb_zones; t++) {
+            ret = scan_morton_index(db, &matching_rects[t],
+                                    find_nearest_in_morton_batch, &context);
+        }
+        if (ret != 0 || context.nb_candidates >= (size_t) limit ||
+            context.distance >= max_span ||
+            (max_distance >= (Meters) 0.0 &&
+             context.distance >= max_distance)) {
+            break;
+        }
+        context.distance = context.distance > (Meters) 0.0 ?
+            context.distance * (Meters) 2.0 : (Meters) 1.0;
+        if (max_distance >= (Meters) 0.0 && context.distance > max_distance) {
+            context.distance = max_distance;
+        }
+    }
+    if (ret == 0) {
+        qsort(context.candidates, context.nb_candidates,
+              sizeof *context.candidates, nearest_morton_candidate_cmp);
+    }
+    for (i = (size_t) 0U; ret == 0 && i < context.nb_candidates; i++) {
+        candidate = &context.candidates[i];
+        if (candidate->slot == previous_slot) {
+            continue;
+        }
+        previous_slot = candidate->slot;
+        if ((ret = cb(context_cb, candidate->slot,
+                      candidate->distance)) != 0) {
+            break;
+        }
+        if (--limit <= (SubSlots) 0U) {
+            break;
+        }
+    }
+    free(context.candidates);
+    
+    return ret;
+}
+
+int find_nearest(const PanDB * const db,
+                 FindNearestCB cb, void * const context_cb,
+                 const Position2D * const position,
+                 const Meters max_distance, SubSlots limit)
+{
+    NearestCandidate candidate;
+    const Bucket *bucket;
+    int ret = 0;
+    
+    if (limit <= (SubSlots) 0) {
+        return 0;
+    }
+    if (db->index_type == INDEX_TYPE_MORTON) {
+        return find_nearest_in_morton_index(db, cb, context_cb, position,
+                                            max_distance, limit);
+    }
+    FindNearestIntCBContext context = {
+        .db = db,
+        .position = position,
+        .max_distance = max_distance,
+        .candidates = new_pnt_heap(DEFAULT_HEAP_SIZE_FOR_SEARCHES,
+                                   sizeof(NearestCandidate),
+                                   nearest_candidate_cmp)
+    };
+    if (context.candidates == NULL) {
+        return -1;
+    }
+    candidate = (NearestCandidate) {
+        .distance = (Meters) 0.0,
+        .node = (const Node *) &db->root,
+        .slot = NULL,
+        .qrect = db->qbounds
+    };
+    push_pnt_heap(context.candidates, &candidate);
+    while (pop_pnt_heap(context.candidates, &candidate) == 0) {
+        if (candidate.slot != NULL) {
+            if ((ret = cb(context_cb, candidate.slot,
+                          candidate.distance)) != 0) {
+                break;
+            }
+            if (--limit <= (SubSlots) 0U) {
+                break;
+            }
+            continue;
+        }
+        if (candidate.node->bare_node.type == NODE_TYPE_BUCKET_NODE) {
+            bucket = &candidate.node->bucket_node.bucket;
+            ret = push_nearest_slots(&context, bucket);
+        } else {
+            assert(candidate.node->bare_node.type == NODE_TYPE_QUAD_NODE);
+            ret = push_nearest_children(&context, &candidate);
+        }
+        if (ret != 0) {
+            ret = -1;
+            break;
+        }
+    }
+    free_pnt_heap(context.candidates);
+    
+    return ret;
+}
+
+static Meters max_distance_to_geoidal_rect(const PanDB * const db,
+                                           const Position2D * const position,
+                                           const Rectangle2D * const rect_)
+{
+    const Rectangle2D rect = {
+        .edge0 = {
+            .latitude = dimension_clamp(rect_->edge0.latitude,
+                                        (Dimension) -90.0, (Dimension) 90.0),
+            .longitude = rect_->edge0.longitude
+        },
+        .edge1 = {
+            .latitude = dimension_clamp(rect_->edge1.latitude,
+                                        (Dimension) -90.0, (Dimension) 90.0),
+            .longitude = rect_->edge1.longitude
+        }
+    };
+    const Dimension dlon0 = rect.edge0.longitude - position->longitude;
+    const Dimension dlon1 = rect.edge1.longitude - position->longitude;
+    Position2D corner;
+    Meters max_distance = (Meters) 0.0;
+    Meters distance;
+    unsigned int t;
+    
+    if (db->accuracy == ACCURACY_RHOMBOID) {
+        return DEG_AVG_DISTANCE *
+            (fabsf(cosf(DEG_TO_RAD(position->latitude))) *
+             dimension_max(fabsf(dlon0), fabsf(dlon1)) +
+             dimension_max(fabsf(rect.edge0.latitude - position->latitude),
+                           fabsf(rect.edge1.latitude - position->latitude)));
+    }
+    if ((dlon0 < (Dimension) -180.0 && dlon1 > (Dimension) -180.0) ||
+        (dlon0 < (Dimension) 180.0 && dlon1 > (Dimension) 180.0)) {
+        return HUGE_VALF;
+    }
+    for (t = 0U; t < 4U; t++) {
+        corner.latitude = (t & 1U) ? rect.edge1.latitude : rect.edge0.latitude;
+        corner.longitude =
+            (t & 2U) ? rect.edge1.longitude : rect.edge0.longitude;
+        distance = hs_distance_between_geoidal_positions(position, &corner);
+        if (distance > max_distance) {
+            max_distance = distance;
+        }
+    }
+    if (max_distance >= EARTH_CIRCUMFERENCE / 4.0F) {
+        return HUGE_VALF;
+    }
+    return max_distance / NEAREST_GEOIDAL_DISTANCE_SLACK;
+}
+
+static Meters max_distance_to_rect(const PanDB * const db,
+                                   const Position2D * const position,
+                                   const Rectangle2D * const rect)
+{
+    Dimension gap_lat;
+    Dimension gap_lon;
+    
+    if (db->layer_type == LAYER_TYPE_SPHERICAL ||
+        db->layer_type == LAYER_TYPE_ELLIPSOIDAL) {
+        return max_distance_to_geoidal_rect(db, position, rect);
+    }
+    if (db->layer_type == LAYER_TYPE_FLATWRAP) {
+        return HUGE_VALF;
+    }
+    gap_lat = dimension_max(fabsf(position->latitude - rect->edge0.latitude),
+                            fabsf(position->latitude - rect->edge1.latitude));
+    gap_lon = dimension_max(fabsf(position->longitude - rect->edge0.longitude),
+                            fabsf(position->longitude - rect->edge1.longitude));
+    
+    return (Meters) sqrtf(gap_lat * gap_lat + gap_lon * gap_lon);
+}
+
+static Meters cluster_radius(const PanDB * const db,
+                             const Dimension deviation)
+{
+    if (db->layer_type == LAYER_TYPE_SPHERICAL ||
+        db->layer_type == LAYER_TYPE_ELLIPSOIDAL) {
+        return geoidal_distance_to_meters(deviation);
+    }
+    return (Meters) deviation;
+}
+
+static int get_quad_node_cluster(const PanDB * const db,
+                                 const QuadNode * const quad_node,
+                                 const Rectangle2D * const qrect,
+                                 Position2D * const centroid,
+                                 Meters * const radius)
+{
+    assert(quad_node->type == NODE_TYPE_QUAD_NODE);
+    if (quad_node->sub_slots <= (SubSlots) 0U) {
+        return 0;
+    }
+    *centroid = (Position2D) {
+        .latitude = dimension_clamp((Dimension) quad_node->mean_latitude,
+                                    qrect->edge0.latitude,
+                                    qrect->edge1.latitude),
+        .longitude = dimension_clamp((Dimension) quad_node->mean_longitude,
+                                     qrect->edge0.longitude,
+                                     qrect->edge1.longitude)
+    };
+    *radius = cluster_radius(db, (Dimension)
+                             sqrt(quad_node->square_deviations /
+                                  (double) quad_node->sub_slots));
+    return 1;
+}
+
+typedef struct FindNearIntCBContext_ {    
+    const PanDB *db;
+    const Position2D *position;
+    Meters distance;
+    SubSlots limit;
+    FindNearCB cb;
+    FindNearClusterCB cluster_cb;
+    void *context_cb;
+} FindNearIntCBContext;
+
+static int find_near_in_bucket(FindNearIntCBContext * const context,
+                               const Bucket * const bucket)
+{
+    const NbSlots busy_slots = bucket->busy_slots;
+    Meters distances[DISTANCES_BATCH_SIZE];
+    Slot *scanned_slot;
+    NbSlots offset;
+    NbSlots count;
+    NbSlots i;
+    int ret;
+    
+    for (offset = (NbSlots) 0U; offset < busy_slots; offset += count) {
+        count = busy_slots - offset;
+        if (count > DISTANCES_BATCH_SIZE) {
+            count = DISTANCES_BATCH_SIZE;
+        }
+        if (batch_distances(context->db, context->position, bucket,
+                            offset, count, context->distance,
+                            distances) != 0) {
+            return -1;
+        }
+        for (i = (NbSlots) 0U; i < count; i++) {
+            if (distances[i] > context->distance) {
+                continue;
+            }
+            scanned_slot = DEREF_SLOT(context->db, bucket->slots[offset + i]);
+            assert(scanned_slot->key_node != NULL_REF);
+            if (context->cb != NULL) {
+                if ((ret = context->cb(context->context_cb,
+                                       scanned_slot, distances[i])) != 0) {
+                    return ret;
+                }
+                if (context->limit-- <= (SubSlots) 1U) {
+                    return 1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+static int find_near_cluster(FindNearIntCBContext * const context,
+                             const QuadNode * const quad_node,
+                             const Rectangle2D * const qrect)
+{
+    Position2D centroid;
+    Meters radius;
+    int ret;
+    
+    if (get_quad_node_cluster(context->db, quad_node, qrect,
+                              &centroid, &radius) == 0) {
+        return 0;
+    }
+    if ((ret = context->cluster_cb(context->context_cb, &centroid, radius,
+                                   (NbSlots) quad_node->sub_slots)) != 0) {
+        return ret;
+    }
+    if (context->limit-- <= (SubSlots) 1U) {
+        return 1;
+    }
+    return 0;
+}
+
+static int find_near_in_zone(Rectangle2D * const matching_rect,
+                             PntStack *stack_inspect,
+                             const PanDB * const db,
+                             FindNearCB cb,
+                             FindNearClusterCB cluster_cb,
+                             void * const context_cb,
+                             const Position2D * const position,
+                             const Meters distance,
+                             const SubSlots limit, const Dimension epsilon)
+{
+    const _Bool cluster = (epsilon > (Dimension) 0.0 && cluster_cb != NULL);
+    SubSlots max_nb_slots_without_clustering = (SubSlots) 0U;
+    const QuadNode *scanned_node;
+    Rectangle2D scanned_qbounds = db->qbounds;
+    Rectangle2D scanned_children_qbounds[4];
+    unsigned int t;
+    Node *scanned_node_child;
+    Rectangle2D *scanned_child_qbound;
+    QuadNodeWithBounds qnb;
+    QuadNodeWithBounds *sqnb;    
+    
+    scanned_node = &db->root;    
+    FindNearIntCBContext context = {
+        .db = db,
+        .position = position,
+        .distance = distance,
+        .cb = cb,
+        .cluster_cb = cluster_cb,
+        .context_cb = context_cb,
+        .limit = limit
+    };
+    for (;;) {
+        assert(scanned_node->type == NODE_TYPE_QUAD_NODE);
+        get_qrects_from_qbounds(scanned_children_qbounds, &scanned_qbounds);
+        if (cluster != 0) {
+            max_nb_slots_without_clustering = context.limit / (SubSlots) 4U;
+        }
+        t = 0U;
+        do {
+            scanned_node_child = scanned_node->nodes[t];
+            scanned_child_qbound = &scanned_children_qbounds[t];
+            if (rectangle2d_intersect(scanned_child_qbound,
+                                      matching_rect) == 0) {
+                continue;
+            }
+            if (scanned_node_child->bare_node.type == NODE_TYPE_QUAD_NODE &&
+                cluster != 0 &&
+                scanned_node_child->quad_node.sub_slots >
+                max_nb_slots_without_clustering &&
+                scanned_child_qbound->edge1.latitude -
+                scanned_child_qbound->edge0.latitude < epsilon &&
+                scanned_child_qbound->edge1.longitude -
+                scanned_child_qbound->edge0.longitude < epsilon &&
+                max_distance_to_rect(db, position,
+                                     scanned_child_qbound) <= distance) {
+                const int ret =
+                    find_near_cluster(&context,
+                                      &scanned_node_child->quad_node,
+                                      scanned_child_qbound);
+                if (ret != 0) {
+                    return ret;
+                }
+                continue;
+            }
+            if (scanned_node_child->bare_node.type == NODE_TYPE_BUCKET_NODE) {
+                const Bucket *bucket = &scanned_node_child->bucket_node.bucket;
+                const int ret = find_near_in_bucket(&context, bucket);
+                if (ret != 0) {
+                    return ret;
+                }
+                continue;
+            }
+            assert(scanned_node_child->bare_node.type == NODE_TYPE_QUAD_NODE);
+            qnb.quad_node = &scanned_node_child->quad_node;
+            qnb.qrect = *scanned_child_qbound;
+            push_pnt_stack(stack_inspect, &qnb);
+        } while (t++ < 3U);
+        sqnb = pop_pnt_stack(stack_inspect);
+        if (sqnb == NULL) {
+            break;
+        }
+        scanned_node = sqnb->quad_node;
+        scanned_qbounds = sqnb->qrect;
+    }
+    return 0;
+}
+
+static int find_near_in_morton_batch(void * const context_,
+                                     const Dimension * const latitudes,
+                                     const Dimension * const longitudes,
+                                     Slot * const * const slots,
+                                     const NbSlots count)
+{
+    FindNearIntCBContext * const context = context_;
+    Meters distances[DISTANCES_BATCH_SIZE];
+    NbSlots i;
+    int ret;
+    
+    batch_position_distances(context->db, context->position,
+                             latitudes, longitudes, distances, count);
+    for (i = (NbSlots) 0U; i < count; i++) {
+        if (distances[i] > context->distance) {
+            continue;
+        }
+        assert(slots[i]->key_node != NULL_REF);
+        if (context->cb == NULL) {
+            continue;
+        }
+        if ((ret = context->cb(context->context_cb,
+                               slots[i], distances[i])) != 0) {
+            return ret;
+        }
+        if (context->limit-- <= (SubSlots) 1U) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int find_near_in_morton_cell(void * const context_,
+                                    const Rectangle2D * const cell)
+{
+    FindNearIntCBContext * const context = context_;
+    
+    return max_distance_to_rect(context->db, context->position,
+                                cell) <= context->distance;
+}
+
+static int find_near_in_morton_cluster(void * const context_,
+                                       const Position2D * const centroid,
+                                       const Dimension deviation,
+                                       const NbSlots children)
+{
+    FindNearIntCBContext * const context = context_;
+    int ret;
+    
+    if ((ret = context->cluster_cb(context->context_cb, centroid,
+                                   cluster_radius(context->db, deviation),
+                                   children)) != 0) {
+        return ret;
+    }
+    if (context->limit-- <= (SubSlots) 1U) {
+        return 1;
+    }
+    return 0;
+}
+
+static int find_near_in_morton_index(const PanDB * const db, FindNearCB cb,
+                                     FindNearClusterCB cluster_cb,
+                                     void * const context_cb,
+                                     const Position2D * const position,
+                                     const Meters distance,
+                                     const SubSlots limit,
+                                     const Dimension epsilon)
+{
+    const _Bool cluster = (epsilon > (Dimension) 0.0 && cluster_cb != NULL);
+    FindNearIntCBContext context = {
+        .db = db,
+        .position = position,
+        .distance = distance,
+        .cb = cb,
+        .cluster_cb = cluster_cb,
+        .context_cb = context_cb,
+        .limit = limit
+    };
+    Rectangle2D matching_rects[4];
+    unsigned int nb_zones;
+    unsigned int t;
+    int ret = 0;
+    
+    nb_zones = find_radius_zones(db, position, distance, 0.0,
+                                 matching_rects);
+    for (t = 0U; ret == 0 && t < nb_zones; t++) {
+        if (cluster == 0) {
+            ret = scan_morton_index(db, &matching_rects[t],
+                                    find_near_in_morton_batch, &context);
+            continue;
+        }
+        ret = cluster_morton_index(db, &matching_rects[t], epsilon,
+                                   context.limit / (SubSlots) 4U,
+                                   find_near_in_morton_batch,
+                                   find_near_in_morton_cell,
+                                   find_near_in_morton_cluster, &context);
+    }
+    return ret;
+}
+
+int find_near(const PanDB * const db,
+              FindNearCB cb, FindNearClusterCB cluster_cb,
+              void * const context_cb,
+              const Position2D * const position, const Meters distance,
+              const SubSlots limit, const Dimension epsilon)
+{
+    if (limit <= (SubSlots) 0) {
+        return 0;
+    }
+    if (db->index_type == INDEX_TYPE_MORTON) {
+        return find_near_in_morton_index(db, cb, cluster_cb, context_cb,
+                                         position, distance, limit, epsilon);
+    }
+    Rectangle2D matching_rects[4];
+    Rectangle2D *matching_rect = &matching_rects[0];    
+    PntStack *stack_inspect;
+
+    Dimension dlat = distance / DEG_AVG_DISTANCE;
+    Dimension dlon = distance /
+        fabs(cosf((float) DEG_TO_RAD(position->latitude)) * DEG_AVG_DISTANCE);
+    if (db->layer_type == LAYER_TYPE_FLAT ||
+        db->layer_type == LAYER_TYPE_FLATWRAP) {
+        dlat = dlon = distance;
+    }
+    const Rectangle2D rect = { {
+        position->latitude - dlat, position->longitude - dlon
+    }, {
+        position->latitude + dlat, position->longitude + dlon
+    } };
+    unsigned int nb_zones;
+    if (db->layer_type == LAYER_TYPE_FLAT) {
+        matching_rects[0] = rect;        
+        nb_zones = 1U;
+    } else {
+        nb_zones = find_zones(db, &rect, matching_rects);
+    }
+    assert(nb_zones >= 1U);
+    assert(nb_zones <= 4U);
+    stack_inspect = new_pnt_stack(DEFAULT_STACK_SIZE_FOR_SEARCHES,
+                                  sizeof(QuadNodeWithBounds));
+    if (stack_inspect == NULL) {
+        return -1;
+    }
+    assert(matching_rect == &matching_rects[0]);
+    int ret;
+    do {
+        ret = find_near_in_zone(matching_rect,
+                                stack_inspect,
+                                db,
+                                cb,
+                                cluster_cb,
+                                context_cb,
+                                position,
+                                distance,
+                                limit,
+                                epsilon);
+        matching_rect++;
+    } while (ret == 0 && --nb_zones > 0U);
+    free_pnt_stack(stack_inspect);
+    
+    return ret;
+}
+
+static int count_near_in_bucket(const PanDB * const db,
+                                const Position2D * const position,
+                                const Meters distance,
+                                const Bucket * const bucket,
+                                SubSlots * const count)
+{
+    const NbSlots busy_slots = bucket->busy_slots;
+    Meters distances[DISTANCES_BATCH_SIZE];
+    NbSlots offset;
+    NbSlots nb;
+    NbSlots i;
+    
+    for (offset = (NbSlots) 0U; offset < busy_slots; offset += nb) {
+        nb = busy_slots - offset;
+        if (nb > DISTANCES_BATCH_SIZE) {
+            nb = DISTANCES_BATCH_SIZE;
+        }
+        if (batch_distances(db, position, bucket, offset, nb, distance,
+                            distances) != 0) {
+            return -1;
+        }
+        for (i = (NbSlots) 0U; i < nb; i++) {
+            if (distances[i] <= distance) {
+                (*count)++;
+            }
+        }
+    }
+    return 0;
+}
+
+typedef struct CountNearIntCBContext_ {
+    const PanDB *db;
+    const Position2D *position;
+    Meters distance;
+    SubSlots *count;
+} CountNearIntCBContext;
+
+static int count_near_in_morton_batch(void * const context_,
+                                      const Dimension * const latitudes,
+                                      const Dimension * const longitudes,
+                                      Slot * const * const slots,
+                                      const NbSlots count)
+{
+    CountNearIntCBContext * const context = context_;
+    Meters distances[DISTANCES_BATCH_SIZE];
+    NbSlots i;
+    
+    (void) slots;
+    batch_position_distances(context->db, context->position,
+                             latitudes, longitudes, distances, count);
+    for (i = (NbSlots) 0U; i < count; i++) {
+        if (distances[i] <= context->distance) {
+            (*context->count)++;
+        }
+    }
+    return 0;
+}
+
+static int count_near_in_morton_index(const PanDB * const db,
+                                      const Position2D * const position,
+                                      const Meters distance,
+                                      SubSlots * const count)
+{
+    CountNearIntCBContext context = {
+        .db = db,
+        .position = position,
+        .distance = distance,
+        .count = count
+    };
+    Rectangle2D matching_rects[4];
+    unsigned int nb_zones;
+    unsigned int t;
+    int ret = 0;
+    
+    // Counts have to agree with the distances reported to clients, so the
+    // zones also cover the rounding error of the fast kernels.
+    nb_zones = find_radius_zones(db, position, distance,
+                                 db->accuracy == ACCURACY_GC ||
+                                 db->accuracy == ACCURACY_FAST ?
+                                 (double) DISTANCES_GC_CHORD_MARGIN :
+                                 (double) DISTANCES_CHORD_MARGIN,
+                                 matching_rects);
+    for (t = 0U; ret == 0 && t < nb_zones; t++) {
+        ret = scan_morton_index(db, &matching_rects[t],
+                                count_near_in_morton_batch, &context);
+    }
+    return ret;
+}
+
+int count_near(const PanDB * const db,
+               const Position2D * const position, const Meters distance,
+               SubSlots * const count)
+{
+    const QuadNode *scanned_node = &db->root;
+    Rectangle2D scanned_qbounds = db->qbounds;
+    Rectangle2D scanned_children_qbounds[4];
+    Rectangle2D *scanned_child_qbound;
+    QuadNodeWithBounds qnb;
+    QuadNodeWithBounds *sqnb;
+    Node *scanned_node_child;
+    PntStack *stack_inspect;
+    unsigned int t;
+    int ret = 0;
+    
+    *count = (SubSlots) 0U;
+    if (db->index_type == INDEX_TYPE_MORTON) {
+        return count_near_in_morton_index(db, position, distance, count);
+    }
+    stack_inspect = new_pnt_stack(DEFAULT_STACK_SIZE_FOR_SEARCHES,
+                                  sizeof(QuadNodeWithBounds));
+    if (stack_inspect == NULL) {
+        return -1;
+    }
+    for (;;) {
+        assert(scanned_node->type == NODE_TYPE_QUAD_NODE);
+        get_qrects_from_qbounds(scanned_children_qbounds, &scanned_qbounds);
+        t = 0U;
+        do {
+            scanned_node_child = scanned_node->nodes[t];
+            scanned_child_qbound = &scanned_children_qbounds[t];
+            if (min_distance_to_rect(db, position,
+                                     scanned_child_qbound) > distance) {
+                continue;
+            }
+            if (scanned_node_child->bare_node.type == NODE_TYPE_BUCKET_NODE) {
+                const Bucket *bucket = &scanned_node_child->bucket_node.bucket;
+                if (max_distance_to_rect(db, position,
+                                         scanned_child_qbound) <= distance) {
+                    *count += (SubSlots) bucket->busy_slots;
+                } else if ((ret = count_near_in_bucket(db, position, distance,
+                                                       bucket, count)) != 0) {
+                    break;
+                }
+                continue;
+            }
+            assert(scanned_node_child->bare_node.type == NODE_TYPE_QUAD_NODE);
+            if (max_distance_to_rect(db, position,
+                                     scanned_child_qbound) <= distance) {
+                *count += scanned_node_child->quad_node.sub_slots;
+                continue;
+            }
+            qnb.quad_node = &scanned_node_child->quad_node;
+            qnb.qrect = *scanned_child_qbound;
+            push_pnt_stack(stack_inspect, &qnb);
+        } while (t++ < 3U);
+        if (ret != 0) {
+            break;
+        }
+        sqnb = pop_pnt_stack(stack_inspect);
+        if (sqnb == NULL) {
+            break;
+        }
+        scanned_node = sqnb->quad_node;
+        scanned_qbounds = sqnb->qrect;
+    }
+    free_pnt_stack(stack_inspect);
+    
+    return ret;
+}
+
+typedef struct FindInRectIntCBContext_ {    
+    const PanDB *db;
+    const Position2D *position;
+    const Rectangle2D *rect;
+    SubSlots limit;
+    FindInRectCB cb;
+    FindInRectClusterCB cluster_cb;
+    void *context_cb;
+} FindInRectIntCBContext;
+
+static int find_in_rect_in_bucket(FindInRectIntCBContext * const context,
+                                  const Bucket * const bucket)
+{
+    const NbSlots busy_slots = bucket->busy_slots;
+    const Rectangle2D * const rect = context->rect;
+    const _Bool geoidal = context->db->layer_type == LAYER_TYPE_SPHERICAL ||
+        context->db->layer_type == LAYER_TYPE_ELLIPSOIDAL;
+    Position2D scanned_position;
+    Slot *scanned_slot;
+    Meters cd;
+    NbSlots i;
+    int ret;
+    
+    for (i = (NbSlots) 0U; i < busy_slots; i++) {
+        scanned_position = bucket_position(bucket, i);
+        if (position_is_in_rect(&scanned_position, rect) == 0) {
+            continue;
+        }
+        if (context->limit <= (SubSlots) 0U) {
+            return 1;
+        }
+        context->limit--;
+        if (context->cb == NULL) {
+            continue;
+        }
+        if (geoidal != 0) {
+            cd = rhomboid_distance_between_geoidal_positions
+                (context->position, &scanned_position);
+        } else {
+            cd = distance_between_flat_positions(context->db,
+                                                 context->position,
+                                                 &scanned_position);
+        }
+        scanned_slot = DEREF_SLOT(context->db, bucket->slots[i]);
+        assert(scanned_slot->key_node != NULL_REF);
+        if ((ret = context->cb(context->context_cb,
+                               scanned_slot, cd)) != 0) {
+            return ret;
+        }
+    }
+    return 0;
+}
+
+static int find_in_rect_cluster_context_cb(void *context_, void *entry,
+                                           const size_t sizeof_entry)
+{
+    FindInRectIntCBContext *context = context_;
+    if (context->cluster_cb == NULL) {
+        return 0;
+    }
+    QuadNode *scanned_node = entry;
+    Position2D centroid;
+    Meters radius;
+    if (get_quad_node_cluster(context->db, scanned_node, context->rect,
+                              &centroid, &radius) == 0) {
+        return 0;
+    }
+    const NbSlots children = scanned_node->sub_slots;
+    (void) sizeof_entry;
+    
+    const int ret =
+        context->cluster_cb(context->context_cb, &centroid, radius, children);
+    if (ret != 0) {
+        return ret;
+    }
+    if (context->limit-- <= (SubSlots) 1U) {
+        return 1;
+    }
+    return 0;
+}
+
+static int find_in_rect_in_zone(Rectangle2D * const matching_rect,
+                                PntStack *stack_inspect,
+                                const PanDB * const db,
+                                FindInRectCB cb,
+                                FindInRectClusterCB cluster_cb,
+                                void * const context_cb,
+                                const Rectangle2D * const rect,
+                                const SubSlots limit, const Dimension epsilon)
+{
+    const Position2D rect_center = {
+        .latitude =
+        (rect->edge1.latitude + rect->edge0.latitude) / (Dimension) 2.0,
+        .longitude =
+        (rect->edge1.longitude + rect->edge0.longitude) / (Dimension) 2.0
+    };
+    const _Bool cluster = (epsilon > (Dimension) 0.0);
+    SubSlots max_nb_slots_without_clustering = (SubSlots) 0U;
+    Rectangle2D scanned_qbounds = db->qbounds;
+    const QuadNode *scanned_node;
+    Rectangle2D scanned_children_qbounds[4];
+    Rectangle2D *scanned_child_qbound;
+    QuadNodeWithBounds qnb;
+    QuadNodeWithBounds *sqnb;
+    Node *scanned_node_child;
+    unsigned int t;
+    
+    scanned_node = &db->root;
+    FindInRectIntCBContext context = {
+        .db = db,
+        .cb = cb,
+        .cluster_cb = cluster_cb,
+        .context_cb = context_cb,
+        .position = &rect_center,
+        .limit = limit
+    };
+    for (;;) {
+        assert(scanned_node->type == NODE_TYPE_QUAD_NODE);
+        get_qrects_from_qbounds(scanned_children_qbounds, &scanned_qbounds);
+        if (cluster != 0) {
+            max_nb_slots_without_clustering = context.limit / (SubSlots) 4U;
+        }
+        t = 0U;
+        do {
+            scanned_node_child = scanned_node->nodes[t];
+            scanned_child_qbound = &scanned_children_qbounds[t];
+            if (rectangle2d_intersect(scanned_child_qbound,
+                                      matching_rect) == 0) {
+                continue;
+            }
+            if (scanned_node_child->bare_node.type == NODE_TYPE_QUAD_NODE &&
+                cluster != 0 &&
+                scanned_node_child->quad_node.sub_slots >
+                max_nb_slots_without_clustering &&
+                fabsf(scanned_child_qbound->edge1.latitude -
+                      scanned_child_qbound->edge0.latitude) < epsilon &&
+                fabsf(scanned_child_qbound->edge1.longitude -
+                      scanned_child_qbound->edge0.longitude) < epsilon) {
+                context.rect = scanned_child_qbound;
+                const int ret = find_in_rect_cluster_context_cb
+                    (&context,
+                        (void *) scanned_node_child, sizeof *scanned_node_child);
+                if (ret != 0) {
+                    return ret;
+                }
+                continue;
+            }
+            if (scanned_node_child->bare_node.type == NODE_TYPE_BUCKET_NODE) {
+                const Bucket *bucket = &scanned_node_child->bucket_node.bucket;
+                context.rect = rect;
+                const int ret = find_in_rect_in_bucket(&context, bucket);
+                if (ret != 0) {
+                    return ret;
+                }
+                continue;
+            }
+            assert(scanned_node_child->bare_node.type == NODE_TYPE_QUAD_NODE);
+            qnb.quad_node = &scanned_node_child->quad_node;
+            qnb.qrect = *scanned_child_qbound;
+            push_pnt_stack(stack_inspect, &qnb);
+        } while (t++ < 3U);
+        sqnb = pop_pnt_stack(stack_inspect);
+        if (sqnb == NULL) {
+            break;
+        }
+        scanned_node = sqnb->quad_node;
+        scanned_qbounds = sqnb->qrect;
+    }
+    return 0;
+}
+
+static unsigned int find_rect_zones(const PanDB * const db,
+                                    const Rectangle2D * const rect,
+                                    Rectangle2D matching_rects[4])
+{
+    if (db->layer_type == LAYER_TYPE_FLAT) {
+        matching_rects[0] = *rect;
+        return 1U;
+    }
+    Rectangle2D orect = *rect;
+    if (orect.edge0.latitude > orect.edge1.latitude) {
+        orect.edge1.latitude +=
+            db->qbounds.edge1.latitude - db->qbounds.edge0.latitude;
+    }
+    if (orect.edge0.longitude > orect.edge1.longitude) {
+        orect.edge1.longitude +=
+            db->qbounds.edge1.longitude - db->qbounds.edge0.longitude;
+    }        
+    return find_zones(db, &orect, matching_rects);
+}
+
+static int find_in_rect_in_morton_batch(void * const context_,
+                                        const Dimension * const latitudes,
+                                        const Dimension * const longitudes,
+                                        Slot * const * const slots,
+                                        const NbSlots count)
+{
+    FindInRectIntCBContext * const context = context_;
+    const _Bool geoidal = context->db->layer_type == LAYER_TYPE_SPHERICAL ||
+        context->db->layer_type == LAYER_TYPE_ELLIPSOIDAL;
+    Position2D scanned_position;
+    Meters cd;
+    NbSlots i;
+    int ret;
+    
+    for (i = (NbSlots) 0U; i < count; i++) {
+        scanned_position.latitude = latitudes[i];
+        scanned_position.longitude = longitudes[i];
+        if (position_is_in_rect(&scanned_position, context->rect) == 0) {
+            continue;
+        }
+        if (context->limit <= (SubSlots) 0U) {
+            return 1;
+        }
+        context->limit--;
+        if (context->cb == NULL) {
+            continue;
+        }
+        if (geoidal != 0) {
+            cd = rhomboid_distance_between_geoidal_positions
+                (context->position, &scanned_position);
+        } else {
+            cd = distance_between_flat_positions(context->db,
+                                                 context->position,
+                                                 &scanned_position);
+        }
+        assert(slots[i]->key_node != NULL_REF);
+        if ((ret = context->cb(context->context_cb, slots[i], cd)) != 0) {
+            return ret;
+        }
+    }
+    return 0;
+}
+
+static int find_in_rect_in_morton_cluster(void * const context_,
+                                          const Position2D * const centroid,
+                                          const Dimension deviation,
+                                          const NbSlots children)
+{
+    FindInRectIntCBContext * const context = context_;
+    
+    if (context->limit <= (SubSlots) 0U) {
+        return 1;
+    }
+    context->limit--;
+    
+    return context->cluster_cb(context->context_cb, centroid,
+                               cluster_radius(context->db, deviation),
+                               children);
+}
+
+static int find_in_rect_in_morton_index(const PanDB * const db,
+                                        FindInRectCB cb,
+                                        FindInRectClusterCB cluster_cb,
+                                        void * const context_cb,
+                                        const SubSlots limit,
+                                        const Dimension epsilon,
+                                        const Rectangle2D * const
+                                        matching_rects,
+                                        const unsigned int nb_zones)
+{
+    const _Bool cluster = (epsilon > (Dimension) 0.0 && cluster_cb != NULL);
+    const Rectangle2D *matching_rect;
+    Position2D rect_center;
+    unsigned int t;
+    int ret = 0;
+    FindInRectIntCBContext context = {
+        .db = db,
+        .cb = cb,
+        .cluster_cb = cluster_cb,
+        .context_cb = context_cb,
+        .position = &rect_center,
+        .limit = limit
+    };
+    for (t = 0U; ret == 0 && t < nb_zones; t++) {
+        matching_rect = &matching_rects[t];
+        rect_center = (Position2D) {
+            .latitude = (matching_rect->edge1.latitude +
+                         matching_rect->edge0.latitude) / (Dimension) 2.0,
+            .longitude = (matching_rect->edge1.longitude +
+                          matching_rect->edge0.longitude) / (Dimension) 2.0
+        };
+        context.rect = matching_rect;
+        if (cluster == 0) {
+            ret = scan_morton_index(db, matching_rect,
+                                    find_in_rect_in_morton_batch, &context);
+            continue;
+        }
+        ret = cluster_morton_index(db, matching_rect, epsilon,
+                                   context.limit / (SubSlots) 4U,
+                                   find_in_rect_in_morton_batch, NULL,
+                                   find_in_rect_in_morton_cluster, &context);
+    }
+    return ret;
+}
+
+int find_in_rect(const PanDB * const db,
+                 FindInRectCB cb, FindInRectClusterCB cluster_cb,
+                 void * const context_cb,
+                 const Rectangle2D * const rect,
+                 const SubSlots limit, const Dimension epsilon)
+{
+    if (limit <= (SubSlots) 0) {
+        return 0;
+    }
+    Rectangle2D matching_rects[4];
+    Rectangle2D *matching_rect = &matching_rects[0];
+    PntStack *stack_inspect;
+    unsigned int nb_zones;
+    
+    nb_zones = find_rect_zones(db, rect, matching_rects);
+    assert(nb_zones >= 1U);
+    assert(nb_zones <= 4U);
+    if (db->index_type == INDEX_TYPE_MORTON) {
+        return find_in_rect_in_morton_index(db, cb, cluster_cb, context_cb,
+                                            limit, epsilon,
+                                            matching_rects, nb_zones);
+    }
+    stack_inspect = new_pnt_stack(DEFAULT_STACK_SIZE_FOR_SEARCHES,
+                                  sizeof(QuadNodeWithBounds));
+    if (stack_inspect == NULL) {
+        return -1;
+    }    
+    assert(matching_rect == &matching_rects[0]);
+    int ret;
+    do {
+        ret = find_in_rect_in_zone(matching_rect,
+                                   stack_inspect,
+                                   db,
+                                   cb,
+                                   cluster_cb,
+                                   context_cb,
+                                   matching_rect,
+                                   limit,
+                                   epsilon);
+        matching_rect++;
+    } while (ret == 0 && --nb_zones > 0U);    
+    free_pnt_stack(stack_inspect);
+
+    return ret;
+}
+
+static int rectangle2d_contains(const Rectangle2D * const outer,
+                                const Rectangle2D * const inner)
+{
+    if (inner->edge0.latitude >= outer->edge0.latitude &&
+        inner->edge0.longitude >= outer->edge0.longitude &&
+        inner->edge1.latitude <= outer->edge1.latitude &&
+        inner->edge1.longitude <= outer->edge1.longitude) {
+        return 1;
+    }
+    return 0;
+}
+
+static void count_in_rect_in_bucket(const Rectangle2D * const rect,
+                                    const Bucket * const bucket,
+                                    SubSlots * const count)
+{
+    Position2D scanned_position;
+    NbSlots i;
+    
+    for (i = (NbSlots) 0U; i < bucket->busy_slots; i++) {
+        scanned_position = bucket_position(bucket, i);
+        if (position_is_in_rect(&scanned_position, rect) != 0) {
+            (*count)++;
+        }
+    }
+}
+
+static void count_in_rect_in_zone(const Rectangle2D * const matching_rect,
+                                  PntStack *stack_inspect,
+                                  const PanDB * const db,
+                                  SubSlots * const count)
+{
+    const QuadNode *scanned_node = &db->root;
+    Rectangle2D scanned_qbounds = db->qbounds;
+    Rectangle2D scanned_children_qbounds[4];
+    Rectangle2D *scanned_child_qbound;
+    QuadNodeWithBounds qnb;
+    QuadNodeWithBounds *sqnb;
+    Node *scanned_node_child;
+    unsigned int t;
+    
+    for (;;) {
+        assert(scanned_node->type == NODE_TYPE_QUAD_NODE);
+        get_qrects_from_qbounds(scanned_children_qbounds, &scanned_qbounds);
+        t = 0U;
+        do {
+            scanned_node_child = scanned_node->nodes[t];
+            scanned_child_qbound = &scanned_children_qbounds[t];
+            if (rectangle2d_intersect(scanned_child_qbound,
+                                      matching_rect) == 0) {
+                continue;
+            }
+            if (scanned_node_child->bare_node.type == NODE_TYPE_BUCKET_NODE) {
+                const Bucket *bucket = &scanned_node_child->bucket_node.bucket;
+                if (rectangle2d_contains(matching_rect,
+                                         scanned_child_qbound) != 0) {
+                    *count += (SubSlots) bucket->busy_slots;
+                } else {
+                    count_in_rect_in_bucket(matching_rect, bucket, count);
+                }
+                continue;
+            }
+            assert(scanned_node_child->bare_node.type == NODE_TYPE_QUAD_NODE);
+            if (rectangle2d_contains(matching_rect,
+                                     scanned_child_qbound) != 0) {
+                *count += scanned_node_child->quad_node.sub_slots;
+                continue;
+            }
+            qnb.quad_node = &scanned_node_child->quad_node;
+            qnb.qrect = *scanned_child_qbound;
+            push_pnt_stack(stack_inspect, &qnb);
+        } while (t++ < 3U);
+        sqnb = pop_pnt_stack(stack_inspect);
+        if (sqnb == NULL) {
+            break;
+        }
+        scanned_node = sqnb->quad_node;
+        scanned_qbounds = sqnb->qrect;
+    }
+}
+
+typedef struct CountInRectIntCBContext_ {
+    const Rectangle2D *rect;
+    SubSlots *count;
+} CountInRectIntCBContext;
+
+static int count_in_rect_in_morton_batch(void * const context_,
+                                         const Dimension * const latitudes,
+                                         const Dimension * const longitudes,
+                                         Slot * const * const slots,
+                                         const NbSlots count)
+{
+    CountInRectIntCBContext * const context = context_;
+    Position2D scanned_position;
+    NbSlots i;
+    
+    (void) slots;
+    for (i = (NbSlots) 0U; i < count; i++) {
+        scanned_position.latitude = latitudes[i];
+        scanned_position.longitude = longitudes[i];
+        if (position_is_in_rect(&scanned_position, context->rect) != 0) {
+            (*context->count)++;
+        }
+    }
+    return 0;
+}
+
+int count_in_rect(const PanDB * const db, const Rectangle2D * const rect,
+                  SubSlots * const count)
+{
+    Rectangle2D matching_rects[4];
+    PntStack *stack_inspect;
+    unsigned int nb_zones;
+    unsigned int t;
+    
+    *count = (SubSlots) 0U;
+    nb_zones = find_rect_zones(db, rect, matching_rects);
+    assert(nb_zones >= 1U);
+    assert(nb_zones <= 4U);
+    if (db->index_type == INDEX_TYPE_MORTON) {
+        CountInRectIntCBContext context = { .count = count };
+        int ret = 0;
+        
+        for (t = 0U; ret == 0 && t < nb_zones; t++) {
+            context.rect = &matching_rects[t];
+            ret = scan_morton_index(db, context.rect,
+                                    count_in_rect_in_morton_batch, &context);
+        }
+        return ret;
+    }
+    stack_inspect = new_pnt_stack(DEFAULT_STACK_SIZE_FOR_SEARCHES,
+                                  sizeof(QuadNodeWithBounds));
+    if (stack_inspect == NULL) {
+        return -1;
+    }
+    for (t = 0U; t < nb_zones; t++) {
+        count_in_rect_in_zone(&matching_rects[t], stack_inspect, db, count);
+    }
+    free_pnt_stack(stack_inspect);
+    
+    return 0;
+}
+
+typedef struct GridInRectContext_ {
+    const PanDB *db;
+    Position2D origin;
+    Dimension cell_latitude;
+    Dimension cell_longitude;
+    Dimension wrap_latitude;
+    Dimension wrap_longitude;
+    NbSlots cols;
+    NbSlots rows;
+    SubSlots *counts;
+    GridInRectCB cb;
+    void *context_cb;
+} GridInRectContext;
+
+static NbSlots grid_axis_cell(Dimension offset, const Dimension wrap,
+                              const Dimension cell_size, const NbSlots nb_cells)
+{
+    NbSlots cell;
+    
+    if (offset < (Dimension) 0.0F) {
+        offset += wrap;
+    }
+    if (offset <= (Dimension) 0.0F || cell_size <= (Dimension) 0.0F) {
+        return (NbSlots) 0U;
+    }
+    cell = (NbSlots) (offset / cell_size);
+    if (cell >= nb_cells) {
+        cell = nb_cells - (NbSlots) 1U;
+    }
+    return cell;
+}
+
+static NbSlots grid_cell(const GridInRectContext * const grid,
+                         const Position2D * const position)
+{
+    const NbSlots row =
+        grid_axis_cell(position->latitude - grid->origin.latitude,
+                       grid->wrap_latitude, grid->cell_latitude, grid->rows);
+    const NbSlots col =
+        grid_axis_cell(position->longitude - grid->origin.longitude,
+                       grid->wrap_longitude, grid->cell_longitude, grid->cols);
+    
+    return row * grid->cols + col;
+}
+
+static int grid_single_cell(const GridInRectContext * const grid,
+                            const Rectangle2D * const qrect,
+                            NbSlots * const cell)
+{
+    const NbSlots cell0 = grid_cell(grid, &qrect->edge0);
+    
+    if (cell0 != grid_cell(grid, &qrect->edge1)) {
+        return 0;
+    }
+    *cell = cell0;
+    
+    return 1;
+}
+
+static int grid_in_rect_in_bucket(const Rectangle2D * const rect,
+                                  const Bucket * const bucket,
+                                  GridInRectContext * const grid)
+{
+    Position2D scanned_position;
+    NbSlots cell;
+    NbSlots i;
+    
+    for (i = (NbSlots) 0U; i < bucket->busy_slots; i++) {
+        scanned_position = bucket_position(bucket, i);
+        if (position_is_in_rect(&scanned_position, rect) == 0) {
+            continue;
+        }
+        cell = grid_cell(grid, &scanned_position);
+        grid->counts[cell]++;
+        if (grid->cb != NULL &&
+            grid->cb(grid->context_cb, DEREF_SLOT(grid->db, bucket->slots[i]),
+                     cell) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int grid_in_rect_in_zone(const Rectangle2D * const matching_rect,
+                                PntStack *stack_inspect,
+                                const PanDB * const db,
+                                GridInRectContext * const grid)
+{
+    const QuadNode *scanned_node = &db->root;
+    Rectangle2D scanned_qbounds = db->qbounds;
+    Rectangle2D scanned_children_qbounds[4];
+    Rectangle2D *scanned_child_qbound;
+    QuadNodeWithBounds qnb;
+    QuadNodeWithBounds *sqnb;
+    Node *scanned_node_child;
+    NbSlots cell;
+    unsigned int t;
+    
+    for (;;) {
+        assert(scanned_node->type == NODE_TYPE_QUAD_NODE);
+        get_qrects_from_qbounds(scanned_children_qbounds, &scanned_qbounds);
+        t = 0U;
+        do {
+            scanned_node_child = scanned_node->nodes[t];
+            scanned_child_qbound = &scanned_children_qbounds[t];
+            if (rectangle2d_intersect(scanned_child_qbound,
+                                      matching_rect) == 0) {
+                continue;
+            }
+            const _Bool single_cell = grid->cb == NULL &&
+                rectangle2d_contains(matching_rect,
+                                     scanned_child_qbound) != 0 &&
+                grid_single_cell(grid, scanned_child_qbound, &cell) != 0;
+            if (scanned_node_child->bare_node.type == NODE_TYPE_BUCKET_NODE) {
+                const Bucket *bucket = &scanned_node_child->bucket_node.bucket;
+                if (single_cell != 0) {
+                    grid->counts[cell] += (SubSlots) bucket->busy_slots;
+                } else if (grid_in_rect_in_bucket(matching_rect, bucket,
+                                                  grid) != 0) {
+                    return -1;
+                }
+                continue;
+            }
+            assert(scanned_node_child->bare_node.type == NODE_TYPE_QUAD_NODE);
+            if (single_cell != 0) {
+                grid->counts[cell] += scanned_node_child->quad_node.sub_slots;
+                continue;
+            }
+            qnb.quad_node = &scanned_node_child->quad_node;
+            qnb.qrect = *scanned_child_qbound;
+            push_pnt_stack(stack_inspect, &qnb);
+        } while (t++ < 3U);
+        sqnb = pop_pnt_stack(stack_inspect);
+        if (sqnb == NULL) {
+            break;
+        }
+        scanned_node = sqnb->quad_node;
+        scanned_qbounds = sqnb->qrect;
+    }
+    return 0;
+}
+
+typedef struct GridInRectIntCBContext_ {
+    const Rectangle2D *rect;
+    GridInRectContext *grid;
+} GridInRectIntCBContext;
+
+static int grid_in_rect_in_morton_batch(void * const context_,
+                                        const Dimension * const latitudes,
+                                        const Dimension * const longitudes,
+                                        Slot * const * const slots,
+                                        const NbSlots count)
+{
+    GridInRectIntCBContext * const context = context_;
+    GridInRectContext * const grid = context->grid;
+    Position2D scanned_position;
+    NbSlots cell;
+    NbSlots i;
+    
+    for (i = (NbSlots) 0U; i < count; i++) {
+        scanned_position.latitude = latitudes[i];
+        scanned_position.longitude = longitudes[i];
+        if (position_is_in_rect(&scanned_position, context->rect) == 0) {
+            continue;
+        }
+        cell = grid_cell(grid, &scanned_position);
+        grid->counts[cell]++;
+        if (grid->cb != NULL &&
+            grid->cb(grid->context_cb, slots[i], cell) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int grid_in_rect(const PanDB * const db, const Rectangle2D * const rect,
+                 const NbSlots cols, const NbSlots rows,
+                 SubSlots * const counts,
+                 GridInRectCB cb, void * const context_cb)
+{
+    Rectangle2D matching_rects[4];
+    PntStack *stack_inspect;
+    Dimension height = rect->edge1.latitude - rect->edge0.latitude;
+    Dimension width = rect->edge1.longitude - rect->edge0.longitude;
+    unsigned int nb_zones;
+    unsigned int t;
+    int ret = 0;
+    
+    assert(cols > (NbSlots) 0U);
+    assert(rows > (NbSlots) 0U);
+    memset(counts, 0, (size_t) cols * (size_t) rows * sizeof *counts);
+    GridInRectContext grid = {
+        .db = db,
+        .origin = rect->edge0,
+        .wrap_latitude = (Dimension) 0.0F,
+        .wrap_longitude = (Dimension) 0.0F,
+        .cols = cols,
+        .rows = rows,
+        .counts = counts,
+        .cb = cb,
+        .context_cb = context_cb
+    };
+    if (db->layer_type != LAYER_TYPE_FLAT) {
+        grid.wrap_latitude =
+            db->qbounds.edge1.latitude - db->qbounds.edge0.latitude;
+        grid.wrap_longitude =
+            db->qbounds.edge1.longitude - db->qbounds.edge0.longitude;
+        if (height < (Dimension) 0.0F) {
+            height += grid.wrap_latitude;
+        }
+        if (width < (Dimension) 0.0F) {
+            width += grid.wrap_longitude;
+        }
     }
+    grid.cell_latitude = height / (Dimension) rows;
+    grid.cell_longitude = width / (Dimension) cols;
+    nb_zones = find_rect_zones(db, rect, matching_rects);
     assert(nb_zones >= 1U);
     assert(nb_zones <= 4U);
+    if (db->index_type == INDEX_TYPE_MORTON) {
+        GridInRectIntCBContext context = { .grid = &grid };
+        
+        for (t = 0U; ret == 0 && t < nb_zones; t++) {
+            context.rect = &matching_rects[t];
+            ret = scan_morton_index(db, context.rect,
+                                    grid_in_rect_in_morton_batch, &context);
+        }
+        return ret;
+    }
     stack_inspect = new_pnt_stack(DEFAULT_STACK_SIZE_FOR_SEARCHES,
                                   sizeof(QuadNodeWithBounds));
     if (stack_inspect == NULL) {
         return -1;
     }
-    assert(matching_rect == &matching_rects[0]);
-    int ret;
-    do {
-        ret = find_near_in_zone(matching_rect,
-                                stack_inspect,
-                                db,
-                                cb,
-                                context_cb,
-                                position,
-                                distance,
-                                limit);
-        matching_rect++;
-    } while (ret == 0 && --nb_zones > 0U);
+    for (t = 0U; ret == 0 && t < nb_zones; t++) {
+        ret = grid_in_rect_in_zone(&matching_rects[t], stack_inspect,
+                                   db, &grid);
+    }
     free_pnt_stack(stack_inspect);
     
     return ret;
 }
 
-typedef struct FindInRectIntCBContext_ {    
+typedef enum PolygonCover_ {
+    POLYGON_COVER_NONE, POLYGON_COVER_PARTIAL, POLYGON_COVER_FULL
+} PolygonCover;
+
+typedef struct PolygonQuadNode_ {
+    const QuadNode *quad_node;
+    Rectangle2D qrect;
+    _Bool covered;
+} PolygonQuadNode;
+
+typedef struct FindInPolygonIntCBContext_ {
     const PanDB *db;
-    const Position2D *position;
-    const Rectangle2D *rect;
+    const Position2D *vertices;
+    NbSlots nb_vertices;
+    Rectangle2D bounds;
+    Position2D center;
     SubSlots limit;
-    FindInRectCB cb;
-    FindInRectClusterCB cluster_cb;
+    FindInPolygonCB cb;
     void *context_cb;
-} FindInRectIntCBContext;
+} FindInPolygonIntCBContext;
 
-static int find_in_rect_context_cb(void *context_, void *entry,
-                                   const size_t sizeof_entry)
+int position_is_in_polygon(const Position2D * const position,
+                           const Position2D * const vertices,
+                           const NbSlots nb_vertices)
 {
-    FindInRectIntCBContext *context = context_;
-    Slot *scanned_slot = entry;
-    Meters cd;
+    const Position2D *v0 = &vertices[nb_vertices - (NbSlots) 1U];
+    const Position2D *v1;
+    NbSlots i;
+    int inside = 0;
     
-    (void) sizeof_entry;
-    if (position_is_in_rect(&scanned_slot->position, context->rect) == 0) {
-        return 0;
-    }
-    if (context->db->layer_type == LAYER_TYPE_SPHERICAL ||
-        context->db->layer_type == LAYER_TYPE_ELLIPSOIDAL) {
-        cd = rhomboid_distance_between_geoidal_positions
-            (context->position, &scanned_slot->position);
-    } else {
-        cd = distance_between_flat_positions(context->db,
-                                             context->position,
-                                             &scanned_slot->position);
+    for (i = (NbSlots) 0U; i < nb_vertices; i++) {
+        v1 = &vertices[i];
+        if ((v1->latitude > position->latitude) !=
+            (v0->latitude > position->latitude) &&
+            position->longitude <
+            (v0->longitude - v1->longitude) *
+            (position->latitude - v1->latitude) /
+            (v0->latitude - v1->latitude) + v1->longitude) {
+            inside = !inside;
+        }
+        v0 = v1;
     }
-    if (scanned_slot->key_node != NULL) {
-        if (context->limit <= (SubSlots) 0U) {
-            return 1;
+    return inside;
+}
+
+static int segment_intersects_rect(const Position2D * const p0,
+                                   const Position2D * const p1,
+                                   const Rectangle2D * const rect)
+{
+    const double dx = (double) p1->longitude - (double) p0->longitude;
+    const double dy = (double) p1->latitude - (double) p0->latitude;
+    const double p[4] = { -dx, dx, -dy, dy };
+    const double q[4] = {
+        (double) p0->longitude - (double) rect->edge0.longitude,
+        (double) rect->edge1.longitude - (double) p0->longitude,
+        (double) p0->latitude - (double) rect->edge0.latitude,
+        (double) rect->edge1.latitude - (double) p0->latitude
+    };
+    double t0 = 0.0;
+    double t1 = 1.0;
+    double t;
+    unsigned int i;
+    
+    for (i = 0U; i < 4U; i++) {
+        if (p[i] == 0.0) {
+            if (q[i] < 0.0) {
+                return 0;
+            }
+            continue;
         }
-        context->limit--;
-        if (context->cb != NULL) {
-            const int ret =
-                context->cb(context->context_cb, scanned_slot, cd);
-            if (ret != 0) {
-                return ret;
+        t = q[i] / p[i];
+        if (p[i] < 0.0) {
+            if (t > t1) {
+                return 0;
+            }
+            if (t > t0) {
+                t0 = t;
+            }
+        } else {
+            if (t < t0) {
+                return 0;
+            }
+            if (t < t1) {
+                t1 = t;
             }
         }
-    } else {
-        fprintf(stderr, "=== [NULL KEY] => %.3f/%.3f (%.2f)\n",
-                scanned_slot->position.latitude,
-                scanned_slot->position.longitude,
-                cd);
     }
-    return 0;
+    return 1;
 }
 
-static int find_in_rect_cluster_context_cb(void *context_, void *entry,
-                                           const size_t sizeof_entry)
+static PolygonCover polygon_cover(const FindInPolygonIntCBContext * const
+                                  context, const Rectangle2D * const qrect)
 {
-    FindInRectIntCBContext *context = context_;
-    if (context->cluster_cb == NULL) {
-        return 0;
+    const Position2D *v0 = &context->vertices[context->nb_vertices -
+                                              (NbSlots) 1U];
+    const Position2D *v1;
+    NbSlots i;
+    
+    if (rectangle2d_intersect(qrect, &context->bounds) == 0) {
+        return POLYGON_COVER_NONE;
     }
-    QuadNode *scanned_node = entry;
-    const Rectangle2D * const rect = context->rect;
-    const Position2D center = {
-        .latitude = (rect->edge1.latitude + rect->edge0.latitude) / 2.0,
-        .longitude = (rect->edge1.longitude + rect->edge0.longitude) / 2.0
+    for (i = (NbSlots) 0U; i < context->nb_vertices; i++) {
+        v1 = &context->vertices[i];
+        if (segment_intersects_rect(v0, v1, qrect) != 0) {
+            return POLYGON_COVER_PARTIAL;
+        }
+        v0 = v1;
+    }
+    const Position2D qrect_center = {
+        .latitude = (qrect->edge0.latitude + qrect->edge1.latitude) / 2.0F,
+        .longitude = (qrect->edge0.longitude + qrect->edge1.longitude) / 2.0F
     };
-    if (position_is_in_rect(&center, context->rect) == 0) {
-        return 0;
-    }    
-    const Dimension distance =
-        (fabsf(center.latitude - rect->edge0.latitude) +
-            fabsf(center.longitude - rect->edge0.longitude)) / 2.0;
-    Meters radius;
-    if (context->db->layer_type == LAYER_TYPE_SPHERICAL ||
-        context->db->layer_type == LAYER_TYPE_ELLIPSOIDAL) {
-        radius = geoidal_distance_to_meters(distance);
-    } else {
-        radius = (Meters) distance;
+    if (position_is_in_polygon(&qrect_center, context->vertices,
+                               context->nb_vertices) != 0) {
+        return POLYGON_COVER_FULL;
     }
-    assert(scanned_node->type == NODE_TYPE_QUAD_NODE);
-    const NbSlots children = scanned_node->sub_slots;
-    (void) sizeof_entry;
+    return POLYGON_COVER_NONE;
+}
+
+static int find_in_polygon_in_bucket(FindInPolygonIntCBContext * const context,
+                                     const Bucket * const bucket,
+                                     const _Bool covered)
+{
+    const _Bool geoidal = context->db->layer_type == LAYER_TYPE_SPHERICAL ||
+        context->db->layer_type == LAYER_TYPE_ELLIPSOIDAL;
+    Position2D scanned_position;
+    Slot *scanned_slot;
+    Meters cd;
+    NbSlots i;
+    int ret;
     
-    const int ret =
-        context->cluster_cb(context->context_cb, &center, radius, children);
-    if (ret != 0) {
-        return ret;
+    for (i = (NbSlots) 0U; i < bucket->busy_slots; i++) {
+        scanned_position = bucket_position(bucket, i);
+        if (covered == 0 &&
+            (position_is_in_rect(&scanned_position, &context->bounds) == 0 ||
+             position_is_in_polygon(&scanned_position, context->vertices,
+                                    context->nb_vertices) == 0)) {
+            continue;
+        }
+        if (context->limit <= (SubSlots) 0U) {
+            return 1;
+        }
+        context->limit--;
+        if (geoidal != 0) {
+            cd = rhomboid_distance_between_geoidal_positions
+                (&context->center, &scanned_position);
+        } else {
+            cd = distance_between_flat_positions(context->db,
+                                                 &context->center,
+                                                 &scanned_position);
+        }
+        scanned_slot = DEREF_SLOT(context->db, bucket->slots[i]);
+        assert(scanned_slot->key_node != NULL_REF);
+        if ((ret = context->cb(context->context_cb,
+                               scanned_slot, cd)) != 0) {
+            return ret;
+        }
     }
-    if (context->limit-- <= (SubSlots) 1U) {
-        return 1;
+    return 0;
+}
+
+static int find_in_polygon_in_morton_batch(void * const context_,
+                                           const Dimension * const latitudes,
+                                           const Dimension * const longitudes,
+                                           Slot * const * const slots,
+                                           const NbSlots count)
+{
+    FindInPolygonIntCBContext * const context = context_;
+    const _Bool geoidal = context->db->layer_type == LAYER_TYPE_SPHERICAL ||
+        context->db->layer_type == LAYER_TYPE_ELLIPSOIDAL;
+    Position2D scanned_position;
+    Meters cd;
+    NbSlots i;
+    int ret;
+    
+    for (i = (NbSlots) 0U; i < count; i++) {
+        scanned_position.latitude = latitudes[i];
+        scanned_position.longitude = longitudes[i];
+        if (position_is_in_rect(&scanned_position, &context->bounds) == 0 ||
+            position_is_in_polygon(&scanned_position, context->vertices,
+                                   context->nb_vertices) == 0) {
+            continue;
+        }
+        if (context->limit <= (SubSlots) 0U) {
+            return 1;
+        }
+        context->limit--;
+        if (geoidal != 0) {
+            cd = rhomboid_distance_between_geoidal_positions
+                (&context->center, &scanned_position);
+        } else {
+            cd = distance_between_flat_positions(context->db,
+                                                 &context->center,
+                                                 &scanned_position);
+        }
+        assert(slots[i]->key_node != NULL_REF);
+        if ((ret = context->cb(context->context_cb, slots[i], cd)) != 0) {
+            return ret;
+        }
     }
     return 0;
 }
 
-static int find_in_rect_in_zone(Rectangle2D * const matching_rect,
-                                PntStack *stack_inspect,
-                                const PanDB * const db,
-                                FindInRectCB cb,
-                                FindInRectClusterCB cluster_cb,
-                                void * const context_cb,
-                                const Rectangle2D * const rect,
-                                const SubSlots limit, const Dimension epsilon)
+int find_in_polygon(const PanDB * const db,
+                    FindInPolygonCB cb, void * const context_cb,
+                    const Position2D * const vertices,
+                    const NbSlots nb_vertices, const SubSlots limit)
 {
-    const Position2D rect_center = {
-        .latitude =
-        (rect->edge1.latitude + rect->edge0.latitude) / (Dimension) 2.0,
-        .longitude =
-        (rect->edge1.longitude + rect->edge0.longitude) / (Dimension) 2.0
-    };
-    const _Bool cluster = (epsilon > (Dimension) 0.0);
-    SubSlots max_nb_slots_without_clustering = (SubSlots) 0U;
+    const QuadNode *scanned_node = &db->root;
     Rectangle2D scanned_qbounds = db->qbounds;
-    const QuadNode *scanned_node;
+    _Bool covered = 0;
+    PntStack *stack_inspect;
     Rectangle2D scanned_children_qbounds[4];
-    Rectangle2D *scanned_child_qbound;
-    QuadNodeWithBounds qnb;
-    QuadNodeWithBounds *sqnb;
+    PolygonQuadNode pqn;
+    PolygonQuadNode *spqn;
     Node *scanned_node_child;
+    PolygonCover cover;
+    NbSlots i;
     unsigned int t;
+    int ret = 0;
     
-    scanned_node = &db->root;
-    FindInRectIntCBContext context = {
+    assert(nb_vertices >= (NbSlots) 3U);
+    if (limit <= (SubSlots) 0) {
+        return 0;
+    }
+    FindInPolygonIntCBContext context = {
         .db = db,
+        .vertices = vertices,
+        .nb_vertices = nb_vertices,
+        .bounds = { vertices[0], vertices[0] },
+        .limit = limit,
         .cb = cb,
-        .cluster_cb = cluster_cb,
-        .context_cb = context_cb,
-        .position = &rect_center,
-        .limit = limit
+        .context_cb = context_cb
     };
+    for (i = (NbSlots) 1U; i < nb_vertices; i++) {
+        context.bounds.edge0.latitude =
+            dimension_min(context.bounds.edge0.latitude,
+                          vertices[i].latitude);
+        context.bounds.edge0.longitude =
+            dimension_min(context.bounds.edge0.longitude,
+                          vertices[i].longitude);
+        context.bounds.edge1.latitude =
+            dimension_max(context.bounds.edge1.latitude,
+                          vertices[i].latitude);
+        context.bounds.edge1.longitude =
+            dimension_max(context.bounds.edge1.longitude,
+                          vertices[i].longitude);
+    }
+    context.center = (Position2D) {
+        .latitude = (context.bounds.edge0.latitude +
+                     context.bounds.edge1.latitude) / 2.0F,
+        .longitude = (context.bounds.edge0.longitude +
+                      context.bounds.edge1.longitude) / 2.0F
+    };
+    if (db->index_type == INDEX_TYPE_MORTON) {
+        return scan_morton_index(db, &context.bounds,
+                                 find_in_polygon_in_morton_batch, &context);
+    }
+    stack_inspect = new_pnt_stack(DEFAULT_STACK_SIZE_FOR_SEARCHES,
+                                  sizeof(PolygonQuadNode));
+    if (stack_inspect == NULL) {
+        return -1;
+    }
     for (;;) {
         assert(scanned_node->type == NODE_TYPE_QUAD_NODE);
         get_qrects_from_qbounds(scanned_children_qbounds, &scanned_qbounds);
-        if (cluster != 0) {
-            max_nb_slots_without_clustering = context.limit / (SubSlots) 4U;
-        }
         t = 0U;
         do {
             scanned_node_child = scanned_node->nodes[t];
-            scanned_child_qbound = &scanned_children_qbounds[t];
-            if (rectangle2d_intersect(scanned_child_qbound,
-                                      matching_rect) == 0) {
-                continue;
+            if (covered != 0) {
+                cover = POLYGON_COVER_FULL;
+            } else {
+                cover = polygon_cover(&context, &scanned_children_qbounds[t]);
             }
-            if (scanned_node_child->bare_node.type == NODE_TYPE_QUAD_NODE &&
-                cluster != 0 &&
-                scanned_node_child->quad_node.sub_slots >
-                max_nb_slots_without_clustering &&
-                fabsf(scanned_child_qbound->edge1.latitude -
-                      scanned_child_qbound->edge0.latitude) < epsilon &&
-                fabsf(scanned_child_qbound->edge1.longitude -
-                      scanned_child_qbound->edge0.longitude) < epsilon) {
-                context.rect = scanned_child_qbound;
-                const int ret = find_in_rect_cluster_context_cb
-                    (&context,
-                        (void *) scanned_node_child, sizeof *scanned_node_child);
-                if (ret != 0) {
-                    return ret;
-                }
+            if (cover == POLYGON_COVER_NONE) {
                 continue;
             }
             if (scanned_node_child->bare_node.type == NODE_TYPE_BUCKET_NODE) {
-                const Bucket *bucket = &scanned_node_child->bucket_node.bucket;
-                context.rect = rect;
-                const int ret = slab_foreach((Slab *) &bucket->slab,
-                                             find_in_rect_context_cb, &context);
+                ret = find_in_polygon_in_bucket
+                    (&context, &scanned_node_child->bucket_node.bucket,
+                        cover == POLYGON_COVER_FULL);
                 if (ret != 0) {
-                    return ret;
+                    break;
                 }
                 continue;
             }
             assert(scanned_node_child->bare_node.type == NODE_TYPE_QUAD_NODE);
-            qnb.quad_node = &scanned_node_child->quad_node;
-            qnb.qrect = *scanned_child_qbound;
-            push_pnt_stack(stack_inspect, &qnb);
+            if (cover == POLYGON_COVER_FULL &&
+                scanned_node_child->quad_node.sub_slots > context.limit) {
+                ret = 1;
+                break;
+            }
+            pqn.quad_node = &scanned_node_child->quad_node;
+            pqn.qrect = scanned_children_qbounds[t];
+            pqn.covered = (cover == POLYGON_COVER_FULL);
+            push_pnt_stack(stack_inspect, &pqn);
         } while (t++ < 3U);
-        sqnb = pop_pnt_stack(stack_inspect);
-        if (sqnb == NULL) {
+        if (ret != 0) {
             break;
         }
-        scanned_node = sqnb->quad_node;
-        scanned_qbounds = sqnb->qrect;
-    }
-    return 0;
-}
-
-int find_in_rect(const PanDB * const db,
-                 FindInRectCB cb, FindInRectClusterCB cluster_cb,
-                 void * const context_cb,
-                 const Rectangle2D * const rect,
-                 const SubSlots limit, const Dimension epsilon)
-{
-    if (limit <= (SubSlots) 0) {
-        return 0;
-    }
-    Rectangle2D matching_rects[4];
-    Rectangle2D *matching_rect = &matching_rects[0];
-    PntStack *stack_inspect;
-    unsigned int nb_zones;
-    
-    if (db->layer_type == LAYER_TYPE_FLAT) {
-        matching_rects[0] = *rect;
-        nb_zones = 1U;
-    } else {
-        Rectangle2D orect = *rect;
-        if (orect.edge0.latitude > orect.edge1.latitude) {
-            orect.edge1.latitude +=
-                db->qbounds.edge1.latitude - db->qbounds.edge0.latitude;
-        }
-        if (orect.edge0.longitude > orect.edge1.longitude) {
-            orect.edge1.longitude +=
-                db->qbounds.edge1.longitude - db->qbounds.edge0.longitude;
-        }        
-        nb_zones = find_zones(db, &orect, matching_rects);
+        spqn = pop_pnt_stack(stack_inspect);
+        if (spqn == NULL) {
+            break;
+        }
+        scanned_node = spqn->quad_node;
+        scanned_qbounds = spqn->qrect;
+        covered = spqn->covered;
     }
-    assert(nb_zones >= 1U);
-    assert(nb_zones <= 4U);
-    
-    stack_inspect = new_pnt_stack(DEFAULT_STACK_SIZE_FOR_SEARCHES,
-                                  sizeof(QuadNodeWithBounds));
-    if (stack_inspect == NULL) {
-        return -1;
-    }    
-    assert(matching_rect == &matching_rects[0]);
-    int ret;
-    do {
-        ret = find_in_rect_in_zone(matching_rect,
-                                   stack_inspect,
-                                   db,
-                                   cb,
-                                   cluster_cb,
-                                   context_cb,
-                                   matching_rect,
-                                   limit,
-                                   epsilon);
-        matching_rect++;
-    } while (ret == 0 && --nb_zones > 0U);    
     free_pnt_stack(stack_inspect);
-
+    
     return ret;
 }
 
 int init_pan_db(PanDB * const db,
                 struct HttpHandlerContext_ * const context)
 {
-    pthread_rwlock_init(&db->rwlock_db, NULL);
-    init_quad_node(&db->root);
+    if (init_prwlock(&db->rwlock_db) != 0) {
+        return -1;
+    }
+#if COMPACT_SLOTS
+    init_pool(&db->slots_pool, sizeof(Slot));
+    init_pool(&db->key_nodes_pool, sizeof(KeyNode));
+    init_pool(&db->bucket_nodes_pool, sizeof(BucketNode));
+#endif
+    init_quad_node(db, &db->root);
     db->qbounds = (Rectangle2D) {
         .edge0 = { .latitude = -90.0F, .longitude = -180.0F },
         .edge1 = { .latitude =  90.0F, .longitude =  180.0F }
@@ -1043,10 +3421,31 @@ int init_pan_db(PanDB * const db,
         app_context.dimension_accuracy;
     db->layer_type = app_context.default_layer_type;
     db->accuracy = app_context.default_accuracy;
+    db->index_type = app_context.default_index_type;
     assert(context != NULL);
     db->context = context;
     RB_INIT(&db->key_nodes);
     RB_INIT(&db->expirables);    
+    if (init_slab(&db->expirables_slab,
+                  sizeof(Expirable), "expirables") != 0) {
+        free_prwlock(&db->rwlock_db);
+        return -1;
+    }
+#if !COMPACT_SLOTS
+    if (init_slab(&db->slots_slab, sizeof(Slot), "slots") != 0) {
+        free_slab(&db->expirables_slab, NULL);
+        free_prwlock(&db->rwlock_db);
+        return -1;
+    }
+#endif
+    init_polygons(db);
+    init_morton_index(db);
+    db->bulk_load = (BulkLoad) {
+        .slots = NULL,
+        .nb_slots = (size_t) 0U,
+        .allocated_slots = (size_t) 0U,
+        .active = 0
+    };
     
     return 0;
 }
@@ -1064,6 +3463,10 @@ void free_pan_db(PanDB * const db)
     if (db == NULL) {
         return;
     }
+    free_polygons(db);
+    free_morton_index(db);
+    free(db->bulk_load.slots);
+    db->bulk_load.slots = NULL;
     KeyNode *scanned_key_node;
     KeyNode *next_key_node;
     for (scanned_key_node = RB_MIN(KeyNodes_, &db->key_nodes);
@@ -1083,7 +3486,7 @@ void free_pan_db(PanDB * const db)
         do {
             scanned_node_child = scanned_node->nodes[t];
             if (scanned_node_child->bare_node.type == NODE_TYPE_BUCKET_NODE) {
-                free_bucket_node(&scanned_node_child->bucket_node);
+                free_bucket_node(db, &scanned_node_child->bucket_node);
                 assert(scanned_node_child == scanned_node->nodes[t]);
                 scanned_node->nodes[t] = NULL;
                 continue;
@@ -1106,9 +3509,17 @@ void free_pan_db(PanDB * const db)
         free_quad_node(qn);
     }
     free_pnt_stack(stack_quad_nodes_to_delete);
+    free_slab(&db->expirables_slab, NULL);
+#if COMPACT_SLOTS
+    free_pool(&db->slots_pool);
+    free_pool(&db->key_nodes_pool);
+    free_pool(&db->bucket_nodes_pool);
+#else
+    free_slab(&db->slots_slab, NULL);
+#endif
     assert(db->context != NULL);
     db->context = NULL;
-    pthread_rwlock_destroy(&db->rwlock_db);
+    free_prwlock(&db->rwlock_db);
 }
 
 #ifdef DEBUG
@@ -1138,38 +3549,31 @@ void print_quad_rects(const Rectangle2D * const rects)
     print_rect(&rects[3]);    
 }
 
-static int dump_bucket_node_cb(void *context, void *entry,
-                               const size_t sizeof_entry)
-{
-    _Bool *coma = context;
-    Slot *scanned_slot = entry;
-
-    (void) sizeof_entry;
-    if (*coma != 0) {
-        printf(", ");
-    } else {
-        *coma = 1;
-    }
-    const char *key_s;
-    
-    key_s = (const char *) scanned_slot->key_node->key->val;
-    printf("\"%.3f, %.3f [%s](%p => %p)\"",
-           scanned_slot->position.latitude,
-           scanned_slot->position.longitude,
-           key_s, scanned_slot, scanned_slot->bucket_node);
-    assert(scanned_slot->bucket_node != NULL);
-    
-    return 0;
-}
-
 static void dump_bucket_node(const BucketNode * const bucket_node)
 {
     const Bucket *bucket = &bucket_node->bucket;
-    _Bool coma = 0;
+    NbSlots i;
 
     assert(bucket != NULL);
     printf("[");
-    slab_foreach((Slab *) &bucket->slab, dump_bucket_node_cb, &coma);
+    for (i = (NbSlots) 0U; i < bucket->busy_slots; i++) {
+#if COMPACT_SLOTS
+        printf("%s\"" SLOT_DIMENSION_FORMAT ", " SLOT_DIMENSION_FORMAT
+               " (%lu)\"", i > 0U ? ", " : "",
+               SLOT_DIMENSION(bucket->latitudes[i]),
+               SLOT_DIMENSION(bucket->longitudes[i]),
+               (unsigned long) bucket->slots[i]);
+#else
+        const Slot * const scanned_slot = bucket->slots[i];
+
+        printf("%s\"%.3f, %.3f [%s](%p => %p)\"", i > 0U ? ", " : "",
+               bucket->latitudes[i], bucket->longitudes[i],
+               (const char *) scanned_slot->key_node->key->val,
+               (const void *) scanned_slot,
+               (const void *) scanned_slot->bucket_node);
+        assert(scanned_slot->bucket_node == bucket_node);
+#endif
+    }
     printf("]");    
 }
 
@@ -1211,12 +3615,13 @@ void dump_keys(PanDB * const db)
                                 scanned_key_node);
         assert(scanned_key_node->key != NULL);
         assert(scanned_key_node->key->val != NULL);
+        assert(scanned_key_node->slot != NULL);
         printf("KEY [%s] => (%p => %p)\n",
                scanned_key_node->key->val,
-               scanned_key_node->slot,
-               scanned_key_node->slot->bucket_node);
-        assert(scanned_key_node->slot != NULL);
-        assert(scanned_key_node->slot->bucket_node != NULL);
+               (void *) scanned_key_node->slot,
+               (void *) DEREF_BUCKET_NODE(db,
+                                          scanned_key_node->slot->bucket_node));
+        assert(scanned_key_node->slot->bucket_node != NULL_REF);
     }
     puts("--/KEY--\n");
 }
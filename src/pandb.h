@@ -7,6 +7,7 @@ typedef float Dimension2;
 typedef Dimension Meters;
 typedef unsigned int NbSlots;
 typedef unsigned long SubSlots;
+typedef int32_t FixedDimension;
 
 #ifndef EARTH_CIRCUMFERENCE
 # define EARTH_CIRCUMFERENCE (40000.0F * 1000.0F)
@@ -20,6 +21,27 @@ typedef unsigned long SubSlots;
 #ifndef DEFAULT_STACK_SIZE_FOR_SEARCHES
 # define DEFAULT_STACK_SIZE_FOR_SEARCHES ((size_t) 8U)
 #endif
+#ifndef DEFAULT_HEAP_SIZE_FOR_SEARCHES
+# define DEFAULT_HEAP_SIZE_FOR_SEARCHES ((size_t) 64U)
+#endif
+#ifndef BUCKET_INITIAL_SLOTS
+# define BUCKET_INITIAL_SLOTS ((NbSlots) 8U)
+#endif
+#ifndef NEAREST_GEOIDAL_DISTANCE_SLACK
+# define NEAREST_GEOIDAL_DISTANCE_SLACK 0.99F
+#endif
+#ifndef MORTON_MAX_RUNS
+# define MORTON_MAX_RUNS 64U
+#endif
+#ifndef BULK_LOAD_INITIAL_SLOTS
+# define BULK_LOAD_INITIAL_SLOTS ((size_t) 1024U)
+#endif
+#ifndef COMPACT_SLOTS
+# define COMPACT_SLOTS 0
+#endif
+#ifndef FIXED_DIMENSION_SCALE
+# define FIXED_DIMENSION_SCALE 1e7
+#endif
 
 typedef struct Position2D_ {
     Dimension latitude;    
@@ -31,19 +53,73 @@ typedef struct Rectangle2D_ {
     Position2D edge1;   
 } Rectangle2D;
 
+typedef struct FixedPosition2D_ {
+    FixedDimension latitude;
+    FixedDimension longitude;
+} FixedPosition2D;
+
+// Compact slots keep 32-bit fixed-point coordinates, and refer to slots,
+// key nodes and bucket nodes through 32-bit pool handles.
+#if COMPACT_SLOTS
+typedef FixedDimension SlotDimension;
+typedef FixedPosition2D SlotPosition;
+typedef PoolHandle SlotRef;
+typedef PoolHandle KeyNodeRef;
+typedef PoolHandle BucketNodeRef;
+# define SLOT_DIMENSION(D) ((double) (D) / FIXED_DIMENSION_SCALE)
+# define SLOT_DIMENSION_FORMAT "%.7f"
+# define NULL_REF POOL_HANDLE_NONE
+# define SLOT_REF(DB, S) get_pool_handle(&(DB)->slots_pool, (S))
+# define DEREF_SLOT(DB, R) ((Slot *) POOL_ENTRY(&(DB)->slots_pool, (R)))
+# define KEY_NODE_REF(DB, K) get_pool_handle(&(DB)->key_nodes_pool, (K))
+# define DEREF_KEY_NODE(DB, R) \
+    ((struct KeyNode_ *) POOL_ENTRY(&(DB)->key_nodes_pool, (R)))
+# define BUCKET_NODE_REF(DB, B) get_pool_handle(&(DB)->bucket_nodes_pool, (B))
+# define DEREF_BUCKET_NODE(DB, R) \
+    ((struct BucketNode_ *) POOL_ENTRY(&(DB)->bucket_nodes_pool, (R)))
+#else
+typedef Dimension SlotDimension;
+typedef Position2D SlotPosition;
+typedef struct Slot_ *SlotRef;
+typedef struct KeyNode_ *KeyNodeRef;
+typedef struct BucketNode_ *BucketNodeRef;
+# define SLOT_DIMENSION(D) ((double) (D))
+# define SLOT_DIMENSION_FORMAT "%f"
+# define NULL_REF NULL
+# define SLOT_REF(DB, S) ((SlotRef) (S))
+# define DEREF_SLOT(DB, R) (R)
+# define KEY_NODE_REF(DB, K) (K)
+# define DEREF_KEY_NODE(DB, R) (R)
+# define BUCKET_NODE_REF(DB, B) (B)
+# define DEREF_BUCKET_NODE(DB, R) (R)
+#endif
+
+#define SLOT_POSITION(P) ((Position2D) {                   \
+    .latitude = (Dimension) SLOT_DIMENSION((P)->latitude),  \
+    .longitude = (Dimension) SLOT_DIMENSION((P)->longitude) \
+})
+
 typedef struct Slot_ {
-    Position2D position;
+    SlotPosition position;
 #if PROJECTION
-    Position2D real_position;
+    SlotPosition real_position;
 #endif
-    struct KeyNode_    *key_node;
-    struct BucketNode_ *bucket_node;
+    KeyNodeRef key_node;
+    BucketNodeRef bucket_node;
+    NbSlots bucket_index;
 } Slot;
 
 typedef struct Bucket_ {
-    Slab slab;
+    SlotDimension *latitudes;
+    SlotDimension *longitudes;
+    Dimension *sin_latitudes;
+    Dimension *cos_latitudes;
+    Dimension *unit_xs;
+    Dimension *unit_ys;
+    SlotRef *slots;
     NbSlots bucket_size;
     NbSlots busy_slots;
+    NbSlots allocated_slots;
 } Bucket;
 
 typedef enum NodeType_ {
@@ -56,6 +132,10 @@ typedef enum LayerType_ {
         LAYER_TYPE_SPHERICAL, LAYER_TYPE_ELLIPSOIDAL
 } LayerType;
 
+typedef enum IndexType_ {
+    INDEX_TYPE_NONE, INDEX_TYPE_QUADTREE, INDEX_TYPE_MORTON
+} IndexType;
+
 typedef struct BareNode_ {
     NodeType type;
     struct QuadNode_ *parent;
@@ -71,6 +151,9 @@ typedef struct QuadNode_ {
     NodeType type;
     struct QuadNode_ *parent;
     SubSlots sub_slots;
+    double mean_latitude;
+    double mean_longitude;
+    double square_deviations;
     union Node_ *nodes[4];
 } QuadNode;
 
@@ -88,10 +171,66 @@ typedef struct Expirable_ {
 
 typedef RB_HEAD(Expirables_, Expirable_) Expirables;
 
+typedef struct Polygon_ {
+    struct KeyNode_ *key_node;
+    size_t index;
+    NbSlots nb_vertices;
+    Position2D vertices[];
+} Polygon;
+
+typedef struct RTreeNode_ {
+    Rectangle2D rect;
+    size_t first;
+    NbSlots children;
+    _Bool leaf;
+} RTreeNode;
+
+typedef struct RTree_ {
+    Polygon * *polygons;
+    Rectangle2D *bounds;
+    size_t nb_polygons;
+    size_t allocated_polygons;
+    size_t nb_indexed;
+    size_t nb_removed;
+    RTreeNode *nodes;
+    size_t nb_nodes;
+} RTree;
+
+// Compact entries decode their position from the code, whose cells are
+// finer than a fixed-point unit
+typedef struct MortonEntry_ {
+    uint64_t code;
+#if !COMPACT_SLOTS
+    Position2D position;
+#endif
+    SlotRef slot;
+} MortonEntry;
+
+typedef struct MortonRun_ {
+    MortonEntry *entries;
+    size_t nb_entries;
+    size_t nb_removed;
+} MortonRun;
+
+typedef struct MortonIndex_ {
+    MortonRun runs[MORTON_MAX_RUNS];
+    unsigned int nb_runs;
+    MortonEntry *pending;
+    NbSlots nb_pending;
+} MortonIndex;
+
+typedef struct BulkLoad_ {
+    Slot * *slots;
+    size_t nb_slots;
+    size_t allocated_slots;
+    _Bool active;
+} BulkLoad;
+
 typedef struct KeyNode_ {
     RB_ENTRY(KeyNode_) entry;
     Key *key;
     Slot *slot;
+    Polygon *polygon;
     SlipMap *properties;
     Expirable *expirable;
 } KeyNode;
@@ -107,13 +246,25 @@ typedef struct PanDB_ {
     struct HttpHandlerContext_ *context;    
     QuadNode root;
     KeyNodes key_nodes;
-    pthread_rwlock_t rwlock_db;
+    PRWLock rwlock_db;
     Rectangle2D qbounds;
     Dimension latitude_accuracy;
     Dimension longitude_accuracy;
     LayerType layer_type;
     Accuracy accuracy;
+    IndexType index_type;
+    MortonIndex morton;
+    BulkLoad bulk_load;
     Expirables expirables;
+    Slab expirables_slab;
+#if COMPACT_SLOTS
+    Pool slots_pool;
+    Pool key_nodes_pool;
+    Pool bucket_nodes_pool;
+#else
+    Slab slots_slab;
+#endif
+    RTree polygons;
 } PanDB;
 
 typedef struct QuadNodeWithBounds_ {
@@ -124,14 +275,31 @@ typedef struct QuadNodeWithBounds_ {
 typedef int (*FindNearCB)(void * const context,
                           Slot * const slot, Meters distance);
 
+typedef int (*FindNearClusterCB)(void * const context,
+                                 const Position2D * const position,
+                                 const Meters radius,
+                                 const NbSlots children);
+
+typedef int (*FindNearestCB)(void * const context,
+                             Slot * const slot, Meters distance);
+
 typedef int (*FindInRectCB)(void * const context,
                             Slot * const slot, Meters distance);
 
+typedef int (*FindInPolygonCB)(void * const context,
+                               Slot * const slot, Meters distance);
+
+typedef int (*FindContainingCB)(void * const context,
+                                Polygon * const polygon);
+
 typedef int (*FindInRectClusterCB)(void * const context,
                                    const Position2D * const position,
                                    const Meters radius,
                                    const NbSlots children);
 
+typedef int (*GridInRectCB)(void * const context,
+                            Slot * const slot, const NbSlots cell);
+
 void dump(Node *scanned_node);
 
 int init_pan_db(PanDB * const db,
@@ -145,13 +313,29 @@ int remove_entry_from_key_node(PanDB * const db,
 
 int init_slot(Slot * const slot);
 
+int make_slot_position(SlotPosition * const slot_position,
+                       const double latitude, const double longitude);
+
 int add_slot(PanDB * const db, const Slot * const slot,
              Slot * * const new_slot);
 
+int move_slot(PanDB * const db, Slot * const slot,
+              const SlotPosition * const position);
+
+int begin_bulk_load(PanDB * const db);
+
+int end_bulk_load(PanDB * const db);
+
 int find_near(const PanDB * const db,
-              FindNearCB cb, void * const cb_context,
+              FindNearCB cb, FindNearClusterCB cluster_cb,
+              void * const cb_context,
               const Position2D * const position, const Meters distance,
-              const SubSlots limit);
+              const SubSlots limit, const Dimension epsilon);
+
+int find_nearest(const PanDB * const db,
+                 FindNearestCB cb, void * const cb_context,
+                 const Position2D * const position,
+                 const Meters max_distance, SubSlots limit);
 
 int find_in_rect(const PanDB * const db,
                  FindInRectCB cb, FindInRectClusterCB cluster_cb,
@@ -159,6 +343,27 @@ int find_in_rect(const PanDB * const db,
                  const Rectangle2D * const rect,
                  const SubSlots limit, const Dimension epsilon);
 
+int find_in_polygon(const PanDB * const db,
+                    FindInPolygonCB cb, void * const context_cb,
+                    const Position2D * const vertices,
+                    const NbSlots nb_vertices, const SubSlots limit);
+
+int position_is_in_polygon(const Position2D * const position,
+                           const Position2D * const vertices,
+                           const NbSlots nb_vertices);
+
+int count_near(const PanDB * const db,
+               const Position2D * const position, const Meters distance,
+               SubSlots * const count);
+
+int count_in_rect(const PanDB * const db, const Rectangle2D * const rect,
+                  SubSlots * const count);
+
+int grid_in_rect(const PanDB * const db, const Rectangle2D * const rect,
+                 const NbSlots cols, const NbSlots rows,
+                 SubSlots * const counts,
+                 GridInRectCB cb, void * const context_cb);
+
 #ifdef DEBUG
 void print_rect(const Rectangle2D * const rect);
 void print_position(const Position2D * const position);
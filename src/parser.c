@@ -30,7 +30,9 @@ int generic_parser(const char * const file,
             
             keyword_len = strlen(config_keywords_pnt->keyword);
             if (strncasecmp(config_keywords_pnt->keyword,
-                            linepnt, keyword_len) == 0) {
+                            linepnt, keyword_len) == 0 &&
+                (linepnt[keyword_len] == 0 ||
+                 isspace((unsigned char) linepnt[keyword_len]))) {
                 linepnt += keyword_len;
                 while (*linepnt != 0 && isspace((unsigned char) *linepnt)) {
                     linepnt++;
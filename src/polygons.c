@@ -0,0 +1,409 @@
+
+#include "common.h"
+#include "polygons.h"
+
+typedef struct PolygonEntry_ {
+    Rectangle2D bounds;
+    Polygon *polygon;
+} PolygonEntry;
+
+int init_polygons(PanDB * const db)
+{
+    db->polygons = (RTree) {
+        .polygons = NULL,
+        .bounds = NULL,
+        .nb_polygons = (size_t) 0U,
+        .allocated_polygons = (size_t) 0U,
+        .nb_indexed = (size_t) 0U,
+        .nb_removed = (size_t) 0U,
+        .nodes = NULL,
+        .nb_nodes = (size_t) 0U
+    };
+    return 0;
+}
+
+void free_polygons(PanDB * const db)
+{
+    RTree * const rtree = &db->polygons;
+    Polygon *polygon;
+    size_t i;
+
+    for (i = (size_t) 0U; i < rtree->nb_polygons; i++) {
+        if ((polygon = rtree->polygons[i]) == NULL) {
+            continue;
+        }
+        assert(polygon->key_node->polygon == polygon);
+        polygon->key_node->polygon = NULL;
+        free(polygon);
+    }
+    free(rtree->polygons);
+    free(rtree->bounds);
+    free(rtree->nodes);
+    init_polygons(db);
+}
+
+Polygon *new_polygon(const Position2D * const vertices,
+                     const NbSlots nb_vertices)
+{
+    Polygon *polygon;
+
+    assert(nb_vertices >= (NbSlots) 3U);
+    if ((polygon = malloc(sizeof *polygon +
+                          nb_vertices * sizeof *vertices)) == NULL) {
+        return NULL;
+    }
+    polygon->key_node = NULL;
+    polygon->index = (size_t) 0U;
+    polygon->nb_vertices = nb_vertices;
+    memcpy(polygon->vertices, vertices, nb_vertices * sizeof *vertices);
+
+    return polygon;
+}
+
+static Rectangle2D polygon_bounds(const Polygon * const polygon)
+{
+    Rectangle2D bounds = {
+        .edge0 = polygon->vertices[0], .edge1 = polygon->vertices[0]
+    };
+    const Position2D *vertex;
+    NbSlots i;
+
+    for (i = (NbSlots) 1U; i < polygon->nb_vertices; i++) {
+        vertex = &polygon->vertices[i];
+        if (vertex->latitude < bounds.edge0.latitude) {
+            bounds.edge0.latitude = vertex->latitude;
+        } else if (vertex->latitude > bounds.edge1.latitude) {
+            bounds.edge1.latitude = vertex->latitude;
+        }
+        if (vertex->longitude < bounds.edge0.longitude) {
+            bounds.edge0.longitude = vertex->longitude;
+        } else if (vertex->longitude > bounds.edge1.longitude) {
+            bounds.edge1.longitude = vertex->longitude;
+        }
+    }
+    return bounds;
+}
+
+static void extend_rect(Rectangle2D * const rect,
+                        const Rectangle2D * const other)
+{
+    if (other->edge0.latitude < rect->edge0.latitude) {
+        rect->edge0.latitude = other->edge0.latitude;
+    }
+    if (other->edge0.longitude < rect->edge0.longitude) {
+        rect->edge0.longitude = other->edge0.longitude;
+    }
+    if (other->edge1.latitude > rect->edge1.latitude) {
+        rect->edge1.latitude = other->edge1.latitude;
+    }
+    if (other->edge1.longitude > rect->edge1.longitude) {
+        rect->edge1.longitude = other->edge1.longitude;
+    }
+}
+
+static int rect_contains_position(const Rectangle2D * const rect,
+                                  const Position2D * const position)
+{
+    return position->latitude >= rect->edge0.latitude &&
+        position->latitude <= rect->edge1.latitude &&
+        position->longitude >= rect->edge0.longitude &&
+        position->longitude <= rect->edge1.longitude;
+}
+
+static int compare_rects_by_longitude(const void * const r1_,
+                                      const void * const r2_)
+{
+    const Rectangle2D * const r1 = r1_;
+    const Rectangle2D * const r2 = r2_;
+    const Dimension c1 = r1->edge0.longitude + r1->edge1.longitude;
+    const Dimension c2 = r2->edge0.longitude + r2->edge1.longitude;
+
+    if (c1 < c2) {
+        return -1;
+    }
+    return c1 > c2;
+}
+
+static int compare_rects_by_latitude(const void * const r1_,
+                                     const void * const r2_)
+{
+    const Rectangle2D * const r1 = r1_;
+    const Rectangle2D * const r2 = r2_;
+    const Dimension c1 = r1->edge0.latitude + r1->edge1.latitude;
+    const Dimension c2 = r2->edge0.latitude + r2->edge1.latitude;
+
+    if (c1 < c2) {
+        return -1;
+    }
+    return c1 > c2;
+}
+
+// Sort-Tile-Recursive packing. Entries start with their bounding rectangle.
+
+static void tile_entries(void * const entries_, const size_t nb_entries,
+                         const size_t sizeof_entry)
+{
+    char * const entries = entries_;
+    const size_t nb_groups = (nb_entries + RTREE_NODE_SIZE - (size_t) 1U) /
+        RTREE_NODE_SIZE;
+    size_t nb_slices = (size_t) 1U;
+    size_t slice_size;
+    size_t i;
+
+    while (nb_slices * nb_slices < nb_groups) {
+        nb_slices++;
+    }
+    slice_size = (nb_groups + nb_slices - (size_t) 1U) /
+        nb_slices * RTREE_NODE_SIZE;
+    qsort(entries, nb_entries, sizeof_entry, compare_rects_by_longitude);
+    for (i = (size_t) 0U; i < nb_entries; i += slice_size) {
+        qsort(entries + i * sizeof_entry,
+              nb_entries - i < slice_size ? nb_entries - i : slice_size,
+              sizeof_entry, compare_rects_by_latitude);
+    }
+}
+
+int rebuild_polygons_index(PanDB * const db)
+{
+    RTree * const rtree = &db->polygons;
+    PolygonEntry *entries;
+    RTreeNode *nodes;
+    RTreeNode *node;
+    size_t nb_entries = (size_t) 0U;
+    size_t nb_nodes = (size_t) 0U;
+    size_t level_nodes;
+    size_t level_start;
+    size_t level_end;
+    size_t i;
+    size_t j;
+    unsigned int depth = 0U;
+
+    for (i = (size_t) 0U; i < rtree->nb_polygons; i++) {
+        if (rtree->polygons[i] != NULL) {
+            nb_entries++;
+        }
+    }
+    level_nodes = nb_entries;
+    while (level_nodes > (size_t) 1U || depth == 0U) {
+        level_nodes = (level_nodes + RTREE_NODE_SIZE - (size_t) 1U) /
+            RTREE_NODE_SIZE;
+        nb_nodes += level_nodes;
+        depth++;
+    }
+    if (depth > RTREE_MAX_DEPTH) {
+        return -1;
+    }
+    if (nb_entries == (size_t) 0U) {
+        entries = NULL;
+        nodes = NULL;
+        nb_nodes = (size_t) 0U;
+    } else if ((entries = malloc(nb_entries * sizeof *entries)) == NULL) {
+        return -1;
+    } else if ((nodes = malloc(nb_nodes * sizeof *nodes)) == NULL) {
+        free(entries);
+        return -1;
+    }
+    for (i = j = (size_t) 0U; i < rtree->nb_polygons; i++) {
+        if (rtree->polygons[i] != NULL) {
+            entries[j++] = (PolygonEntry) {
+                .bounds = rtree->bounds[i],
+                .polygon = rtree->polygons[i]
+            };
+        }
+    }
+    assert(j == nb_entries);
+    if (nb_entries > (size_t) 0U) {
+        tile_entries(entries, nb_entries, sizeof *entries);
+    }
+    for (i = (size_t) 0U; i < nb_entries; i++) {
+        rtree->polygons[i] = entries[i].polygon;
+        rtree->bounds[i] = entries[i].bounds;
+        rtree->polygons[i]->index = i;
+    }
+    free(entries);
+    rtree->nb_polygons = rtree->nb_indexed = nb_entries;
+    rtree->nb_removed = (size_t) 0U;
+    free(rtree->nodes);
+    rtree->nodes = nodes;
+    rtree->nb_nodes = nb_nodes;
+    if (nb_entries == (size_t) 0U) {
+        return 0;
+    }
+    level_end = (size_t) 0U;
+    for (i = (size_t) 0U; i < nb_entries; i += RTREE_NODE_SIZE) {
+        node = &nodes[level_end++];
+        *node = (RTreeNode) {
+            .rect = rtree->bounds[i],
+            .first = i,
+            .children = (NbSlots) (nb_entries - i < RTREE_NODE_SIZE ?
+                                   nb_entries - i : RTREE_NODE_SIZE),
+            .leaf = 1
+        };
+        for (j = i + (size_t) 1U; j < i + node->children; j++) {
+            extend_rect(&node->rect, &rtree->bounds[j]);
+        }
+    }
+    level_start = (size_t) 0U;
+    nb_nodes = level_end;
+    while (level_end - level_start > (size_t) 1U) {
+        tile_entries(&nodes[level_start], level_end - level_start,
+                     sizeof *nodes);
+        for (i = level_start; i < level_end; i += RTREE_NODE_SIZE) {
+            node = &nodes[nb_nodes++];
+            *node = (RTreeNode) {
+                .rect = nodes[i].rect,
+                .first = i,
+                .children = (NbSlots) (level_end - i < RTREE_NODE_SIZE ?
+                                       level_end - i : RTREE_NODE_SIZE),
+                .leaf = 0
+            };
+            for (j = i + (size_t) 1U; j < i + node->children; j++) {
+                extend_rect(&node->rect, &nodes[j].rect);
+            }
+        }
+        level_start = level_end;
+        level_end = nb_nodes;
+    }
+    assert(nb_nodes == rtree->nb_nodes);
+
+    return 0;
+}
+
+static void rebuild_polygons_index_if_needed(PanDB * const db)
+{
+    RTree * const rtree = &db->polygons;
+    const size_t nb_pending = rtree->nb_polygons - rtree->nb_indexed +
+        rtree->nb_removed;
+
+    if (nb_pending > RTREE_MIN_PENDING_POLYGONS &&
+        nb_pending > rtree->nb_indexed / RTREE_PENDING_POLYGONS_RATIO) {
+        rebuild_polygons_index(db);
+    }
+}
+
+int add_polygon(PanDB * const db, Polygon * const polygon)
+{
+    RTree * const rtree = &db->polygons;
+
+    if (rtree->nb_polygons >= rtree->allocated_polygons) {
+        const size_t allocated_polygons =
+            rtree->allocated_polygons < (size_t) RTREE_NODE_SIZE ?
+            (size_t) RTREE_NODE_SIZE : rtree->allocated_polygons * 2U;
+        Polygon * *polygons;
+        Rectangle2D *bounds;
+
+        if ((polygons = realloc(rtree->polygons, allocated_polygons *
+                                sizeof *polygons)) == NULL) {
+            return -1;
+        }
+        rtree->polygons = polygons;
+        if ((bounds = realloc(rtree->bounds, allocated_polygons *
+                              sizeof *bounds)) == NULL) {
+            return -1;
+        }
+        rtree->bounds = bounds;
+        rtree->allocated_polygons = allocated_polygons;
+    }
+    polygon->index = rtree->nb_polygons;
+    rtree->polygons[polygon->index] = polygon;
+    rtree->bounds[polygon->index] = polygon_bounds(polygon);
+    rtree->nb_polygons++;
+    rebuild_polygons_index_if_needed(db);
+
+    return 0;
+}
+
+void remove_polygon(PanDB * const db, Polygon * const polygon)
+{
+    RTree * const rtree = &db->polygons;
+    const size_t index = polygon->index;
+    const size_t last = rtree->nb_polygons - (size_t) 1U;
+
+    assert(index < rtree->nb_polygons);
+    assert(rtree->polygons[index] == polygon);
+    if (index < rtree->nb_indexed) {
+        rtree->polygons[index] = NULL;
+        rtree->nb_removed++;
+    } else {
+        if (index != last) {
+            rtree->polygons[index] = rtree->polygons[last];
+            rtree->bounds[index] = rtree->bounds[last];
+            rtree->polygons[index]->index = index;
+        }
+        rtree->nb_polygons--;
+    }
+    free(polygon);
+    rebuild_polygons_index_if_needed(db);
+}
+
+static int find_containing_in_range(const RTree * const rtree,
+                                    FindContainingCB cb,
+                                    void * const context_cb,
+                                    const Position2D * const position,
+                                    const size_t first, const size_t end,
+                                    const SubSlots limit,
+                                    SubSlots * const matches)
+{
+    Polygon *polygon;
+    size_t i;
+    int ret;
+
+    for (i = first; i < end; i++) {
+        if ((polygon = rtree->polygons[i]) == NULL ||
+            rect_contains_position(&rtree->bounds[i], position) == 0 ||
+            position_is_in_polygon(position, polygon->vertices,
+                                   polygon->nb_vertices) == 0) {
+            continue;
+        }
+        if (*matches >= limit) {
+            return 1;
+        }
+        (*matches)++;
+        if ((ret = cb(context_cb, polygon)) != 0) {
+            return ret;
+        }
+    }
+    return 0;
+}
+
+int find_containing(const PanDB * const db,
+                    FindContainingCB cb, void * const context_cb,
+                    const Position2D * const position,
+                    const SubSlots limit)
+{
+    const RTree * const rtree = &db->polygons;
+    size_t stack[RTREE_MAX_DEPTH * RTREE_NODE_SIZE];
+    size_t stack_size = (size_t) 0U;
+    const RTreeNode *node;
+    SubSlots matches = (SubSlots) 0U;
+    size_t i;
+    int ret;
+
+    if (rtree->nb_nodes > (size_t) 0U &&
+        rect_contains_position(&rtree->nodes[rtree->nb_nodes - 1U].rect,
+                               position) != 0) {
+        stack[stack_size++] = rtree->nb_nodes - 1U;
+    }
+    while (stack_size > (size_t) 0U) {
+        node = &rtree->nodes[stack[--stack_size]];
+        if (node->leaf != 0) {
+            if ((ret = find_containing_in_range
+                 (rtree, cb, context_cb, position,
+                  node->first, node->first + node->children,
+                  limit, &matches)) != 0) {
+                return ret;
+            }
+            continue;
+        }
+        for (i = node->first; i < node->first + node->children; i++) {
+            if (rect_contains_position(&rtree->nodes[i].rect,
+                                       position) != 0) {
+                assert(stack_size < sizeof stack / sizeof stack[0]);
+                stack[stack_size++] = i;
+            }
+        }
+    }
+    return find_containing_in_range(rtree, cb, context_cb, position,
+                                    rtree->nb_indexed, rtree->nb_polygons,
+                                    limit, &matches);
+}
@@ -0,0 +1,36 @@
+
+#ifndef __POLYGONS_H__
+#define __POLYGONS_H__ 1
+
+#ifndef RTREE_NODE_SIZE
+# define RTREE_NODE_SIZE ((NbSlots) 16U)
+#endif
+#ifndef RTREE_MAX_DEPTH
+# define RTREE_MAX_DEPTH 16U
+#endif
+#ifndef RTREE_MIN_PENDING_POLYGONS
+# define RTREE_MIN_PENDING_POLYGONS ((size_t) 32U)
+#endif
+#ifndef RTREE_PENDING_POLYGONS_RATIO
+# define RTREE_PENDING_POLYGONS_RATIO ((size_t) 4U)
+#endif
+
+int init_polygons(PanDB * const db);
+
+void free_polygons(PanDB * const db);
+
+Polygon *new_polygon(const Position2D * const vertices,
+                     const NbSlots nb_vertices);
+
+int add_polygon(PanDB * const db, Polygon * const polygon);
+
+void remove_polygon(PanDB * const db, Polygon * const polygon);
+
+int rebuild_polygons_index(PanDB * const db);
+
+int find_containing(const PanDB * const db,
+                    FindContainingCB cb, void * const context_cb,
+                    const Position2D * const position,
+                    const SubSlots limit);
+
+#endif
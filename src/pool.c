@@ -0,0 +1,135 @@
+
+#include "common.h"
+#include "pool.h"
+
+// Chunks are aligned on their size, so that the chunk holding an entry,
+// and the handle of that entry, can be found from the entry address.
+
+int init_pool(Pool * const pool, const size_t sizeof_entry)
+{
+    size_t entries_per_chunk;
+
+    assert(sizeof_entry >= sizeof(PoolHandle));
+    entries_per_chunk = (POOL_CHUNK_SIZE - POOL_CHUNK_HEADER_SIZE) /
+        sizeof_entry;
+    if (entries_per_chunk > (size_t) POOL_ENTRY_MASK + (size_t) 1U) {
+        entries_per_chunk = (size_t) POOL_ENTRY_MASK + (size_t) 1U;
+    }
+    pool->chunks = NULL;
+    pool->sizeof_entry = sizeof_entry;
+    pool->entries_per_chunk = (PoolHandle) entries_per_chunk;
+    pool->nb_chunks = (PoolHandle) 0U;
+    pool->allocated_chunks = (PoolHandle) 0U;
+    pool->nb_entries_in_last_chunk = (PoolHandle) 0U;
+    pool->first_free_entry = POOL_HANDLE_NONE;
+
+    return 0;
+}
+
+void free_pool(Pool * const pool)
+{
+    PoolHandle t;
+
+    if (pool == NULL) {
+        return;
+    }
+    for (t = (PoolHandle) 0U; t < pool->nb_chunks; t++) {
+        free(pool->chunks[t]);
+    }
+    free(pool->chunks);
+    pool->chunks = NULL;
+    pool->nb_chunks = (PoolHandle) 0U;
+    pool->allocated_chunks = (PoolHandle) 0U;
+    pool->nb_entries_in_last_chunk = (PoolHandle) 0U;
+    pool->first_free_entry = POOL_HANDLE_NONE;
+}
+
+static int new_pool_chunk(Pool * const pool)
+{
+    unsigned char * *chunks;
+    void *chunk;
+    PoolHandle allocated_chunks;
+
+    if (pool->nb_chunks >= POOL_MAX_CHUNKS) {
+        return -1;
+    }
+    if (pool->nb_chunks >= pool->allocated_chunks) {
+        allocated_chunks = pool->allocated_chunks * (PoolHandle) 2U;
+        if (allocated_chunks <= (PoolHandle) 0U) {
+            allocated_chunks = (PoolHandle) 16U;
+        }
+        if ((chunks = realloc(pool->chunks, allocated_chunks *
+                              sizeof *chunks)) == NULL) {
+            return -1;
+        }
+        pool->chunks = chunks;
+        pool->allocated_chunks = allocated_chunks;
+    }
+    if (posix_memalign(&chunk, POOL_CHUNK_SIZE, POOL_CHUNK_SIZE) != 0) {
+        return -1;
+    }
+    pool->chunks[pool->nb_chunks++] = chunk;
+    *(PoolHandle *) chunk = pool->nb_chunks;
+    pool->nb_entries_in_last_chunk = (PoolHandle) 0U;
+
+    return 0;
+}
+
+void *add_entry_to_pool(Pool * const pool, const void * const entry)
+{
+    PoolHandle handle;
+    void *pool_entry;
+
+    if ((handle = pool->first_free_entry) != POOL_HANDLE_NONE) {
+        pool_entry = POOL_ENTRY(pool, handle);
+        memcpy(&pool->first_free_entry, pool_entry,
+               sizeof pool->first_free_entry);
+    } else {
+        if ((pool->nb_chunks <= (PoolHandle) 0U ||
+             pool->nb_entries_in_last_chunk >= pool->entries_per_chunk) &&
+            new_pool_chunk(pool) != 0) {
+            return NULL;
+        }
+        handle = (pool->nb_chunks << POOL_ENTRY_BITS) |
+            pool->nb_entries_in_last_chunk++;
+        pool_entry = POOL_ENTRY(pool, handle);
+    }
+    memcpy(pool_entry, entry, pool->sizeof_entry);
+
+    return pool_entry;
+}
+
+int remove_entry_from_pool(Pool * const pool, void * const entry)
+{
+    const PoolHandle handle = get_pool_handle(pool, entry);
+
+    if (handle == POOL_HANDLE_NONE) {
+        return -1;
+    }
+    memcpy(entry, &pool->first_free_entry, sizeof pool->first_free_entry);
+    pool->first_free_entry = handle;
+
+    return 0;
+}
+
+PoolHandle get_pool_handle(const Pool * const pool, const void * const entry)
+{
+    const unsigned char *chunk;
+    PoolHandle chunk_id;
+    size_t offset;
+
+    if (entry == NULL) {
+        return POOL_HANDLE_NONE;
+    }
+    chunk = (const unsigned char *)
+        ((uintptr_t) entry & ~(uintptr_t) (POOL_CHUNK_SIZE - (size_t) 1U));
+    chunk_id = *(const PoolHandle *) (const void *) chunk;
+    assert(chunk_id > (PoolHandle) 0U && chunk_id <= pool->nb_chunks);
+    assert(pool->chunks[chunk_id - 1U] == chunk);
+    offset = (size_t) ((const unsigned char *) entry - chunk) -
+        POOL_CHUNK_HEADER_SIZE;
+    assert(offset % pool->sizeof_entry == (size_t) 0U);
+
+    return (chunk_id << POOL_ENTRY_BITS) |
+        (PoolHandle) (offset / pool->sizeof_entry);
+}
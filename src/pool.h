@@ -0,0 +1,44 @@
+
+#ifndef __POOL_H__
+#define __POOL_H__ 1
+
+typedef uint32_t PoolHandle;
+
+#define POOL_HANDLE_NONE ((PoolHandle) 0U)
+
+#ifndef POOL_CHUNK_SIZE
+# define POOL_CHUNK_SIZE ((size_t) 65536U)
+#endif
+#ifndef POOL_ENTRY_BITS
+# define POOL_ENTRY_BITS 14U
+#endif
+#define POOL_ENTRY_MASK ((PoolHandle) ((1U << POOL_ENTRY_BITS) - 1U))
+#define POOL_MAX_CHUNKS ((PoolHandle) (UINT32_MAX >> POOL_ENTRY_BITS))
+#define POOL_CHUNK_HEADER_SIZE ((size_t) 16U)
+
+typedef struct Pool_ {
+    unsigned char * *chunks;
+    size_t sizeof_entry;
+    PoolHandle entries_per_chunk;
+    PoolHandle nb_chunks;
+    PoolHandle allocated_chunks;
+    PoolHandle nb_entries_in_last_chunk;
+    PoolHandle first_free_entry;
+} Pool;
+
+// H is evaluated more than once
+#define POOL_ENTRY(P, H) ((H) == POOL_HANDLE_NONE ? NULL : (void *)     \
+    ((P)->chunks[((H) >> POOL_ENTRY_BITS) - 1U] +                       \
+     POOL_CHUNK_HEADER_SIZE +                                           \
+     (size_t) ((H) & POOL_ENTRY_MASK) * (P)->sizeof_entry))
+
+int init_pool(Pool * const pool, const size_t sizeof_entry);
+
+void free_pool(Pool * const pool);
+
+void *add_entry_to_pool(Pool * const pool, const void * const entry);
+int remove_entry_from_pool(Pool * const pool, void * const entry);
+
+PoolHandle get_pool_handle(const Pool * const pool, const void * const entry);
+
+#endif
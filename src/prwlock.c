@@ -0,0 +1,157 @@
+
+#include "common.h"
+#include "prwlock.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+# define prwlock_cpu_relax() __asm__ __volatile__("pause" ::: "memory")
+#else
+# define prwlock_cpu_relax() __asm__ __volatile__("" ::: "memory")
+#endif
+
+static unsigned int prwlock_next_thread_id;
+static __thread unsigned int prwlock_thread_id;
+
+static unsigned int get_prwlock_thread_id(void)
+{
+    if (prwlock_thread_id == 0U) {
+        do {
+            prwlock_thread_id = __atomic_add_fetch(&prwlock_next_thread_id,
+                                                   1U, __ATOMIC_RELAXED);
+        } while (prwlock_thread_id == 0U);
+    }
+    return prwlock_thread_id;
+}
+
+int init_prwlock(PRWLock * const prwlock)
+{
+    PRWLockState *state;
+    void *state_;
+    unsigned int t;
+    
+    if (posix_memalign(&state_, CQUEUE_CACHELINE_SIZE, sizeof *state) != 0) {
+        prwlock->state = NULL;
+        return -1;
+    }
+    state = state_;
+    state->writer = 0U;
+    state->writer_id = 0U;
+    pthread_mutex_init(&state->mtx_writers, NULL);
+    init_cqueue_waiters(&state->readers_waiters);
+    init_cqueue_waiters(&state->writer_waiters);
+    for (t = 0U; t < PRWLOCK_NB_SLOTS; t++) {
+        state->slots[t].readers = 0U;
+    }
+    prwlock->state = state;
+    
+    return 0;
+}
+
+void free_prwlock(PRWLock * const prwlock)
+{
+    PRWLockState * const state = prwlock->state;
+    
+    if (state == NULL) {
+        return;
+    }
+    free_cqueue_waiters(&state->readers_waiters);
+    free_cqueue_waiters(&state->writer_waiters);
+    pthread_mutex_destroy(&state->mtx_writers);
+    free(state);
+    prwlock->state = NULL;
+}
+
+static void wait_for_writer(PRWLockState * const state)
+{
+    unsigned int round = 0U;
+    uint32_t seq;
+    
+    while (__atomic_load_n(&state->writer, __ATOMIC_SEQ_CST) != 0U) {
+        if (++round < PRWLOCK_SPIN_ROUNDS) {
+            prwlock_cpu_relax();
+            continue;
+        }
+        seq = prepare_wait_cqueue_waiters(&state->readers_waiters);
+        if (__atomic_load_n(&state->writer, __ATOMIC_SEQ_CST) == 0U) {
+            cancel_wait_cqueue_waiters(&state->readers_waiters);
+            break;
+        }
+        wait_cqueue_waiters(&state->readers_waiters, seq);
+    }
+}
+
+static void wait_for_readers(PRWLockState * const state,
+                             PRWLockSlot * const slot)
+{
+    unsigned int round = 0U;
+    uint32_t seq;
+    
+    while (__atomic_load_n(&slot->readers, __ATOMIC_SEQ_CST) != 0U) {
+        if (++round < PRWLOCK_SPIN_ROUNDS) {
+            prwlock_cpu_relax();
+            continue;
+        }
+        seq = prepare_wait_cqueue_waiters(&state->writer_waiters);
+        if (__atomic_load_n(&slot->readers, __ATOMIC_SEQ_CST) == 0U) {
+            cancel_wait_cqueue_waiters(&state->writer_waiters);
+            break;
+        }
+        wait_cqueue_waiters(&state->writer_waiters, seq);
+    }
+}
+
+int prwlock_rdlock(PRWLock * const prwlock)
+{
+    PRWLockState * const state = prwlock->state;
+    PRWLockSlot * const slot =
+        &state->slots[get_prwlock_thread_id() % PRWLOCK_NB_SLOTS];
+    
+    for (;;) {
+        __atomic_add_fetch(&slot->readers, 1U, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&state->writer, __ATOMIC_SEQ_CST) == 0U) {
+            break;
+        }
+        if (__atomic_sub_fetch(&slot->readers, 1U, __ATOMIC_SEQ_CST) == 0U) {
+            wake_cqueue_waiters(&state->writer_waiters, 0);
+        }
+        wait_for_writer(state);
+    }
+    return 0;
+}
+
+int prwlock_wrlock(PRWLock * const prwlock)
+{
+    PRWLockState * const state = prwlock->state;
+    unsigned int t;
+    
+    pthread_mutex_lock(&state->mtx_writers);
+    __atomic_store_n(&state->writer_id, get_prwlock_thread_id(),
+                     __ATOMIC_RELAXED);
+    __atomic_store_n(&state->writer, 1U, __ATOMIC_SEQ_CST);
+    for (t = 0U; t < PRWLOCK_NB_SLOTS; t++) {
+        wait_for_readers(state, &state->slots[t]);
+    }
+    return 0;
+}
+
+int prwlock_unlock(PRWLock * const prwlock)
+{
+    PRWLockState * const state = prwlock->state;
+    const unsigned int thread_id = get_prwlock_thread_id();
+    PRWLockSlot *slot;
+    
+    if (__atomic_load_n(&state->writer, __ATOMIC_SEQ_CST) != 0U &&
+        __atomic_load_n(&state->writer_id, __ATOMIC_RELAXED) == thread_id) {
+        __atomic_store_n(&state->writer_id, 0U, __ATOMIC_RELAXED);
+        __atomic_store_n(&state->writer, 0U, __ATOMIC_SEQ_CST);
+        wake_cqueue_waiters(&state->readers_waiters, 1);
+        pthread_mutex_unlock(&state->mtx_writers);
+        
+        return 0;
+    }
+    slot = &state->slots[thread_id % PRWLOCK_NB_SLOTS];
+    if (__atomic_sub_fetch(&slot->readers, 1U, __ATOMIC_SEQ_CST) == 0U &&
+        __atomic_load_n(&state->writer, __ATOMIC_SEQ_CST) != 0U) {
+        wake_cqueue_waiters(&state->writer_waiters, 0);
+    }
+    return 0;
+}
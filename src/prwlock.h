@@ -0,0 +1,35 @@
+
+#ifndef __PRWLOCK_H__
+#define __PRWLOCK_H__ 1
+
+#ifndef PRWLOCK_NB_SLOTS
+# define PRWLOCK_NB_SLOTS 32U
+#endif
+#ifndef PRWLOCK_SPIN_ROUNDS
+# define PRWLOCK_SPIN_ROUNDS 256U
+#endif
+
+typedef struct PRWLockSlot_ {
+    unsigned int readers;
+} __attribute__((aligned(CQUEUE_CACHELINE_SIZE))) PRWLockSlot;
+
+typedef struct PRWLockState_ {
+    unsigned int writer;
+    unsigned int writer_id;
+    pthread_mutex_t mtx_writers __attribute__((aligned(CQUEUE_CACHELINE_SIZE)));
+    CQueueWaiters readers_waiters;
+    CQueueWaiters writer_waiters;
+    PRWLockSlot slots[PRWLOCK_NB_SLOTS];
+} PRWLockState;
+
+typedef struct PRWLock_ {
+    PRWLockState *state;
+} PRWLock;
+
+int init_prwlock(PRWLock * const prwlock);
+void free_prwlock(PRWLock * const prwlock);
+int prwlock_rdlock(PRWLock * const prwlock);
+int prwlock_wrlock(PRWLock * const prwlock);
+int prwlock_unlock(PRWLock * const prwlock);
+
+#endif
@@ -45,11 +45,10 @@ int handle_public_request(HttpHandlerContext * const context,
                           const char * const opts,
                           struct evhttp_request * const req)
 {
+    Op op;
+    PublicGetOp * const get_op = &op.public_get_op;
     Key *layer_name;
     Key *key;
-    PanDB *pan_db;
-    KeyNode *key_node;
-    int status;
     char *sep;    
     
     (void) opts;
@@ -78,23 +77,34 @@ int handle_public_request(HttpHandlerContext * const context,
         release_key(layer_name);
         evhttp_send_error(req, HTTP_SERVUNAVAIL, "Out of memory (key)");
         return -2;
-    }    
-    pthread_rwlock_rdlock(&context->rwlock_layers);
-    if (get_pan_db_by_layer_name(context, layer_name->val, 0, &pan_db) < 0) {
+    }
+    *get_op = (PublicGetOp) {
+        .type = OP_TYPE_PUBLIC_GET,
+        .req = req,
+        .fake_req = 0,
+        .op_tid = next_op_tid(context),
+        .layer_name = layer_name,
+        .key = key
+    };
+    if (dispatch_op(context, &op) != 0) {
         release_key(layer_name);
         release_key(key);
-        
-unlock_and_bailout:
-        pthread_rwlock_unlock(&context->rwlock_layers);
-        evhttp_send_error(req, HTTP_NOTFOUND, "Not Found");
-        
-        return -1;
+        evhttp_send_error(req, HTTP_SERVUNAVAIL, "Too many queued requests");
+        return -2;
     }
-    release_key(layer_name);
-    status = get_key_node_from_key(pan_db, key, 0, &key_node);
-    release_key(key);
+    return 0;
+}
+
+static int public_get_in_layer(PublicGetOp * const get_op,
+                               PanDB * const pan_db,
+                               PublicGetOpReply * const get_op_reply)
+{
+    KeyNode *key_node;
+    int status;
+    
+    status = get_key_node_from_key(pan_db, get_op->key, 0, &key_node);
     if (key_node == NULL || status <= 0) {
-        goto unlock_and_bailout;
+        return HTTP_NOTFOUND;
     }
     PublicPropertiesCBContext cb_context = {
         .content = NULL,
@@ -105,38 +115,67 @@ unlock_and_bailout:
     slip_map_foreach(&key_node->properties, public_properties_cb,
                      &cb_context);
     if (cb_context.content_len <= (size_t) 0U) {
-        pthread_rwlock_unlock(&context->rwlock_layers);
-        evhttp_send_error(req, HTTP_NOTFOUND, "Not Found");
-        return -1;
+        return HTTP_NOTFOUND;
     }
     if (cb_context.content_type_len > MAX_CONTENT_TYPE_LENGTH) {
-        pthread_rwlock_unlock(&context->rwlock_layers);
-        evhttp_send_error(req, HTTP_BADREQUEST, "Content-Type too long");
-        return -1;        
-    }
-    struct evbuffer *evb;
-    if ((evb = evbuffer_new()) == NULL) {
-        pthread_rwlock_unlock(&context->rwlock_layers);
-        evhttp_send_error(req, HTTP_SERVUNAVAIL, "Out of memory (evbuffer)");
-        return -1;
+        return HTTP_BADREQUEST;
     }
-    const char *content_type;
-    char content_type_buf[MAX_CONTENT_TYPE_LENGTH + (size_t) 1U];
-    if (cb_context.content_type_len <= (size_t) 0U) {
-        content_type = DEFAULT_CONTENT_TYPE_FOR_PUBLIC_DATA;
-    } else {
-        assert(cb_context.content_type_len <= MAX_CONTENT_TYPE_LENGTH);
-        memcpy(content_type_buf, cb_context.content_type,
+    if (cb_context.content_type_len > (size_t) 0U) {
+        if ((get_op_reply->content_type =
+             malloc(cb_context.content_type_len + (size_t) 1U)) == NULL) {
+            return HTTP_SERVUNAVAIL;
+        }
+        memcpy(get_op_reply->content_type, cb_context.content_type,
                cb_context.content_type_len);
-        *(content_type_buf + cb_context.content_type_len) = 0;
-        content_type = content_type_buf;
-    }
-    evhttp_add_header(req->output_headers, "Content-Type", content_type);
-    evbuffer_add(evb, cb_context.content, cb_context.content_len);
-    pthread_rwlock_unlock(&context->rwlock_layers);
-    evhttp_send_reply(req, HTTP_OK, "OK", evb);
-    evbuffer_free(evb);
-    
-    return -1;   
+        *(get_op_reply->content_type + cb_context.content_type_len) = 0;
+    }
+    if ((get_op_reply->evb = evbuffer_new()) == NULL ||
+        evbuffer_add(get_op_reply->evb, cb_context.content,
+                     cb_context.content_len) != 0) {
+        return HTTP_SERVUNAVAIL;
+    }
+    return HTTP_OK;
 }
 
+int handle_op_public_get(PublicGetOp * const get_op,
+                         HttpHandlerContext * const context)
+{
+    PanDB *pan_db;
+    OpReply *op_reply = malloc(sizeof *op_reply);
+    
+    if (op_reply == NULL) {
+        release_key(get_op->layer_name);
+        release_key(get_op->key);
+        return HTTP_SERVUNAVAIL;
+    }
+    PublicGetOpReply * const get_op_reply = &op_reply->public_get_op_reply;
+    *get_op_reply = (PublicGetOpReply) {
+        .type = OP_TYPE_PUBLIC_GET,
+        .req = get_op->req,
+        .op_tid = get_op->op_tid,
+        .json_gen = NULL,
+        .status = HTTP_NOTFOUND,
+        .evb = NULL,
+        .content_type = NULL
+    };
+    if (get_pan_db_by_layer_name(context, get_op->layer_name->val,
+                                 0, &pan_db) >= 0) {
+        prwlock_rdlock(&pan_db->rwlock_db);
+        get_op_reply->status = public_get_in_layer(get_op, pan_db,
+                                                   get_op_reply);
+        prwlock_unlock(&pan_db->rwlock_db);
+    }
+    release_key(get_op->layer_name);
+    release_key(get_op->key);
+    if (get_op_reply->status != HTTP_OK) {
+        if (get_op_reply->evb != NULL) {
+            evbuffer_free(get_op_reply->evb);
+            get_op_reply->evb = NULL;
+        }
+        free(get_op_reply->content_type);
+        get_op_reply->content_type = NULL;
+    }
+    send_op_reply(context, op_reply);
+    
+    return 0;
+}
@@ -14,4 +14,7 @@ int handle_public_request(HttpHandlerContext * const context,
                           const char * const opts,
                           struct evhttp_request * const req);
 
+int handle_op_public_get(PublicGetOp * const get_op,
+                         HttpHandlerContext * const context);
+
 #endif
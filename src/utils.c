@@ -101,6 +101,19 @@ static int records_get_properties_cb(void * const context_,
     return 0;
 }
 
+static void slot_dimension_to_json(yajl_gen json_gen,
+                                   const SlotDimension d)
+{
+#if COMPACT_SLOTS
+    char buf[sizeof "-2147483648.0000000"];
+
+    snprintf(buf, sizeof buf, SLOT_DIMENSION_FORMAT, SLOT_DIMENSION(d));
+    yajl_gen_number(json_gen, buf, strlen(buf));
+#else
+    yajl_gen_double(json_gen, SLOT_DIMENSION(d));
+#endif
+}
+
 static int key_node_to_json_(KeyNode * const key_node, yajl_gen json_gen,
                              PanDB * const pan_db,                             
                              const _Bool with_properties,
@@ -121,6 +134,12 @@ static int key_node_to_json_(KeyNode * const key_node, yajl_gen json_gen,
         } else {
             type = "point";
         }
+    } else if (key_node->polygon != NULL) {
+        if (key_node->properties != NULL) {
+            type = "polygon+hash";
+        } else {
+            type = "polygon";
+        }
     } else if (key_node->properties != NULL) {
         type = "hash";
     }
@@ -130,32 +149,49 @@ static int key_node_to_json_(KeyNode * const key_node, yajl_gen json_gen,
 #if PROJECTION
         yajl_gen_string(json_gen, (const unsigned char *) "latitude",
                         (unsigned int) sizeof "latitude" - (size_t) 1U);
-        yajl_gen_double(json_gen,
-                        (double) key_node->slot->real_position.latitude);
+        slot_dimension_to_json(json_gen,
+                               key_node->slot->real_position.latitude);
         yajl_gen_string(json_gen, (const unsigned char *) "longitude",
                         (unsigned int) sizeof "longitude" - (size_t) 1U);
-        yajl_gen_double(json_gen,
-                        (double) key_node->slot->real_position.longitude);
+        slot_dimension_to_json(json_gen,
+                               key_node->slot->real_position.longitude);
         
         yajl_gen_string(json_gen, (const unsigned char *) "latitude_proj",
                         (unsigned int) sizeof "latitude_proj" - (size_t) 1U);
-        yajl_gen_double(json_gen,
-                        (double) key_node->slot->position.latitude);
+        slot_dimension_to_json(json_gen,
+                               key_node->slot->position.latitude);
         yajl_gen_string(json_gen, (const unsigned char *) "longitude_proj",
                         (unsigned int) sizeof "longitude_proj" - (size_t) 1U);
-        yajl_gen_double(json_gen,
-                        (double) key_node->slot->position.longitude);
+        slot_dimension_to_json(json_gen,
+                               key_node->slot->position.longitude);
 #else
         yajl_gen_string(json_gen, (const unsigned char *) "latitude",
                         (unsigned int) sizeof "latitude" - (size_t) 1U);
-        yajl_gen_double(json_gen,
-                        (double) key_node->slot->position.latitude);
+        slot_dimension_to_json(json_gen,
+                               key_node->slot->position.latitude);
         yajl_gen_string(json_gen, (const unsigned char *) "longitude",
                         (unsigned int) sizeof "longitude" - (size_t) 1U);
-        yajl_gen_double(json_gen,
-                        (double) key_node->slot->position.longitude);
+        slot_dimension_to_json(json_gen,
+                               key_node->slot->position.longitude);
 #endif
     }
+    if (key_node->polygon != NULL) {
+        const Polygon * const polygon = key_node->polygon;
+        NbSlots i;
+        
+        yajl_gen_string(json_gen, (const unsigned char *) "polygon",
+                        (unsigned int) sizeof "polygon" - (size_t) 1U);
+        yajl_gen_array_open(json_gen);
+        for (i = (NbSlots) 0U; i < polygon->nb_vertices; i++) {
+            yajl_gen_array_open(json_gen);
+            yajl_gen_double(json_gen,
+                            (double) polygon->vertices[i].latitude);
+            yajl_gen_double(json_gen,
+                            (double) polygon->vertices[i].longitude);
+            yajl_gen_array_close(json_gen);
+        }
+        yajl_gen_array_close(json_gen);
+    }
     if (with_properties == 0) {
         return 0;
     }
@@ -291,182 +327,6 @@ Dimension meters_to_geoidal_distance(const Meters d)
     return (Dimension) d / (Dimension) (EARTH_CIRCUMFERENCE / 360.0);
 }
 
-Dimension2 compute_square_distance(const PanDB * const pan_db,
-                                   const Position2D * const position1,
-                                   const Position2D * const position2)
-{
-    Dimension2 d_latitude = (Dimension2) position2->latitude -
-        (Dimension2) position1->latitude;
-    Dimension2 d_longitude = (Dimension2) position2->longitude -
-        (Dimension2) position1->longitude;
-    
-    if (pan_db == NULL) {
-        return (Dimension2) 0.0;
-    }
-    if (pan_db->layer_type != LAYER_TYPE_FLAT) {
-        assert(pan_db->layer_type == LAYER_TYPE_FLATWRAP);
-        
-        if (d_latitude > pan_db->qbounds.edge1.latitude) {
-            d_latitude = d_latitude - pan_db->qbounds.edge1.latitude +
-                pan_db->qbounds.edge0.latitude;
-        }
-        if (d_longitude > pan_db->qbounds.edge1.longitude) {
-            d_longitude = d_longitude - pan_db->qbounds.edge1.longitude +
-                    pan_db->qbounds.edge0.longitude;
-        }
-    }
-    return d_latitude * d_latitude + d_longitude * d_longitude;
-}
-
-Meters distance_between_flat_positions(const PanDB * const pan_db,
-                                       const Position2D * const p1,
-                                       const Position2D * const p2)
-{
-    assert(pan_db->layer_type == LAYER_TYPE_FLAT ||
-           pan_db->layer_type == LAYER_TYPE_FLATWRAP);
-    
-    return (Meters) sqrtf(compute_square_distance(pan_db, p1, p2));
-}
-
-// Adapted from an implementation by Chris Veness
-
-Meters vincenty_distance_between_geoidal_positions(const Position2D * const p1,
-                                                   const Position2D * const p2)
-{
-    const double a = 6378137.0;
-    const double b = 6356752.3142;
-    const double f = 1.0 / 298.257223563;
-    const double L = DEG_TO_RAD(p2->longitude - p1->longitude);
-    const double U1 = atan((1.0 - f) * tan(DEG_TO_RAD(p1->latitude)));
-    const double U2 = atan((1.0 - f) * tan(DEG_TO_RAD(p2->latitude)));
-    const double sinU1 = sin(U1);
-    const double cosU1 = cos(U1);
-    const double sinU2 = sin(U2);
-    const double cosU2 = cos(U2);    
-    double lambda = L;
-    double lambdaP;
-    double sinSigma;
-    double cosSigma;
-    double cosSqAlpha;
-    double cos2SigmaM;
-    double sigma = 0.0;
-    unsigned int iterLimit = 100U;
-    do {
-        const double sinLambda = sin(lambda);
-        const double cosLambda = cos(lambda);
-        sinSigma = sqrt((cosU2 * sinLambda) * (cosU2 * sinLambda) + 
-                        (cosU1 * sinU2 - sinU1 * cosU2 * cosLambda) *
-                        (cosU1 * sinU2 - sinU1 * cosU2 * cosLambda));
-        if (sinSigma == 0.0) {
-            return (Meters) 0.0;
-        }
-        cosSigma = sinU1 * sinU2 + cosU1 * cosU2 * cosLambda;
-        sigma = atan2(sinSigma, cosSigma);
-        const double sinAlpha = cosU1 * cosU2 * sinLambda / sinSigma;
-        cosSqAlpha = 1.0 - sinAlpha * sinAlpha;
-        cos2SigmaM = cosSigma - 2.0 * sinU1 * sinU2 / cosSqAlpha;
-        if (isnan(cos2SigmaM)) {
-            cos2SigmaM = 0.0;
-        }
-        const double C = f / 16.0 * cosSqAlpha *
-            (4.0 + f * (4.0 - 3.0 * cosSqAlpha));
-        lambdaP = lambda;
-        lambda = L + (1.0 - C) * f * sinAlpha *
-            (sigma + C * sinSigma *
-                (cos2SigmaM + C * cosSigma *
-                    (-1.0 + 2.0 * cos2SigmaM * cos2SigmaM))
-            );
-    } while (fabs(lambda-lambdaP) > 1E-12 && --iterLimit > 0U);
-    
-    if (iterLimit == 0) {
-        return hs_distance_between_geoidal_positions(p1, p2);
-    }
-    const double uSq = cosSqAlpha * (a * a - b * b) / (b * b);
-    const double A = 1.0 + uSq / 16384.0 *
-        (4096.0 + uSq *
-            (-768.0 + uSq * (320.0 - 175.0 * uSq))
-        );
-    const double B = uSq / 1024.0 *
-        (256.0 + uSq *
-            (-128.0 + uSq * (74.0 - 47.0 * uSq))
-        );
-    const double deltaSigma = B * sinSigma *
-        (cos2SigmaM + B / 4.0 *
-            (cosSigma * (-1.0 + 2.0 * cos2SigmaM * cos2SigmaM) -
-                B / 6.0 * cos2SigmaM *
-                (-3.0 + 4.0 * sinSigma * sinSigma) *
-                (-3.0 + 4.0 * cos2SigmaM * cos2SigmaM)
-            )
-        );
-    const double d = b * A * (sigma - deltaSigma);
-    
-    return (Meters) d;
-}
-
-Meters hs_distance_between_geoidal_positions(const Position2D * const p1,
-                                             const Position2D * const p2)
-{
-    const float lat1 = (float) DEG_TO_RAD(p1->latitude);
-    const float lon1 = (float) DEG_TO_RAD(p1->longitude);
-    const float lat2 = (float) DEG_TO_RAD(p2->latitude);
-    const float lon2 = (float) DEG_TO_RAD(p2->longitude);
-    const float dlat = lat2 - lat1;
-    const float dlon = lon2 - lon1;
-    const float sin_dlath = sinf(dlat / 2.0F);
-    const float sin_dlat2 = sin_dlath * sin_dlath;    
-    const float sin_dlonh = sinf(dlon / 2.0F);
-    const float sin_dlon2 = sin_dlonh * sin_dlonh;
-    const float a = sin_dlat2 + cosf(lat1) * cosf(lat2) * sin_dlon2;
-    const float c = 2.0F * atan2f(sqrtf(a), sqrtf(1.0F - a));
-    const float d = EARTH_RADIUS * c;
-    
-    return (Meters) d;
-}
-
-Meters gc_distance_between_geoidal_positions(const Position2D * const p1,
-                                             const Position2D * const p2)
-{
-    const float a = (float) DEG_TO_RAD(p1->latitude);
-    const float b = (float) DEG_TO_RAD(p2->latitude);
-    const float x = (float) DEG_TO_RAD(- p1->longitude);
-    const float y = (float) DEG_TO_RAD(- p2->longitude);
-    const float cosa = sinf(a) * sinf(b) + cosf(a) * cosf(b) * cosf(x - y);
-    float d = 0.0F;
-    if (cosa > 1.0) {
-        return 0.0F;
-    }
-    if (cosa < (1.0F - FLT_EPSILON)) {
-        d = acosf(cosa);
-    }
-    d *= EARTH_RADIUS;
-    if (d < 10.0F) {
-        d = fast_distance_between_geoidal_positions(p1, p2);
-    }
-    return d;
-}
-
-Meters fast_distance_between_geoidal_positions(const Position2D * const p1,
-                                               const Position2D * const p2)
-{
-    const float k = cosf(DEG_TO_RAD(p1->latitude));
-    const float dx = k * (p1->longitude - p2->longitude);
-    const float dy = p1->latitude - p2->latitude;
-    const float d = DEG_AVG_DISTANCE * sqrtf(dx * dx + dy * dy);
-    
-    return (Meters) d;
-}
-
-Meters rhomboid_distance_between_geoidal_positions(const Position2D * const p1,
-                                                   const Position2D * const p2)
-{
-    const float k = cosf(DEG_TO_RAD(p1->latitude));
-    const float dx = k * (p1->longitude - p2->longitude);
-    const float dy = p1->latitude - p2->latitude;
-    const float d = DEG_AVG_DISTANCE * (fabs(dx) + fabs(dy));
-    
-    return (Meters) d;
-}
-
 void untangle_rect(Rectangle2D * const rect)
 {
     if (rect->edge0.latitude > rect->edge1.latitude) {
@@ -481,6 +341,55 @@ void untangle_rect(Rectangle2D * const rect)
     }
 }
 
+int parse_polygon(const char *svalue, Position2D * * const vertices_,
+                  NbSlots * const nb_vertices)
+{
+    const char *pnt;
+    char *endptr;
+    Position2D *vertices;
+    size_t nb_dimensions = (size_t) 1U;
+    size_t i;
+    Dimension dimension;
+    
+    for (pnt = svalue; *pnt != 0; pnt++) {
+        if (*pnt == ',') {
+            nb_dimensions++;
+        }
+    }
+    if (nb_dimensions % (size_t) 2U != (size_t) 0U ||
+        nb_dimensions / (size_t) 2U < (size_t) 3U ||
+        nb_dimensions / (size_t) 2U > (size_t) MAX_POLYGON_VERTICES) {
+        return -1;
+    }
+    if ((vertices = malloc(nb_dimensions / (size_t) 2U *
+                           sizeof *vertices)) == NULL) {
+        return -1;
+    }
+    for (i = (size_t) 0U; i < nb_dimensions; i++) {
+        skip_spaces(&svalue);
+        dimension = (Dimension) strtod(svalue, &endptr);
+        if (endptr == NULL || endptr == svalue) {
+            free(vertices);
+            return -1;
+        }
+        if ((i & (size_t) 1U) == (size_t) 0U) {
+            vertices[i / (size_t) 2U].latitude = dimension;
+        } else {
+            vertices[i / (size_t) 2U].longitude = dimension;
+        }
+        svalue = endptr;
+        skip_spaces(&svalue);
+        if (i + (size_t) 1U < nb_dimensions && *svalue++ != ',') {
+            free(vertices);
+            return -1;
+        }
+    }
+    *vertices_ = vertices;
+    *nb_vertices = (NbSlots) (nb_dimensions / (size_t) 2U);
+    
+    return 0;
+}
+
 int safe_write(const int fd, const void * const buf_, size_t count,
                const int timeout)
 {
@@ -650,8 +559,9 @@ ssize_t buffered_read(BufferedReadContext * const context,
                       char * const out_buf, const size_t length)
 {
     struct evbuffer * const buf = context->buf;
-    const size_t available_in_buf = evbuffer_get_length(buf);
-    if (available_in_buf < length) {
+    size_t available_in_buf;
+    
+    while ((available_in_buf = evbuffer_get_length(buf)) < length) {
         if (context->offset >= context->total_size) {
             return 0;
         }        
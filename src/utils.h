@@ -10,6 +10,10 @@
 # define INITIAL_TRAVERSAL_STACK_SIZE ((size_t) 100U)
 #endif
 
+#ifndef MAX_POLYGON_VERTICES
+# define MAX_POLYGON_VERTICES 4096
+#endif
+
 #define BINVAL_IS_EQUAL_TO_CONST_STRING(BV, S) \
     ((BV)->size == sizeof (S) - (size_t) 1U && \
         strncasecmp((BV)->val, (S), sizeof (S) - (size_t) 1U) == 0)
@@ -47,31 +51,11 @@ Position2D flat_projection(const Position2D * const position);
 Meters geoidal_distance_to_meters(const Dimension d);
 Dimension meters_to_geoidal_distance(const Meters d);
 
-Dimension2 compute_square_distance(const PanDB * const pan_db,
-                                   const Position2D * const position1,
-                                   const Position2D * const position2);
-
-Meters distance_between_flat_positions(const PanDB * const pan_db,
-                                       const Position2D * const p1,
-                                       const Position2D * const p2);
-
-Meters vincenty_distance_between_geoidal_positions(const Position2D * const p1,
-                                                   const Position2D * const p2);
-
-Meters hs_distance_between_geoidal_positions(const Position2D * const p1,
-                                             const Position2D * const p2);
-
-Meters gc_distance_between_geoidal_positions(const Position2D * const p1,
-                                             const Position2D * const p2);
-
-Meters fast_distance_between_geoidal_positions(const Position2D * const p1,
-                                               const Position2D * const p2);
-
-Meters rhomboid_distance_between_geoidal_positions(const Position2D * const p1,
-                                                   const Position2D * const p2);
-
 void untangle_rect(Rectangle2D * const rect);
 
+int parse_polygon(const char *svalue, Position2D * * const vertices,
+                  NbSlots * const nb_vertices);
+
 int safe_write(const int fd, const void * const buf_, size_t count,
                const int timeout);
 
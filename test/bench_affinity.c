@@ -0,0 +1,327 @@
+#define DEFINE_GLOBALS 1
+#include "common.h"
+#include "cpu_affinity.h"
+#include <time.h>
+
+#define BENCH_LAYERS      4U
+#define BENCH_KEYS        100000U
+#define BENCH_OPS         500000U
+#define BENCH_LANE_OPS    4096U
+#define BENCH_SEARCH_RATE 4U
+
+typedef enum BenchOpType_ {
+    BENCH_OP_PUT,
+    BENCH_OP_SEARCH,
+    BENCH_OP_STOP
+} BenchOpType;
+
+typedef struct BenchOp_ {
+    BenchOpType type;
+    unsigned int layer;
+    unsigned int key;
+    Position2D position;
+} BenchOp;
+
+typedef struct BenchWorker_ {
+    CQueueWaiters *waiters;
+    CQueue *lane;
+    pthread_t thr;
+    SubSlots results;
+} BenchWorker;
+
+typedef struct BenchLoop_ {
+    pthread_t thr;
+    unsigned int seed;
+    unsigned int nb_ops;
+} BenchLoop;
+
+static PanDB layers[BENCH_LAYERS];
+static KeyNode *key_nodes[BENCH_LAYERS][BENCH_KEYS];
+static BenchWorker *workers;
+static CQueueWaiters *workers_waiters;
+static BenchLoop *loops;
+static unsigned int nb_workers;
+static unsigned int nb_loops;
+static Key key;
+static char fake_context;
+static const volatile sig_atomic_t never_exit;
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static Dimension random_dimension(unsigned int * const seed,
+                                  const Dimension min, const Dimension max)
+{
+    const int r = rand_r(seed);
+
+    return min + (max - min) * (Dimension) r / (Dimension) RAND_MAX;
+}
+
+static Position2D random_position(unsigned int * const seed)
+{
+    return (Position2D) {
+        .latitude = 48.85F + random_dimension(seed, -0.5F, 0.5F),
+        .longitude = 2.35F + random_dimension(seed, -0.5F, 0.5F)
+    };
+}
+
+static int count_cb(void * const context, Slot * const slot,
+                    Meters distance)
+{
+    SubSlots * const count = context;
+
+    (void) slot;
+    (void) distance;
+    (*count)++;
+
+    return 0;
+}
+
+static BenchWorker *get_worker_for_key(const unsigned int layer,
+                                       const unsigned int key_id)
+{
+    uint32_t h = (uint32_t) layer * 0x9e3779b1U ^ (uint32_t) key_id;
+
+    h ^= h >> 16;
+    h *= 0x85ebca6bU;
+    h ^= h >> 13;
+
+    return &workers[h % nb_workers];
+}
+
+static int put_record(const unsigned int layer, const unsigned int key_id,
+                      const Position2D * const position)
+{
+    PanDB * const db = &layers[layer];
+    KeyNode * const key_node = key_nodes[layer][key_id];
+    SlotPosition slot_position;
+    Slot slot;
+    Slot *new_slot;
+
+    if (make_slot_position(&slot_position, (double) position->latitude,
+                           (double) position->longitude) != 0) {
+        return -1;
+    }
+    if (key_node->slot != NULL) {
+        if (move_slot(db, key_node->slot, &slot_position) == 0) {
+            return 0;
+        }
+        remove_entry_from_key_node(db, key_node, 0);
+    }
+    init_slot(&slot);
+    slot.position = slot_position;
+    slot.key_node = KEY_NODE_REF(db, key_node);
+    if (add_slot(db, &slot, &new_slot) != 0) {
+        return -1;
+    }
+    key_node->slot = new_slot;
+
+    return 0;
+}
+
+static void *worker_thread(void *worker_)
+{
+    BenchWorker * const worker = worker_;
+    CQueue *lane = worker->lane;
+    BenchOp op;
+    PanDB *db;
+
+    for (;;) {
+        if (shift_cqueues_wait(&lane, (size_t) 1U, worker->waiters,
+                               &op, &never_exit) != 0) {
+            break;
+        }
+        if (op.type == BENCH_OP_STOP) {
+            break;
+        }
+        db = &layers[op.layer];
+        if (op.type == BENCH_OP_PUT) {
+            prwlock_wrlock(&db->rwlock_db);
+            if (put_record(op.layer, op.key, &op.position) != 0) {
+                exit(1);
+            }
+            prwlock_unlock(&db->rwlock_db);
+        } else {
+            prwlock_rdlock(&db->rwlock_db);
+            find_near(db, count_cb, NULL, &worker->results, &op.position,
+                      (Meters) 1000.0F, (SubSlots) ULONG_MAX,
+                      (Dimension) 0.0F);
+            prwlock_unlock(&db->rwlock_db);
+        }
+    }
+    return NULL;
+}
+
+static void *loop_thread(void *loop_)
+{
+    BenchLoop * const loop = loop_;
+    BenchOp op;
+    unsigned int i;
+
+    for (i = 0U; i < loop->nb_ops; i++) {
+        op.layer = (unsigned int) rand_r(&loop->seed) % BENCH_LAYERS;
+        op.key = (unsigned int) rand_r(&loop->seed) % BENCH_KEYS;
+        op.position = random_position(&loop->seed);
+        op.type = i % BENCH_SEARCH_RATE == 0U ?
+            BENCH_OP_SEARCH : BENCH_OP_PUT;
+        push_cqueue_wait(get_worker_for_key(op.layer, op.key)->lane, &op);
+    }
+    return NULL;
+}
+
+static void run(const char * const name,
+                const CPUSet * const workers_cpus,
+                const CPUSet * const loops_cpus)
+{
+    const BenchOp stop_op = { .type = BENCH_OP_STOP };
+    SubSlots results = (SubSlots) 0U;
+    double start;
+    double elapsed;
+    unsigned int t;
+
+    for (t = 0U; t < nb_workers; t++) {
+        workers[t].results = (SubSlots) 0U;
+        pthread_create(&workers[t].thr, NULL, worker_thread, &workers[t]);
+        if (pin_thread_to_cpu_set(workers[t].thr, workers_cpus,
+                                  (size_t) t) != 0) {
+            fprintf(stderr, "Unable to set the CPU affinity of worker %u\n",
+                    t);
+        }
+    }
+    start = now();
+    for (t = 0U; t < nb_loops; t++) {
+        loops[t].seed = t + 1U;
+        loops[t].nb_ops = BENCH_OPS / nb_loops;
+        pthread_create(&loops[t].thr, NULL, loop_thread, &loops[t]);
+        if (pin_thread_to_cpu_set(loops[t].thr, loops_cpus,
+                                  (size_t) t) != 0) {
+            fprintf(stderr, "Unable to set the CPU affinity of loop %u\n",
+                    t);
+        }
+    }
+    for (t = 0U; t < nb_loops; t++) {
+        pthread_join(loops[t].thr, NULL);
+    }
+    for (t = 0U; t < nb_workers; t++) {
+        push_cqueue_wait(workers[t].lane, &stop_op);
+    }
+    for (t = 0U; t < nb_workers; t++) {
+        pthread_join(workers[t].thr, NULL);
+        results += workers[t].results;
+    }
+    elapsed = now() - start;
+    printf("%-9s %12.0f ops/s  %10.1f ns/op  %12lu results\n", name,
+           (double) (BENCH_OPS / nb_loops * nb_loops) / elapsed,
+           elapsed * 1e9 / (double) (BENCH_OPS / nb_loops * nb_loops),
+           results);
+    fflush(stdout);
+}
+
+static int default_cpu_set(CPUSet * const cpu_set)
+{
+    char str[sizeof "0-18446744073709551615"];
+    long nb_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (nb_cpus < 1L) {
+        nb_cpus = 1L;
+    }
+    snprintf(str, sizeof str, "0-%ld", nb_cpus - 1L);
+
+    return parse_cpu_set(cpu_set, str);
+}
+
+int main(int argc, char *argv[])
+{
+    const CPUSet no_cpus = { .cpus = NULL, .nb_cpus = (size_t) 0U };
+    const KeyNode template_key_node = { .key = &key };
+    CPUSet workers_cpus;
+    CPUSet loops_cpus;
+    void *waiters;
+    unsigned int seed = 1U;
+    unsigned int layer;
+    unsigned int i;
+
+    if (argc > 3) {
+        fprintf(stderr, "Usage: %s [<WorkersCPUs> [<EventLoopsCPUs>]]\n",
+                argv[0]);
+        return 1;
+    }
+    if ((argc > 1 ? parse_cpu_set(&workers_cpus, argv[1]) :
+         default_cpu_set(&workers_cpus)) != 0 ||
+        (argc > 2 ? parse_cpu_set(&loops_cpus, argv[2]) :
+         parse_cpu_set(&loops_cpus, "0")) != 0) {
+        fprintf(stderr, "Invalid CPU list\n");
+        return 1;
+    }
+    nb_workers = (unsigned int) workers_cpus.nb_cpus;
+    nb_loops = (unsigned int) loops_cpus.nb_cpus;
+    app_context.default_layer_type = LAYER_TYPE_ELLIPSOIDAL;
+    app_context.default_accuracy = ACCURACY_FAST;
+    app_context.bucket_size = BUCKET_SIZE;
+    app_context.dimension_accuracy = DEFAULT_DIMENSION_ACCURACY;
+    init_distances();
+    if ((workers = calloc(nb_workers, sizeof *workers)) == NULL ||
+        (loops = calloc(nb_loops, sizeof *loops)) == NULL ||
+        posix_memalign(&waiters, CQUEUE_CACHELINE_SIZE,
+                       nb_workers * sizeof *workers_waiters) != 0) {
+        return 1;
+    }
+    workers_waiters = waiters;
+    for (i = 0U; i < nb_workers; i++) {
+        init_cqueue_waiters(&workers_waiters[i]);
+        workers[i].waiters = &workers_waiters[i];
+        if ((workers[i].lane = malloc(sizeof *workers[i].lane)) == NULL ||
+            init_cqueue(workers[i].lane, BENCH_LANE_OPS,
+                        sizeof(BenchOp)) != 0) {
+            return 1;
+        }
+        set_cqueue_consumers(workers[i].lane, workers[i].waiters,
+                             (size_t) 1U);
+    }
+    for (layer = 0U; layer < BENCH_LAYERS; layer++) {
+        if (init_pan_db(&layers[layer],
+                        (struct HttpHandlerContext_ *) &fake_context) != 0) {
+            return 1;
+        }
+        for (i = 0U; i < BENCH_KEYS; i++) {
+            const Position2D position = random_position(&seed);
+
+            if ((key_nodes[layer][i] =
+                 new_key_node_entry(&layers[layer],
+                                    &template_key_node)) == NULL ||
+                put_record(layer, i, &position) != 0) {
+                return 1;
+            }
+        }
+    }
+    printf("%u workers, %u event loops, %u layers of %u records\n",
+           nb_workers, nb_loops, BENCH_LAYERS, BENCH_KEYS);
+    run("unpinned", &no_cpus, &no_cpus);
+    run("pinned", &workers_cpus, &loops_cpus);
+    run("unpinned", &no_cpus, &no_cpus);
+    run("pinned", &workers_cpus, &loops_cpus);
+
+    for (layer = 0U; layer < BENCH_LAYERS; layer++) {
+        for (i = 0U; i < BENCH_KEYS; i++) {
+            remove_entry_from_key_node(&layers[layer], key_nodes[layer][i], 0);
+            free_key_node_entry(&layers[layer], key_nodes[layer][i]);
+        }
+        free_pan_db(&layers[layer]);
+    }
+    for (i = 0U; i < nb_workers; i++) {
+        free_cqueue(workers[i].lane);
+        free_cqueue_waiters(&workers_waiters[i]);
+    }
+    free(workers);
+    free(workers_waiters);
+    free(loops);
+    free_cpu_set(&workers_cpus);
+    free_cpu_set(&loops_cpus);
+
+    return 0;
+}
@@ -0,0 +1,160 @@
+#include "common.h"
+#include "distances.h"
+#include <time.h>
+
+#define BENCH_POINTS 50U
+#define BENCH_ROUNDS 200000U
+
+typedef Meters (*ScalarDistance)(const Position2D * const p1,
+                                 const Position2D * const p2);
+
+typedef void (*BatchDistances)(const Position2D * const position,
+                               const Dimension * const latitudes,
+                               const Dimension * const longitudes,
+                               Meters * const distances, const NbSlots count);
+
+static Dimension latitudes[BENCH_POINTS];
+static Dimension longitudes[BENCH_POINTS];
+static Meters distances[BENCH_POINTS];
+static Meters expected[BENCH_POINTS];
+static volatile Meters sink;
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static void report(const char * const name, const char * const kernels,
+                   const double elapsed)
+{
+    Meters max_error = (Meters) 0.0F;
+    unsigned int i;
+
+    for (i = 0U; i < BENCH_POINTS; i++) {
+        if (fabsf(distances[i] - expected[i]) > max_error) {
+            max_error = fabsf(distances[i] - expected[i]);
+        }
+    }
+    printf("%-10s %-8s %8.2f ns/distance  max error %g m\n", name, kernels,
+           elapsed * 1e9 / ((double) BENCH_ROUNDS * BENCH_POINTS),
+           (double) max_error);
+}
+
+static double bench_scalar(const Position2D * const position,
+                           ScalarDistance fn)
+{
+    Position2D scanned_position;
+    unsigned int round;
+    unsigned int i;
+    double start = now();
+
+    for (round = 0U; round < BENCH_ROUNDS; round++) {
+        for (i = 0U; i < BENCH_POINTS; i++) {
+            scanned_position.latitude = latitudes[i];
+            scanned_position.longitude = longitudes[i];
+            distances[i] = fn(position, &scanned_position);
+        }
+        sink = distances[round % BENCH_POINTS];
+    }
+    memcpy(expected, distances, sizeof expected);
+    return now() - start;
+}
+
+static double bench_batch(const Position2D * const position,
+                          BatchDistances fn)
+{
+    unsigned int round;
+    double start = now();
+
+    for (round = 0U; round < BENCH_ROUNDS; round++) {
+        fn(position, latitudes, longitudes, distances, BENCH_POINTS);
+        sink = distances[round % BENCH_POINTS];
+    }
+    return now() - start;
+}
+
+static double bench_flat(const PanDB * const db,
+                         const Position2D * const position)
+{
+    unsigned int round;
+    double start = now();
+
+    for (round = 0U; round < BENCH_ROUNDS; round++) {
+        batch_flat_distances(db, position, latitudes, longitudes,
+                             distances, BENCH_POINTS);
+        sink = distances[round % BENCH_POINTS];
+    }
+    return now() - start;
+}
+
+static double bench_flat_scalar(const PanDB * const db,
+                                const Position2D * const position)
+{
+    Position2D scanned_position;
+    unsigned int round;
+    unsigned int i;
+    double start = now();
+
+    for (round = 0U; round < BENCH_ROUNDS; round++) {
+        for (i = 0U; i < BENCH_POINTS; i++) {
+            scanned_position.latitude = latitudes[i];
+            scanned_position.longitude = longitudes[i];
+            distances[i] = distance_between_flat_positions
+                (db, position, &scanned_position);
+        }
+        sink = distances[round % BENCH_POINTS];
+    }
+    memcpy(expected, distances, sizeof expected);
+    return now() - start;
+}
+
+int main(void)
+{
+    static const struct {
+        const char *name;
+        ScalarDistance scalar;
+        BatchDistances batch;
+    } geoidal[] = {
+        { "fast", fast_distance_between_geoidal_positions,
+          batch_fast_distances },
+        { "rhomboid", rhomboid_distance_between_geoidal_positions,
+          batch_rhomboid_distances },
+        { "gc", gc_distance_between_geoidal_positions,
+          batch_gc_distances },
+        { "hs", hs_distance_between_geoidal_positions,
+          batch_hs_distances }
+    };
+    const Position2D position = { .latitude = 48.5F, .longitude = 2.3F };
+    PanDB db = { .layer_type = LAYER_TYPE_FLAT };
+    DistancesKernels kernels;
+    unsigned int i;
+    unsigned int t;
+
+    for (i = 0U; i < BENCH_POINTS; i++) {
+        latitudes[i] = 48.5F + (Dimension) (rand() % 10000) / 10000.0F;
+        longitudes[i] = 2.3F + (Dimension) (rand() % 10000) / 10000.0F;
+    }
+    report("flat", "per-call", bench_flat_scalar(&db, &position));
+    for (kernels = DISTANCES_KERNELS_SCALAR;
+         kernels <= DISTANCES_KERNELS_AVX2; kernels++) {
+        if (set_distances_kernels(kernels) == 0) {
+            report("flat", distances_kernels_name(kernels),
+                   bench_flat(&db, &position));
+        }
+    }
+    for (t = 0U; t < sizeof geoidal / sizeof geoidal[0]; t++) {
+        report(geoidal[t].name, "per-call",
+               bench_scalar(&position, geoidal[t].scalar));
+        for (kernels = DISTANCES_KERNELS_SCALAR;
+             kernels <= DISTANCES_KERNELS_AVX2; kernels++) {
+            if (set_distances_kernels(kernels) == 0) {
+                report(geoidal[t].name, distances_kernels_name(kernels),
+                       bench_batch(&position, geoidal[t].batch));
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,278 @@
+#define DEFINE_GLOBALS 1
+#include "common.h"
+#include <time.h>
+
+#define BENCH_SLOTS   1000000U
+#define BENCH_QUERIES 2000U
+#define BENCH_MOVES   200000U
+
+static Position2D positions[BENCH_SLOTS];
+static Position2D queries[BENCH_QUERIES];
+static KeyNode *key_nodes[BENCH_SLOTS];
+static Key key;
+static char fake_context;
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static Dimension random_dimension(const Dimension min, const Dimension max)
+{
+    const int r = rand();
+
+    return min + (max - min) * (Dimension) r / (Dimension) RAND_MAX;
+}
+
+static Position2D random_position(void)
+{
+    static const Position2D cities[] = {
+        { 48.85F, 2.35F }, { 40.71F, -74.0F }, { 35.68F, 139.69F },
+        { -23.55F, -46.63F }, { 51.5F, -0.12F }, { 19.43F, -99.13F }
+    };
+    const Position2D *city;
+
+    if (rand() % 4 == 0) {
+        return (Position2D) {
+            .latitude = random_dimension(-80.0F, 80.0F),
+            .longitude = random_dimension(-179.0F, 179.0F)
+        };
+    }
+    city = &cities[rand() % (int) (sizeof cities / sizeof cities[0])];
+
+    return (Position2D) {
+        .latitude = city->latitude + random_dimension(-0.5F, 0.5F) *
+        random_dimension(0.0F, 1.0F),
+        .longitude = city->longitude + random_dimension(-0.5F, 0.5F) *
+        random_dimension(0.0F, 1.0F)
+    };
+}
+
+static SlotPosition slot_position(const Position2D * const position)
+{
+    SlotPosition slot_position;
+
+    if (make_slot_position(&slot_position, (double) position->latitude,
+                           (double) position->longitude) != 0) {
+        exit(1);
+    }
+    return slot_position;
+}
+
+static void new_key_nodes(PanDB * const db, KeyNode * * const key_nodes_)
+{
+    const KeyNode template_key_node = { .key = &key };
+    unsigned int i;
+
+    for (i = 0U; i < BENCH_SLOTS; i++) {
+        key_nodes_[i] = new_key_node_entry(db, &template_key_node);
+        if (key_nodes_[i] == NULL) {
+            exit(1);
+        }
+    }
+}
+
+static void free_key_nodes(PanDB * const db, KeyNode * * const key_nodes_)
+{
+    unsigned int i;
+
+    for (i = 0U; i < BENCH_SLOTS; i++) {
+        if (key_nodes_[i]->slot != NULL) {
+            remove_entry_from_key_node(db, key_nodes_[i], 0);
+            key_nodes_[i]->slot = NULL;
+        }
+        free_key_node_entry(db, key_nodes_[i]);
+    }
+}
+
+static int count_cb(void * const context, Slot * const slot,
+                    Meters distance)
+{
+    SubSlots * const count = context;
+
+    (void) slot;
+    (void) distance;
+    (*count)++;
+
+    return 0;
+}
+
+static void report(const char * const engine, const char * const name,
+                   const double elapsed, const unsigned int nb_ops,
+                   const SubSlots results)
+{
+    printf("%-9s %-16s %10.1f ns/op  %12lu results\n", engine, name,
+           elapsed * 1e9 / (double) nb_ops, results);
+    fflush(stdout);
+}
+
+static void bench_bulk_load(const char * const engine)
+{
+    static KeyNode *bulk_key_nodes[BENCH_SLOTS];
+    PanDB db;
+    Slot slot;
+    Slot *new_slot;
+    double start;
+    unsigned int i;
+
+    if (init_pan_db(&db, (struct HttpHandlerContext_ *) &fake_context) != 0) {
+        exit(1);
+    }
+    new_key_nodes(&db, bulk_key_nodes);
+    start = now();
+    begin_bulk_load(&db);
+    for (i = 0U; i < BENCH_SLOTS; i++) {
+        init_slot(&slot);
+        slot.position = slot_position(&positions[i]);
+        slot.key_node = KEY_NODE_REF(&db, bulk_key_nodes[i]);
+        if (add_slot(&db, &slot, &new_slot) != 0) {
+            exit(1);
+        }
+        bulk_key_nodes[i]->slot = new_slot;
+    }
+    if (end_bulk_load(&db) != 0) {
+        exit(1);
+    }
+    report(engine, "bulk insert", now() - start, BENCH_SLOTS,
+           db.root.sub_slots);
+    free_key_nodes(&db, bulk_key_nodes);
+    free_pan_db(&db);
+}
+
+static void bench(const IndexType index_type, const char * const engine)
+{
+    static const Meters radiuses[] = { 1000.0F, 20000.0F };
+    PanDB db;
+    Slot slot;
+    Slot *new_slot;
+    Rectangle2D rect;
+    SubSlots results;
+    SubSlots count;
+    double start;
+    unsigned int i;
+
+    app_context.default_index_type = index_type;
+    if (init_pan_db(&db, (struct HttpHandlerContext_ *) &fake_context) != 0) {
+        exit(1);
+    }
+    new_key_nodes(&db, key_nodes);
+    start = now();
+    for (i = 0U; i < BENCH_SLOTS; i++) {
+        init_slot(&slot);
+        slot.position = slot_position(&positions[i]);
+        slot.key_node = KEY_NODE_REF(&db, key_nodes[i]);
+        if (add_slot(&db, &slot, &new_slot) != 0) {
+            exit(1);
+        }
+        key_nodes[i]->slot = new_slot;
+    }
+    report(engine, "insert", now() - start, BENCH_SLOTS, db.root.sub_slots);
+    bench_bulk_load(engine);
+    for (i = 0U; i < sizeof radiuses / sizeof radiuses[0]; i++) {
+        unsigned int q;
+        char name[32];
+
+        results = (SubSlots) 0U;
+        start = now();
+        for (q = 0U; q < BENCH_QUERIES; q++) {
+            find_near(&db, count_cb, NULL, &results, &queries[q],
+                      radiuses[i], (SubSlots) ULONG_MAX, (Dimension) 0.0F);
+        }
+        snprintf(name, sizeof name, "near %gkm", (double) radiuses[i] / 1e3);
+        report(engine, name, now() - start, BENCH_QUERIES, results);
+    }
+    results = (SubSlots) 0U;
+    start = now();
+    for (i = 0U; i < BENCH_QUERIES; i++) {
+        find_nearest(&db, count_cb, &results, &queries[i],
+                     (Meters) -1.0F, (SubSlots) 10U);
+    }
+    report(engine, "nearest 10", now() - start, BENCH_QUERIES, results);
+    results = (SubSlots) 0U;
+    start = now();
+    for (i = 0U; i < BENCH_QUERIES; i++) {
+        rect = (Rectangle2D) {
+            .edge0 = queries[i],
+            .edge1 = {
+                .latitude = queries[i].latitude + 0.2F,
+                .longitude = queries[i].longitude + 0.2F
+            }
+        };
+        find_in_rect(&db, count_cb, NULL, &results, &rect,
+                     (SubSlots) ULONG_MAX, (Dimension) 0.0F);
+    }
+    report(engine, "in_rect", now() - start, BENCH_QUERIES, results);
+    results = (SubSlots) 0U;
+    start = now();
+    for (i = 0U; i < BENCH_QUERIES; i++) {
+        rect = (Rectangle2D) {
+            .edge0 = queries[i],
+            .edge1 = {
+                .latitude = queries[i].latitude + 2.0F,
+                .longitude = queries[i].longitude + 2.0F
+            }
+        };
+        count_in_rect(&db, &rect, &count);
+        results += count;
+    }
+    report(engine, "count_in_rect", now() - start, BENCH_QUERIES, results);
+
+    srand(2);
+    start = now();
+    for (i = 0U; i < BENCH_MOVES; i++) {
+        KeyNode * const key_node = key_nodes[(unsigned int) rand() %
+                                             BENCH_SLOTS];
+        Position2D position = SLOT_POSITION(&key_node->slot->position);
+        SlotPosition new_position;
+
+        position.latitude += random_dimension(-0.01F, 0.01F);
+        position.longitude += random_dimension(-0.01F, 0.01F);
+        new_position = slot_position(&position);
+        if (move_slot(&db, key_node->slot, &new_position) == 0) {
+            continue;
+        }
+        remove_entry_from_key_node(&db, key_node, 0);
+        init_slot(&slot);
+        slot.position = new_position;
+        slot.key_node = KEY_NODE_REF(&db, key_node);
+        if (add_slot(&db, &slot, &new_slot) != 0) {
+            exit(1);
+        }
+        key_node->slot = new_slot;
+    }
+    report(engine, "move", now() - start, BENCH_MOVES, db.root.sub_slots);
+    start = now();
+    for (i = 0U; i < BENCH_SLOTS; i += 2U) {
+        remove_entry_from_key_node(&db, key_nodes[i], 0);
+        key_nodes[i]->slot = NULL;
+    }
+    report(engine, "remove", now() - start, BENCH_SLOTS / 2U,
+           db.root.sub_slots);
+    free_key_nodes(&db, key_nodes);
+    free_pan_db(&db);
+}
+
+int main(void)
+{
+    unsigned int i;
+
+    app_context.default_layer_type = LAYER_TYPE_ELLIPSOIDAL;
+    app_context.default_accuracy = ACCURACY_FAST;
+    app_context.bucket_size = BUCKET_SIZE;
+    app_context.dimension_accuracy = DEFAULT_DIMENSION_ACCURACY;
+    init_distances();
+    srand(1);
+    for (i = 0U; i < BENCH_SLOTS; i++) {
+        positions[i] = random_position();
+    }
+    for (i = 0U; i < BENCH_QUERIES; i++) {
+        queries[i] = random_position();
+    }
+    bench(INDEX_TYPE_QUADTREE, "quadtree");
+    bench(INDEX_TYPE_MORTON, "morton");
+
+    return 0;
+}
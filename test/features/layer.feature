@@ -20,6 +20,7 @@ Feature: Layer API
                             "geo_records": 0,
                             "type": "geoidal",
                             "distance_accuracy": "fast",
+                            "index": "quadtree",
                             "latitude_accuracy": 0.0001,
                             "longitude_accuracy": 0.0001,
                             "bounds": [
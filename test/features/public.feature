@@ -9,3 +9,9 @@ Feature: Public API
     """
     <html><body><h1>Hello world</h1></body></html>
     """
+  Scenario: get without content
+    Given Pincaster is started
+    And Layer 'restaurants' is created
+    And Record 'efgh' is created in layer 'restaurants' with location '_loc=48.512,2.243' and properties 'name=MacDonalds'
+    When Client GET /public/restaurants/efgh
+    Then Pincaster throws 404
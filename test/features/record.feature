@@ -96,3 +96,54 @@ Feature: Record API
               }
       }
       """
+  Scenario: import
+    Given Pincaster is started
+      And Layer 'restaurants' is created
+      When Client POST /api/1.0/records/restaurants.json with:
+      """
+      _key=abcd&_loc=48.512,2.243&name=MacDonalds
+      _key=efgh&_loc=48.510,2.240
+      _key=home&description=Maison
+      """
+      Then Pincaster returns:
+      """
+      {
+              "status": "stored",
+              "records": 3
+      }
+      """
+      When Client GET /api/1.0/records/restaurants/abcd.json
+      Then Pincaster returns:
+      """
+      {
+              "key": "abcd",
+              "type": "point+hash",
+              "latitude": 48.512,
+              "longitude": 2.243,
+              "properties": {
+                      "name": "MacDonalds"
+              }
+      }
+      """
+      When Client GET /api/1.0/search/restaurants/nearby/48.510,2.240.json?radius=1000&properties=0
+      Then Pincaster returns:
+      """
+      {
+              "matches": [
+                      {
+                              "distance": 313.502,
+                              "key": "abcd",
+                              "type": "point+hash",
+                              "latitude": 48.512,
+                              "longitude": 2.243
+                      },
+                      {
+                              "distance": 0,
+                              "key": "efgh",
+                              "type": "point",
+                              "latitude": 48.51,
+                              "longitude": 2.24
+                      }
+              ]
+      }
+      """
@@ -24,6 +24,83 @@ Feature: Search API
               ]
       }
       """
+  Scenario: nearby sorted by distance
+    Given Pincaster is started
+      And Layer 'restaurants' is created
+      And Record 'abcd' is created in layer 'restaurants' with location '_loc=48.512,2.243' and properties 'name=MacDonalds'
+      And Record 'abce' is created in layer 'restaurants' with location '_loc=48.612,2.343' and properties 'name=MacDonalds2'
+      And Record 'abde' is created in layer 'restaurants' with location '_loc=48.712,2.443' and properties 'name=MacDonalds3'
+      When Client GET /api/1.0/search/restaurants/nearby/48.710,2.440.json?radius=20000&limit=1&sort=distance&properties=0
+      Then Pincaster returns:
+      """
+      {
+              "matches": [
+                      {
+                              "distance": 312.888,
+                              "key": "abde",
+                              "type": "point+hash",
+                              "latitude": 48.712,
+                              "longitude": 2.443
+                      }
+              ]
+      }
+      """
+  Scenario: nearest
+    Given Pincaster is started
+      And Layer 'restaurants' is created
+      And Record 'abcd' is created in layer 'restaurants' with location '_loc=48.512,2.243' and properties 'name=MacDonalds'
+      And Record 'abce' is created in layer 'restaurants' with location '_loc=48.612,2.343' and properties 'name=MacDonalds2'
+      And Record 'abde' is created in layer 'restaurants' with location '_loc=48.712,2.443' and properties 'name=MacDonalds3'
+      When Client GET /api/1.0/search/restaurants/nearest/48.710,2.440.json?k=2&properties=0
+      Then Pincaster returns:
+      """
+      {
+              "matches": [
+                      {
+                              "distance": 312.888,
+                              "key": "abde",
+                              "type": "point+hash",
+                              "latitude": 48.712,
+                              "longitude": 2.443
+                      },
+                      {
+                              "distance": 12826.3,
+                              "key": "abce",
+                              "type": "point+hash",
+                              "latitude": 48.612,
+                              "longitude": 2.343
+                      }
+              ]
+      }
+      """
+  Scenario: nearest in a morton layer
+    Given Pincaster is started
+      And Client POST /api/1.0/layers/restaurants.json?index=morton ''
+      And Record 'abcd' is created in layer 'restaurants' with location '_loc=48.512,2.243' and properties 'name=MacDonalds'
+      And Record 'abce' is created in layer 'restaurants' with location '_loc=48.612,2.343' and properties 'name=MacDonalds2'
+      And Record 'abde' is created in layer 'restaurants' with location '_loc=48.712,2.443' and properties 'name=MacDonalds3'
+      When Client GET /api/1.0/search/restaurants/nearest/48.710,2.440.json?k=2&properties=0
+      Then Pincaster returns:
+      """
+      {
+              "matches": [
+                      {
+                              "distance": 312.888,
+                              "key": "abde",
+                              "type": "point+hash",
+                              "latitude": 48.712,
+                              "longitude": 2.443
+                      },
+                      {
+                              "distance": 12826.3,
+                              "key": "abce",
+                              "type": "point+hash",
+                              "latitude": 48.612,
+                              "longitude": 2.343
+                      }
+              ]
+      }
+      """
   Scenario: in_rect
     Given Pincaster is started
       And Layer 'restaurants' is created
@@ -43,6 +120,183 @@ Feature: Search API
               ]
       }
       """
+  Scenario: nearby count=1
+    Given Pincaster is started
+    And Layer 'restaurants' is created
+    And Record 'abcd' is created in layer 'restaurants' with location '_loc=48.512,2.243' and properties 'name=MacDonalds&address=blabla&visits=100000'
+    And Record 'abce' is created in layer 'restaurants' with location '_loc=48.612,2.343' and properties 'name=MacDonalds2&address=blabla2&visits=200000'
+    And Record 'abde' is created in layer 'restaurants' with location '_loc=48.712,2.443' and properties 'name=MacDonalds3&address=blabla3&visits=300000'
+    When Client GET /api/1.0/search/restaurants/nearby/48.510,2.240.json?radius=15000&count=1
+      Then Pincaster returns:
+      """
+      {
+              "count": 2
+      }
+      """
+  Scenario: in_rect count=1
+    Given Pincaster is started
+    And Layer 'restaurants' is created
+    And Record 'abcd' is created in layer 'restaurants' with location '_loc=48.512,2.243' and properties 'name=MacDonalds&address=blabla&visits=100000'
+    And Record 'abce' is created in layer 'restaurants' with location '_loc=48.612,2.343' and properties 'name=MacDonalds2&address=blabla2&visits=200000'
+    And Record 'abde' is created in layer 'restaurants' with location '_loc=48.712,2.443' and properties 'name=MacDonalds3&address=blabla3&visits=300000'
+    When Client GET /api/1.0/search/restaurants/in_rect/48.000,2.000,48.700,3.000.json?count=1
+      Then Pincaster returns:
+      """
+      {
+              "count": 2
+      }
+      """
+  Scenario: in_rect after moves
+    Given Pincaster is started
+    And Layer 'restaurants' is created
+    And Record 'abcd' is created in layer 'restaurants' with location '_loc=48.512,2.243' and properties 'name=MacDonalds&address=blabla&visits=100000'
+    When Client PUT /api/1.0/records/restaurants/abcd.json '_loc=48.513,2.244'
+    When Client PUT /api/1.0/records/restaurants/abcd.json '_loc=48.612,2.343'
+    When Client GET /api/1.0/search/restaurants/in_rect/48.600,2.300,48.700,2.400.json?count=1
+      Then Pincaster returns:
+      """
+      {
+              "count": 1
+      }
+      """
+    When Client GET /api/1.0/search/restaurants/in_rect/48.500,2.200,48.600,2.300.json?count=1
+      Then Pincaster returns:
+      """
+      {
+              "count": 0
+      }
+      """
+  Scenario: in_rect clusters
+    Given Pincaster is started
+      And Layer 'spots' is created
+      And A 8x8 grid of records is created in layer 'spots' from '48.5,2.5' with a step of '0.0001'
+      And Record 'far' is created in layer 'spots' with location '_loc=48.55,2.55' and properties 'name=far'
+      When Client GET /api/1.0/search/spots/in_rect/48.4,2.4,48.6,2.6.json?epsilon=0.01&properties=0
+      Then Pincaster returns:
+      """
+      {
+              "matches": [
+                      {
+                              "distance": 9236.689453125,
+                              "key": "far",
+                              "type": "point+hash",
+                              "latitude": 48.54999923706055,
+                              "longitude": 2.549999952316284
+                      },
+                      {
+                              "type": "cluster",
+                              "children": 64,
+                              "latitude": 48.50035095214844,
+                              "longitude": 2.500349998474121,
+                              "radius": 36.038909912109375
+                      }
+              ]
+      }
+      """
+  Scenario: nearby clusters
+    Given Pincaster is started
+      And Layer 'spots' is created
+      And A 8x8 grid of records is created in layer 'spots' from '48.5,2.5' with a step of '0.0001'
+      And Record 'far' is created in layer 'spots' with location '_loc=48.55,2.55' and properties 'name=far'
+      When Client GET /api/1.0/search/spots/nearby/48.5,2.5.json?radius=10000&epsilon=0.01&properties=0
+      Then Pincaster returns:
+      """
+      {
+              "matches": [
+                      {
+                              "distance": 6599.08837890625,
+                              "key": "far",
+                              "type": "point+hash",
+                              "latitude": 48.54999923706055,
+                              "longitude": 2.549999952316284
+                      },
+                      {
+                              "type": "cluster",
+                              "children": 64,
+                              "latitude": 48.50035095214844,
+                              "longitude": 2.500349998474121,
+                              "radius": 36.038909912109375
+                      }
+              ]
+      }
+      """
+  Scenario: nearby with a null epsilon
+    Given Pincaster is started
+      And Layer 'spots' is created
+      When Client GET /api/1.0/search/spots/nearby/48.5,2.5.json?radius=10000&epsilon=0
+      Then Pincaster throws 400
+  Scenario: nearby with a negative epsilon
+    Given Pincaster is started
+      And Layer 'spots' is created
+      When Client GET /api/1.0/search/spots/nearby/48.5,2.5.json?radius=10000&epsilon=-1
+      Then Pincaster throws 400
+  Scenario: in_polygon
+    Given Pincaster is started
+    And Layer 'restaurants' is created
+    And Record 'abcd' is created in layer 'restaurants' with location '_loc=48.512,2.243' and properties 'name=MacDonalds&address=blabla&visits=100000'
+    And Record 'abce' is created in layer 'restaurants' with location '_loc=48.612,2.343' and properties 'name=MacDonalds2&address=blabla2&visits=200000'
+    And Record 'abde' is created in layer 'restaurants' with location '_loc=48.712,2.443' and properties 'name=MacDonalds3&address=blabla3&visits=300000'
+    When Client POST /api/1.0/search/restaurants/in_polygon.json?properties=0 'polygon=48.500,2.200,48.550,2.400,48.700,2.300'
+      Then Pincaster returns:
+      """
+      {
+              "matches": [
+                      {
+                              "distance": 13965.8,
+                              "key": "abcd",
+                              "type": "point+hash",
+                              "latitude": 48.512,
+                              "longitude": 2.243
+                      },
+                      {
+                              "distance": 4493.03,
+                              "key": "abce",
+                              "type": "point+hash",
+                              "latitude": 48.612,
+                              "longitude": 2.343
+                      }
+              ]
+      }
+      """
+  Scenario: containing
+    Given Pincaster is started
+    And Layer 'zones' is created
+    And Record 'center' is created in layer 'zones' with location '_polygon=48.5,2.25,48.5,2.5,48.75,2.5,48.75,2.25' and properties 'name=Center'
+    And Record 'east' is created in layer 'zones' with location '_polygon=48.5,2.5,48.5,2.75,48.75,2.75' and properties 'name=East'
+    When Client GET /api/1.0/search/zones/containing/48.600,2.300.json?properties=0
+      Then Pincaster returns:
+      """
+      {
+              "matches": [
+                      {
+                              "key": "center",
+                              "type": "polygon+hash",
+                              "polygon": [
+                                      [ 48.5, 2.25 ],
+                                      [ 48.5, 2.5 ],
+                                      [ 48.75, 2.5 ],
+                                      [ 48.75, 2.25 ]
+                              ]
+                      }
+              ]
+      }
+      """
+  Scenario: grid
+    Given Pincaster is started
+    And Layer 'restaurants' is created
+    And Record 'abcd' is created in layer 'restaurants' with location '_loc=48.512,2.243' and properties 'name=MacDonalds&address=blabla&visits=100000'
+    And Record 'abce' is created in layer 'restaurants' with location '_loc=48.612,2.343' and properties 'name=MacDonalds2&address=blabla2&visits=200000'
+    And Record 'abde' is created in layer 'restaurants' with location '_loc=48.712,2.443' and properties 'name=MacDonalds3&address=blabla3&visits=300000'
+    When Client GET /api/1.0/search/restaurants/grid/48.500,2.200,48.800,2.500.json?cols=2&rows=2&sum=visits
+      Then Pincaster returns:
+      """
+      {
+              "cols": 2,
+              "rows": 2,
+              "cells": [ [ 2, 0 ], [ 0, 1 ] ],
+              "sums": [ [ 300000.0, 0.0 ], [ 0.0, 300000.0 ] ]
+      }
+      """
   Scenario: keys
     Given Pincaster is started
     And Layer 'restaurants' is created
@@ -22,6 +22,15 @@ Given /^Record '(.*)' is created in layer '(.*)' with location '(.*)' and proper
   RestClient.put 'localhost:4269/api/1.0/records/'+layer+'/'+record+'.json', location+'&'+properties
 end
 
+Given /^A (\d+)x(\d+) grid of records is created in layer '(.*)' from '(.*),(.*)' with a step of '(.*)'$/ do |rows, cols, layer, latitude, longitude, step|
+  body = (0...rows.to_i).flat_map do |i|
+    (0...cols.to_i).map do |j|
+      '_key=p%d%d&_loc=%.4f,%.4f' % [i, j, latitude.to_f + i * step.to_f, longitude.to_f + j * step.to_f]
+    end
+  end
+  RestClient.post 'localhost:4269/api/1.0/records/'+layer+'.json', body.join("\n")
+end
+
 def capture_api_result
   begin
     result = JSON.parse(yield)
@@ -37,9 +46,13 @@ When /^Client GET (\/api\/.*)$/ do |path|
 end
 
 When /^Client GET (\/public\/.*)$/ do |path|
-  @result = RestClient.get 'localhost:4269'+path do |response, request|
-    @content_type = response.headers[:content_type]
-    response.return!
+  begin
+    @result = RestClient.get 'localhost:4269'+path do |response, request|
+      @content_type = response.headers[:content_type]
+      response.return!
+    end
+  rescue Exception=>e
+    @result = e.class
   end
 end
 
@@ -47,6 +60,10 @@ When /^Client POST (.*) '(.*)'$/ do |path, content|
   @result = capture_api_result { RestClient.post 'localhost:4269'+path, content }
 end
 
+When /^Client POST (.*) with:$/ do |path, content|
+  @result = capture_api_result { RestClient.post 'localhost:4269'+path, content }
+end
+
 When /^Client DELETE (.*)$/ do |path|
   @result = capture_api_result { RestClient.delete 'localhost:4269'+path }
 end
@@ -72,3 +89,7 @@ end
 Then /^Pincaster throws 404$/ do
   @result.should == RestClient::ResourceNotFound
 end
+
+Then /^Pincaster throws 400$/ do
+  @result.should == RestClient::BadRequest
+end